@@ -0,0 +1,74 @@
+//
+// Compares the Verlet update written with the AddArrays/SetToScaled helpers against the
+// same update written as array expressions.
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "Cloth.h"
+#include "BenchReport.h"
+
+using namespace std;
+
+int main() {
+
+    double m = 0.1;
+    double dt = 0.001;
+
+    cout << setw(6) << "N" << setw(10) << "nodes" << setw(16) << "helpers [ms]"
+         << setw(16) << "expr [ms]" << setw(10) << "speedup" << setw(12) << "max diff" << endl;
+
+    int sizes[] = {20, 200, 2000};
+    for (int N : sizes) {
+
+        int numNodes = N*N;
+
+        ArrayT<Vec3> force_int(numNodes), force_vis(numNodes), force_gravity(numNodes);
+        ArrayT<Vec3> pos_old(numNodes), forces, acc;
+        for (int n = 0; n < numNodes; n++) {
+            force_int[n] = Vec3(0.01*(n % 13), -0.02*(n % 7), 0.03*(n % 5));
+            force_vis[n] = Vec3(-0.001*(n % 3), 0.0, 0.001);
+            force_gravity[n] = Vec3(0.0, 0.0, -0.98);
+            pos_old[n] = Vec3(n % N, n / N, 0.0);
+        }
+        ArrayT<Vec3> pos_helpers, pos_expr;
+        pos_helpers = pos_old;
+        pos_expr = pos_old;
+
+        /* the update of the time loop, once with the helpers ... */
+        double helpers_ms = TimeIt([&]() {
+            forces = AddArrays(force_int, force_vis, force_gravity);
+            acc = SetToScaled(forces, 1.0/m);
+            pos_helpers = AddArrays(SetToScaled(pos_helpers, 2.0), SetToScaled(pos_old, -1), SetToScaled(acc, dt*dt));
+        }, 0.5);
+
+        /* ... and once with expressions */
+        double expr_ms = TimeIt([&]() {
+            forces = force_int + force_vis + force_gravity;
+            acc = (1.0/m)*forces;
+            pos_expr = 2.0*pos_expr - pos_old + (dt*dt)*acc;
+        }, 0.5);
+
+        /* both variants should agree after the same number of updates */
+        pos_helpers = pos_old;
+        pos_expr = pos_old;
+        for (int r = 0; r < 3; r++) {
+            forces = AddArrays(force_int, force_vis, force_gravity);
+            acc = SetToScaled(forces, 1.0/m);
+            pos_helpers = AddArrays(SetToScaled(pos_helpers, 2.0), SetToScaled(pos_old, -1), SetToScaled(acc, dt*dt));
+
+            forces = force_int + force_vis + force_gravity;
+            acc = (1.0/m)*forces;
+            pos_expr = 2.0*pos_expr - pos_old + (dt*dt)*acc;
+        }
+        double diff = 0.0;
+        for (int n = 0; n < numNodes; n++) {
+            diff = Max(diff, (pos_helpers[n] - pos_expr[n]).Magnitude());
+        }
+
+        cout << setw(6) << N << setw(10) << numNodes << setw(16) << helpers_ms << setw(16) << expr_ms
+             << setw(10) << helpers_ms/expr_ms << setw(12) << diff << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+//
+// Shared by the benchmarks: the timing of a call and machine-readable results, one JSON file per run
+// to compare builds.
+//
+
+#ifndef SIMPLECLOTH_BENCHREPORT_H
+#define SIMPLECLOTH_BENCHREPORT_H
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** \name the build, set by the CMake file */
+/*@{*/
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE ""
+#endif
+#ifndef BENCH_COMPILER
+#define BENCH_COMPILER __VERSION__
+#endif
+/*@}*/
+
+/** Average wall-clock time of one call in ms, repeated for at least minSeconds */
+inline double TimeIt(const std::function<void()>& step, double minSeconds) {
+
+    typedef std::chrono::steady_clock clock;
+
+    int reps = 0;
+    double elapsed = 0.0;
+    clock::time_point start = clock::now();
+    do {
+        step();
+        reps++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < minSeconds);
+
+    return 1000.0*elapsed/reps;
+}
+
+/**
+ * Collects (benchmark, N, value) records and writes them with the build and the machine they
+ * were measured on:
+ *
+ *   {"suite": "micro", "build_type": "Release", "compiler": "...", "hardware_threads": 8,
+ *    "date": "...", "results": [{"name": "internal_forces", "N": 128, "unit": "ms", "value": 0.21}, ...]}
+ */
+class BenchReport {
+
+protected:
+    struct Record {
+        std::string name;
+        int N;
+        std::string unit;
+        double value;
+    };
+
+    std::string fSuite;
+    std::vector<Record> fRecords;
+
+public:
+    explicit BenchReport(const std::string& suite): fSuite(suite) { };
+
+    void Add(const std::string& name, int N, const std::string& unit, double value) {
+        fRecords.push_back(Record{name, N, unit, value});
+    };
+
+    /** Throws std::runtime_error if the file cannot be written */
+    void Write(const std::string& filename) const {
+
+        std::ofstream out(filename);
+        if (!out) throw std::runtime_error("BenchReport: cannot create " + filename);
+
+        char date[32];
+        std::time_t now = std::time(NULL);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+        out.precision(10);
+        out << "{\n  \"suite\": \"" << fSuite << "\",\n"
+            << "  \"build_type\": \"" << BENCH_BUILD_TYPE << "\",\n"
+            << "  \"compiler\": \"" << BENCH_COMPILER << "\",\n"
+            << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"date\": \"" << date << "\",\n"
+            << "  \"results\": [";
+        for (size_t r = 0; r < fRecords.size(); r++) {
+            const Record& record = fRecords[r];
+            out << (r > 0 ? ",\n" : "\n") << "    {\"name\": \"" << record.name << "\", \"N\": " << record.N
+                << ", \"unit\": \"" << record.unit << "\", \"value\": " << record.value << "}";
+        }
+        out << "\n  ]\n}\n";
+
+        if (!out) throw std::runtime_error("BenchReport: cannot write " + filename);
+    };
+};
+
+#endif //SIMPLECLOTH_BENCHREPORT_H
@@ -0,0 +1,198 @@
+//
+// Locality of the numberings of a garment: the springs of a sleeve whose vertices come in a scattered
+// order, against the same sleeve renumbered by reverse Cuthill-McKee and along the Morton curve.
+// The cache misses of the spring walks are counted by the hardware where the kernel allows it, and
+// by a model of the caches in any case.
+//
+// usage: SimpleCloth_bench_garment [--json file] [--seconds s] [segments ...]
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "TriangleMesh.h"
+#include "Garment.h"
+#include "SpringNetwork.h"
+#include "StrainLimiter.h"
+#include "BenchReport.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* The last level cache misses of this thread in user space, if the kernel lets us count them */
+class CacheMissCounter {
+
+protected:
+    int fDescriptor;
+
+public:
+    CacheMissCounter() {
+        perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fDescriptor = int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+    };
+
+    ~CacheMissCounter() { if (fDescriptor >= 0) close(fDescriptor); };
+
+    bool Available() const { return fDescriptor >= 0; };
+
+    /* the misses of one call of step, -1 if they cannot be counted */
+    long Count(const std::function<void()>& step) {
+        if (fDescriptor < 0) {
+            step();
+            return -1;
+        }
+        ioctl(fDescriptor, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+        step();
+        ioctl(fDescriptor, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fDescriptor, &count, sizeof(count)) != sizeof(count)) return -1;
+        return long(count);
+    };
+};
+
+/* A set associative cache of 64 byte lines with LRU replacement */
+class CacheModel {
+
+protected:
+    int fSets;
+    int fWays;
+    ArrayT<uint64_t> fTags;     /**< of the ways of every set, the most recent first */
+    long fMisses;
+
+public:
+    CacheModel(int bytes, int ways): fSets(bytes/(64*ways)), fWays(ways), fTags(bytes/64), fMisses(0) {
+        fTags = ~uint64_t(0);
+    };
+
+    void Touch(const void* address) {
+        uint64_t line = reinterpret_cast<uintptr_t>(address)/64;
+        uint64_t* set = fTags.Pointer(int(line % fSets)*fWays);
+        int way = 0;
+        while (way < fWays && set[way] != line) way++;
+        if (way == fWays) {
+            fMisses++;
+            way = fWays - 1;
+        }
+        for (; way > 0; way--) set[way] = set[way - 1];
+        set[0] = line;
+    };
+
+    long Misses() const { return fMisses; };
+};
+
+/* the lines of positions and forces touched by one pass of internal_forces, through a cache of bytes */
+static long ModelMisses(const SpringNetwork& springs, const ArrayT<Vec3>& pos, const ArrayT<Vec3>& force, int bytes) {
+
+    CacheModel cache(bytes, 8);
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        cache.Touch(&springs[s]);
+        cache.Touch(pos.Pointer(springs[s].i));
+        cache.Touch(pos.Pointer(springs[s].j));
+        cache.Touch(force.Pointer(springs[s].i));
+        cache.Touch(force.Pointer(springs[s].j));
+    }
+    return cache.Misses();
+}
+
+int main(int argc, char* argv[]) {
+
+    string json;
+    double seconds = 0.5;
+    vector<int> sizes;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) json = argv[++a];
+        else if (strcmp(argv[a], "--seconds") == 0 && a + 1 < argc) seconds = atof(argv[++a]);
+        else sizes.push_back(atoi(argv[a]));
+    }
+    if (sizes.empty()) sizes = {64, 256, 512};
+
+    CacheMissCounter counter;
+    BenchReport report("garment");
+
+    cout << "springs of a sleeve of segments x segments nodes, model of 32 KB and 1 MB caches of 8 ways";
+    cout << (counter.Available() ? ", hardware misses of the last level" : ", no hardware counters") << endl;
+    cout << setw(9) << "segments" << setw(8) << "order" << setw(11) << "bandwidth" << setw(11) << "mean span"
+         << setw(13) << "32K miss/s" << setw(12) << "1M miss/s" << setw(13) << "LLC miss/s" << setw(12) << "forces ms"
+         << setw(12) << "Msprings/s" << setw(11) << "limit ms" << setw(9) << "speedup" << endl;
+
+    for (int segments : sizes) {
+        /* a sleeve of square cells, its vertices shuffled as by an exporter which wrote them panel by
+         * panel in no particular order */
+        double radius = 1.0;
+        double height = 2.0*3.14159265358979*radius;
+        TriangleMesh tube = TubeMesh(Vec3(0.0, 0.0, 0.0), radius, height, segments, segments);
+        ArrayT<int> shuffle = NodeNumbering(tube, kImportOrder);
+        std::mt19937 random(1234);
+        std::shuffle(shuffle.Pointer(), shuffle.Pointer() + shuffle.Length(), random);
+        TriangleMesh imported = RenumberVertices(tube, shuffle);
+
+        double importMs = 0.0;
+        for (NodeOrder order : {kImportOrder, kCuthillMcKee, kMortonOrder}) {
+            const char* name = order == kImportOrder ? "import" : (order == kCuthillMcKee ? "rcm" : "morton");
+            TriangleMesh mesh = RenumberVertices(imported, NodeNumbering(imported, order));
+            SpringNetwork springs = MeshSprings(mesh);
+            springs.SetRestState(mesh.vertices, 1000.0);
+            int S = springs.NumSprings();
+
+            /* the sleeve a little stretched, so that the strain limiting works on every spring */
+            ArrayT<Vec3> pos(mesh.NumVertices()), force(mesh.NumVertices());
+            for (int n = 0; n < pos.Length(); n++) pos[n] = Vec3(mesh.vertices[n].x, mesh.vertices[n].y, 1.2*mesh.vertices[n].z);
+            ArrayT<int> pinned;
+            StrainLimiter limiter(0.1, 1, kGaussSeidel);
+
+            long small = ModelMisses(springs, pos, force, 32*1024);
+            long large = ModelMisses(springs, pos, force, 1024*1024);
+            long hardware = counter.Count([&]() { internal_forces(springs, pos, force); });
+            double forcesMs = TimeIt([&]() { internal_forces(springs, pos, force); }, seconds);
+            ArrayT<Vec3> limited(pos.Length());
+            StepArena arena;
+            ArenaScope scope(arena);
+            double limitMs = TimeIt([&]() {
+                arena.Reset();
+                limited = pos;
+                limiter.Apply(springs, pinned, limited);
+            }, seconds);
+            if (order == kImportOrder) importMs = forcesMs;
+
+            cout << setw(9) << segments << setw(8) << name << setw(11) << Bandwidth(springs)
+                 << setw(11) << fixed << setprecision(1) << MeanSpringSpan(springs)
+                 << setw(13) << setprecision(3) << double(small)/S << setw(12) << double(large)/S;
+            if (hardware >= 0) cout << setw(13) << double(hardware)/S;
+            else cout << setw(13) << "-";
+            cout << setw(12) << setprecision(3) << forcesMs << setw(12) << S/forcesMs/1000.0
+                 << setw(11) << limitMs << setw(9) << setprecision(2) << importMs/forcesMs << endl;
+
+            string label = string(name) + " ";
+            report.Add(label + "internal_forces", segments, "Msprings/s", S/forcesMs/1000.0);
+            report.Add(label + "strain limiting", segments, "ms", limitMs);
+            report.Add(label + "modelled 32K misses", segments, "per spring", double(small)/S);
+            report.Add(label + "modelled 1M misses", segments, "per spring", double(large)/S);
+            if (hardware >= 0) report.Add(label + "LLC misses", segments, "per spring", double(hardware)/S);
+        }
+    }
+
+    if (!json.empty()) report.Write(json);
+    return 0;
+}
@@ -0,0 +1,72 @@
+//
+// Wall-clock time to t_final of the hanging cloth of main(): the Verlet scheme at its stable step
+// against the implicit integrator at steps 50 and 100 times larger.
+//
+// usage: SimpleCloth_bench_integrator [N] [t_final]
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "ClothSimulation.h"
+
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+
+/* Wall-clock time in s of the steps of main() to t_final, without the output. pos gets the positions
+ * at the end, iterations the CG iterations per step of the implicit integrator */
+static double Run(const SimulationOptions& options, ArrayT<Vec3>& pos, double& iterations) {
+
+    ClothSimulation sim(options);
+
+    auto start = std::chrono::steady_clock::now();
+    while (!sim.Finished()) sim.Step();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    pos = sim.Positions();
+    iterations = 0.0;
+    if (const ImplicitIntegrator* integrator = sim.Integrator())
+        iterations = double(integrator->TotalIterations())/Max(integrator->TotalSolves(), 1L);
+    return seconds;
+}
+
+int main(int argc, char* argv[]) {
+
+    SimulationOptions options;
+    options.N = (argc > 1) ? atoi(argv[1]) : 20;
+    options.t_final = (argc > 2) ? atof(argv[2]) : 20;
+    options.dt = 0.001;
+
+    cout << "N = " << options.N << ", t_final = " << options.t_final << endl;
+    cout << setw(10) << "scheme" << setw(8) << "dt" << setw(12) << "time [s]" << setw(14) << "CG iter/step"
+         << setw(14) << "lowest z" << setw(14) << "from verlet" << endl;
+
+    ArrayT<Vec3> reference;
+    double iterations;
+    double verlet = Run(options, reference, iterations);
+    double lowest = 0.0;
+    for (int n = 0; n < reference.Length(); n++) lowest = Min(lowest, reference[n].z);
+    cout << setw(10) << "verlet" << setw(8) << options.dt << setw(12) << verlet << setw(14) << "-" << setw(14)
+         << lowest << setw(14) << 0.0 << endl;
+
+    /* the largest distance of a node from where the Verlet steps put it tells the accuracy */
+    double steps[] = {0.05, 0.1};
+    for (double dt : steps) {
+        options.integrator = "implicit";
+        options.dt = dt;
+        ArrayT<Vec3> pos;
+        double seconds = Run(options, pos, iterations);
+        lowest = 0.0;
+        double deviation = 0.0;
+        for (int n = 0; n < pos.Length(); n++) {
+            lowest = Min(lowest, pos[n].z);
+            deviation = Max(deviation, (pos[n] - reference[n]).Magnitude());
+        }
+        cout << setw(10) << "implicit" << setw(8) << dt << setw(12) << seconds << setw(14) << iterations
+             << setw(14) << lowest << setw(14) << deviation << "   (" << verlet/seconds << "x)" << endl;
+    }
+
+    return 0;
+}
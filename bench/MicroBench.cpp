@@ -0,0 +1,168 @@
+//
+// Microbenchmarks of the building blocks of a step, swept over the size N of the cloth.
+//
+// usage: SimpleCloth_bench_micro [--json file] [--seconds s] [N ...]
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+#include "Cloth.h"
+#include "ForceModels.h"
+#include "SelfCollision.h"
+#include "BenchReport.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+
+    string json;
+    double seconds = 0.2;
+    vector<int> sizes;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) json = argv[++a];
+        else if (strcmp(argv[a], "--seconds") == 0 && a + 1 < argc) seconds = atof(argv[++a]);
+        else sizes.push_back(atoi(argv[a]));
+    }
+    if (sizes.empty()) sizes = {32, 128, 512};
+
+    double length = 10;
+    double k = 1000.0;
+    double c = 0.0001;
+
+    BenchReport report("micro");
+    const char* csv = "bench_micro.csv";
+
+    cout << setw(24) << "ms per call" << fixed << setprecision(4);
+    for (size_t s = 0; s < sizes.size(); s++) cout << setw(12) << ("N = " + to_string(sizes[s]));
+    cout << endl;
+
+    /* one row per benchmark, one column per size */
+    vector<pair<string, function<double(int)> > > benchmarks;
+
+    benchmarks.push_back(make_pair(string("ConnectivityStructure"), [&](int N) {
+        return TimeIt([&]() { SpringNetwork springs = ConnectivityStructure(N); }, seconds);
+    }));
+
+    /* a flat grid with a smooth out of plane perturbation */
+    auto grid = [&](int N) {
+        ArrayT<Vec3> pos(N*N);
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                pos[N*j + i] = Vec3(i * length / (N - 1), j * length / (N - 1), 0.05*sin(0.3*i)*cos(0.2*j));
+            }
+        }
+        return pos;
+    };
+
+    benchmarks.push_back(make_pair(string("internal_forces"), [&](int N) {
+        ArrayT<Vec3> pos = grid(N), force(N*N);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos, k);
+        pos = 1.01*pos;
+        return TimeIt([&]() { internal_forces(springs, pos, force); }, seconds);
+    }));
+
+    /* the broad phase alone and the whole self-collision pass, both linear in the nodes. Their arrays
+     * come from an arena which is reset before every call, as in the steps */
+    StepArena arena;
+    ArenaScope scope(arena);
+    benchmarks.push_back(make_pair(string("SpatialHash::Build"), [&](int N) {
+        ArrayT<Vec3> pos = grid(N);
+        return TimeIt([&]() {
+            arena.Reset();
+            SpatialHash hash;
+            hash.Build(pos, length/(N - 1));
+        }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("SelfCollision"), [&](int N) {
+        ArrayT<Vec3> pos = grid(N), prev = grid(N);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos, k);
+        SelfCollision collision(N, springs, length/(N - 1), 0.2*length/(N - 1));
+        ArrayT<int> pinned;
+        return TimeIt([&]() {
+            arena.Reset();
+            collision.Apply(prev, pinned, pos);
+        }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("viscous_forces"), [&](int N) {
+        ArrayT<Vec3> vel = grid(N), force(N*N);
+        return TimeIt([&]() { viscous_forces(vel, c, force); }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("AddArrays"), [&](int N) {
+        ArrayT<Vec3> a = grid(N), b = grid(N), d = grid(N), sum;
+        return TimeIt([&]() { sum = AddArrays(a, b, d); }, seconds);
+    }));
+
+    /* viscous drag, gravity and wind: an array each and their sum, against adding them in one sweep */
+    benchmarks.push_back(make_pair(string("force arrays + sum"), [&](int N) {
+        ArrayT<Vec3> vel = grid(N), springs = grid(N), vis(N*N), weight(N*N), wind(N*N), force(N*N);
+        return TimeIt([&]() {
+            viscous_forces(vel, c, vis);
+            gravity_force(0.1, weight);
+            for (int n = 0; n < N*N; n++) wind[n] = (Vec3(0, 2, 0) - vel[n])*0.01;
+            force = springs + vis + weight + wind;
+        }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("NodeForcesT"), [&](int N) {
+        ArrayT<Vec3> vel = grid(N), springs = grid(N), force(N*N);
+        ClothNodeForcesT<double> models(ViscousDragT<double>(c), GravityT<double>(0.1), WindT<double>(Vec3(0, 2, 0), 0.01));
+        return TimeIt([&]() { models.Accumulate(vel, vel, springs, force); }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("Aerodynamics"), [&](int N) {
+        ArrayT<Vec3> pos = grid(N), vel(N*N), force(N*N);
+        vel = Vec3(0, 0, 0);
+        Aerodynamics air(GridTriangles(N), Vec3(0, 2, -1), 1.2, 1.0, 0.5);
+        return TimeIt([&]() { air.Accumulate(pos, vel, force); }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("SetToScaled"), [&](int N) {
+        ArrayT<Vec3> a = grid(N), scaled;
+        return TimeIt([&]() { scaled = SetToScaled(a, 0.5); }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("ArrayT::Insert"), [&](int N) {
+        return TimeIt([&]() {
+            ArrayT<Vec3> array;
+            for (int n = 0; n < N*N; n++) array.Insert(Vec3(n, 0, 0));
+        }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("ArrayT::operator="), [&](int N) {
+        ArrayT<Vec3> source = grid(N), copy;
+        return TimeIt([&]() { copy = source; }, seconds);
+    }));
+
+    benchmarks.push_back(make_pair(string("write_csv"), [&](int N) {
+        ArrayT<Vec3> pos = grid(N);
+        return TimeIt([&]() { write_csv(csv, pos); }, seconds);
+    }));
+
+    for (size_t b = 0; b < benchmarks.size(); b++) {
+        cout << setw(24) << benchmarks[b].first << flush;
+        for (size_t s = 0; s < sizes.size(); s++) {
+            double ms = benchmarks[b].second(sizes[s]);
+            report.Add(benchmarks[b].first, sizes[s], "ms", ms);
+            cout << setw(12) << ms << flush;
+        }
+        cout << endl;
+    }
+    std::remove(csv);
+
+    if (!json.empty()) report.Write(json);
+    return 0;
+}
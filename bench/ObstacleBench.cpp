@@ -0,0 +1,106 @@
+//
+// Throughput of the obstacle queries: the nodes of a cloth draped over a sphere against its bounding
+// volume hierarchy, for spheres of more and more triangles, serial and over the threads.
+//
+// usage: SimpleCloth_bench_obstacle [--json file] [--seconds s] [--threads n] [--N n] [segments ...]
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "TriangleMesh.h"
+#include "Obstacle.h"
+#include "ThreadPool.h"
+#include "BenchReport.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+
+    string json;
+    double seconds = 0.5;
+    int threads = 0;
+    int N = 256;
+    vector<int> segments;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) json = argv[++a];
+        else if (strcmp(argv[a], "--seconds") == 0 && a + 1 < argc) seconds = atof(argv[++a]);
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) threads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--N") == 0 && a + 1 < argc) N = atoi(argv[++a]);
+        else segments.push_back(atoi(argv[a]));
+    }
+    if (segments.empty()) segments = {16, 64, 256, 1024};
+
+    /* a cloth of side 4 over a sphere of radius 1, the nodes within a spacing of its surface above it
+     * and moving down onto it */
+    double length = 4.0;
+    double radius = 1.0;
+    double spacing = length/(N - 1);
+    Vec3 center(0.5*length, 0.5*length, 0.0);
+    ArrayT<Vec3> start(N*N), prev(N*N), pos(N*N);
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            Vec3 p(i*spacing, j*spacing, 0.0);
+            double d2 = (p.x - center.x)*(p.x - center.x) + (p.y - center.y)*(p.y - center.y);
+            p.z = (d2 < radius*radius ? sqrt(radius*radius - d2) : 0.0) + spacing*(0.5 + 0.5*sin(0.7*i + 1.3*j));
+            start[N*j + i] = p;
+            prev[N*j + i] = p + Vec3(0.0, 0.0, spacing);
+        }
+    }
+    ArrayT<int> pinned;
+
+    ThreadPool pool(threads);
+    BenchReport report("obstacle");
+
+    cout << "obstacle queries of " << N << " x " << N << " nodes, " << pool.NumThreads() << " threads" << endl;
+    cout << setw(10) << "triangles" << setw(8) << "boxes" << setw(7) << "depth" << setw(12) << "build [ms]"
+         << setw(10) << "contacts" << setw(14) << "ns/node" << setw(14) << "Mnodes/s" << setw(14) << "threaded"
+         << setw(10) << "speedup" << endl;
+
+    for (int s : segments) {
+        TriangleMesh sphere = SphereMesh(center, radius, s);
+
+        typedef std::chrono::steady_clock clock;
+        clock::time_point built = clock::now();
+        Obstacle obstacle(sphere, 0.2*spacing);
+        double buildMs = 1000.0*std::chrono::duration<double>(clock::now() - built).count();
+        const BoundingVolumeHierarchy& bvh = obstacle.Hierarchy();
+
+        /* every call starts from the same positions, so that all of them do the same work, and from
+         * an empty arena as a step does */
+        StepArena arena;
+        ArenaScope scope(arena);
+        pos = start;
+        int contacts = obstacle.Apply(prev, pinned, pos);
+        double serialMs = TimeIt([&]() {
+            arena.Reset();
+            pos = start;
+            obstacle.Apply(prev, pinned, pos);
+        }, seconds);
+        double threadedMs = TimeIt([&]() {
+            arena.Reset();
+            pos = start;
+            obstacle.Apply(prev, pinned, pos, &pool);
+        }, seconds);
+
+        double rate = N*N/serialMs/1000.0;
+        double threadedRate = N*N/threadedMs/1000.0;
+        cout << setw(10) << bvh.NumTriangles() << setw(8) << bvh.NumNodes() << setw(7) << bvh.Depth()
+             << setw(12) << fixed << setprecision(3) << buildMs << setw(10) << contacts
+             << setw(14) << setprecision(1) << 1.0e6*serialMs/(N*N) << setw(14) << setprecision(3) << rate
+             << setw(14) << threadedRate << setw(10) << setprecision(2) << serialMs/threadedMs << endl;
+
+        report.Add("build " + to_string(bvh.NumTriangles()) + " triangles", N, "ms", buildMs);
+        report.Add("queries " + to_string(bvh.NumTriangles()) + " triangles", N, "Mnodes/s", rate);
+        report.Add("threaded queries " + to_string(bvh.NumTriangles()) + " triangles", N, "Mnodes/s", threadedRate);
+    }
+
+    if (!json.empty()) report.Write(json);
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+// Cost of one snapshot (positions and forces) of a N x N cloth: a pair of CSV files against a
+// frame of the binary trajectory, and the size on disk of both. The last columns give the time
+// the stepping loses per snapshot with the background writer, when snapshots are taken while
+// stepping: Submit() and the share of it spent waiting for a free buffer.
+//
+// usage: SimpleCloth_bench_output [N ...]
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "Cloth.h"
+#include "Trajectory.h"
+#include "AsyncTrajectoryWriter.h"
+#include "SpringNetwork.h"
+#include "BenchReport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace std;
+
+static double FileSize(const std::string& filename) {
+    struct stat status;
+    return (stat(filename.c_str(), &status) == 0) ? double(status.st_size) : 0.0;
+}
+
+int main(int argc, char* argv[]) {
+
+    vector<int> sizes;
+    for (int a = 1; a < argc; a++) sizes.push_back(atoi(argv[a]));
+    if (sizes.empty()) sizes = {100, 500, 1000};
+
+    cout << setw(6) << "N" << setw(14) << "csv [ms]" << setw(14) << "traj [ms]" << setw(10) << "speedup"
+         << setw(14) << "csv [MB]" << setw(14) << "traj [MB]" << setw(14) << "submit [ms]" << setw(12) << "stall [ms]" << endl;
+
+    for (int N : sizes) {
+        ArrayT<Vec3> pos(N*N), force(N*N);
+        for (int n = 0; n < N*N; n++) {
+            pos[n] = Vec3(0.01*(n % N), 0.01*(n / N), 0.05*sin(0.3*n));
+            force[n] = Vec3(cos(0.1*n), 0.001*n, -0.98);
+        }
+
+        double csv = TimeIt([&]() {
+            write_csv("bench_pos.csv", pos);
+            write_csv("bench_force.csv", force);
+        }, 1.0);
+        double csvBytes = FileSize("bench_pos.csv") + FileSize("bench_force.csv");
+
+        TrajectoryWriter writer("bench.traj", N*N, N, 0.001, {"pos", "force"});
+        long step = 0;
+        double traj = TimeIt([&]() {
+            writer.WriteFrame(0.001*step, step, {&pos, &force});
+            writer.Flush();
+            step++;
+        }, 1.0);
+        writer.Close();
+        double trajBytes = (FileSize("bench.traj") - TRAJECTORY_HEADER_SIZE)/step;
+
+        /* stepping between the snapshots: a few evaluations of the spring forces */
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos, 1000.0);
+        ArrayT<Vec3> force_int(N*N);
+        int snapshots = 10;
+        double submit = 0.0;
+        {
+            AsyncTrajectoryWriter async("bench.traj", N*N, N, 0.001, {"pos", "force"});
+            for (int s = 0; s < snapshots; s++) {
+                for (int step = 0; step < 20; step++) internal_forces(springs, pos, force_int);
+                submit += TimeIt([&]() { async.Submit(0.001*s, s, {&pos, &force}); }, 0.0);
+            }
+            async.Close();
+            submit /= snapshots;
+
+            cout << setw(6) << N << setw(14) << csv << setw(14) << traj << setw(10) << csv/traj
+                 << setw(14) << csvBytes/1.0e6 << setw(14) << trajBytes/1.0e6 << setw(14) << submit
+                 << setw(12) << 1000.0*async.StallSeconds()/snapshots << endl;
+        }
+
+        std::remove("bench_pos.csv");
+        std::remove("bench_force.csv");
+        std::remove("bench.traj");
+    }
+
+    return 0;
+}
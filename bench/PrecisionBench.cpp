@@ -0,0 +1,122 @@
+//
+// Cost and accuracy of the precision tiers: the hanging cloth of main() in double and float, with
+// exact and approximate inverse lengths, against the double exact reference.
+//
+// usage: SimpleCloth_bench_precision [--json file] [--steps n] [N ...]
+//
+
+#include "Options.h"
+#include "ClothSimulation.h"
+#include "BenchReport.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+/** A run of one tier: its throughput and its positions at the checks */
+struct TierRun {
+    double rate;
+    vector<ArrayT<Vec3> > checks;
+};
+
+/* Step a tier, keeping its positions every steps/numChecks steps */
+template <class REAL>
+static TierRun RunTier(const SimulationOptions& options, long steps, int numChecks) {
+
+    typedef std::chrono::steady_clock clock;
+
+    /* serial, so that the tiers compare their kernels only */
+    ClothSimulationT<REAL> sim(options);
+    TierRun run;
+    double elapsed = 0.0;
+
+    for (int c = 1; c <= numChecks; c++) {
+        clock::time_point start = clock::now();
+        while (sim.Counter() < c*steps/numChecks) sim.Step();
+        elapsed += std::chrono::duration<double>(clock::now() - start).count();
+
+        const ArrayT<Vec3T<REAL> >& pos = sim.Positions();
+        ArrayT<Vec3> check(pos.Length());
+        for (int n = 0; n < pos.Length(); n++) check[n] = Vec3(pos[n]);
+        run.checks.push_back(check);
+    }
+    run.rate = steps/Max(elapsed, 1.0e-9);
+    return run;
+}
+
+/* Largest and root mean square distance between two sets of positions */
+static void Deviation(const ArrayT<Vec3>& pos, const ArrayT<Vec3>& reference, double& max, double& rms) {
+
+    max = 0.0;
+    rms = 0.0;
+    for (int n = 0; n < pos.Length(); n++) {
+        double d = (pos[n] - reference[n]).Magnitude();
+        max = Max(max, d);
+        rms += d*d;
+    }
+    rms = sqrt(rms/Max(pos.Length(), 1));
+}
+
+int main(int argc, char* argv[]) {
+
+    string json;
+    long steps = 20000;
+    vector<int> sizes;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) json = argv[++a];
+        else if (strcmp(argv[a], "--steps") == 0 && a + 1 < argc) steps = atol(argv[++a]);
+        else sizes.push_back(atoi(argv[a]));
+    }
+    if (sizes.empty()) sizes = {32, 128};
+
+    /* the deviations are reported at a few points of the run, to see whether they grow */
+    const int numChecks = 4;
+
+    BenchReport report("precision");
+
+    cout << "precision tiers against double/exact, " << steps << " steps" << endl;
+    cout << setw(8) << "N" << setw(16) << "tier" << setw(14) << "steps/s" << setw(10) << "speedup"
+         << setw(8) << "step" << setw(14) << "max dev" << setw(14) << "rms dev" << endl;
+
+    for (size_t s = 0; s < sizes.size(); s++) {
+        int N = sizes[s];
+
+        SimulationOptions options;
+        options.N = N;
+        options.t_final = 1.0e30;
+
+        TierRun reference;
+        for (const char* precision : {"double", "float"}) {
+            for (const char* rsqrt : {"exact", "approx"}) {
+                options.precision = precision;
+                options.rsqrt = rsqrt;
+                string tier = string(precision) + "/" + rsqrt;
+
+                TierRun run = options.precision == "float" ? RunTier<float>(options, steps, numChecks)
+                                                           : RunTier<double>(options, steps, numChecks);
+                if (reference.checks.empty()) reference = run;
+
+                report.Add(tier + " steps", N, "steps/s", run.rate);
+                for (int c = 0; c < numChecks; c++) {
+                    double max, rms;
+                    Deviation(run.checks[c], reference.checks[c], max, rms);
+                    long step = (c + 1)*steps/numChecks;
+
+                    cout << setw(8) << N << setw(16) << tier << setw(14) << run.rate << setw(10)
+                         << run.rate/reference.rate << setw(8) << step << setw(14) << max << setw(14) << rms << endl;
+                    report.Add(tier + " max deviation at " + to_string(step), N, "m", max);
+                    report.Add(tier + " rms deviation at " + to_string(step), N, "m", rms);
+                }
+            }
+        }
+    }
+
+    if (!json.empty()) report.Write(json);
+    return 0;
+}
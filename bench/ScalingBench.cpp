@@ -0,0 +1,74 @@
+//
+// Strong scaling of the force stage (internal, viscous and gravity forces) over the number of
+// threads, for several cloth sizes.
+//
+// usage: SimpleCloth_bench_scaling [max threads] [N ...]
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+#include "Cloth.h"
+#include "ThreadPool.h"
+#include "BenchReport.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : 64;
+
+    vector<int> sizes;
+    for (int a = 2; a < argc; a++) sizes.push_back(atoi(argv[a]));
+    if (sizes.empty()) sizes = {200, 1000, 2000, 4000};
+
+    cout << "hardware threads: " << std::thread::hardware_concurrency() << endl;
+    cout << setw(6) << "N" << setw(9) << "threads" << setw(14) << "time [ms]" << setw(10) << "speedup"
+         << setw(12) << "efficiency" << setw(10) << "bitwise" << endl;
+
+    for (int N : sizes) {
+        double length = 10;
+
+        ArrayT<Vec3> pos0(N*N), pos(N*N), vel(N*N);
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                pos0[N*j + i] = Vec3(i * length / (N - 1), j * length / (N - 1), 0.0);
+                pos[N*j + i] = Vec3(pos0[N*j + i].x, pos0[N*j + i].y, 0.05*sin(0.3*i)*cos(0.2*j));
+            }
+        }
+        vel = Vec3(0.1, 0.0, -0.1);
+
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 1000.0);
+
+        ArrayT<Vec3> force_int(N*N), force_vis(N*N), force_gravity(N*N), reference;
+        double serial_ms = 0.0;
+
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            ThreadPool pool(threads);
+
+            double ms = TimeIt([&]() {
+                internal_forces(springs, pos, force_int, pool);
+                viscous_forces(vel, 0.0001, force_vis, pool);
+                gravity_force(0.1, force_gravity, pool);
+            }, 1.0);
+
+            bool bitwise = true;
+            if (threads == 1) {
+                serial_ms = ms;
+                reference = force_int;
+            } else {
+                for (int n = 0; n < N*N && bitwise; n++) {
+                    bitwise = force_int[n].x == reference[n].x && force_int[n].y == reference[n].y && force_int[n].z == reference[n].z;
+                }
+            }
+
+            cout << setw(6) << N << setw(9) << threads << setw(14) << ms << setw(10) << serial_ms/ms
+                 << setw(12) << serial_ms/ms/threads << setw(10) << (bitwise ? "yes" : "NO") << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+//
+// Internal spring forces on a N x N cloth: the original neighbour walk, the edge list on
+// the array of Vec3, the grid stencil and the structure-of-arrays kernels of every supported
+// instruction set.
+//
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+#include "ClothState.h"
+#include "GridStencil.h"
+#include "BenchReport.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+/* The kernel before the edge list: every spring is visited from both ends and the rest
+ * lengths are recomputed, the arrays are passed by value */
+static void NeighbourWalkForces(ArrayT<vector<int>> indices, ArrayT<Vec3> pos, ArrayT<Vec3> pos0, double k, ArrayT<Vec3> &force_int) {
+    for (int i = 0; i < pos.Length(); i++) {
+        Vec3 f_i(0,0,0);
+        for (size_t j = 0; j < indices[i].size(); j++) {
+            double rest = (pos0[i] - pos0[indices[i][j]]).Magnitude();
+            f_i += SpringForce(pos[i], pos[indices[i][j]], rest, k);
+        }
+        force_int[i] = f_i;
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    int N = (argc > 1) ? atoi(argv[1]) : 1000;
+    double length = 10;
+    double k = 1000.0;
+
+    /* a flat grid with a smooth out of plane perturbation */
+    ArrayT<Vec3> pos0(N*N), pos(N*N), force(N*N);
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            pos0[N*j + i] = Vec3(i * length / (N - 1), j * length / (N - 1), 0.0);
+            pos[N*j + i] = Vec3(pos0[N*j + i].x, pos0[N*j + i].y, 0.05*sin(0.3*i)*cos(0.2*j));
+        }
+    }
+
+    SpringNetwork springs = ConnectivityStructure(N);
+    springs.SetRestState(pos0, k);
+
+    ArrayT<vector<int>> indices(N*N);
+    for (int n = 0; n < N*N; n++) {
+        for (int s = 0; s < springs.NumNodeSprings(n); s++) {
+            const Spring& spring = springs[springs.NodeSprings(n)[s]];
+            indices[n].push_back(spring.i == n ? spring.j : spring.i);
+        }
+    }
+
+    SpringBatches batches;
+    batches.Build(springs);
+    ClothState state(N*N);
+    state.pos.CopyFrom(pos);
+
+    cout << "N = " << N << ", " << springs.NumSprings() << " springs, "
+         << batches.NumSlots() - batches.NumSprings() << " padding slots" << endl;
+
+    double walk_ms = TimeIt([&]() { NeighbourWalkForces(indices, pos, pos0, k, force); }, 1.0);
+    cout << setw(24) << "neighbour walk" << setw(12) << walk_ms << " ms" << endl;
+
+    double edge_ms = TimeIt([&]() { internal_forces(springs, pos, force); }, 1.0);
+    cout << setw(24) << "edge list (AoS)" << setw(12) << edge_ms << " ms"
+         << setw(10) << walk_ms/edge_ms << "x" << endl;
+
+    GridStencil stencil;
+    stencil.SetRestState(N, pos0, k);
+    double stencil_ms = TimeIt([&]() { grid_forces(stencil, pos, force); }, 1.0);
+    cout << setw(24) << "grid stencil (AoS)" << setw(12) << stencil_ms << " ms"
+         << setw(10) << walk_ms/stencil_ms << "x" << endl;
+
+    for (int level = kSimdScalar; level <= DetectSimdLevel(); level++) {
+        double soa_ms = TimeIt([&]() { internal_forces(batches, state, SimdLevel(level)); }, 1.0);
+        cout << setw(24) << string("SoA ") + SimdLevelName(SimdLevel(level)) << setw(12) << soa_ms << " ms"
+             << setw(10) << walk_ms/soa_ms << "x" << setw(10) << edge_ms/soa_ms << "x the edge list" << endl;
+    }
+
+    return 0;
+}
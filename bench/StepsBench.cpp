@@ -0,0 +1,82 @@
+//
+// End-to-end throughput of the hanging cloth of main(): time steps per second of ClothSimulation,
+// forces, integration and strain limiting included, output left out.
+//
+// usage: SimpleCloth_bench_steps [--json file] [--seconds s] [--threads n] [N ...]
+//
+
+#include "Options.h"
+#include "ThreadPool.h"
+#include "ClothSimulation.h"
+#include "BenchReport.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+/* Steps per second of a simulation, stepped for at least minSeconds after a warm-up step */
+static double StepsPerSecond(ClothSimulation& sim, double minSeconds) {
+
+    typedef std::chrono::steady_clock clock;
+
+    sim.Step();
+
+    long steps = 0;
+    double elapsed = 0.0;
+    clock::time_point start = clock::now();
+    do {
+        sim.Step();
+        steps++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < minSeconds);
+
+    return steps/elapsed;
+}
+
+int main(int argc, char* argv[]) {
+
+    string json;
+    double seconds = 1.0;
+    int threads = 1;
+    vector<int> sizes;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) json = argv[++a];
+        else if (strcmp(argv[a], "--seconds") == 0 && a + 1 < argc) seconds = atof(argv[++a]);
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) threads = atoi(argv[++a]);
+        else sizes.push_back(atoi(argv[a]));
+    }
+    if (sizes.empty()) sizes = {32, 128, 512};
+
+    ThreadPool pool(threads);
+    BenchReport report("steps");
+
+    cout << "steps per second on " << pool.NumThreads() << " threads" << endl;
+    cout << setw(10) << "integrator" << setw(8) << "N" << setw(14) << "steps/s" << setw(16) << "nodes/s" << endl;
+
+    for (const char* integrator : {"verlet", "implicit"}) {
+        for (size_t s = 0; s < sizes.size(); s++) {
+            int N = sizes[s];
+
+            /* the defaults of SimpleCloth, the implicit integrator at a 50 times larger step */
+            SimulationOptions options;
+            options.N = N;
+            options.integrator = integrator;
+            if (options.integrator == "implicit") options.dt *= 50;
+            options.t_final = 1.0e30;
+
+            ClothSimulation sim(options, &pool);
+            double rate = StepsPerSecond(sim, seconds);
+
+            report.Add(string(integrator) + " steps", N, "steps/s", rate);
+            report.Add(string(integrator) + " nodes", N, "nodes/s", rate*N*N);
+            cout << setw(10) << integrator << setw(8) << N << setw(14) << rate << setw(16) << rate*N*N << endl;
+        }
+    }
+
+    if (!json.empty()) report.Write(json);
+    return 0;
+}
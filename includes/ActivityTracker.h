@@ -0,0 +1,112 @@
+//
+// Sleeping tiles: the parts of the cloth which have settled are left out of the forces and the integration.
+//
+
+#ifndef SIMPLECLOTH_ACTIVITYTRACKER_H
+#define SIMPLECLOTH_ACTIVITYTRACKER_H
+
+#include "ArrayT.h"
+
+/**
+ * The N x N grid is cut into square tiles of tileSize x tileSize nodes (smaller along the last row and
+ * column). After every step the caller records, for each awake tile, the largest displacement of its
+ * nodes and the largest residual force on them. A tile which stays below both thresholds for
+ * quietSteps steps in a row goes to sleep: its nodes keep their positions and forces until it wakes,
+ * and the caller stops them (FellAsleep()) so that they wake at rest.
+ *
+ * A tile wakes up when a neighbouring tile (the eight around it) moved over the thresholds in the
+ * last step, since the springs of its edge nodes reach into it, or when WakeAll() is called for a
+ * scheduled event. Tiles next to moving ones therefore never fall asleep.
+ */
+class ActivityTracker {
+
+protected:
+    int fN;                     /**< nodes per side */
+    int fTileSize;              /**< nodes per side of a tile */
+    int fTilesPerSide;
+
+    /** \name thresholds */
+    /*@{*/
+    double fDisplacement;       /**< largest displacement in a step */
+    double fForce;              /**< largest residual force */
+    int fQuietSteps;            /**< steps below both before a tile sleeps */
+    /*@}*/
+
+    /** \name per tile */
+    /*@{*/
+    ArrayT<char> fAwake;
+    ArrayT<int> fQuiet;                 /**< consecutive steps below the thresholds */
+    ArrayT<double> fMaxDisplacement;    /**< recorded in the current step */
+    ArrayT<double> fMaxForce;
+    /*@}*/
+
+    ArrayT<int> fAwakeTiles;    /**< indices of the awake tiles */
+    ArrayT<int> fFellAsleep;    /**< indices of the tiles which went to sleep in the last Update() */
+    ArrayT<char> fNodeAsleep;   /**< per node, for the strain limiting */
+    int fActiveNodes;           /**< nodes of the awake tiles */
+
+    /** \name statistics */
+    /*@{*/
+    long fSteps;
+    double fActiveNodeSteps;
+    /*@}*/
+
+    /* rebuild the list of awake tiles, the node mask and the number of active nodes */
+    void Rebuild();
+
+public:
+    /** All tiles are awake at first */
+    ActivityTracker(int N, int tileSize, double displacement, double force, int quietSteps);
+
+    /** \name tiles */
+    /*@{*/
+    int TileSize() const { return fTileSize; };
+    int TilesPerSide() const { return fTilesPerSide; };
+    int NumTiles() const { return fTilesPerSide*fTilesPerSide; };
+
+    /** The nodes (i, j) of tile t: firstColumn <= i < lastColumn and firstRow <= j < lastRow */
+    void TileRange(int t, int& firstColumn, int& lastColumn, int& firstRow, int& lastRow) const;
+
+    bool Awake(int t) const { return fAwake[t] != 0; };
+    int NumAwakeTiles() const { return fAwakeTiles.Length(); };
+    int AwakeTile(int a) const { return fAwakeTiles[a]; };
+
+    /** The tiles which went to sleep in the last Update() */
+    const ArrayT<int>& FellAsleep() const { return fFellAsleep; };
+
+    /** 1 for the nodes of sleeping tiles */
+    const ArrayT<char>& NodesAsleep() const { return fNodeAsleep; };
+    /*@}*/
+
+    /** Record the displacement and residual force of a node of awake tile t in the current step */
+    void Record(int t, double displacement, double force) {
+        if (displacement > fMaxDisplacement[t]) fMaxDisplacement[t] = displacement;
+        if (force > fMaxForce[t]) fMaxForce[t] = force;
+    };
+
+    /** End of a step: count the quiet steps, wake the neighbours of moving tiles and put the tiles
+     * which stayed quiet long enough to sleep. Its temporaries come from the current StepArena, it is
+     * called within an ArenaScope, as in ClothSimulationT::Step() */
+    void Update();
+
+    /** Wake every tile, e.g. before a change of the boundary conditions */
+    void WakeAll();
+
+    /** \name statistics */
+    /*@{*/
+    int ActiveNodes() const { return fActiveNodes; };
+    double ActiveFraction() const { return double(fActiveNodes)/(fN*fN); };
+
+    /** Average fraction of active nodes over the steps so far */
+    double MeanActiveFraction() const { return fSteps > 0 ? fActiveNodeSteps/(double(fSteps)*fN*fN) : 1.0; };
+    /*@}*/
+
+    /** \name the state of the tiles, saved in checkpoints */
+    /*@{*/
+    const ArrayT<char>& AwakeFlags() const { return fAwake; };
+    const ArrayT<int>& QuietSteps() const { return fQuiet; };
+    void Restore(const ArrayT<char>& awake, const ArrayT<int>& quiet);
+    /*@}*/
+};
+
+#endif //SIMPLECLOTH_ACTIVITYTRACKER_H
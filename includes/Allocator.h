@@ -0,0 +1,156 @@
+//
+// Allocator policies of ArrayT: aligned storage on the heap and a per-step arena, with a count of the
+// allocations.
+//
+
+#ifndef SIMPLECLOTH_ALLOCATOR_H
+#define SIMPLECLOTH_ALLOCATOR_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/** Alignment in bytes of the storage of plain types (numbers, vectors and structs of them): a cache
+ * line, which covers the widest SIMD loads as well */
+#define ARRAY_ALIGNMENT 64
+
+/** Default size in bytes of the blocks of a StepArena */
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+/** \name the heap allocations made for arrays since the start of the program, by all threads */
+/*@{*/
+inline std::atomic<long>& AllocationCounter() {
+    static std::atomic<long> counter(0);
+    return counter;
+}
+
+inline long NumAllocations() { return AllocationCounter().load(std::memory_order_relaxed); }
+/*@}*/
+
+/** Counted heap memory aligned to ARRAY_ALIGNMENT, the address of the block from operator new is kept
+ * in front of it */
+inline void* AlignedAllocate(size_t bytes) {
+
+    AllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    char* raw = static_cast<char*>(::operator new(bytes + ARRAY_ALIGNMENT));
+    char* aligned = raw + ARRAY_ALIGNMENT - reinterpret_cast<uintptr_t>(raw) % ARRAY_ALIGNMENT;
+    reinterpret_cast<char**>(aligned)[-1] = raw;
+    return aligned;
+}
+
+inline void AlignedRelease(void* aligned) {
+    if (aligned) ::operator delete(static_cast<char**>(aligned)[-1]);
+}
+
+/**
+ * The default policy of ArrayT: the heap. Types without a destructor (numbers, Vec3T and structs of
+ * them) get storage aligned to ARRAY_ALIGNMENT, the others new[] and delete[]. A policy provides
+ * Allocate(n), which returns n default initialized elements, and Release(elements, n).
+ */
+template <class TYPE>
+struct HeapAllocator {
+    static const bool aligned = std::is_trivially_destructible<TYPE>::value;
+
+    static TYPE* Allocate(int n) {
+        if (!aligned) {
+            AllocationCounter().fetch_add(1, std::memory_order_relaxed);
+            return new TYPE[n];
+        }
+        TYPE* elements = static_cast<TYPE*>(AlignedAllocate(n*sizeof(TYPE)));
+        for (int i = 0; i < n; i++) new (elements + i) TYPE;
+        return elements;
+    };
+
+    static void Release(TYPE* elements, int) {
+        if (!aligned) delete[] elements;
+        else AlignedRelease(elements);
+    };
+};
+
+/**
+ * Memory of the temporaries of one time step: allocations are taken off blocks in order and all of
+ * them are given back at once by Reset(), which keeps the blocks. Once the blocks are large enough
+ * for a step, the steps allocate nothing. Every allocation is aligned to ARRAY_ALIGNMENT.
+ *
+ * The arena of a thread is the one of the innermost ArenaScope, ArenaAllocator takes its memory from
+ * there. An arena is used by one thread at a time.
+ */
+class StepArena {
+
+protected:
+    std::vector<char*> fBlocks;
+    std::vector<size_t> fSizes;
+    size_t fBlockSize;          /**< of new blocks, at least */
+    size_t fBlock;              /**< the block allocations are taken off */
+    size_t fOffset;             /**< in it */
+    size_t fUsed;               /**< bytes since the last reset */
+    size_t fPeak;               /**< largest fUsed */
+
+public:
+    explicit StepArena(size_t blockSize = ARENA_BLOCK_SIZE);
+    ~StepArena();
+
+    /** bytes of memory aligned to ARRAY_ALIGNMENT, valid until the next Reset() */
+    void* Allocate(size_t bytes);
+
+    /** Give all the memory back, the blocks are kept for the next step */
+    void Reset();
+
+    /** \name statistics */
+    /*@{*/
+    size_t Used() const { return fUsed; };
+    size_t Peak() const { return fPeak; };
+    size_t Capacity() const;
+    int NumBlocks() const { return int(fBlocks.size()); };
+    /*@}*/
+
+    /** The arena of the innermost ArenaScope of this thread, NULL outside of them */
+    static StepArena* Current();
+
+private:
+    friend class ArenaScope;
+    static StepArena*& CurrentSlot();
+
+    StepArena(const StepArena&);
+    StepArena& operator=(const StepArena&);
+};
+
+/** Makes an arena the current one of this thread for its lifetime */
+class ArenaScope {
+
+protected:
+    StepArena* fPrevious;
+
+public:
+    explicit ArenaScope(StepArena& arena): fPrevious(StepArena::CurrentSlot()) { StepArena::CurrentSlot() = &arena; };
+    ~ArenaScope() { StepArena::CurrentSlot() = fPrevious; };
+
+private:
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+};
+
+/**
+ * The policy of the arrays of a step: the memory of the current StepArena, which has to exist. Nothing
+ * is released before the arena is reset, the array must not be used after that.
+ */
+template <class TYPE>
+struct ArenaAllocator {
+    static_assert(std::is_trivially_destructible<TYPE>::value, "ArenaAllocator: the elements are never destroyed");
+
+    static TYPE* Allocate(int n) {
+        StepArena* arena = StepArena::Current();
+        assert(arena != NULL);
+        TYPE* elements = static_cast<TYPE*>(arena->Allocate(n*sizeof(TYPE)));
+        for (int i = 0; i < n; i++) new (elements + i) TYPE;
+        return elements;
+    };
+
+    static void Release(TYPE*, int) { };
+};
+
+#endif //SIMPLECLOTH_ALLOCATOR_H
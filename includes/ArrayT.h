@@ -6,17 +6,36 @@
 #define SIMPLEBEAM_ARRAYT_H
 
 #include "Environment.h"
+#include "Allocator.h"
 
 #include <vector>
+#include <utility>
 
 using namespace std;
 
-template <class TYPE>
-class ArrayT {
+/**
+ * Base of all lazily evaluated array expressions (CRTP). An expression only provides
+ * Length() and an element-wise operator[], the loop runs once when it is assigned to an ArrayT.
+ */
+template <class EXPR>
+class ArrayExprT {
+public:
+    /** Downcast to the actual expression */
+    const EXPR& Expr() const { return static_cast<const EXPR&>(*this); };
+};
+
+/**
+ * A resizable array whose memory comes from the ALLOCATOR policy: the heap by default (HeapAllocator),
+ * aligned to ARRAY_ALIGNMENT for plain types, or the arena of the current step (ArenaAllocator).
+ */
+template <class TYPE, class ALLOCATOR = HeapAllocator<TYPE> >
+class ArrayT: public ArrayExprT<ArrayT<TYPE, ALLOCATOR> > {
 
 protected:
     int fLength;    /**< logical size (length) of the array */
 
+    int fCapacity;  /**< number of allocated elements, fLength <= fCapacity */
+
     TYPE *fArray;   /**< the main data container */
 
 public:
@@ -33,17 +52,33 @@ public:
 
     /** Copy constructor with a given ArrayT type */
     ArrayT(const ArrayT& source);
+
+    /** Move constructor, takes over the memory of the source */
+    ArrayT(ArrayT&& source) noexcept;
     /*@}*/
 
     /* Deconstruct */
     ~ArrayT();
 
-    /* Set the dimension */
+    /* Set the dimension, the values are not preserved. Memory is only allocated when the
+     * length exceeds the capacity */
     virtual void Dimension(int length);
 
+    /* Set the dimension preserving the first Min(length, Length()) values */
+    void Resize(int length);
+
+    /* Allocate memory for at least capacity elements, the values are preserved */
+    void Reserve(int capacity);
+
     /* Returning the Length */
     int Length() const;
 
+    /* Returning the number of allocated elements */
+    int Capacity() const;
+
+    /* Exchange the contents with another array without copying */
+    void swap(ArrayT& other) noexcept;
+
     /** Operators */
     /* Access/Allocation operator */
     /*@{*/
@@ -54,9 +89,14 @@ public:
     /** Assignment operators */
     /*@{*/
     /** Set all elements in the array to the given value */
-    virtual ArrayT<TYPE>& operator=(const TYPE& valueRHS);
-    virtual ArrayT<TYPE>& operator=(const TYPE* ptrRHS);
-    ArrayT<TYPE>& operator=(const ArrayT<TYPE>& arrRHS);
+    virtual ArrayT& operator=(const TYPE& valueRHS);
+    virtual ArrayT& operator=(const TYPE* ptrRHS);
+    ArrayT& operator=(const ArrayT& arrRHS);
+    ArrayT& operator=(ArrayT&& arrRHS) noexcept;
+
+    /** Evaluate an array expression in a single loop, e.g. pos = 2.0*pos - pos_old + (dt*dt)*acc */
+    template <class EXPR>
+    ArrayT& operator=(const ArrayExprT<EXPR>& exprRHS);
     /*@}*/
 
     /**
@@ -73,31 +113,35 @@ public:
     /* Removing the element from the vector and resize */
     void Remove(int row_num);
 
-    /* Inserting new element to the vector  */
-    void Insert(TYPE value);
+    /* Inserting new element at the end of the vector, the capacity grows geometrically */
+    void Insert(const TYPE& value);
+    void Insert(TYPE&& value);
 
 };
 
 /* Constructors */
-template <class TYPE>
-inline ArrayT<TYPE>::ArrayT():
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>::ArrayT():
     fLength(0),
+    fCapacity(0),
     fArray(NULL)
 {
 
 }
 
-template <class TYPE>
-inline ArrayT<TYPE>::ArrayT(int length):
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>::ArrayT(int length):
     fLength(0),
+    fCapacity(0),
     fArray(NULL)
 {
     Dimension(length);
 }
 
-template <class TYPE>
-inline ArrayT<TYPE>::ArrayT(const TYPE* ptrArray):
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>::ArrayT(const TYPE* ptrArray):
     fLength(0),
+    fCapacity(0),
     fArray(NULL)
 {
     /* First finding the length of given array */
@@ -106,80 +150,89 @@ inline ArrayT<TYPE>::ArrayT(const TYPE* ptrArray):
     Alias(arrayLength, ptrArray);
 }
 
-template<class TYPE>
-inline ArrayT<TYPE>::ArrayT(const ArrayT &source):
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>::ArrayT(const ArrayT &source):
     fLength(0),
+    fCapacity(0),
     fArray(NULL)
 {
     operator=(source);
 }
 
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>::ArrayT(ArrayT &&source) noexcept:
+    fLength(source.fLength),
+    fCapacity(source.fCapacity),
+    fArray(source.fArray)
+{
+    source.fLength = 0;
+    source.fCapacity = 0;
+    source.fArray = NULL;
+}
+
 /* Destructor */
-template <class TYPE>
-inline ArrayT<TYPE>::~ArrayT() {
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>::~ArrayT() {
 
-    delete[] fArray;
+    ALLOCATOR::Release(fArray, fCapacity);
 
     fArray = NULL;
     fLength = 0;
+    fCapacity = 0;
 }
 
-template <class TYPE>
-inline void ArrayT<TYPE>::Remove(int row_num) {
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Remove(int row_num) {
 
     /* First check if the row exist */
-    assert (row_num < fLength);
-
-    /* Reduce the size */
-    fLength -= 1;
+    assert (row_num >= 0 && row_num < fLength);
 
-    /* Copying over the data by memory */
-    TYPE *ptrTemp_ = new TYPE[fLength];
-    for (int i = 0; i < row_num-1; i++) {
-        ptrTemp_[i]= fArray[i];
+    /* shift the following rows over the removed one */
+    for (int j = row_num + 1; j < fLength; j++){
+        fArray[j-1] = std::move(fArray[j]);
     }
 
-    /* jump over the removed row */
-    for (int j = row_num; j < fLength; j++){
-        ptrTemp_[j-1] = fArray[j];
-    }
-
-    /* replace the array */
-    delete[] fArray;
-    fArray = ptrTemp_;
+    /* Reduce the size, the memory is kept */
+    fLength -= 1;
 }
 
-template <class TYPE>
-inline void ArrayT<TYPE>::Insert(TYPE value) {
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Insert(const TYPE& value) {
 
-    /* Copy the elements temporary to a temp array */
-    TYPE *ptrTemp_ = new TYPE[fLength + 1];
-
-    for (int i = 0; i < fLength; i++) {
-        ptrTemp_[i] = fArray[i];
+    if (fLength == fCapacity) {
+        /* value may live in this array, copy it before the memory is replaced */
+        TYPE copy(value);
+        Reserve(Max(2*fCapacity, 4));
+        fArray[fLength++] = std::move(copy);
+    } else {
+        fArray[fLength++] = value;
     }
+}
 
-    /* Insert the final spot */
-    ptrTemp_[fLength] = value;
-
-    delete[] fArray;
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Insert(TYPE&& value) {
 
-    fArray = ptrTemp_;
-    fLength += 1;
+    if (fLength == fCapacity) {
+        TYPE moved(std::move(value));
+        Reserve(Max(2*fCapacity, 4));
+        fArray[fLength++] = std::move(moved);
+    } else {
+        fArray[fLength++] = std::move(value);
+    }
 }
 
 /** Operators */
 /* element accessor */
-template <class TYPE>
-inline TYPE &ArrayT<TYPE>::operator[](int index) {
+template <class TYPE, class ALLOCATOR>
+inline TYPE &ArrayT<TYPE, ALLOCATOR>::operator[](int index) {
 
     /* Simple range check */
     assert(index < fLength || index >= fLength);
 
     return fArray[index];
 }
-template <class TYPE>
-inline const TYPE& ArrayT<TYPE>::operator[](int index) const {
+template <class TYPE, class ALLOCATOR>
+inline const TYPE& ArrayT<TYPE, ALLOCATOR>::operator[](int index) const {
 
     /* Simple range check */
     assert(index < fLength || index >= fLength);
@@ -188,8 +241,8 @@ inline const TYPE& ArrayT<TYPE>::operator[](int index) const {
 }
 
 /* Assignments operators */
-template<class TYPE>
-inline ArrayT<TYPE>& ArrayT<TYPE>::operator=(const TYPE& valueRHS) {
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>& ArrayT<TYPE, ALLOCATOR>::operator=(const TYPE& valueRHS) {
 
     TYPE* p = fArray;
     for (int i = 0; i < fLength; i++)
@@ -198,8 +251,8 @@ inline ArrayT<TYPE>& ArrayT<TYPE>::operator=(const TYPE& valueRHS) {
     return *this;
 }
 
-template<class TYPE>
-inline ArrayT<TYPE>& ArrayT<TYPE>::operator=(const TYPE* ptrRHS) {
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>& ArrayT<TYPE, ALLOCATOR>::operator=(const TYPE* ptrRHS) {
 
     /* Getting the size of the STL array */
     int arrayLength = (sizeof(*ptrRHS) / sizeof(ptrRHS)) + 1;
@@ -215,8 +268,8 @@ inline ArrayT<TYPE>& ArrayT<TYPE>::operator=(const TYPE* ptrRHS) {
     return *this;
 }
 
-template<class TYPE>
-inline ArrayT<TYPE>& ArrayT<TYPE>::operator=(const ArrayT<TYPE>& arrRHS) {
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>& ArrayT<TYPE, ALLOCATOR>::operator=(const ArrayT<TYPE, ALLOCATOR>& arrRHS) {
 
     if (fArray != arrRHS.fArray) {
 
@@ -231,48 +284,120 @@ inline ArrayT<TYPE>& ArrayT<TYPE>::operator=(const ArrayT<TYPE>& arrRHS) {
     return *this;
 }
 
-template<class TYPE>
-inline void ArrayT<TYPE>::Alias(int length, const TYPE* ptrArray) {
+template <class TYPE, class ALLOCATOR>
+inline ArrayT<TYPE, ALLOCATOR>& ArrayT<TYPE, ALLOCATOR>::operator=(ArrayT<TYPE, ALLOCATOR>&& arrRHS) noexcept {
+
+    if (this != &arrRHS) {
+        ALLOCATOR::Release(fArray, fCapacity);
+
+        fLength = arrRHS.fLength;
+        fCapacity = arrRHS.fCapacity;
+        fArray = arrRHS.fArray;
+
+        arrRHS.fLength = 0;
+        arrRHS.fCapacity = 0;
+        arrRHS.fArray = NULL;
+    }
+    return *this;
+}
+
+template <class TYPE, class ALLOCATOR>
+template <class EXPR>
+inline ArrayT<TYPE, ALLOCATOR>& ArrayT<TYPE, ALLOCATOR>::operator=(const ArrayExprT<EXPR>& exprRHS) {
+
+    const EXPR& expr = exprRHS.Expr();
+
+    /* element-wise evaluation, so the expression may refer to this array itself */
+    if (fLength != expr.Length()) Dimension(expr.Length());
+
+    for (int i = 0; i < fLength; i++) {
+        fArray[i] = expr[i];
+    }
+    return *this;
+}
+
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Alias(int length, const TYPE* ptrArray) {
 
-    fArray = new TYPE[length];
+    Dimension(length);
 
     for (int i = 0; i < length; i++) {
         fArray[i] = ptrArray[i];
     }
-    fLength = length;
 }
 
-template <class TYPE>
-inline int ArrayT<TYPE>::Length() const {
+template <class TYPE, class ALLOCATOR>
+inline int ArrayT<TYPE, ALLOCATOR>::Length() const {
     return this->fLength;
 }
 
-template<class TYPE>
-inline void ArrayT<TYPE>::Dimension(int length) {
+template <class TYPE, class ALLOCATOR>
+inline int ArrayT<TYPE, ALLOCATOR>::Capacity() const {
+    return this->fCapacity;
+}
+
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Dimension(int length) {
 
-    /* do nothing if the correct length is already assigned */
-    if (length != fLength) {
-        delete[] fArray;
+    /* reallocate only if the current memory is too small */
+    if (length > fCapacity) {
+        ALLOCATOR::Release(fArray, fCapacity);
 
         /* Allocating new memory */
-        TYPE* ptrArr = NULL;
-        if (length > 0) {
-            ptrArr = new TYPE[length];
+        fArray = ALLOCATOR::Allocate(length);
+        fCapacity = length;
+    }
+
+    /* set dimensions */
+    fLength = length;
+}
+
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Resize(int length) {
+
+    Reserve(length);
+
+    fLength = length;
+}
+
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::Reserve(int capacity) {
+
+    if (capacity > fCapacity) {
+
+        /* Moving the elements over to the new memory */
+        TYPE* ptrArr = ALLOCATOR::Allocate(capacity);
+        for (int i = 0; i < fLength; i++) {
+            ptrArr[i] = std::move(fArray[i]);
         }
 
-        fArray = ptrArr;
+        ALLOCATOR::Release(fArray, fCapacity);
 
-        /* set dimensions */
-        fLength = length;
+        fArray = ptrArr;
+        fCapacity = capacity;
     }
 }
 
+template <class TYPE, class ALLOCATOR>
+inline void ArrayT<TYPE, ALLOCATOR>::swap(ArrayT<TYPE, ALLOCATOR>& other) noexcept {
+
+    std::swap(fLength, other.fLength);
+    std::swap(fCapacity, other.fCapacity);
+    std::swap(fArray, other.fArray);
+}
+
+/* Exchange two arrays without copying */
+template <class TYPE, class ALLOCATOR>
+inline void swap(ArrayT<TYPE, ALLOCATOR>& arr1, ArrayT<TYPE, ALLOCATOR>& arr2) noexcept {
+    arr1.swap(arr2);
+}
+
 /**
  * returns a pointer specified element in the array - offset
  * must be 0 <= offset <= Length() <--- one passed the end!
  */
-template<class TYPE>
-TYPE* ArrayT<TYPE>::Pointer(int offset) {
+template <class TYPE, class ALLOCATOR>
+TYPE* ArrayT<TYPE, ALLOCATOR>::Pointer(int offset) {
     if (offset < 0 || offset > fLength){
         cout << "ERR: Offset must be within the length of the array.";
         return nullptr;
@@ -281,8 +406,8 @@ TYPE* ArrayT<TYPE>::Pointer(int offset) {
     }
 }
 
-template<class TYPE>
-const TYPE* ArrayT<TYPE>::Pointer(int offset) const {
+template <class TYPE, class ALLOCATOR>
+const TYPE* ArrayT<TYPE, ALLOCATOR>::Pointer(int offset) const {
     if (offset < 0 || offset > fLength ){
         cout << "ERR: Offset must be within the length of the array.";
         return nullptr;
@@ -292,4 +417,100 @@ const TYPE* ArrayT<TYPE>::Pointer(int offset) const {
 }
 
 
+/**
+ * \name Expression templates
+ * Arrays are held by reference inside an expression and sub-expressions by value, so an
+ * expression must be evaluated before the arrays it refers to go out of scope.
+ */
+/*@{*/
+/** How an operand is stored inside an expression node */
+template <class EXPR>
+struct ArrayOperandT {
+    typedef const EXPR type;
+};
+
+template <class TYPE, class ALLOCATOR>
+struct ArrayOperandT<ArrayT<TYPE, ALLOCATOR> > {
+    typedef const ArrayT<TYPE, ALLOCATOR>& type;
+};
+
+/** Element-wise sum of two expressions */
+template <class LHS, class RHS>
+class ArraySumT: public ArrayExprT<ArraySumT<LHS, RHS> > {
+
+protected:
+    typename ArrayOperandT<LHS>::type fLHS;
+    typename ArrayOperandT<RHS>::type fRHS;
+
+public:
+    ArraySumT(const LHS& lhs, const RHS& rhs): fLHS(lhs), fRHS(rhs) {
+        assert(lhs.Length() == rhs.Length());
+    };
+
+    int Length() const { return fLHS.Length(); };
+
+    auto operator[](int index) const -> decltype(fLHS[index] + fRHS[index]) {
+        return fLHS[index] + fRHS[index];
+    };
+};
+
+/** Element-wise difference of two expressions */
+template <class LHS, class RHS>
+class ArrayDiffT: public ArrayExprT<ArrayDiffT<LHS, RHS> > {
+
+protected:
+    typename ArrayOperandT<LHS>::type fLHS;
+    typename ArrayOperandT<RHS>::type fRHS;
+
+public:
+    ArrayDiffT(const LHS& lhs, const RHS& rhs): fLHS(lhs), fRHS(rhs) {
+        assert(lhs.Length() == rhs.Length());
+    };
+
+    int Length() const { return fLHS.Length(); };
+
+    auto operator[](int index) const -> decltype(fLHS[index] - fRHS[index]) {
+        return fLHS[index] - fRHS[index];
+    };
+};
+
+/** An expression scaled by a constant */
+template <class EXPR>
+class ArrayScaledT: public ArrayExprT<ArrayScaledT<EXPR> > {
+
+protected:
+    typename ArrayOperandT<EXPR>::type fExpr;
+    double fScale;
+
+public:
+    ArrayScaledT(const EXPR& expr, double scale): fExpr(expr), fScale(scale) { };
+
+    int Length() const { return fExpr.Length(); };
+
+    auto operator[](int index) const -> decltype(fExpr[index]*fScale) {
+        return fExpr[index]*fScale;
+    };
+};
+
+template <class LHS, class RHS>
+inline ArraySumT<LHS, RHS> operator+(const ArrayExprT<LHS>& lhs, const ArrayExprT<RHS>& rhs) {
+    return ArraySumT<LHS, RHS>(lhs.Expr(), rhs.Expr());
+}
+
+template <class LHS, class RHS>
+inline ArrayDiffT<LHS, RHS> operator-(const ArrayExprT<LHS>& lhs, const ArrayExprT<RHS>& rhs) {
+    return ArrayDiffT<LHS, RHS>(lhs.Expr(), rhs.Expr());
+}
+
+template <class EXPR>
+inline ArrayScaledT<EXPR> operator*(double scale, const ArrayExprT<EXPR>& expr) {
+    return ArrayScaledT<EXPR>(expr.Expr(), scale);
+}
+
+template <class EXPR>
+inline ArrayScaledT<EXPR> operator*(const ArrayExprT<EXPR>& expr, double scale) {
+    return ArrayScaledT<EXPR>(expr.Expr(), scale);
+}
+/*@}*/
+
 #endif //SIMPLEBEAM_ARRAYT_H
@@ -0,0 +1,102 @@
+//
+// Trajectory output on a background thread, so that the time stepping does not wait for the disk.
+//
+
+#ifndef SIMPLECLOTH_ASYNCTRAJECTORYWRITER_H
+#define SIMPLECLOTH_ASYNCTRAJECTORYWRITER_H
+
+#include "Trajectory.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+/**
+ * Frames are copied into a ring of preallocated snapshots and written to the trajectory by a
+ * dedicated thread. Submit() only waits when all the snapshots are still queued, which bounds
+ * the memory and slows the stepping down to the speed of the disk. The time spent waiting and the
+ * depth of the queue are recorded to check that the output keeps up.
+ *
+ * Errors of the writer thread are thrown again by the next Submit() or by Close().
+ */
+class AsyncTrajectoryWriter {
+
+protected:
+    /** a frame waiting to be written */
+    struct Snapshot {
+        double time;
+        long step;
+        ArrayT<Vec3> fields[TRAJECTORY_MAX_FIELDS];
+    };
+
+    TrajectoryWriter fWriter;       /**< only used by the writer thread once it runs */
+
+    /** \name ring of snapshots: fCount queued ones starting at fHead */
+    /*@{*/
+    ArrayT<Snapshot> fRing;
+    int fHead;
+    int fCount;
+    /*@}*/
+
+    /** \name synchronization */
+    /*@{*/
+    std::thread fThread;
+    std::mutex fMutex;
+    std::condition_variable fQueued;    /**< signals a new snapshot (or the shut down) to the writer */
+    std::condition_variable fFreed;     /**< signals a written snapshot to Submit() */
+    bool fShutDown;
+    std::exception_ptr fError;
+    /*@}*/
+
+    /** \name statistics */
+    /*@{*/
+    long fSubmitted;
+    long fWritten;
+    int fMaxDepth;
+    long fSumDepth;
+    double fStallSeconds;
+    /*@}*/
+
+    /* write the queued snapshots until the shut down */
+    void WriterLoop();
+
+    /* throw the error of the writer thread, if any */
+    void CheckError();
+
+public:
+    /** Create the trajectory (see TrajectoryWriter::Open()) with a ring of numBuffers snapshots. With
+     * resumeStep >= 0 the frames of an existing trajectory up to that step are kept instead (see
+     * TrajectoryWriter::Resume()) */
+    AsyncTrajectoryWriter(const std::string& filename, int numNodes, int gridSize, double dt,
+                          std::initializer_list<const char*> fields, int numBuffers = 2, long resumeStep = -1);
+
+    /** Closes the trajectory, errors are lost: call Close() to see them */
+    ~AsyncTrajectoryWriter();
+
+    /** Queue a frame, one array per field in the order of the constructor */
+    void Submit(double time, long step, std::initializer_list<const ArrayT<Vec3>*> fields);
+
+    /** Write the queued frames, stop the thread and close the trajectory */
+    void Close();
+
+    /** \name statistics */
+    /*@{*/
+    int NumBuffers() const { return fRing.Length(); };
+    long NumSubmitted() const { return fSubmitted; };
+    long NumWritten() const { return fWritten; };
+
+    /** Largest number of queued snapshots seen by Submit(), including its own */
+    int MaxQueueDepth() const { return fMaxDepth; };
+    double AverageQueueDepth() const { return fSubmitted > 0 ? double(fSumDepth)/fSubmitted : 0.0; };
+
+    /** Time Submit() spent waiting for a free snapshot */
+    double StallSeconds() const { return fStallSeconds; };
+    /*@}*/
+
+private:
+    AsyncTrajectoryWriter(const AsyncTrajectoryWriter&);
+    AsyncTrajectoryWriter& operator=(const AsyncTrajectoryWriter&);
+};
+
+#endif //SIMPLECLOTH_ASYNCTRAJECTORYWRITER_H
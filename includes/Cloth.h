@@ -0,0 +1,78 @@
+//
+// Array helpers, external forces and output of the cloth simulator.
+//
+
+#ifndef SIMPLECLOTH_CLOTH_H
+#define SIMPLECLOTH_CLOTH_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "ThreadPool.h"
+#include "ForceModels.h"
+
+#include <string>
+
+/** Adding two arrays of containing cartesian vectors Vec3 */
+ArrayT<Vec3> AddArrays(const ArrayT<Vec3>& arr1, const ArrayT<Vec3>& arr2);
+
+/** Adding three arrays of containing cartesian vectors */
+ArrayT<Vec3> AddArrays(const ArrayT<Vec3>& arr1, const ArrayT<Vec3>& arr2, const ArrayT<Vec3>& arr3);
+
+/* Set each vector of the array to scaled */
+ArrayT<Vec3> SetToScaled(const ArrayT<Vec3>& arr, double scale);
+
+/* Viscous forces! In double or float (REAL) */
+template <class REAL>
+void viscous_forces(const ArrayT<Vec3T<REAL> >& vel, double vis_coeff, ArrayT<Vec3T<REAL> > &force_vis);
+template <class REAL>
+void viscous_forces(const ArrayT<Vec3T<REAL> >& vel, double vis_coeff, ArrayT<Vec3T<REAL> > &force_vis, ThreadPool& pool);
+
+/* Applying external forces */
+template <class REAL>
+void gravity_force(double mass, ArrayT<Vec3T<REAL> > &force_gravity);
+template <class REAL>
+void gravity_force(double mass, ArrayT<Vec3T<REAL> > &force_gravity, ThreadPool& pool);
+
+/** Rows of the grid whose spring forces and fixed Verlet step are done together by the fused step of
+ * ClothSimulationT, while their positions and forces are still in cache */
+#define VERLET_BLOCK_ROWS 8
+
+/**
+ * The fixed Verlet step in one sweep over the nodes, instead of a pass per force, for their sum, the
+ * accelerations, the positions and the copy of the old ones: force holds the forces of the springs
+ * (and of the triangles) and gets those of the models of the nodes added, then
+ *      v(t + dt) = v(t) + dt force/mass
+ *      x(t + dt) = x(t) + dt v(t + dt)
+ * go into vel and over pos_old. It is the Verlet scheme carrying the velocity of the step,
+ * (x(t + dt) - x(t))/dt, instead of x(t - dt): the rounding of the positions is not fed back into the
+ * velocity. The nodes of pinned stay at pos0, at rest. Swapping pos and pos_old afterwards makes the
+ * new positions the current ones.
+ */
+template <class REAL>
+void verlet_step(const ClothNodeForcesT<REAL>& models, double mass, double dt, const ArrayT<Vec3T<REAL> >& pos,
+                 ArrayT<Vec3T<REAL> >& pos_old, ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force,
+                 const ArrayT<int>& pinned, const ArrayT<Vec3T<REAL> >& pos0);
+template <class REAL>
+void verlet_step(const ClothNodeForcesT<REAL>& models, double mass, double dt, const ArrayT<Vec3T<REAL> >& pos,
+                 ArrayT<Vec3T<REAL> >& pos_old, ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force,
+                 const ArrayT<int>& pinned, const ArrayT<Vec3T<REAL> >& pos0, ThreadPool& pool);
+
+/* The same for the nodes [first, last) only and without the pinned nodes, for the sweeps which compute
+ * the spring forces of a block of nodes right before its step */
+template <class REAL>
+void verlet_step(const ClothNodeForcesT<REAL>& models, double mass, double dt, const ArrayT<Vec3T<REAL> >& pos,
+                 ArrayT<Vec3T<REAL> >& pos_old, ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force,
+                 int first, int last);
+
+/* The pinned nodes of the fixed Verlet step back at pos0, at rest */
+template <class REAL>
+void verlet_pinned(const ArrayT<int>& pinned, const ArrayT<Vec3T<REAL> >& pos0, ArrayT<Vec3T<REAL> >& pos_old,
+                   ArrayT<Vec3T<REAL> >& vel);
+
+/* Writing the output in a csv */
+void write_csv(const std::string& filename, const ArrayT<Vec3>& dataset);
+
+/* Writing part of a dataset in a csv, ids are the global node indices of the rows */
+void write_csv(const std::string& filename, const ArrayT<Vec3>& dataset, const ArrayT<int>& ids);
+
+#endif //SIMPLECLOTH_CLOTH_H
@@ -0,0 +1,223 @@
+//
+// The hanging and released cloth of main(): state, time stepping and checkpoints.
+//
+
+#ifndef SIMPLECLOTH_CLOTHSIMULATION_H
+#define SIMPLECLOTH_CLOTHSIMULATION_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "Options.h"
+#include "SpringNetwork.h"
+#include "GridStencil.h"
+#include "StrainLimiter.h"
+#include "ImplicitIntegrator.h"
+#include "StaticSolver.h"
+#include "StepController.h"
+#include "ActivityTracker.h"
+#include "SelfCollision.h"
+#include "Obstacle.h"
+#include "Garment.h"
+#include "ForceModels.h"
+#include "ThreadPool.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * A N x N cloth hanging from its two top corners, the bottom-left corner is let go at t_release.
+ * With --garment the cloth is the triangle mesh of an OBJ or PLY file instead, hanging from its
+ * highest nodes with the springs of MeshSprings(), its nodes renumbered by --node_order. The state
+ * can be saved to a checkpoint and restored from it, after which the run continues bit for bit as
+ * if it had not been interrupted.
+ *
+ * The state is kept in double or float (REAL, --precision), the springs with the exact or the
+ * approximate inverse lengths of SpringForceT() (--rsqrt). The implicit integrator needs double.
+ * The internal forces come from the GridStencil of the grid unless --spring_kernel edges asks for
+ * the spring list, which garments, the strain limiting and the implicit integrator use in any case.
+ *
+ * With --dt_control adaptive the size of every step is chosen by a StepController and the Verlet
+ * scheme takes the time-corrected form for steps of varying size.
+ *
+ * With --start equilibrium the hanging phase is replaced by its static equilibrium, see
+ * StartFromEquilibrium().
+ *
+ * With --sleep_tile the settled parts of the cloth are left out of the forces and the fixed Verlet
+ * steps, see ActivityTracker; they all wake up when the corner is released.
+ *
+ * With --collision on the cloth cannot pass through itself, see SelfCollision, and with --obstacle
+ * it cannot pass through the mesh of the file, see Obstacle. The contacts are resolved after the
+ * strain limiting in every scheme, those with the obstacle last.
+ *
+ * The forces of the springs and of the triangles of the cloth (Aerodynamics) go into one buffer, to
+ * which the models of the nodes (ClothNodeForcesT: viscous drag, gravity and wind) add theirs.
+ */
+template <class REAL>
+class ClothSimulationT {
+
+protected:
+    SimulationOptions fOptions;
+    ThreadPool* fPool;              /**< threads of the force stage, NULL for serial runs */
+    bool fApprox;                   /**< approximate inverse lengths in the spring forces */
+    bool fUseStencil;               /**< internal forces from fStencil rather than fSprings */
+
+    SpringNetwork fSprings;
+    GridStencil fStencil;
+    StrainLimiter fLimiter;
+    std::unique_ptr<ImplicitIntegrator> fIntegrator;   /**< only for the implicit integrator */
+    std::unique_ptr<StepController> fController;       /**< only for adaptive steps */
+    int fMaxNodeSprings;                               /**< for the stability limit of the steps */
+    std::unique_ptr<ActivityTracker> fActivity;       /**< only with sleeping tiles */
+    std::unique_ptr<StaticSolver> fStatic;             /**< only once started from the equilibrium */
+    std::unique_ptr<SelfCollision> fCollision;         /**< only with self-collision */
+    std::unique_ptr<Obstacle> fObstacle;               /**< only with an obstacle */
+    ClothNodeForcesT<REAL> fNodeForces;                /**< the forces besides the springs, per node */
+    Aerodynamics fAerodynamics;                        /**< and per triangle */
+
+    /** \name the nodes of the cloth */
+    /*@{*/
+    ArrayT<int> fFixed;         /**< pinned for the whole run */
+    int fReleased;              /**< pinned until t_release, -1 if none */
+    ArrayT<int> fImportIndex;   /**< of every node of a garment in its file, empty for the grid */
+    double fSpacing;            /**< of the grid, or mean length of the structural springs of a garment */
+    /*@}*/
+
+    /** \name state */
+    /*@{*/
+    double fTime;
+    long fCounter;              /**< steps done */
+    ArrayT<Vec3T<REAL> > fPos0;
+    ArrayT<Vec3T<REAL> > fPos;
+    ArrayT<Vec3T<REAL> > fPosOld;
+    ArrayT<Vec3T<REAL> > fVel;
+    /*@}*/
+
+    /** \name work arrays */
+    /*@{*/
+    ArrayT<Vec3T<REAL> > fAcc;
+    ArrayT<Vec3T<REAL> > fForces;
+    ArrayT<Vec3T<REAL> > fForceInt;    /**< of the springs with sleeping tiles, those of sleeping nodes are kept */
+    ArrayT<Vec3T<REAL> > fPosNext;
+    ArrayT<Vec3T<REAL> > fAccPrev;     /**< accelerations of the last adaptive step */
+    ArrayT<Vec3T<REAL> > fPosStart;    /**< positions at the beginning of the step, for the collisions */
+    ArrayT<int> fPinned;
+    /*@}*/
+
+    StepArena fArena;               /**< temporaries of a step */
+
+public:
+    typedef Vec3T<REAL> VecType;
+
+    /** Set up the cloth at rest in its initial configuration, throws std::runtime_error for the
+     * implicit integrator in single precision or an obstacle file which cannot be read. The options
+     * are those accepted by ParseOptions() */
+    explicit ClothSimulationT(const SimulationOptions& options, ThreadPool* pool = NULL);
+
+    /** The same with the springs of ConnectivityStructure(N) built beforehand, runs of the same size
+     * share it instead of building their own */
+    ClothSimulationT(const SimulationOptions& options, const SpringNetwork& connectivity, ThreadPool* pool = NULL);
+
+    /** Skip the hanging phase: the cloth jumps to the static equilibrium of its springs under gravity
+     * with the three corners pinned (StaticSolver), strain limited and at rest at t_release. The steps of the hanging
+     * phase count as done, so that fixed steps keep their schedule of outputs. Returns whether the
+     * Newton iteration converged. If it did not, the cloth is left as it was, to step through the
+     * hanging phase */
+    bool StartFromEquilibrium();
+
+    /** Advance one time step, of dt or of the size chosen by the StepController */
+    void Step();
+
+    /** The next time an adaptive step has to land on: an output, a checkpoint, the release or t_final */
+    double NextEventTime() const;
+
+    /** Whether the last step ended on a multiple of interval, for the outputs and checkpoints */
+    bool OnMultipleOf(double interval) const;
+
+    /** Whether t_final is reached */
+    bool Finished() const { return fTime >= fOptions.t_final; };
+
+    /** \name accessors */
+    /*@{*/
+    const SimulationOptions& Options() const { return fOptions; };
+    int NumNodes() const { return fPos.Length(); };
+    double Time() const { return fTime; };
+    long Counter() const { return fCounter; };
+
+    const SpringNetwork& Springs() const { return fSprings; };
+
+    /** The index in the file of every node of a garment, empty for the grid */
+    const ArrayT<int>& ImportIndices() const { return fImportIndex; };
+
+    /** The unit of the collision distances: the spacing of the grid, or the mean length of the
+     * structural springs of a garment */
+    double Spacing() const { return fSpacing; };
+    const ArrayT<VecType>& Positions() const { return fPos; };
+    const ArrayT<VecType>& Velocities() const { return fVel; };
+
+    /** Total nodal forces of the last step */
+    const ArrayT<VecType>& Forces() const { return fForces; };
+
+    /** NULL unless the implicit integrator is used */
+    const ImplicitIntegrator* Integrator() const { return fIntegrator.get(); };
+
+    /** NULL unless the steps are adaptive */
+    const StepController* Controller() const { return fController.get(); };
+
+    /** NULL unless the run started from the equilibrium */
+    const StaticSolver* Equilibrium() const { return fStatic.get(); };
+
+    /** NULL unless the tiles of the grid can sleep */
+    const ActivityTracker* Activity() const { return fActivity.get(); };
+
+    /** NULL unless the cloth collides with itself */
+    const SelfCollision* Collision() const { return fCollision.get(); };
+
+    /** NULL without an obstacle */
+    const Obstacle* Obstacles() const { return fObstacle.get(); };
+
+    const ClothNodeForcesT<REAL>& NodeForces() const { return fNodeForces; };
+    const Aerodynamics& TriangleForces() const { return fAerodynamics; };
+    /*@}*/
+
+    /** \name checkpoints */
+    /*@{*/
+    /** Save the options and the state (in double whatever REAL), the file is replaced atomically
+     * (written next to it, then renamed) */
+    void WriteCheckpoint(const std::string& filename) const;
+
+    /** Restore the state of a checkpoint of a cloth of the same size. The options of this simulation
+     * are kept, see ReadCheckpointOptions() */
+    void ReadCheckpoint(const std::string& filename);
+    /*@}*/
+
+protected:
+    /** Accelerations of the current forces into fAcc and the size of the step, dtPrev is set to the last one */
+    double AdaptiveStep(double& dtPrev);
+
+    /** Internal forces of the nodes of the awake tiles */
+    void ActiveForces();
+
+    /** The fixed Verlet step with the stencil: the spring forces of every VERLET_BLOCK_ROWS rows are
+     * computed right before their step, in the same sweep over the nodes, into fPosOld */
+    void BlockedVerletStep(double dt);
+
+    /** The fixed Verlet step of the nodes of the awake tiles, the others keep their positions */
+    void ActiveVerletStep(double dt);
+
+    /** Resolve the collisions of the new positions pos, coming from fPosStart: with the cloth itself
+     * and with the obstacle, if enabled, the number of contacts resolved. The nodes moved get their
+     * displacement over dt added to vel, if given */
+    int Collide(ArrayT<VecType>& pos, const ArrayT<char>* asleep = NULL, ArrayT<VecType>* vel = NULL, double dt = 0.0);
+
+private:
+    ClothSimulationT(const ClothSimulationT&);
+    ClothSimulationT& operator=(const ClothSimulationT&);
+};
+
+/** The reference simulation in double precision */
+typedef ClothSimulationT<double> ClothSimulation;
+
+/** Read the options stored in a checkpoint, throws std::runtime_error if it cannot be read */
+void ReadCheckpointOptions(const std::string& filename, SimulationOptions& options);
+
+#endif //SIMPLECLOTH_CLOTHSIMULATION_H
@@ -0,0 +1,119 @@
+//
+// Structure-of-arrays cloth state and the vectorized spring force kernel.
+//
+
+#ifndef SIMPLECLOTH_CLOTHSTATE_H
+#define SIMPLECLOTH_CLOTHSTATE_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+
+/** x, y and z components of a nodal vector field in separate arrays, aligned to ARRAY_ALIGNMENT */
+class Vec3ArrayT {
+
+public:
+    ArrayT<double> x;
+    ArrayT<double> y;
+    ArrayT<double> z;
+
+    void Dimension(int length) {
+        x.Dimension(length);
+        y.Dimension(length);
+        z.Dimension(length);
+    };
+
+    int Length() const { return x.Length(); };
+
+    /* Set all components to the given value */
+    Vec3ArrayT& operator=(double valueRHS) {
+        x = valueRHS;
+        y = valueRHS;
+        z = valueRHS;
+        return *this;
+    };
+
+    /** \name conversion from and to the array of Vec3 */
+    /*@{*/
+    void CopyFrom(const ArrayT<Vec3>& source);
+    void CopyTo(ArrayT<Vec3>& target) const;
+    /*@}*/
+};
+
+/**
+ * Structure-of-arrays state of the cloth: positions, previous positions and forces. Two dummy
+ * nodes are kept after the last node, the padding springs of SpringBatches connect them.
+ */
+class ClothState {
+
+protected:
+    int fNumNodes;  /**< number of real nodes */
+
+public:
+    Vec3ArrayT pos;         /**< current positions */
+    Vec3ArrayT pos_old;     /**< previous positions */
+    Vec3ArrayT force;       /**< nodal forces */
+
+    ClothState(): fNumNodes(0) { };
+
+    explicit ClothState(int numNodes): fNumNodes(0) { Dimension(numNodes); };
+
+    /** Allocate the arrays of numNodes nodes (plus the dummy nodes) */
+    void Dimension(int numNodes);
+
+    int NumNodes() const { return fNumNodes; };
+
+    /** Index of the first of the two dummy nodes */
+    int DummyNode() const { return fNumNodes; };
+};
+
+/** Number of springs processed together: one AVX-512 register of doubles, two AVX2 registers */
+#define SPRING_BATCH 8
+
+/**
+ * The springs of a SpringNetwork in structure-of-arrays layout. Springs are grouped into batches
+ * of SPRING_BATCH in which no node appears twice, so that the forces of a whole batch can be
+ * scattered at once. Incomplete batches are padded with force-free springs between the dummy nodes.
+ */
+class SpringBatches {
+
+protected:
+    int fNumSprings;    /**< number of real springs */
+
+public:
+    ArrayT<int> i;           /**< first end points */
+    ArrayT<int> j;           /**< second end points */
+    ArrayT<double> rest;     /**< rest lengths */
+    ArrayT<double> k;        /**< stiffnesses */
+
+    SpringBatches(): fNumSprings(0) { };
+
+    /** Group the springs of the network into conflict-free batches */
+    void Build(const SpringNetwork& springs);
+
+    int NumSprings() const { return fNumSprings; };
+
+    /** Number of springs including the padding: a multiple of SPRING_BATCH */
+    int NumSlots() const { return i.Length(); };
+};
+
+/** Instruction sets of the spring force kernel */
+enum SimdLevel {
+    kSimdScalar = 0,
+    kSimdAVX2   = 1,    /**< 4 springs per instruction */
+    kSimdAVX512 = 2     /**< 8 springs per instruction */
+};
+
+/** Best instruction set supported by the CPU we are running on */
+SimdLevel DetectSimdLevel();
+
+/** Readable name of an instruction set */
+const char* SimdLevelName(SimdLevel level);
+
+/** Calculate the internal spring forces into state.force, using the best instruction set of the CPU */
+void internal_forces(const SpringBatches& springs, ClothState& state);
+
+/** Same, with a given instruction set (it has to be supported by the CPU) */
+void internal_forces(const SpringBatches& springs, ClothState& state, SimdLevel level);
+
+#endif //SIMPLECLOTH_CLOTHSTATE_H
@@ -0,0 +1,128 @@
+//
+// The cloth of main() split over MPI ranks: one rectangular tile of the N x N grid per rank.
+//
+
+#ifndef SIMPLECLOTH_DISTRIBUTEDCLOTH_H
+#define SIMPLECLOTH_DISTRIBUTEDCLOTH_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "Options.h"
+#include "GridStencil.h"
+
+#include <mpi.h>
+#include <string>
+
+/** Width of the halo: bending springs reach two nodes away */
+#define HALO_WIDTH 2
+
+/**
+ * A rank owns the nodes (i, j) with i0 <= i < i1 and j0 <= j < j1 of the grid, node (i, j) being
+ * the global node N*j + i of the serial code. The local arrays hold the tile surrounded by a halo
+ * of HALO_WIDTH nodes which mirrors the positions owned by the (up to 8) neighbouring ranks.
+ *
+ * Every step the halo exchange is started with non-blocking sends and receives, the forces of the
+ * nodes which do not depend on the halo are computed meanwhile, and the forces of the nodes close
+ * to the tile boundary are computed once the halo has arrived. Forces are gathered per node over
+ * its 12 springs, so nothing has to be sent back.
+ *
+ * The strain limiting always uses Jacobi sweeps, which do not depend on the order of the nodes and
+ * therefore not on the decomposition. Every sweep exchanges the halo once more.
+ *
+ * The forces, the strain corrections and the Verlet step add up in the order of ClothSimulation with
+ * the stencil spring kernel and Jacobi sweeps, so that the distributed run follows the serial one to
+ * the last bit.
+ */
+class DistributedCloth {
+
+protected:
+    SimulationOptions fOptions;
+
+    /** \name decomposition */
+    /*@{*/
+    MPI_Comm fComm;         /**< cartesian communicator of the ranks */
+    int fRank;
+    int fDims[2];           /**< ranks along i and j */
+    int fCoords[2];         /**< position of this rank in the rank grid */
+    int fI0, fI1;           /**< owned range of i */
+    int fJ0, fJ1;           /**< owned range of j */
+    int fLX, fLY;           /**< local grid size including the halo */
+    int fNeighbours[9];     /**< ranks of the neighbouring tiles, indexed by (di+1) + 3*(dj+1) */
+    /*@}*/
+
+    /** \name local arrays over the tile and its halo */
+    /*@{*/
+    ArrayT<Vec3> fPos0;
+    ArrayT<Vec3> fPos;
+    ArrayT<Vec3> fVel;
+    ArrayT<Vec3> fForce;
+    ArrayT<Vec3> fCorrection;
+    /*@}*/
+
+    /** \name owned nodes */
+    /*@{*/
+    ArrayT<int> fInterior;      /**< local indices of owned nodes whose springs stay inside the tile */
+    ArrayT<int> fFrame;         /**< local indices of owned nodes with springs into the halo */
+    ArrayT<double> fRest;       /**< rest lengths of the 12 springs of each local node, < 0 if absent */
+    double fStencilRest[GRID_NUM_DIRECTIONS];   /**< rest length of every direction of the grid, for the forces */
+    /*@}*/
+
+    /** \name halo exchange buffers, one per direction */
+    /*@{*/
+    ArrayT<double> fSendBuffer[9];
+    ArrayT<double> fRecvBuffer[9];
+    MPI_Request fRequests[18];
+    /*@}*/
+
+    double fTime;
+    int fCounter;
+
+    /* local index of the global node (i, j), which must lie in the tile or its halo */
+    int Local(int i, int j) const { return (j - fJ0 + HALO_WIDTH)*fLX + (i - fI0 + HALO_WIDTH); };
+
+    /* range of i (or j) exchanged with the neighbour in direction d = -1, 0, 1 */
+    void SendRange(int d, int first, int last, int& begin, int& end) const;
+    void RecvRange(int d, int first, int last, int& begin, int& end) const;
+
+    /* start the non-blocking halo exchange of the positions */
+    void StartHaloExchange();
+
+    /* wait for the halo and copy it into the local positions */
+    void FinishHaloExchange();
+
+    /* internal, viscous and gravity forces of the given owned nodes */
+    void ComputeForces(const ArrayT<int>& nodes);
+
+    /* whether the global node (i, j) is one of the fixed corners at the current time */
+    bool Pinned(int i, int j) const;
+
+    /* Jacobi sweeps of the strain limiting over the owned nodes */
+    void LimitStrain();
+
+public:
+    /** Split the cloth described by options over the ranks of comm */
+    DistributedCloth(const SimulationOptions& options, MPI_Comm comm);
+
+    ~DistributedCloth();
+
+    /** Advance one Verlet step */
+    void Step();
+
+    double Time() const { return fTime; };
+    int Counter() const { return fCounter; };
+
+    /** \name owned nodes */
+    /*@{*/
+    int NumOwned() const { return (fI1 - fI0)*(fJ1 - fJ0); };
+
+    /** Global indices of the owned nodes, in the order of OwnedPositions() */
+    void OwnedIndices(ArrayT<int>& ids) const;
+    void OwnedPositions(ArrayT<Vec3>& pos) const;
+    void OwnedForces(ArrayT<Vec3>& force) const;
+    /*@}*/
+
+    /** Every rank writes its own part of the positions and forces: pos_<tag>_rank<r>.csv and force_<tag>_rank<r>.csv */
+    void WriteOutput(const std::string& tag) const;
+};
+
+#endif //SIMPLECLOTH_DISTRIBUTEDCLOTH_H
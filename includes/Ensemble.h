@@ -0,0 +1,74 @@
+//
+// Batches of independent cloth runs in one process: parameter sweeps on a work-stealing scheduler.
+//
+
+#ifndef SIMPLECLOTH_ENSEMBLE_H
+#define SIMPLECLOTH_ENSEMBLE_H
+
+#include "Vec3.h"
+#include "Options.h"
+#include "SpringNetwork.h"
+#include "TaskScheduler.h"
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * Read a sweep description: one option per line as on the command line, "--name value", with
+ * blank lines and lines starting with '#' ignored. An option given several values, "--N 20 40 80",
+ * is swept; the instances are all the combinations of the swept values, the last swept option
+ * varying fastest, on top of the base options. Returns false (and reports on cerr) if a line or
+ * an instance is invalid.
+ */
+bool ReadSweep(std::istream& in, const SimulationOptions& base, std::vector<SimulationOptions>& instances);
+
+/** Summary of a finished instance */
+struct EnsembleResult {
+    long steps;
+    double seconds;         /**< wall clock time of the instance */
+    int thread;             /**< thread of the scheduler which ran it */
+    Vec3 centre;            /**< centre of the nodes at t_final */
+    double lowest;          /**< lowest z of the nodes at t_final */
+    double kinetic;         /**< kinetic energy at t_final */
+};
+
+/**
+ * Runs the instances of a sweep, each one serially on one thread of a TaskScheduler. The springs
+ * of ConnectivityStructure(N) are built once per size and shared by all its instances. The
+ * summary of an instance is written to the results as a CSV row as soon as it is done, so rows
+ * come in the order of completion with the instance number in the first column.
+ */
+class Ensemble {
+
+protected:
+    std::vector<SimulationOptions> fInstances;
+    std::vector<EnsembleResult> fResults;
+
+    std::map<int, SpringNetwork> fConnectivity;     /**< per size N */
+    std::mutex fOutputMutex;
+
+    /* run an instance and write its row */
+    void RunInstance(int instance, int thread, std::ostream& results);
+
+public:
+    explicit Ensemble(const std::vector<SimulationOptions>& instances);
+
+    int NumInstances() const { return int(fInstances.size()); };
+    const SimulationOptions& Instance(int instance) const { return fInstances[instance]; };
+
+    /** Estimated work of an instance: node updates, weighted for the implicit solves */
+    double Cost(int instance) const;
+
+    /** Run all instances, the header of the CSV is written first */
+    void Run(TaskScheduler& scheduler, std::ostream& results);
+
+    const EnsembleResult& Result(int instance) const { return fResults[instance]; };
+
+private:
+    Ensemble(const Ensemble&);
+    Ensemble& operator=(const Ensemble&);
+};
+
+#endif //SIMPLECLOTH_ENSEMBLE_H
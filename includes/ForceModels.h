@@ -0,0 +1,162 @@
+//
+// Force models of the cloth besides its springs: gravity, viscous drag, wind and the aerodynamic drag
+// and lift of the triangles, all added into one force buffer.
+//
+
+#ifndef SIMPLECLOTH_FORCEMODELS_H
+#define SIMPLECLOTH_FORCEMODELS_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+/** Earth's gravity on nodes of mass m */
+template <class REAL>
+class GravityT {
+
+protected:
+    Vec3T<REAL> fWeight;
+
+public:
+    explicit GravityT(double mass): fWeight(Vec3T<REAL>(0, 0, REAL(-9.8))*REAL(mass)) { };
+
+    bool Enabled() const { return true; };
+    Vec3T<REAL> Force(const Vec3T<REAL>&, const Vec3T<REAL>&) const { return fWeight; };
+};
+
+/** The viscous forces, -c v */
+template <class REAL>
+class ViscousDragT {
+
+protected:
+    REAL fDamping;      /**< -c */
+
+public:
+    explicit ViscousDragT(double c): fDamping(REAL(-c)) { };
+
+    bool Enabled() const { return fDamping != REAL(0); };
+    Vec3T<REAL> Force(const Vec3T<REAL>&, const Vec3T<REAL>& vel) const { return vel*fDamping; };
+};
+
+/** A steady wind: every node is dragged towards the velocity of the air, drag (air - v) */
+template <class REAL>
+class WindT {
+
+protected:
+    Vec3T<REAL> fAir;
+    REAL fDrag;
+
+public:
+    WindT(const Vec3& air, double drag): fAir(air), fDrag(REAL(drag)) { };
+
+    bool Enabled() const { return fDrag != REAL(0); };
+    Vec3T<REAL> Force(const Vec3T<REAL>&, const Vec3T<REAL>& vel) const { return (fAir - vel)*fDrag; };
+};
+
+/**
+ * The models of the nodes of a simulation, added to a force buffer in the order of the list. A model
+ * is a force on a node which depends on the position and velocity of that node only, MODEL provides
+ *      bool Enabled() const;
+ *      Vec3T<REAL> Force(const Vec3T<REAL>& pos, const Vec3T<REAL>& vel) const;
+ * and the calls of Force() are resolved at compile time, there is no virtual call per node. A new
+ * model is added to the list of the simulation (ClothNodeForcesT); it costs no array and no pass over
+ * the nodes of its own. The profiles time the models together, in the phase of the sweep which adds
+ * them.
+ */
+template <class REAL, class... MODELS>
+class NodeForcesT {
+
+protected:
+    std::tuple<MODELS...> fModels;
+
+public:
+    explicit NodeForcesT(const MODELS&... models): fModels(models...) { };
+
+    /** The model of type MODEL */
+    template <class MODEL>
+    const MODEL& Model() const { return std::get<MODEL>(fModels); }
+
+    /** force + the forces of the enabled models on a node, for the sweeps of the integrators */
+    Vec3T<REAL> Add(Vec3T<REAL> force, const Vec3T<REAL>& pos, const Vec3T<REAL>& vel) const {
+        return AddModels(force, pos, vel, std::index_sequence_for<MODELS...>());
+    };
+
+    /** force = from + the forces of the enabled models, for every node, from may be force */
+    void Accumulate(const ArrayT<Vec3T<REAL> >& pos, const ArrayT<Vec3T<REAL> >& vel,
+                    const ArrayT<Vec3T<REAL> >& from, ArrayT<Vec3T<REAL> >& force) const {
+        PROFILE_SCOPE(kProfileNodeForces);
+        Sweep(0, pos.Length(), pos.Pointer(), vel.Pointer(), from.Pointer(), force.Pointer());
+    };
+
+    /** The same on the threads of the pool */
+    void Accumulate(const ArrayT<Vec3T<REAL> >& pos, const ArrayT<Vec3T<REAL> >& vel,
+                    const ArrayT<Vec3T<REAL> >& from, ArrayT<Vec3T<REAL> >& force, ThreadPool& pool) const {
+        PROFILE_SCOPE(kProfileNodeForces);
+        pool.ParallelFor(0, pos.Length(), [&](int first, int last) {
+            Sweep(first, last, pos.Pointer(), vel.Pointer(), from.Pointer(), force.Pointer());
+        });
+    };
+
+protected:
+    template <std::size_t... I>
+    Vec3T<REAL> AddModels(Vec3T<REAL> force, const Vec3T<REAL>& pos, const Vec3T<REAL>& vel,
+                          std::index_sequence<I...>) const {
+        int expand[] = {0, (std::get<I>(fModels).Enabled() ? (force += std::get<I>(fModels).Force(pos, vel), 0) : 0)...};
+        (void) expand;
+        return force;
+    }
+
+    /* all the models, node by node, from a copy of them which the stores to force cannot alias */
+    void Sweep(int first, int last, const Vec3T<REAL>* pos, const Vec3T<REAL>* vel, const Vec3T<REAL>* from,
+               Vec3T<REAL>* force) const {
+        const NodeForcesT models(*this);
+        for (int n = first; n < last; n++) force[n] = models.Add(from[n], pos[n], vel[n]);
+    };
+};
+
+/** The models of the nodes of ClothSimulationT, in the order they are added */
+template <class REAL>
+using ClothNodeForcesT = NodeForcesT<REAL, ViscousDragT<REAL>, GravityT<REAL>, WindT<REAL> >;
+
+/**
+ * Aerodynamic forces on the triangles of the cloth, in air of density rho blowing at the velocity of
+ * the wind. With u the velocity of the air relative to a triangle (to the mean velocity of its
+ * corners), n its unit normal and A its area, the drag pushes the triangle along its normal and the
+ * lift across the wind:
+ *      drag = 1/2 rho C_d A |u| (u.n) n
+ *      lift = 1/2 rho C_l A |u| (u.n) (n - (n.u) u/|u|^2)
+ * which vanish for a triangle edge-on to the wind, the lift for one facing it as well. Each corner
+ * gets a third. Triangles share nodes, so the forces are added by one thread.
+ */
+class Aerodynamics {
+
+protected:
+    ArrayT<int> fTriangles;     /**< three nodes per triangle */
+    Vec3 fWind;
+    double fDensity;
+    double fDrag;               /**< C_d */
+    double fLift;               /**< C_l */
+
+public:
+    /** Disabled, no triangles */
+    Aerodynamics();
+
+    Aerodynamics(const ArrayT<int>& triangles, const Vec3& wind, double density, double drag, double lift);
+
+    bool Enabled() const { return fDensity > 0.0 && NumTriangles() > 0; };
+    int NumTriangles() const { return fTriangles.Length()/3; };
+
+    /** Add the forces of the triangles to force, the positions and velocities in double or float (REAL) */
+    template <class REAL>
+    void Accumulate(const ArrayT<Vec3T<REAL> >& pos, const ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force) const;
+};
+
+/** The triangles of the N x N grid, two per quad, their normals along +z while the cloth is flat */
+ArrayT<int> GridTriangles(int N);
+
+#endif //SIMPLECLOTH_FORCEMODELS_H
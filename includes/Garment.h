@@ -0,0 +1,68 @@
+//
+// Garments: the springs of a triangulated cloth of any shape and the numbering of its nodes.
+//
+
+#ifndef SIMPLECLOTH_GARMENT_H
+#define SIMPLECLOTH_GARMENT_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "TriangleMesh.h"
+#include "SpringNetwork.h"
+
+#include <string>
+
+/** Smallest angle in degrees opposite the shared edge in both triangles for a pair of triangles to
+ * count as a quad cut along its diagonal */
+#define QUAD_DIAGONAL_ANGLE 80.0
+
+/** Relative height below the highest vertex within which the nodes of a garment are pinned */
+#define GARMENT_PIN_TOLERANCE 1.0e-6
+
+/** Numberings of the nodes of a garment */
+enum NodeOrder {
+    kImportOrder = 0,   /**< that of the file */
+    kCuthillMcKee = 1,  /**< reverse Cuthill-McKee over the edges of the mesh */
+    kMortonOrder = 2    /**< along the Z-order curve through the bounding box */
+};
+
+/** The order of a name, "import", "rcm" or "morton", throws std::runtime_error for the others */
+NodeOrder NodeOrderFromName(const std::string& name);
+
+/**
+ * The springs of a triangle mesh, each stored once and sorted by their end points, with the CSR map
+ * and the colouring built, in chunks small enough for 64 colours (the rest lengths are not set):
+ *  - the edges are structural springs, unless the two triangles of an edge both have an angle of at
+ *    least QUAD_DIAGONAL_ANGLE opposite it: they form a quad and the edge is one of its shear
+ *    springs, the other joins the opposite corners;
+ *  - across the other edges of two triangles, the opposite corners are joined by a bending spring.
+ * On a grid cut into triangles this gives the structural and shear springs of ConnectivityStructure()
+ * and bending springs across every edge of the grid. Degenerate triangles are ignored.
+ */
+SpringNetwork MeshSprings(const TriangleMesh& mesh);
+
+/**
+ * The nodes of the mesh in the given order: the index in the mesh of every new node. Neighbours end
+ * up close to each other with kCuthillMcKee (a breadth-first walk from a node at the end of a longest
+ * path, each component of the mesh on its own, reversed) and with kMortonOrder (by the interleaved
+ * bits of the positions quantized to 21 bits per axis).
+ */
+ArrayT<int> NodeNumbering(const TriangleMesh& mesh, NodeOrder order);
+
+/** The mesh with its vertices renumbered, vertex n of the result is vertex order[n] of mesh */
+TriangleMesh RenumberVertices(const TriangleMesh& mesh, const ArrayT<int>& order);
+
+/** The nodes of a garment pinned at its top: those within GARMENT_PIN_TOLERANCE of the height of the
+ * mesh from its highest vertex (the largest z) */
+ArrayT<int> TopNodes(const ArrayT<Vec3>& pos0);
+
+/** \name locality of the numbering of the springs */
+/*@{*/
+/** Largest difference between the end points of a spring */
+int Bandwidth(const SpringNetwork& springs);
+
+/** Average difference between the end points of the springs */
+double MeanSpringSpan(const SpringNetwork& springs);
+/*@}*/
+
+#endif //SIMPLECLOTH_GARMENT_H
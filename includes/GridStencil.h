@@ -0,0 +1,79 @@
+//
+// Spring forces of the regular N x N grid as a fixed stencil: no spring list, no index lookups.
+//
+
+#ifndef SIMPLECLOTH_GRIDSTENCIL_H
+#define SIMPLECLOTH_GRIDSTENCIL_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+
+/** Number of spring directions of ConnectivityStructure(): every node has up to twice as many springs */
+#define GRID_NUM_DIRECTIONS 6
+
+/** Nodes within this distance of an edge of the grid miss some of their springs */
+#define GRID_REACH 2
+
+/** A spring direction: from node (i, j) to node (i + di, j + dj) */
+struct GridDirection {
+    int di;
+    int dj;
+    SpringType type;
+};
+
+/** The directions of ConnectivityStructure(), in the order of SpringType */
+constexpr GridDirection kGridDirections[GRID_NUM_DIRECTIONS] = {
+    { 1, 0, kStructural}, {0, 1, kStructural},
+    { 1, 1, kShear},      {-1, 1, kShear},
+    { 2, 0, kBending},    {0, 2, kBending}
+};
+
+/**
+ * The springs of ConnectivityStructure(N) on a regular grid: all springs of a direction have the
+ * same rest length, so the whole network is N, the stiffness and GRID_NUM_DIRECTIONS rest lengths.
+ * Node (i, j) is stored at N*j + i.
+ */
+class GridStencil {
+
+protected:
+    int fN;                                 /**< nodes per side */
+    double fK;                              /**< stiffness of all the springs */
+    double fRest[GRID_NUM_DIRECTIONS];      /**< rest length per direction */
+
+public:
+    GridStencil();
+
+    /** Take the rest lengths from the initial configuration of the N x N grid, throws std::runtime_error
+     * if the springs of a direction have different rest lengths (the grid is not regular) */
+    void SetRestState(int N, const ArrayT<Vec3>& pos0, double k);
+
+    /** \name Accessors */
+    /*@{*/
+    int N() const { return fN; };
+    double Stiffness() const { return fK; };
+    double Rest(int direction) const { return fRest[direction]; };
+    /*@}*/
+};
+
+/* Calculate internal spring forces with the stencil. Every node sums the forces of its own springs:
+ * each spring is evaluated from both ends, but there is no scatter and no index array. Interior nodes
+ * take an unrolled branch-free path, the GRID_REACH rows and columns along the edges a checked one.
+ * The usual sizes (32, 64, 128, 256, 512) are compiled with N known to the compiler */
+template <class REAL, bool APPROX = false>
+void grid_forces(const GridStencil& stencil, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int);
+
+/* Same on the threads of the pool, by blocks of rows: the nodes only write their own force, the
+ * result does not depend on the number of threads */
+template <class REAL, bool APPROX = false>
+void grid_forces(const GridStencil& stencil, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int,
+                 ThreadPool& pool);
+
+/* Same for the nodes (i, j) of the block firstColumn <= i < lastColumn, firstRow <= j < lastRow only,
+ * the forces of the other nodes are left as they are */
+template <class REAL, bool APPROX = false>
+void grid_forces(const GridStencil& stencil, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int,
+                 int firstColumn, int lastColumn, int firstRow, int lastRow);
+
+#endif //SIMPLECLOTH_GRIDSTENCIL_H
@@ -0,0 +1,137 @@
+//
+// Implicit (backward Euler) time integration of the cloth in the style of Baraff & Witkin.
+//
+
+#ifndef SIMPLECLOTH_IMPLICITINTEGRATOR_H
+#define SIMPLECLOTH_IMPLICITINTEGRATOR_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "MultArrayT.h"
+#include "SpringNetwork.h"
+
+/** A diagonal block whose determinant is below this fraction of the product of its diagonal entries
+ * counts as singular, the preconditioner takes the inverse of its diagonal instead */
+#define SINGULAR_BLOCK_TOLERANCE 1.0e-12
+
+/**
+ * A sparse matrix of 3 x 3 blocks with the sparsity of the spring network: block row n holds the
+ * diagonal block and one block per node connected to n. The pattern is built once, only the values
+ * of the blocks change from step to step.
+ */
+class BlockSparseMatrix {
+
+protected:
+    int fNumRows;                   /**< number of block rows (nodes) */
+
+    /** \name CSR pattern: blocks of row n are fColumns[fRowOffsets[n]] ... fColumns[fRowOffsets[n+1]-1] */
+    /*@{*/
+    ArrayT<int> fRowOffsets;
+    ArrayT<int> fColumns;
+    ArrayT<int> fDiagonal;          /**< block index of the diagonal block of each row */
+    ArrayT<int> fSpringBlocks;      /**< block indices of (i, j) and (j, i) of each spring */
+    /*@}*/
+
+    /** the values: column b holds block b, in column-major order */
+    MultArrayT<double> fBlocks;
+
+public:
+    BlockSparseMatrix(): fNumRows(0) { };
+
+    /** Build the pattern from the springs */
+    void BuildPattern(const SpringNetwork& springs);
+
+    /** Set all blocks to zero */
+    void Zero() { fBlocks = 0.0; };
+
+    int NumRows() const { return fNumRows; };
+    int NumBlocks() const { return fColumns.Length(); };
+
+    /** \name the pattern: the blocks of row n are RowBegin(n) ... RowEnd(n) - 1, by increasing column */
+    /*@{*/
+    int RowBegin(int row) const { return fRowOffsets[row]; };
+    int RowEnd(int row) const { return fRowOffsets[row + 1]; };
+    int Column(int b) const { return fColumns[b]; };
+    /*@}*/
+
+    /** \name blocks, as pointers to their 9 entries in column-major order */
+    /*@{*/
+    double* Block(int b) { return fBlocks(b); };
+    const double* Block(int b) const { return fBlocks(b); };
+
+    int DiagonalBlock(int row) const { return fDiagonal[row]; };
+
+    /** Block (i, j) of spring s for which = 0, block (j, i) for which = 1 */
+    int SpringBlock(int s, int which) const { return fSpringBlocks[2*s + which]; };
+    /*@}*/
+
+    /** y = A x, both of NumRows() nodes */
+    void Multiply(const Vec3* x, Vec3* y) const;
+};
+
+/**
+ * One backward Euler step of M dv/dt = f(x, v), dx/dt = v linearized once per step:
+ *
+ *      (M - dt df/dv - dt^2 df/dx) dv = dt (f0 + dt df/dx v0)
+ *
+ * The spring Jacobian df/dx is assembled in a BlockSparseMatrix (with the transverse part clamped
+ * for compressed springs, which keeps the system positive definite) and the system is solved with
+ * a block-Jacobi preconditioned conjugate gradient. Pinned nodes are filtered out of the solve.
+ * Singular diagonal blocks (see SINGULAR_BLOCK_TOLERANCE) are preconditioned by their diagonal and
+ * counted.
+ */
+class ImplicitIntegrator {
+
+protected:
+    BlockSparseMatrix fA;               /**< system matrix, pattern reused over the steps */
+    MultArrayT<double> fInvDiagonal;    /**< inverses of the diagonal blocks */
+
+    ArrayT<Vec3> fDv;                   /**< velocity change of the last step */
+
+    double fTolerance;          /**< relative residual of the conjugate gradient */
+    int fMaxIterations;
+
+    int fIterations;            /**< iterations of the last solve */
+    double fResidual;           /**< relative residual of the last solve */
+    int fSingularBlocks;        /**< diagonal blocks of the last step preconditioned by their diagonal */
+    long fTotalIterations;
+    long fTotalSolves;
+    long fTotalSingularBlocks;
+
+    /* assemble the system and its right hand side into rhs */
+    void Assemble(const SpringNetwork& springs, double m, double c, double dt, const ArrayT<Vec3>& forces,
+                  const ArrayT<Vec3>& pos, const ArrayT<Vec3>& vel, Vec3* rhs);
+
+    /* solve A dv = rhs for the nodes not flagged in fixed */
+    void Solve(const Vec3* rhs, const char* fixed);
+
+public:
+    /** Set up the system for the springs */
+    ImplicitIntegrator(const SpringNetwork& springs, double tolerance = 1.0e-6, int maxIterations = 500);
+
+    /**
+     * Advance pos and vel by dt. forces are the total nodal forces at the beginning of the step
+     * (springs, drag and gravity), the nodes listed in pinned do not move. The work arrays of the
+     * solve come from the current StepArena, it is called within an ArenaScope.
+     */
+    void Step(const SpringNetwork& springs, double m, double c, double dt, const ArrayT<Vec3>& forces,
+              const ArrayT<int>& pinned, ArrayT<Vec3>& pos, ArrayT<Vec3>& vel);
+
+    /** \name the velocity change of the last step, where the next solve starts from */
+    /*@{*/
+    const ArrayT<Vec3>& LastDv() const { return fDv; };
+    void SetLastDv(const ArrayT<Vec3>& dv) { assert(dv.Length() == fDv.Length()); fDv = dv; };
+    /*@}*/
+
+    /** \name statistics of the solver */
+    /*@{*/
+    int Iterations() const { return fIterations; };
+    double Residual() const { return fResidual; };
+    int SingularBlocks() const { return fSingularBlocks; };
+    long TotalIterations() const { return fTotalIterations; };
+    long TotalSolves() const { return fTotalSolves; };
+    long TotalSingularBlocks() const { return fTotalSingularBlocks; };
+    /*@}*/
+};
+
+#endif //SIMPLECLOTH_IMPLICITINTEGRATOR_H
@@ -158,12 +158,11 @@ inline MultArrayT<TYPE>& MultArrayT<TYPE>::operator=(const TYPE& valRHS) {
 template<class TYPE>
 inline MultArrayT<TYPE>& MultArrayT<TYPE>::operator=(const MultArrayT<TYPE>& matRHS) {
 
-    /* Inherited */
-    MultArrayT<TYPE>::operator=(matRHS);
+    /* Setting dimensions first, the inherited assignment would take the length as a square size */
+    Dimension(matRHS.fRows, matRHS.fCols);
 
-    /* Setting dimensions */
-    fRows = matRHS.fRows;
-    fCols = matRHS.fCols;
+    /* Inherited */
+    ArrayT<TYPE>::operator=(matRHS);
 
     return (*this);
 }
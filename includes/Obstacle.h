@@ -0,0 +1,124 @@
+//
+// Static obstacles: the nodes of the cloth against a triangle mesh, through a bounding volume hierarchy.
+//
+
+#ifndef SIMPLECLOTH_OBSTACLE_H
+#define SIMPLECLOTH_OBSTACLE_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "TriangleMesh.h"
+#include "ThreadPool.h"
+
+/** Largest number of triangles in a leaf of the hierarchy */
+#define BVH_LEAF_SIZE 4
+
+/** Bins of the centroids per axis when a node is split */
+#define BVH_BINS 16
+
+/** Depth of the traversal stacks, far beyond that of any hierarchy of leaves of a few triangles */
+#define BVH_STACK_DEPTH 64
+
+/**
+ * A bounding volume hierarchy of axis-aligned boxes over the triangles of a static mesh, built once.
+ * Every node is split where the surface area heuristic is smallest among BVH_BINS planes per axis,
+ * binned by the centroids of the triangles, down to leaves of at most BVH_LEAF_SIZE triangles.
+ *
+ * The nodes are flattened in depth-first order: the first child of an interior node follows it, the
+ * index of the second is stored in the node, so that a traversal walks mostly forward through one
+ * array. The triangles are stored in the order of the leaves, each with its corner and edges.
+ */
+class BoundingVolumeHierarchy {
+
+protected:
+    struct Node {
+        Vec3 low;
+        Vec3 high;
+        int first;      /**< leaves: first triangle, interior nodes: second child */
+        int count;      /**< triangles of a leaf, 0 for interior nodes */
+    };
+
+    struct Triangle {
+        Vec3 a;
+        Vec3 ab;        /**< b - a */
+        Vec3 ac;        /**< c - a */
+        Vec3 normal;    /**< unit */
+        int index;      /**< in the mesh */
+    };
+
+    ArrayT<Node> fNodes;
+    ArrayT<Triangle> fTriangles;
+    int fDepth;
+
+    /* the node of triangles [first, last) of order, whose centroids and boxes are given */
+    int Build(ArrayT<int>& order, int first, int last, const ArrayT<Vec3>& centroids,
+              const ArrayT<Vec3>& lows, const ArrayT<Vec3>& highs, int depth);
+
+public:
+    /** Build the hierarchy of the triangles of the mesh, which needs at least one */
+    explicit BoundingVolumeHierarchy(const TriangleMesh& mesh);
+
+    /**
+     * The point of the mesh closest to p if nearer than radius: its position, the triangle (index in
+     * the hierarchy) and the distance. Returns false if no triangle is that close.
+     */
+    bool Closest(const Vec3& p, double radius, Vec3& closest, int& triangle, double& distance) const;
+
+    /** The first triangle crossed by the segment from one point to another, at the fraction t of the
+     * segment. Returns false if it crosses none */
+    bool FirstHit(const Vec3& from, const Vec3& to, int& triangle, double& t) const;
+
+    /** \name the hierarchy */
+    /*@{*/
+    int NumNodes() const { return fNodes.Length(); };
+    int NumTriangles() const { return fTriangles.Length(); };
+    int Depth() const { return fDepth; };
+    const Vec3& Normal(int triangle) const { return fTriangles[triangle].normal; };
+    int MeshTriangle(int triangle) const { return fTriangles[triangle].index; };
+    /*@}*/
+};
+
+/**
+ * A static triangle mesh the cloth cannot go through. After the position update of every step each
+ * free node is tested against the BoundingVolumeHierarchy of the mesh: a node whose motion over the
+ * step crossed a triangle goes back to the crossing, and any node nearer to the mesh than thickness
+ * is pushed out to that distance, away from the closest point. The nodes are independent of each
+ * other, the queries are spread over the threads of the pool.
+ */
+class Obstacle {
+
+protected:
+    BoundingVolumeHierarchy fBVH;
+    double fThickness;
+
+    int fContacts;              /**< nodes moved by the last call */
+    long fTotalContacts;        /**< over all calls */
+
+    /* the correction of one node, whether it moved */
+    bool Resolve(const Vec3& prev, Vec3& pos) const;
+
+public:
+    Obstacle(const TriangleMesh& mesh, double thickness);
+
+    /**
+     * Push the nodes of pos out of the mesh, prev are the positions at the beginning of the step.
+     * The nodes listed in pinned do not move, nor those flagged in asleep if given (see
+     * ActivityTracker). If vel is given, every node moved by delta gets delta/dt added to its
+     * velocity. Returns the number of nodes moved. The flags of the fixed nodes come from the current
+     * StepArena, it is called within an ArenaScope.
+     */
+    template <class REAL>
+    int Apply(const ArrayT<Vec3T<REAL> >& prev, const ArrayT<int>& pinned, ArrayT<Vec3T<REAL> >& pos,
+              ThreadPool* pool = NULL, const ArrayT<char>* asleep = NULL, ArrayT<Vec3T<REAL> >* vel = NULL,
+              double dt = 0.0);
+
+    /** \name parameters and statistics */
+    /*@{*/
+    const BoundingVolumeHierarchy& Hierarchy() const { return fBVH; };
+    double Thickness() const { return fThickness; };
+    int Contacts() const { return fContacts; };
+    long TotalContacts() const { return fTotalContacts; };
+    /*@}*/
+};
+
+#endif //SIMPLECLOTH_OBSTACLE_H
@@ -0,0 +1,159 @@
+//
+// Run parameters of the simulator and their command line.
+//
+
+#ifndef SIMPLECLOTH_OPTIONS_H
+#define SIMPLECLOTH_OPTIONS_H
+
+#include <iostream>
+#include <string>
+
+/** Parameters of a simulation, the defaults are the hanging and released cloth of main() */
+struct SimulationOptions {
+
+    /** \name geometrical size */
+    /*@{*/
+    int N = 20;
+    double length = 10;
+    /*@}*/
+
+    /** \name a garment (Garment.h): triangle mesh of an OBJ or PLY file which replaces the N x N grid if
+     * not empty, pinned at its top, and the numbering of its nodes, "import", "rcm" or "morton" */
+    /*@{*/
+    std::string garment = "";
+    std::string node_order = "rcm";
+    /*@}*/
+
+    /** \name material properties */
+    /*@{*/
+    double m = 0.1;
+    double k = 1000.0;
+    double c = 0.0001;
+    /*@}*/
+
+    /** \name time integration parameters */
+    /*@{*/
+    double dt = 0.001;
+    double t_final = 2000;
+
+    /** "fixed" steps of dt or "adaptive" ones, see StepController: dt is then the first step,
+     * dt_min and dt_max bound the steps, dt_tolerance is the position error allowed per step and
+     * dt_safety the fraction of the stability limit taken by the explicit scheme */
+    std::string dt_control = "fixed";
+    double dt_min = 1.0e-6;
+    double dt_max = 0.01;
+    double dt_tolerance = 1.0e-4;
+    double dt_safety = 0.5;
+
+    /** "verlet" (explicit) or "implicit" (backward Euler) */
+    std::string integrator = "verlet";
+
+    /** relative tolerance and iteration limit of the conjugate gradient of the implicit integrator */
+    double cg_tolerance = 1.0e-4;
+    int cg_iterations = 500;
+    /*@}*/
+
+    /** \name accuracy tiers: "double" or "float" state (float for the Verlet scheme only) and
+     * "exact" or "approx" (hardware reciprocal square root) inverse spring lengths */
+    /*@{*/
+    std::string precision = "double";
+    std::string rsqrt = "exact";
+    /*@}*/
+
+    /** internal forces from the "stencil" of the regular grid (GridStencil) or the "edges" of the
+     * spring list (SpringNetwork), "auto" takes the stencil for the grid and the edges for a garment */
+    std::string spring_kernel = "auto";
+
+    /** \name strain limiting (Provot): maximum elongation of the springs, projection sweeps per step
+     * (0 disables it) and "gauss-seidel" or "jacobi" sweeps */
+    /*@{*/
+    double max_strain = 0.1;
+    int strain_iterations = 10;
+    std::string strain_sweep = "gauss-seidel";
+    /*@}*/
+
+    /** \name self-collision (SelfCollision): "off" or "on", the nodes are kept at collision_thickness
+     * times the spacing of the grid from the triangles */
+    /*@{*/
+    std::string collision = "off";
+    double collision_thickness = 0.2;
+    /*@}*/
+
+    /** \name a static obstacle (Obstacle): triangle mesh of an OBJ file, none if empty, the nodes are
+     * kept at obstacle_thickness times the spacing of the grid from it */
+    /*@{*/
+    std::string obstacle = "";
+    double obstacle_thickness = 0.2;
+    /*@}*/
+
+    /** \name air (ForceModels.h): the velocity of the wind, the drag of every node towards it and the
+     * aerodynamic drag and lift of the triangles of the cloth in air of density air_density (0
+     * disables them, as sleeping tiles do), with their drag and lift coefficients */
+    /*@{*/
+    double wind_x = 0.0;
+    double wind_y = 0.0;
+    double wind_z = 0.0;
+    double wind_drag = 0.0;
+    double air_density = 0.0;
+    double drag_coefficient = 1.0;
+    double lift_coefficient = 0.5;
+    /*@}*/
+
+    /** \name sleeping tiles (ActivityTracker, fixed Verlet steps with the stencil only): tiles of
+     * sleep_tile x sleep_tile nodes (0 disables them) sleep after sleep_steps steps in which no node
+     * moved by sleep_displacement and no residual force reached sleep_force. sleep_force is below
+     * the weight m g of a node, the residual force of a node in free fall. The fraction of active
+     * nodes is written to the activity file at every output */
+    /*@{*/
+    int sleep_tile = 0;
+    double sleep_displacement = 1.0e-7;
+    double sleep_force = 1.0e-2;
+    int sleep_steps = 100;
+    std::string activity = "activity.csv";
+    /*@}*/
+
+    /** time at which the bottom-left corner is let go */
+    double t_release = 1000;
+
+    /** \name the hanging phase: from the flat sheet at "rest", or replaced by its static
+     * "equilibrium" (StaticSolver) from which the run starts at t_release. newton_tolerance is the
+     * largest residual force left relative to the weight of a node */
+    /*@{*/
+    std::string start = "rest";
+    double newton_tolerance = 1.0e-8;
+    int newton_iterations = 200;
+    /*@}*/
+
+    /** trajectory file of the snapshots, written every output_interval time units */
+    std::string output = "cloth.traj";
+    double output_interval = 10;
+
+    /** snapshots queued for the writer thread before the stepping waits for it */
+    int output_buffers = 2;
+
+    /** \name checkpoints: the complete state is saved every checkpoint_interval time units (0 for
+     * never) and at the end of the run, restart names a checkpoint to resume from */
+    /*@{*/
+    std::string checkpoint = "cloth.chk";
+    double checkpoint_interval = 100;
+    std::string restart = "";
+    /*@}*/
+
+    /** number of threads of the force stage, 0 for one per hardware thread */
+    int threads = 0;
+};
+
+/** Read the options from the command line, returns false (after printing the usage) on errors or --help */
+bool ParseOptions(int argc, char* argv[], SimulationOptions& options);
+
+/** Print the command line options */
+void PrintUsage(std::ostream& out, const char* program);
+
+/** Write the options as the command line which sets them, one "--name value" pair per line. The
+ * restart file is left out */
+void WriteOptions(std::ostream& out, const SimulationOptions& options);
+
+/** Read options written by WriteOptions(), returns false on errors */
+bool ReadOptions(std::istream& in, SimulationOptions& options);
+
+#endif //SIMPLECLOTH_OPTIONS_H
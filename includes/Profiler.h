@@ -0,0 +1,126 @@
+//
+// Per-phase profiling of the time loop: scoped timers and hardware counters, compiled out by default.
+//
+
+#ifndef SIMPLECLOTH_PROFILER_H
+#define SIMPLECLOTH_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/** The phases of a step and of the output */
+enum ProfilePhase {
+    kProfileInternalForces,
+    kProfileViscousForces,
+    kProfileGravity,
+    kProfileNodeForces,         /**< the models of the nodes (ForceModels.h) in a sweep of their own */
+    kProfileAerodynamics,       /**< drag and lift of the triangles */
+    kProfileIntegration,
+    kProfileBoundary,
+    kProfileStrainLimiting,
+    kProfileCollision,          /**< self-collision of the cloth */
+    kProfileObstacle,           /**< collision with the obstacle */
+    kProfileStepControl,        /**< choosing the size of adaptive steps */
+    kProfileActivity,           /**< putting tiles to sleep and waking them */
+    kProfileEquilibrium,        /**< the static solve replacing the hanging phase */
+    kProfileOutput,             /**< handing the snapshots to the output */
+    kProfileFileWrite,          /**< writing trajectories and CSV files, on the writer thread if any */
+    kProfileCheckpoint,
+    kNumProfilePhases
+};
+
+/** \name hardware counters */
+/*@{*/
+#define PROFILE_CYCLES 0
+#define PROFILE_INSTRUCTIONS 1
+#define PROFILE_LLC_MISSES 2
+#define PROFILE_NUM_COUNTERS 3
+/*@}*/
+
+/**
+ * Totals per phase over all the threads: wall-clock time, calls, bytes written and, if enabled,
+ * the cycles, instructions and last level cache misses of the thread which entered the phase
+ * (the Linux perf_event_open counters, work handed to the threads of a pool is not counted).
+ *
+ * The counters are enabled by setting SIMPLECLOTH_COUNTERS=1 in the environment; where the
+ * kernel does not allow them (perf_event_paranoid, containers) they are reported as n/a.
+ *
+ * Everything is recorded through the PROFILE_* macros, which are empty unless the code is built
+ * with SIMPLECLOTH_PROFILE (cmake -DSIMPLECLOTH_PROFILE=ON).
+ */
+class Profiler {
+
+protected:
+    struct Totals {
+        std::atomic<int64_t> ns;
+        std::atomic<int64_t> calls;
+        std::atomic<int64_t> bytes;
+        std::atomic<int64_t> counters[PROFILE_NUM_COUNTERS];
+    };
+    Totals fTotals[kNumProfilePhases];
+
+    bool fCountersWanted;
+    std::atomic<bool> fCountersFailed;
+
+    Profiler();
+
+public:
+    static Profiler& Instance();
+
+    static const char* PhaseName(ProfilePhase phase);
+
+    /** Whether the hardware counters are read */
+    bool CountersEnabled() const { return fCountersWanted && !fCountersFailed; };
+
+    /** Read the counters of the calling thread, false if they are not available */
+    bool ReadCounters(int64_t values[PROFILE_NUM_COUNTERS]);
+
+    /** \name recording */
+    /*@{*/
+    void Add(ProfilePhase phase, int64_t ns, const int64_t* counters);
+    void AddBytes(ProfilePhase phase, int64_t bytes) { fTotals[phase].bytes += bytes; };
+    /*@}*/
+
+    /** Clear all totals */
+    void Reset();
+
+    /** The table of the phases with steps/s, ns/node/step and the bytes written */
+    void Print(std::ostream& out, long steps, long numNodes, double seconds) const;
+
+private:
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+};
+
+/** Records the time (and counters) from its construction to its destruction */
+class ProfileScope {
+
+protected:
+    ProfilePhase fPhase;
+    int64_t fStart;
+    int64_t fCounters[PROFILE_NUM_COUNTERS];
+    bool fCounting;
+
+public:
+    explicit ProfileScope(ProfilePhase phase);
+    ~ProfileScope();
+
+private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+};
+
+#ifdef SIMPLECLOTH_PROFILE
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(phase)
+#define PROFILE_BYTES(phase, bytes) Profiler::Instance().AddBytes(phase, bytes)
+#define PROFILE_PRINT(out, steps, numNodes, seconds) Profiler::Instance().Print(out, steps, numNodes, seconds)
+#else
+#define PROFILE_SCOPE(phase) ((void) 0)
+#define PROFILE_BYTES(phase, bytes) ((void) 0)
+#define PROFILE_PRINT(out, steps, numNodes, seconds) ((void) 0)
+#endif
+
+#endif //SIMPLECLOTH_PROFILER_H
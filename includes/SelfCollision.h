@@ -0,0 +1,144 @@
+//
+// Self-collision of the cloth: the nodes against the triangles of the grid, with a spatial hash as
+// broad phase.
+//
+
+#ifndef SIMPLECLOTH_SELFCOLLISION_H
+#define SIMPLECLOTH_SELFCOLLISION_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+
+#include <cmath>
+
+/** Entries of the hash table per point, at least */
+#define HASH_LOAD_FACTOR 2
+
+/** Size of the cells of the self-collision in grid spacings: a triangle with its margin spans at
+ * most two of them along each axis */
+#define COLLISION_CELL_SIZE 1.5
+
+/**
+ * Points sorted into a uniform grid of cubic cells, the cells hashed into a table of a power of two
+ * entries. Build() is a counting sort: one pass counts the points of every entry, a prefix sum turns
+ * the counts into offsets and a second pass scatters the point indices. Nothing is allocated per
+ * cell and the build is linear in the number of points. Cells which share an entry return each
+ * other's points as well, the caller checks what it gets. The arrays come from the current StepArena,
+ * a hash is built and queried within one ArenaScope.
+ */
+class SpatialHash {
+
+protected:
+    double fCellSize;
+    unsigned fMask;             /**< entries - 1 */
+
+    /** \name the points of entry e are fPoints[fStart[e]] ... fPoints[fStart[e + 1] - 1] */
+    /*@{*/
+    ArrayT<int, ArenaAllocator<int> > fStart;
+    ArrayT<int, ArenaAllocator<int> > fPoints;
+    /*@}*/
+
+public:
+    SpatialHash(): fCellSize(1.0), fMask(0) { };
+
+    /** Sort the points into cells of the given size */
+    template <class REAL>
+    void Build(const ArrayT<Vec3T<REAL> >& pos, double cellSize);
+
+    /** \name cells */
+    /*@{*/
+    double CellSize() const { return fCellSize; };
+    int NumEntries() const { return int(fMask) + 1; };
+    int Cell(double x) const { return int(std::floor(x/fCellSize)); };
+    unsigned Entry(int i, int j, int k) const {
+        unsigned row = (unsigned(j)*73856093u ^ unsigned(k)*19349663u)*2654435761u;
+        return (unsigned(i) + (row ^ (row >> 16))) & fMask;
+    };
+    /*@}*/
+
+    /** Call visit(point) for the points of the entries of the cells overlapping [low, high]. A point
+     * comes twice if two of the cells share its entry, which is rare in a small box */
+    template <class VISIT>
+    void Query(const Vec3& low, const Vec3& high, VISIT visit) const;
+};
+
+/**
+ * Keeps the nodes of the cloth at a distance of at least thickness from the triangles of the grid
+ * (two per quad), on the side they were at the beginning of the step, so that the cloth can neither
+ * pass through itself nor rest inside itself. It runs after the integration and the strain limiting,
+ * as a position correction like theirs: a node too close to a triangle and the three corners of the
+ * triangle are pushed apart along its normal, with momentum conserved.
+ *
+ * Every call builds a SpatialHash of the nodes with cells of COLLISION_CELL_SIZE grid spacings. Each triangle
+ * queries the cells of its bounding box grown by the thickness. Nodes joined by a spring of
+ * ConnectivityStructure() to a corner of the triangle are skipped: they are that close at rest.
+ */
+class SelfCollision {
+
+protected:
+    double fSpacing;            /**< rest distance of neighbouring nodes */
+    double fThickness;
+
+    ArrayT<int> fTriangles;     /**< three nodes per triangle */
+
+    /** \name the nodes joined to node n by a spring: fNeighbours[fNeighbourStart[n]] ..., sorted */
+    /*@{*/
+    ArrayT<int> fNeighbourStart;
+    ArrayT<int> fNeighbours;
+    /*@}*/
+
+    /** \name statistics of the last call */
+    /*@{*/
+    long fCandidates;           /**< node-triangle pairs from the hash, before any filtering */
+    int fContacts;              /**< pairs pushed apart */
+    /*@}*/
+
+    long fTotalContacts;        /**< over all calls */
+
+public:
+    /** The triangles of the N x N grid and the neighbours of the springs, thickness in units of length */
+    SelfCollision(int N, const SpringNetwork& springs, double spacing, double thickness);
+
+    /** Whether nodes a and b are the same or joined by a spring */
+    bool Adjacent(int a, int b) const;
+
+    /**
+     * Push apart the nodes and triangles closer than the thickness in pos, prev are the positions at
+     * the beginning of the step which tell the sides. The nodes listed in pinned do not move, nor
+     * those flagged in asleep if given (see ActivityTracker). If vel is given, every node pushed by
+     * delta gets delta/dt added to its velocity. Returns the number of contacts. The hash and the
+     * work arrays come from the current StepArena, it is called within an ArenaScope.
+     */
+    template <class REAL>
+    int Apply(const ArrayT<Vec3T<REAL> >& prev, const ArrayT<int>& pinned, ArrayT<Vec3T<REAL> >& pos,
+              const ArrayT<char>* asleep = NULL, ArrayT<Vec3T<REAL> >* vel = NULL, double dt = 0.0);
+
+    /** \name parameters and statistics */
+    /*@{*/
+    double Thickness() const { return fThickness; };
+    int NumTriangles() const { return fTriangles.Length()/3; };
+    long Candidates() const { return fCandidates; };
+    int Contacts() const { return fContacts; };
+    long TotalContacts() const { return fTotalContacts; };
+    /*@}*/
+};
+
+template <class VISIT>
+void SpatialHash::Query(const Vec3& low, const Vec3& high, VISIT visit) const {
+
+    int i0 = Cell(low.x), i1 = Cell(high.x);
+    int j0 = Cell(low.y), j1 = Cell(high.y);
+    int k0 = Cell(low.z), k1 = Cell(high.z);
+
+    for (int k = k0; k <= k1; k++) {
+        for (int j = j0; j <= j1; j++) {
+            for (int i = i0; i <= i1; i++) {
+                unsigned entry = Entry(i, j, k);
+                for (int p = fStart[entry]; p < fStart[entry + 1]; p++) visit(fPoints[p]);
+            }
+        }
+    }
+}
+
+#endif //SIMPLECLOTH_SELFCOLLISION_H
@@ -0,0 +1,145 @@
+//
+// Flat spring topology of the cloth: every spring is stored once.
+//
+
+#ifndef SIMPLECLOTH_SPRINGNETWORK_H
+#define SIMPLECLOTH_SPRINGNETWORK_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "ThreadPool.h"
+
+/** The three spring families of Provot's model */
+enum SpringType {
+    kStructural = 0,    /**< (i, j)<--->(i+1, j) and (i, j)<--->(i, j+1) */
+    kShear      = 1,    /**< (i, j)<--->(i+1, j+1) and (i, j)<--->(i-1, j+1) */
+    kBending    = 2     /**< (i, j)<--->(i+2, j) and (i, j)<--->(i, j+2) */
+};
+
+/** A single spring connecting node i to node j */
+struct Spring {
+    int i;              /**< first end point */
+    int j;              /**< second end point */
+    SpringType type;    /**< spring family */
+    double rest;        /**< rest length, cached from the initial configuration */
+    double k;           /**< stiffness */
+};
+
+/**
+ * Edge list of springs with a CSR node-to-spring map. Each spring is stored only once,
+ * the force kernel applies +f to one end point and -f to the other one.
+ */
+class SpringNetwork {
+
+protected:
+    int fNumNodes;              /**< number of nodes the springs refer to */
+
+    ArrayT<Spring> fSprings;    /**< the edge list */
+
+    /** \name CSR map: springs attached to node n are fNodeSprings[fNodeOffsets[n]] ... fNodeSprings[fNodeOffsets[n+1]-1] */
+    /*@{*/
+    ArrayT<int> fNodeOffsets;
+    ArrayT<int> fNodeSprings;
+    /*@}*/
+
+    /**
+     * \name colouring: the springs are cut into chunks of fChunkSize consecutive springs and
+     * chunks of the same colour share no node, so they can be evaluated concurrently without races.
+     * Chunks of colour c are fColourChunks[fColourOffsets[c]] ... fColourChunks[fColourOffsets[c+1]-1]
+     */
+    /*@{*/
+    int fChunkSize;
+    ArrayT<int> fColourOffsets;
+    ArrayT<int> fColourChunks;
+    /*@}*/
+
+public:
+    /** Constructors */
+    /*@{*/
+    SpringNetwork();
+
+    /** Create a network with given number of nodes and springs */
+    SpringNetwork(int numNodes, int numSprings);
+    /*@}*/
+
+    /** Set the dimensions, springs are not initialized */
+    void Dimension(int numNodes, int numSprings);
+
+    /** Define the s-th spring */
+    void SetSpring(int s, int i, int j, SpringType type);
+
+    /** Cache the rest lengths from the initial configuration and set the stiffness of all springs */
+    void SetRestState(const ArrayT<Vec3>& pos0, double k);
+
+    /** (Re)build the CSR map from nodes to their springs */
+    void BuildNodeMap();
+
+    /** (Re)build the colouring of the chunks of chunkSize consecutive springs */
+    void BuildColouring(int chunkSize = 512);
+
+    /** \name Accessors */
+    /*@{*/
+    int NumNodes() const { return fNumNodes; };
+    int NumSprings() const { return fSprings.Length(); };
+
+    Spring& operator[](int s) { return fSprings[s]; };
+    const Spring& operator[](int s) const { return fSprings[s]; };
+
+    /** Number of springs attached to node n */
+    int NumNodeSprings(int n) const { return fNodeOffsets[n+1] - fNodeOffsets[n]; };
+
+    /** Pointer to the indices of the springs attached to node n */
+    const int* NodeSprings(int n) const { return fNodeSprings.Pointer(fNodeOffsets[n]); };
+
+    int NumColours() const { return Max(fColourOffsets.Length() - 1, 0); };
+    int ChunkSize() const { return fChunkSize; };
+
+    /** Number of chunks of colour c */
+    int NumColourChunks(int c) const { return fColourOffsets[c+1] - fColourOffsets[c]; };
+
+    /** Pointer to the chunk indices of colour c, chunk n holds springs n*ChunkSize() ... */
+    const int* ColourChunks(int c) const { return fColourChunks.Pointer(fColourOffsets[c]); };
+    /*@}*/
+};
+
+/**
+ * Force exerted on end point i by a linear spring of rest length rest and stiffness k. The end
+ * point j receives the opposite force. Over-stretching is handled by the StrainLimiter.
+ */
+inline Vec3 SpringForce(const Vec3& pos_i, const Vec3& pos_j, double rest, double k) {
+
+    Vec3 d = pos_i - pos_j;
+    double length = d.Magnitude();
+
+    return d*(-k*(length - rest)/length);
+}
+
+/**
+ * The same in the precision REAL. With APPROX the inverse length comes from ApproxRsqrt() instead of
+ * a square root and a division.
+ */
+template <class REAL, bool APPROX>
+inline Vec3T<REAL> SpringForceT(const Vec3T<REAL>& pos_i, const Vec3T<REAL>& pos_j, REAL rest, REAL k) {
+
+    Vec3T<REAL> d = pos_i - pos_j;
+    if (APPROX) return d*(-k*(REAL(1) - rest*ApproxRsqrt(d.Dot(d))));
+
+    REAL length = d.Magnitude();
+    return d*(-k*(length - rest)/length);
+}
+
+/** The connectivity structure of a N x N grid of nodes: every spring appears once */
+SpringNetwork ConnectivityStructure(int N);
+
+/* Calculate internal spring forces, in double or float (REAL) and with the exact or approximate
+ * inverse lengths (APPROX, see SpringForceT()) */
+template <class REAL, bool APPROX = false>
+void internal_forces(const SpringNetwork& springs, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int);
+
+/* Calculate internal spring forces on the threads of the pool, one colour after the other. The
+ * result does not depend on the number of threads */
+template <class REAL, bool APPROX = false>
+void internal_forces(const SpringNetwork& springs, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int,
+                     ThreadPool& pool);
+
+#endif //SIMPLECLOTH_SPRINGNETWORK_H
@@ -0,0 +1,113 @@
+//
+// Static equilibrium of the spring network under constant loads: Newton's method with a line search.
+//
+
+#ifndef SIMPLECLOTH_STATICSOLVER_H
+#define SIMPLECLOTH_STATICSOLVER_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "MultArrayT.h"
+#include "SpringNetwork.h"
+#include "ImplicitIntegrator.h"
+
+/**
+ * Incomplete Cholesky factorization without fill-in, IC(0), of a symmetric positive definite
+ * BlockSparseMatrix by 3 x 3 blocks: L has the lower pattern of A and L L^T matches A on it.
+ * If a pivot block breaks down, the diagonal of A is scaled by 1 + shift with a growing shift and
+ * the factorization starts over, up to a limit beyond which A is taken as indefinite.
+ */
+class BlockIncompleteCholesky {
+
+protected:
+    MultArrayT<double> fL;              /**< blocks of L at the lower blocks of A, same indices */
+    MultArrayT<double> fInvDiagonal;    /**< inverses of the diagonal blocks of L */
+    const BlockSparseMatrix* fA;
+    double fShift;                      /**< diagonal shift of the last factorization */
+
+    /* one attempt with the given shift, false if a pivot is not positive */
+    bool TryFactor(double shift);
+
+public:
+    BlockIncompleteCholesky(): fA(NULL), fShift(0.0) { };
+
+    /** Factor A, which has to stay alive and unchanged while the factor is applied. Returns false
+     * if A looks indefinite */
+    bool Factor(const BlockSparseMatrix& A);
+
+    /** z = (L L^T)^-1 r */
+    void Apply(const ArrayT<Vec3>& r, ArrayT<Vec3>& z) const;
+
+    double Shift() const { return fShift; };
+};
+
+/**
+ * The positions of the free nodes at which the springs balance the constant nodal loads, as the
+ * minimum of the energy
+ *
+ *      E(x) = sum_springs k (|x_i - x_j| - rest)^2/2 - sum_nodes load . x
+ *
+ * Every Newton step solves (H + mu I) p = -grad E with a conjugate gradient preconditioned by
+ * BlockIncompleteCholesky, then backtracks along p until E decreases enough (Armijo). H is the
+ * full Hessian where it is definite. Where compressed springs make it indefinite, their transverse
+ * part is clamped as in ImplicitIntegrator, which leaves it positive semi-definite. The shift mu
+ * keeps it definite where it is only semi-definite, e.g. normal to a flat sheet: it grows when the
+ * line search has to backtrack and shrinks after full steps.
+ */
+class StaticSolver {
+
+protected:
+    BlockSparseMatrix fH;                   /**< shifted Hessian, pattern kept between solves */
+    BlockIncompleteCholesky fPreconditioner;
+
+    /** \name work arrays */
+    /*@{*/
+    ArrayT<char> fFixed;
+    ArrayT<Vec3> fGradient;
+    ArrayT<Vec3> fStep;
+    ArrayT<Vec3> fTrial;
+    ArrayT<Vec3> fR;
+    ArrayT<Vec3> fZ;
+    ArrayT<Vec3> fP;
+    ArrayT<Vec3> fHp;
+    /*@}*/
+
+    double fTolerance;          /**< largest residual force relative to the largest load */
+    int fMaxIterations;         /**< Newton steps */
+    int fMaxCGIterations;       /**< per linear solve */
+
+    int fIterations;            /**< Newton steps of the last solve */
+    long fCGIterations;         /**< conjugate gradient iterations of the last solve */
+    double fResidual;           /**< relative residual force at the end of the last solve */
+
+    double Energy(const SpringNetwork& springs, const ArrayT<Vec3>& loads, const ArrayT<Vec3>& pos) const;
+
+    /* gradient of the energy into fGradient, zero at the fixed nodes, returns its largest nodal norm */
+    double Gradient(const SpringNetwork& springs, const ArrayT<Vec3>& loads, const ArrayT<Vec3>& pos);
+
+    /* H + mu I for the free nodes, identity rows and columns for the fixed ones */
+    void AssembleHessian(const SpringNetwork& springs, const ArrayT<Vec3>& pos, double mu, bool clamp);
+
+    /* fH fStep = -fGradient to the relative tolerance, returns the iterations */
+    int SolveStep(double tolerance);
+
+public:
+    /** Set up the Hessian pattern of the springs */
+    StaticSolver(const SpringNetwork& springs, double tolerance = 1.0e-6, int maxIterations = 200,
+                 int maxCGIterations = 500);
+
+    /**
+     * Move the free nodes of pos from where they are to the equilibrium under the loads, the nodes
+     * listed in pinned stay. Returns whether the residual force reached the tolerance.
+     */
+    bool Solve(const SpringNetwork& springs, const ArrayT<Vec3>& loads, const ArrayT<int>& pinned, ArrayT<Vec3>& pos);
+
+    /** \name statistics of the last solve */
+    /*@{*/
+    int Iterations() const { return fIterations; };
+    long CGIterations() const { return fCGIterations; };
+    double Residual() const { return fResidual; };
+    /*@}*/
+};
+
+#endif //SIMPLECLOTH_STATICSOLVER_H
@@ -0,0 +1,98 @@
+//
+// Adaptive time steps: stability limit of the explicit scheme, local error control and scheduled events.
+//
+
+#ifndef SIMPLECLOTH_STEPCONTROLLER_H
+#define SIMPLECLOTH_STEPCONTROLLER_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+
+/** Largest ratio of two consecutive steps, the variable step Verlet update loses accuracy with jumps */
+#define STEP_GROWTH 1.2
+
+/** What set the size of a step */
+enum StepLimit {
+    kStepLimitMax = 0,          /**< the largest step allowed */
+    kStepLimitStability,        /**< the stability limit of the explicit scheme */
+    kStepLimitError,            /**< the local error estimate */
+    kStepLimitGrowth,           /**< STEP_GROWTH times the previous step */
+    kStepLimitMin,              /**< the smallest step allowed */
+    kStepLimitEvent,            /**< cut to land on an output, checkpoint, release or the end */
+    kNumStepLimits
+};
+
+/**
+ * Chooses the size of every step. The step is the smallest of
+ *
+ *   - the largest step allowed,
+ *   - safety times the stability limit 2/omega_max of the explicit scheme, see StableStep(),
+ *   - the step whose position error under a constant acceleration, dt^3 |da/dt|/6, reaches the
+ *     tolerance, with the rate of change of the accelerations of the last step (see MaxJerk()),
+ *   - STEP_GROWTH times the previous step,
+ *
+ * but not smaller than the smallest step allowed, unless the stability limit asks for it. Steps
+ * are then cut to land exactly on the next scheduled event; if the event is less than two steps
+ * away, the rest is split in halves so that no sliver of a step is left.
+ */
+class StepController {
+
+protected:
+    double fMinStep;
+    double fMaxStep;
+    double fTolerance;          /**< position error per step */
+    double fSafety;             /**< fraction of the stability limit */
+    bool fExplicit;             /**< whether the stability limit applies */
+
+    double fLastStep;           /**< the last step taken */
+    double fLastProposal;       /**< the last step before the cut for an event, the base of the growth */
+
+    /** \name statistics */
+    /*@{*/
+    long fCounts[kNumStepLimits];
+    double fSmallest;
+    double fLargest;
+    /*@}*/
+
+public:
+    /** Start with firstStep, the stability limit is applied to the explicit schemes only */
+    StepController(double firstStep, double minStep, double maxStep, double tolerance, double safety,
+                   bool explicitScheme);
+
+    /**
+     * Size of the step from time t, which has to land on nextEvent if it gets there. stableStep is the
+     * stability limit and jerk the largest rate of change of the nodal accelerations, 0 if not known
+     */
+    double NextStep(double t, double nextEvent, double stableStep, double jerk);
+
+    /** \name the steps of the past, saved in checkpoints */
+    /*@{*/
+    double LastStep() const { return fLastStep; };
+    double LastProposal() const { return fLastProposal; };
+    void Restore(double lastStep, double lastProposal);
+    /*@}*/
+
+    /** \name statistics */
+    /*@{*/
+    long Count(StepLimit limit) const { return fCounts[limit]; };
+    double Smallest() const { return fSmallest; };
+    double Largest() const { return fLargest; };
+    static const char* LimitName(StepLimit limit);
+    /*@}*/
+};
+
+/**
+ * Stability limit of the explicit scheme, 2/omega_max. omega_max^2 is bounded by Gershgorin's theorem
+ * on the stiffness matrix of the springs: 2 maxNodeSprings k_eff/m, where the effective stiffness of
+ * a spring is k along it and k |1 - rest/length| across it, which exceeds k only for springs
+ * compressed to less than half their rest length
+ */
+template <class REAL>
+double StableStep(const SpringNetwork& springs, int maxNodeSprings, const ArrayT<Vec3T<REAL> >& pos, double m);
+
+/** Largest |acc - accPrev|/dt over the nodes */
+template <class REAL>
+double MaxJerk(const ArrayT<Vec3T<REAL> >& acc, const ArrayT<Vec3T<REAL> >& accPrev, double dt);
+
+#endif //SIMPLECLOTH_STEPCONTROLLER_H
@@ -0,0 +1,86 @@
+//
+// Provot's deformation constraints: over-stretched springs are projected back to a maximum strain
+// after the integration step.
+//
+
+#ifndef SIMPLECLOTH_STRAINLIMITER_H
+#define SIMPLECLOTH_STRAINLIMITER_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+#include "SpringNetwork.h"
+
+/** Springs less than this fraction longer than their maximum length count as satisfied, the
+ * projections converge only asymptotically */
+#define STRAIN_TOLERANCE 1.0e-4
+
+/** Order in which the springs are projected */
+enum StrainSweep {
+    kGaussSeidel = 0,   /**< one spring after the other, each projection sees the previous ones */
+    kJacobi      = 1    /**< every node moves by the average correction of its springs, order independent */
+};
+
+/**
+ * A spring longer than (1 + max strain) times its rest length is shortened to that length by
+ * moving both end points towards each other by the same amount, or only the free one if the other
+ * end is pinned. Springs share nodes, so the projection is repeated until no spring is over-stretched
+ * or the iteration budget is spent. The material stiffness is left untouched.
+ */
+class StrainLimiter {
+
+protected:
+    double fMaxStrain;          /**< allowed relative elongation of the springs */
+    int fMaxIterations;         /**< sweeps over the springs per call, 0 disables the limiter */
+    StrainSweep fSweep;
+
+    int fIterations;            /**< sweeps of the last call which moved nodes */
+    int fViolations;            /**< over-stretched springs found by the last sweep */
+
+    /* one sweep, returns the number of over-stretched springs found. The nodes flagged in fixed do not
+     * move, those moved by delta get delta inverseDt added to vel if given. The Jacobi sweep sums the
+     * corrections of every node and their number in correction and count */
+    template <class REAL>
+    int SweepGaussSeidel(const SpringNetwork& springs, const char* fixed, ArrayT<Vec3T<REAL> >& pos, Vec3T<REAL>* vel,
+                         REAL inverseDt);
+    template <class REAL>
+    int SweepJacobi(const SpringNetwork& springs, const char* fixed, Vec3* correction, int* count,
+                    ArrayT<Vec3T<REAL> >& pos, Vec3T<REAL>* vel, REAL inverseDt);
+
+public:
+    StrainLimiter(double maxStrain = 0.1, int maxIterations = 10, StrainSweep sweep = kGaussSeidel);
+
+    /** Project the over-stretched springs, the nodes listed in pinned do not move, nor those flagged
+     * in asleep if given (see ActivityTracker). If vel is given, every node moved by delta gets
+     * delta/dt added to its velocity, so that the velocity of the step follows the projections
+     * without a pass over all the nodes. Returns the number of sweeps. Positions in double or float
+     * (REAL). The work arrays come from the current StepArena, it is called within an ArenaScope */
+    template <class REAL>
+    int Apply(const SpringNetwork& springs, const ArrayT<int>& pinned, ArrayT<Vec3T<REAL> >& pos,
+              const ArrayT<char>* asleep = NULL, ArrayT<Vec3T<REAL> >* vel = NULL, double dt = 0.0);
+
+    /** \name parameters and statistics */
+    /*@{*/
+    double MaxStrain() const { return fMaxStrain; };
+    int MaxIterations() const { return fMaxIterations; };
+    int Iterations() const { return fIterations; };
+    int Violations() const { return fViolations; };
+    /*@}*/
+};
+
+/**
+ * Correction of end point i of a spring with end points at pos_i and pos_j which shortens the spring
+ * to maxLength, zero if it is within STRAIN_TOLERANCE of that. share is the part of the excess length
+ * taken by end point i: 1/2 if both ends are free, 1 if j is pinned.
+ */
+template <class REAL>
+inline Vec3T<REAL> StrainCorrection(const Vec3T<REAL>& pos_i, const Vec3T<REAL>& pos_j, REAL maxLength, REAL share) {
+
+    Vec3T<REAL> d = pos_i - pos_j;
+    REAL length = d.Magnitude();
+
+    if (length <= (1.0 + STRAIN_TOLERANCE)*maxLength) return Vec3T<REAL>(0, 0, 0);
+
+    return d*(-share*(length - maxLength)/length);
+}
+
+#endif //SIMPLECLOTH_STRAINLIMITER_H
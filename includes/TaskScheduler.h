@@ -0,0 +1,65 @@
+//
+// Work-stealing scheduler for batches of independent tasks of very different sizes.
+//
+
+#ifndef SIMPLECLOTH_TASKSCHEDULER_H
+#define SIMPLECLOTH_TASKSCHEDULER_H
+
+#include "ArrayT.h"
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * Runs a batch of tasks with estimated costs on a number of threads. The tasks are sorted by
+ * decreasing cost and dealt round robin to one queue per thread, so the large ones start first.
+ * A thread takes the next (largest) task from the front of its own queue; once it is empty it
+ * steals from the back of the other queues, where the small tasks are, and fills the gaps left
+ * by the uneven ones. The threads live for one Run().
+ */
+class TaskScheduler {
+
+protected:
+    int fNumThreads;
+
+    /** a queue of task indices, the mutex is only contended by thieves */
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    /** \name statistics of the last Run() */
+    /*@{*/
+    long fSteals;
+    ArrayT<int> fTaskThreads;      /**< thread which ran each task */
+    /*@}*/
+
+    /* run tasks until all queues are empty */
+    void WorkerLoop(int thread, std::vector<Queue>& queues, const std::function<void(int, int)>& body,
+                    std::mutex& mutex, std::exception_ptr& error);
+
+public:
+    /** numThreads 0 means one per hardware thread */
+    explicit TaskScheduler(int numThreads = 0);
+
+    int NumThreads() const { return fNumThreads; };
+
+    /** Call body(task, thread) once for every task in [0, costs.Length()) and wait for all of them.
+     * The first exception thrown by a task is thrown again once the others are done */
+    void Run(const ArrayT<double>& costs, const std::function<void(int, int)>& body);
+
+    /** \name statistics of the last Run() */
+    /*@{*/
+    long NumSteals() const { return fSteals; };
+    int TaskThread(int task) const { return fTaskThreads[task]; };
+    /*@}*/
+
+private:
+    TaskScheduler(const TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+};
+
+#endif //SIMPLECLOTH_TASKSCHEDULER_H
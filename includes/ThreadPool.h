@@ -0,0 +1,89 @@
+//
+// A small pool of persistent worker threads for data-parallel loops.
+//
+
+#ifndef SIMPLECLOTH_THREADPOOL_H
+#define SIMPLECLOTH_THREADPOOL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The body of a parallel loop, a reference to any callable body(first, last). Unlike a std::function
+ * it neither copies the callable nor allocates, the callable has to outlive it.
+ */
+class LoopBody {
+
+protected:
+    const void* fCallable;
+    void (*fCall)(const void*, int, int);
+
+    template <class BODY>
+    static void Call(const void* callable, int first, int last) { (*static_cast<const BODY*>(callable))(first, last); }
+
+public:
+    template <class BODY>
+    explicit LoopBody(const BODY& body): fCallable(&body), fCall(&Call<BODY>) { }
+
+    void operator()(int first, int last) const { fCall(fCallable, first, last); };
+};
+
+/**
+ * Runs loops on a fixed number of threads. The calling thread takes part in every loop, so a
+ * pool of one thread runs everything serially without synchronization. A range is always cut
+ * into the same contiguous parts for the same number of threads, which keeps the results of
+ * the parallel loops reproducible.
+ */
+class ThreadPool {
+
+protected:
+    int fNumThreads;                        /**< workers plus the calling thread */
+
+    std::vector<std::thread> fWorkers;      /**< threads 1 ... fNumThreads-1 */
+
+    /** \name the loop being executed */
+    /*@{*/
+    const LoopBody* fBody;
+    int fBegin;
+    int fEnd;
+    /*@}*/
+
+    /** \name synchronization */
+    /*@{*/
+    std::mutex fMutex;
+    std::condition_variable fStart;     /**< signals a new loop (or the shut down) to the workers */
+    std::condition_variable fDone;      /**< signals the end of the loop to the caller */
+    long fGeneration;                   /**< number of loops started so far */
+    int fPending;                       /**< workers still busy with the current loop */
+    bool fShutDown;
+    /*@}*/
+
+    /* run part of the current loop */
+    void RunPart(int part);
+
+    /* wait for loops and run the worker's part */
+    void WorkerLoop(int part);
+
+    /* the loop of ParallelFor */
+    void Run(int begin, int end, const LoopBody& body);
+
+public:
+    /** Create a pool of numThreads threads, 0 means one per hardware thread */
+    explicit ThreadPool(int numThreads = 0);
+
+    ~ThreadPool();
+
+    int NumThreads() const { return fNumThreads; };
+
+    /** Call body(first, last) on NumThreads() contiguous parts of [begin, end) and wait for all of them */
+    template <class BODY>
+    void ParallelFor(int begin, int end, const BODY& body) { Run(begin, end, LoopBody(body)); }
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif //SIMPLECLOTH_THREADPOOL_H
@@ -0,0 +1,178 @@
+//
+// Binary trajectory files: all the snapshots of a run in one file, read back with mmap.
+//
+
+#ifndef SIMPLECLOTH_TRAJECTORY_H
+#define SIMPLECLOTH_TRAJECTORY_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+
+/** \name layout of the file */
+/*@{*/
+#define TRAJECTORY_MAGIC "SCLTRAJ"      /**< 7 characters and the terminating zero */
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_HEADER_SIZE 256      /**< bytes before the first frame */
+#define TRAJECTORY_MAX_FIELDS 8
+#define TRAJECTORY_FIELD_NAME 16        /**< bytes per field name, including the terminating zero */
+/*@}*/
+
+/**
+ * The header at the beginning of the file, in the byte order of the machine which wrote it.
+ *
+ * It is followed by fixed-stride frames: the time (double) and step (int64) of the frame, then
+ * every field as numNodes interleaved (x, y, z) doubles. Once the file is closed a frame index of
+ * (time, offset) pairs follows the last frame and numFrames and indexOffset are set; a file whose
+ * writer did not finish has indexOffset 0 and its complete frames are found from the file size.
+ */
+struct TrajectoryHeader {
+    char magic[8];
+    int32_t version;
+    int32_t numNodes;       /**< nodes per field */
+    int32_t gridSize;       /**< N of the N x N cloth, 0 if the nodes are not a grid */
+    int32_t numFields;
+    double dt;              /**< time step of the run */
+    int64_t frameStride;    /**< bytes per frame */
+    int64_t numFrames;      /**< 0 until the file is closed */
+    int64_t indexOffset;    /**< position of the frame index, 0 until the file is closed */
+    char fields[TRAJECTORY_MAX_FIELDS][TRAJECTORY_FIELD_NAME];
+};
+
+/** An entry of the frame index */
+struct TrajectoryIndexEntry {
+    double time;
+    int64_t offset;         /**< position of the frame in the file */
+};
+
+/** Bytes before the fields in a frame: its time and step */
+#define TRAJECTORY_FRAME_HEADER (sizeof(double) + sizeof(int64_t))
+
+/**
+ * Streaming writer: frames are appended as they come, the index is written by Close() (or the
+ * destructor).
+ */
+class TrajectoryWriter {
+
+protected:
+    std::ofstream fFile;
+    TrajectoryHeader fHeader;
+
+    ArrayT<TrajectoryIndexEntry> fIndex;
+    ArrayT<double> fBuffer;     /**< one field in file layout */
+
+    /* fill in the header, throws std::runtime_error for too many or too few fields */
+    void SetHeader(int numNodes, int gridSize, double dt, std::initializer_list<const char*> fields);
+
+public:
+    TrajectoryWriter();
+
+    /** Create the file, the fields are named in the order they are passed to WriteFrame() */
+    TrajectoryWriter(const std::string& filename, int numNodes, int gridSize, double dt,
+                     std::initializer_list<const char*> fields);
+
+    ~TrajectoryWriter();
+
+    /** Create the file, throws std::runtime_error if that fails */
+    void Open(const std::string& filename, int numNodes, int gridSize, double dt,
+              std::initializer_list<const char*> fields);
+
+    /** Continue the trajectory of a restarted run: the frames of an existing file up to lastStep are
+     * kept and the new ones appended after them. A missing file, or one with other nodes, fields or
+     * time step, is created anew as by Open() */
+    void Resume(const std::string& filename, int numNodes, int gridSize, double dt,
+                std::initializer_list<const char*> fields, long lastStep);
+
+    /** Append a frame, one array per field in the order of Open() */
+    void WriteFrame(double time, long step, std::initializer_list<const ArrayT<Vec3>*> fields);
+    void WriteFrame(double time, long step, const ArrayT<Vec3>* const* fields, int numFields);
+
+    int NumNodes() const { return fHeader.numNodes; };
+    int NumFields() const { return fHeader.numFields; };
+
+    /** Push the frames written so far to the file */
+    void Flush();
+
+    /** Write the index and complete the header */
+    void Close();
+
+    bool IsOpen() const { return fFile.is_open(); };
+    long NumFrames() const { return fIndex.Length(); };
+
+private:
+    /* no copies of the open file */
+    TrajectoryWriter(const TrajectoryWriter&);
+    TrajectoryWriter& operator=(const TrajectoryWriter&);
+};
+
+/**
+ * Zero-copy reader: the whole file is mapped into memory and the fields are returned as pointers
+ * into the mapping.
+ */
+class TrajectoryReader {
+
+protected:
+    int fDescriptor;
+    const char* fData;          /**< the mapping */
+    size_t fSize;
+
+    const TrajectoryHeader* fHeader;
+    const TrajectoryIndexEntry* fIndex;     /**< NULL if the writer did not finish */
+    long fNumFrames;
+
+    /* start of frame f */
+    const char* Frame(long f) const;
+
+public:
+    TrajectoryReader();
+
+    /** Map the file */
+    explicit TrajectoryReader(const std::string& filename);
+
+    ~TrajectoryReader();
+
+    /** Map the file, throws std::runtime_error if it cannot be read or is no trajectory */
+    void Open(const std::string& filename);
+
+    void Close();
+
+    /** \name header */
+    /*@{*/
+    int NumNodes() const { return fHeader->numNodes; };
+    int GridSize() const { return fHeader->gridSize; };
+    double Dt() const { return fHeader->dt; };
+    int NumFields() const { return fHeader->numFields; };
+    const char* FieldName(int field) const { return fHeader->fields[field]; };
+
+    /** Index of the field with the given name, -1 if there is none */
+    int FieldIndex(const std::string& name) const;
+
+    long NumFrames() const { return fNumFrames; };
+
+    /** Whether the file was closed properly and has its index */
+    bool HasIndex() const { return fIndex != NULL; };
+    /*@}*/
+
+    /** \name frames */
+    /*@{*/
+    double Time(long frame) const;
+    long Step(long frame) const;
+
+    /** The (x, y, z) triplets of a field of a frame, 3*NumNodes() doubles */
+    const double* Field(long frame, int field) const;
+
+    /** Copy a field of a frame into an array of Vec3 */
+    void CopyField(long frame, int field, ArrayT<Vec3>& values) const;
+    /*@}*/
+
+private:
+    /* no copies of the mapping */
+    TrajectoryReader(const TrajectoryReader&);
+    TrajectoryReader& operator=(const TrajectoryReader&);
+};
+
+#endif //SIMPLECLOTH_TRAJECTORY_H
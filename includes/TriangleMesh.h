@@ -0,0 +1,52 @@
+//
+// Triangle meshes: the static obstacles the cloth collides with and the garments it is made of.
+//
+
+#ifndef SIMPLECLOTH_TRIANGLEMESH_H
+#define SIMPLECLOTH_TRIANGLEMESH_H
+
+#include "Vec3.h"
+#include "ArrayT.h"
+
+#include <string>
+
+/** Vertices and triangles, three vertex indices per triangle */
+struct TriangleMesh {
+    ArrayT<Vec3> vertices;
+    ArrayT<int> triangles;
+
+    int NumVertices() const { return vertices.Length(); };
+    int NumTriangles() const { return triangles.Length()/3; };
+};
+
+/**
+ * Read the vertices ("v x y z") and faces ("f a b c ...") of a Wavefront OBJ file. Faces of more
+ * than three vertices are split into fans, texture and normal indices ("a/t/n") and negative
+ * (relative) indices are accepted, all the other lines are ignored. Throws std::runtime_error if
+ * the file cannot be read or a face refers to a missing vertex.
+ */
+TriangleMesh ReadObj(const std::string& filename);
+
+/**
+ * Read the vertices and faces of a PLY file, ASCII or binary of either byte order. The vertices are
+ * the x, y and z properties of the "vertex" element, the faces the "vertex_indices" (or
+ * "vertex_index") lists of the "face" element, split into fans. The other elements and properties
+ * are skipped. Throws std::runtime_error if the file cannot be read or a face refers to a missing
+ * vertex.
+ */
+TriangleMesh ReadPly(const std::string& filename);
+
+/** ReadPly() for files ending in .ply, ReadObj() for all the others */
+TriangleMesh ReadMesh(const std::string& filename);
+
+/** Write the mesh as an OBJ file, throws std::runtime_error if it cannot be written */
+void WriteObj(const std::string& filename, const TriangleMesh& mesh);
+
+/** A sphere of segments meridians and segments/2 parallels, the triangles facing outwards */
+TriangleMesh SphereMesh(const Vec3& center, double radius, int segments);
+
+/** An open vertical tube, the shape of a sleeve: rings + 1 circles of segments vertices from the top
+ * one, at height above center, down to center */
+TriangleMesh TubeMesh(const Vec3& center, double radius, double height, int segments, int rings);
+
+#endif //SIMPLECLOTH_TRIANGLEMESH_H
@@ -10,32 +10,70 @@
 
 #include <cmath>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 using namespace std;
 
-/* Simple 2D cartesian vector object for simple mass/spring calculations */
-class Vec3 {
+/**
+ * Approximate 1/sqrt(value): the hardware estimate of the reciprocal square root refined by
+ * Newton-Raphson steps, one for float (about 23 correct bits) and two for double (about 44 bits).
+ * Used by the APPROX kernels instead of a square root and a division.
+ */
+inline float ApproxRsqrt(float value) {
+#ifdef __SSE__
+    float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(value)));
+#else
+    float y = 1.0f/std::sqrt(value);
+#endif
+    return y*(1.5f - 0.5f*value*y*y);
+}
+
+inline double ApproxRsqrt(double value) {
+#ifdef __SSE__
+    double y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(float(value))));
+#else
+    double y = 1.0/std::sqrt(value);
+#endif
+    y = y*(1.5 - 0.5*value*y*y);
+    return y*(1.5 - 0.5*value*y*y);
+}
+
+/* Simple 2D cartesian vector object for simple mass/spring calculations, in single or double precision */
+template <class TYPE>
+class Vec3T {
 public:
-    Vec3() {
+    typedef TYPE Scalar;
+
+    Vec3T() {
         this->x = 0.0;
         this->y = 0.0;
         this->z = 0.0;
     };
 
-    Vec3(double x1, double y1, double z1) {
+    Vec3T(TYPE x1, TYPE y1, TYPE z1) {
         this->x = x1;
         this->y = y1;
         this->z = z1;
     };
 
     // Because implicitly-declaration is deprecated
-    Vec3(const Vec3 &obj) {
+    Vec3T(const Vec3T &obj) {
         this->x = obj.x;
         this->y = obj.y;
         this->z = obj.z;
     };
 
+    /* conversion between the precisions */
+    template <class OTHER>
+    explicit Vec3T(const Vec3T<OTHER> &obj) {
+        this->x = TYPE(obj.x);
+        this->y = TYPE(obj.y);
+        this->z = TYPE(obj.z);
+    }
 
-    inline Vec3& operator=(Vec3 const& v) {
+    inline Vec3T& operator=(Vec3T const& v) {
         if (this != &v){
             x = v.x;
             y = v.y;
@@ -44,7 +82,7 @@ public:
         return *this;
     };
 
-    inline Vec3& operator=(double const &val) {
+    inline Vec3T& operator=(TYPE const &val) {
         this->x = val;
         this->y = val;
         this->z = val;
@@ -52,19 +90,15 @@ public:
         return *this;
     };
 
-    inline Vec3 operator+(const Vec3& v) const {
-        return Vec3(x + v.x, y + v.y, z + v.z);
+    inline Vec3T operator+(const Vec3T& v) const {
+        return Vec3T(x + v.x, y + v.y, z + v.z);
     };
 
-    inline Vec3& operator*(const double& val) {
-        this->x = val*x;
-        this->y = val*y;
-        this->z = val*z;
-
-        return *this;
+    inline Vec3T operator*(const TYPE& val) const {
+        return Vec3T(val*x, val*y, val*z);
     };
 
-    inline Vec3& operator+=(Vec3 &v) {
+    inline Vec3T& operator+=(const Vec3T &v) {
         this->x = x + v.x;
         this->y = y + v.y;
         this->z = z + v.z;
@@ -72,7 +106,15 @@ public:
         return *this;
     };
 
-    inline Vec3& operator*=(double const& scale) {
+    inline Vec3T& operator-=(const Vec3T &v) {
+        this->x = x - v.x;
+        this->y = y - v.y;
+        this->z = z - v.z;
+
+        return *this;
+    };
+
+    inline Vec3T& operator*=(TYPE const& scale) {
         this->x = x*scale;
         this->y = y*scale;
         this->z = z*scale;
@@ -80,32 +122,56 @@ public:
         return *this;
     };
 
-    inline Vec3 operator-(const Vec3& v) const {
-        return Vec3(x - v.x, y - v.y, z - v.z);
+    inline Vec3T operator-(const Vec3T& v) const {
+        return Vec3T(x - v.x, y - v.y, z - v.z);
     };
 
-    double Magnitude() const {
+    TYPE Magnitude() const {
         return sqrt(x*x + y*y + z*z);
     };
 
-    Vec3 UnitVec() const {
-        return Vec3(x/Magnitude(), y/Magnitude(), z/Magnitude());
+    Vec3T UnitVec() const {
+        TYPE magnitude = Magnitude();
+        return Vec3T(x/magnitude, y/magnitude, z/magnitude);
     };
 
+    /** \name with ApproxRsqrt() instead of sqrt and division */
+    /*@{*/
+    TYPE MagnitudeApprox() const {
+        TYPE squared = x*x + y*y + z*z;
+        return squared > 0 ? squared*ApproxRsqrt(squared) : TYPE(0);
+    };
+
+    Vec3T UnitVecApprox() const {
+        TYPE inverse = ApproxRsqrt(x*x + y*y + z*z);
+        return Vec3T(x*inverse, y*inverse, z*inverse);
+    };
+    /*@}*/
+
     void PrintVec() const{
         std::cout << x << " " << y << " " << z  << std::endl;
     };
 
-    double Dot(const Vec3& v) const {
+    TYPE Dot(const Vec3T& v) const {
         return x*v.x + y*v.y + z*v.z;
     };
 
-    ~Vec3() = default;
+    Vec3T Cross(const Vec3T& v) const {
+        return Vec3T(y*v.z - z*v.y, z*v.x - x*v.z, x*v.y - y*v.x);
+    };
+
+    ~Vec3T() = default;
 
-    double y;
-    double x;
-    double z;
+    TYPE y;
+    TYPE x;
+    TYPE z;
 };
 
+/** The double precision vector of the reference simulation */
+typedef Vec3T<double> Vec3;
+
+/** Single precision, for previews */
+typedef Vec3T<float> Vec3f;
+
 
 #endif //BASICROPE_VEC3_H
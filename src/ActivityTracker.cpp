@@ -0,0 +1,121 @@
+//
+// Sleeping tiles: the parts of the cloth which have settled are left out of the forces and the integration.
+//
+
+#include "ActivityTracker.h"
+
+ActivityTracker::ActivityTracker(int N, int tileSize, double displacement, double force, int quietSteps):
+    fN(N),
+    fTileSize(tileSize),
+    fTilesPerSide((N + tileSize - 1)/tileSize),
+    fDisplacement(displacement),
+    fForce(force),
+    fQuietSteps(quietSteps),
+    fActiveNodes(0),
+    fSteps(0),
+    fActiveNodeSteps(0.0)
+{
+    assert(N > 0 && tileSize > 0 && quietSteps > 0);
+
+    fAwake.Dimension(NumTiles());
+    fQuiet.Dimension(NumTiles());
+    fMaxDisplacement.Dimension(NumTiles());
+    fMaxForce.Dimension(NumTiles());
+    fMaxDisplacement = 0.0;
+    fMaxForce = 0.0;
+    fNodeAsleep.Dimension(N*N);
+    fFellAsleep.Reserve(NumTiles());
+
+    WakeAll();
+}
+
+void ActivityTracker::TileRange(int t, int& firstColumn, int& lastColumn, int& firstRow, int& lastRow) const {
+
+    firstColumn = (t % fTilesPerSide)*fTileSize;
+    lastColumn = Min(firstColumn + fTileSize, fN);
+    firstRow = (t / fTilesPerSide)*fTileSize;
+    lastRow = Min(firstRow + fTileSize, fN);
+}
+
+void ActivityTracker::Rebuild() {
+
+    fAwakeTiles.Dimension(0);
+    fActiveNodes = 0;
+    for (int t = 0; t < NumTiles(); t++) {
+        int firstColumn, lastColumn, firstRow, lastRow;
+        TileRange(t, firstColumn, lastColumn, firstRow, lastRow);
+
+        if (fAwake[t]) {
+            fAwakeTiles.Insert(t);
+            fActiveNodes += (lastColumn - firstColumn)*(lastRow - firstRow);
+        }
+        for (int j = firstRow; j < lastRow; j++)
+            for (int i = firstColumn; i < lastColumn; i++)
+                fNodeAsleep[fN*j + i] = fAwake[t] ? 0 : 1;
+    }
+}
+
+void ActivityTracker::Update() {
+
+    fSteps++;
+    fActiveNodeSteps += fActiveNodes;
+
+    /* the tiles which moved in this step */
+    ArrayT<int, ArenaAllocator<int> > moving;
+    for (int a = 0; a < fAwakeTiles.Length(); a++) {
+        int t = fAwakeTiles[a];
+        if (fMaxDisplacement[t] < fDisplacement && fMaxForce[t] < fForce) fQuiet[t]++;
+        else {
+            fQuiet[t] = 0;
+            moving.Insert(t);
+        }
+        fMaxDisplacement[t] = 0.0;
+        fMaxForce[t] = 0.0;
+    }
+
+    bool changed = false;
+
+    /* they wake their neighbours, or keep them from sleeping */
+    for (int m = 0; m < moving.Length(); m++) {
+        int ti = moving[m] % fTilesPerSide;
+        int tj = moving[m] / fTilesPerSide;
+        for (int j = Max(tj - 1, 0); j <= Min(tj + 1, fTilesPerSide - 1); j++) {
+            for (int i = Max(ti - 1, 0); i <= Min(ti + 1, fTilesPerSide - 1); i++) {
+                int t = fTilesPerSide*j + i;
+                if (!fAwake[t]) changed = true;
+                fAwake[t] = 1;
+                fQuiet[t] = 0;
+            }
+        }
+    }
+
+    /* the others sleep once they have been quiet long enough */
+    fFellAsleep.Dimension(0);
+    for (int a = 0; a < fAwakeTiles.Length(); a++) {
+        int t = fAwakeTiles[a];
+        if (fQuiet[t] >= fQuietSteps) {
+            fAwake[t] = 0;
+            fFellAsleep.Insert(t);
+            changed = true;
+        }
+    }
+
+    if (changed) Rebuild();
+}
+
+void ActivityTracker::WakeAll() {
+
+    fAwake = char(1);
+    fQuiet = 0;
+    fFellAsleep.Dimension(0);
+    Rebuild();
+}
+
+void ActivityTracker::Restore(const ArrayT<char>& awake, const ArrayT<int>& quiet) {
+
+    assert(awake.Length() == NumTiles() && quiet.Length() == NumTiles());
+    fAwake = awake;
+    fQuiet = quiet;
+    fFellAsleep.Dimension(0);
+    Rebuild();
+}
@@ -0,0 +1,65 @@
+//
+// Allocator policies of ArrayT: aligned storage on the heap and a per-step arena, with a count of the
+// allocations.
+//
+
+#include "Allocator.h"
+
+StepArena::StepArena(size_t blockSize):
+    fBlockSize(blockSize),
+    fBlock(0),
+    fOffset(0),
+    fUsed(0),
+    fPeak(0)
+{
+    assert(blockSize > 0);
+}
+
+StepArena::~StepArena() {
+    for (size_t b = 0; b < fBlocks.size(); b++) AlignedRelease(fBlocks[b]);
+}
+
+void* StepArena::Allocate(size_t bytes) {
+
+    /* every allocation starts on a line of its own */
+    size_t rounded = (bytes + ARRAY_ALIGNMENT - 1)/ARRAY_ALIGNMENT*ARRAY_ALIGNMENT;
+
+    /* the first block from the current one on with room left, a new one at the end if none */
+    while (fBlock < fBlocks.size() && fOffset + rounded > fSizes[fBlock]) {
+        fBlock++;
+        fOffset = 0;
+    }
+    if (fBlock == fBlocks.size()) {
+        size_t size = rounded > fBlockSize ? rounded : fBlockSize;
+        fBlocks.push_back(static_cast<char*>(AlignedAllocate(size)));
+        fSizes.push_back(size);
+        fOffset = 0;
+    }
+
+    void* memory = fBlocks[fBlock] + fOffset;
+    fOffset += rounded;
+    fUsed += rounded;
+    if (fUsed > fPeak) fPeak = fUsed;
+    return memory;
+}
+
+void StepArena::Reset() {
+    fBlock = 0;
+    fOffset = 0;
+    fUsed = 0;
+}
+
+size_t StepArena::Capacity() const {
+    size_t capacity = 0;
+    for (size_t b = 0; b < fSizes.size(); b++) capacity += fSizes[b];
+    return capacity;
+}
+
+StepArena*& StepArena::CurrentSlot() {
+    static thread_local StepArena* current = NULL;
+    return current;
+}
+
+StepArena* StepArena::Current() {
+    return CurrentSlot();
+}
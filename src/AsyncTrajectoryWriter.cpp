@@ -0,0 +1,143 @@
+//
+// Trajectory output on a background thread, so that the time stepping does not wait for the disk.
+//
+
+#include "AsyncTrajectoryWriter.h"
+
+#include <chrono>
+
+AsyncTrajectoryWriter::AsyncTrajectoryWriter(const std::string& filename, int numNodes, int gridSize, double dt,
+                                             std::initializer_list<const char*> fields, int numBuffers,
+                                             long resumeStep):
+    fHead(0),
+    fCount(0),
+    fShutDown(false),
+    fSubmitted(0),
+    fWritten(0),
+    fMaxDepth(0),
+    fSumDepth(0),
+    fStallSeconds(0.0)
+{
+    assert(numBuffers >= 1);
+
+    if (resumeStep >= 0)
+        fWriter.Resume(filename, numNodes, gridSize, dt, fields, resumeStep);
+    else
+        fWriter.Open(filename, numNodes, gridSize, dt, fields);
+
+    /* all the memory is allocated up front */
+    fRing.Dimension(numBuffers);
+    for (int b = 0; b < numBuffers; b++) {
+        for (int f = 0; f < fWriter.NumFields(); f++) {
+            fRing[b].fields[f].Dimension(numNodes);
+        }
+    }
+
+    fThread = std::thread(&AsyncTrajectoryWriter::WriterLoop, this);
+}
+
+AsyncTrajectoryWriter::~AsyncTrajectoryWriter() {
+    try {
+        Close();
+    }
+    catch (...) { }
+}
+
+void AsyncTrajectoryWriter::WriterLoop() {
+
+    const ArrayT<Vec3>* fields[TRAJECTORY_MAX_FIELDS];
+
+    while (true) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fQueued.wait(lock, [&]() { return fShutDown || fCount > 0; });
+            if (fCount == 0) return;
+            slot = fHead;
+        }
+
+        /* the snapshot is not touched by Submit() until it is released */
+        try {
+            if (!fError) {
+                Snapshot& snapshot = fRing[slot];
+                for (int f = 0; f < fWriter.NumFields(); f++) fields[f] = &snapshot.fields[f];
+                fWriter.WriteFrame(snapshot.time, snapshot.step, fields, fWriter.NumFields());
+                fWriter.Flush();
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fError = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fHead = (fHead + 1) % fRing.Length();
+            fCount--;
+            fWritten++;
+        }
+        fFreed.notify_one();
+    }
+}
+
+void AsyncTrajectoryWriter::CheckError() {
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        error = fError;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void AsyncTrajectoryWriter::Submit(double time, long step, std::initializer_list<const ArrayT<Vec3>*> fields) {
+
+    assert(int(fields.size()) == fWriter.NumFields());
+    CheckError();
+
+    /* back-pressure: wait for a free snapshot */
+    int slot;
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        assert(!fShutDown);
+        if (fCount == fRing.Length()) {
+            auto start = std::chrono::steady_clock::now();
+            fFreed.wait(lock, [&]() { return fCount < fRing.Length(); });
+            fStallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        slot = (fHead + fCount) % fRing.Length();
+    }
+
+    Snapshot& snapshot = fRing[slot];
+    snapshot.time = time;
+    snapshot.step = step;
+    int f = 0;
+    for (const ArrayT<Vec3>* field : fields) {
+        snapshot.fields[f++] = *field;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fCount++;
+        fSubmitted++;
+        fSumDepth += fCount;
+        fMaxDepth = Max(fMaxDepth, fCount);
+    }
+    fQueued.notify_one();
+}
+
+void AsyncTrajectoryWriter::Close() {
+
+    if (fThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fShutDown = true;
+        }
+        fQueued.notify_one();
+        fThread.join();
+
+        fWriter.Close();
+    }
+
+    CheckError();
+}
@@ -0,0 +1,225 @@
+//
+// Array helpers, external forces and output of the cloth simulator.
+//
+
+#include "Cloth.h"
+#include "Profiler.h"
+
+#include <fstream>
+
+using namespace std;
+
+ArrayT<Vec3> AddArrays(const ArrayT<Vec3>& arr1, const ArrayT<Vec3>& arr2) {
+
+    /* First check the size match */
+    assert(arr1.Length() == arr2.Length());
+
+    ArrayT<Vec3> vecSum;
+    vecSum.Reserve(arr1.Length());
+
+    for (int i = 0; i < arr1.Length(); i++) {
+        vecSum.Insert(arr1[i] + arr2[i]);
+    }
+
+    return vecSum;
+}
+
+ArrayT<Vec3> AddArrays(const ArrayT<Vec3>& arr1, const ArrayT<Vec3>& arr2, const ArrayT<Vec3>& arr3) {
+    assert(arr1.Length() == arr2.Length() && arr2.Length() == arr3.Length());
+
+    ArrayT<Vec3> vecSum;
+    vecSum.Reserve(arr1.Length());
+
+    for (int i = 0; i < arr1.Length(); i++) {
+        vecSum.Insert(arr1[i] + arr2[i] + arr3[i]);
+    }
+
+    return vecSum;
+}
+
+ArrayT<Vec3> SetToScaled(const ArrayT<Vec3>& arr, double scale) {
+
+    ArrayT<Vec3> scaledArr;
+    scaledArr.Dimension(arr.Length());
+
+    for (int i = 0; i < arr.Length(); i++) {
+        scaledArr[i] = arr[i]*(scale);
+    }
+    return scaledArr;
+}
+
+/* calculates the viscous forces */
+template <class REAL>
+void viscous_forces(const ArrayT<Vec3T<REAL> >& vel, double vis_coeff, ArrayT<Vec3T<REAL> > &force_vis) {
+    PROFILE_SCOPE(kProfileViscousForces);
+    for (int i = 0; i < vel.Length(); i++) {
+        force_vis[i] = vel[i]*REAL(-vis_coeff);
+    }
+}
+
+/* calculates the gravity (external) forces */
+template <class REAL>
+void gravity_force(double mass, ArrayT<Vec3T<REAL> > &force_gravity) {
+    PROFILE_SCOPE(kProfileGravity);
+    for (int i = 0; i < force_gravity.Length(); i++) {
+        Vec3T<REAL> g(0, 0, REAL(-9.8));      // Earth's gravity vector
+        force_gravity[i] = g*REAL(mass);
+    }
+}
+
+/* calculates the viscous forces on the threads of the pool */
+template <class REAL>
+void viscous_forces(const ArrayT<Vec3T<REAL> >& vel, double vis_coeff, ArrayT<Vec3T<REAL> > &force_vis, ThreadPool& pool) {
+    PROFILE_SCOPE(kProfileViscousForces);
+    pool.ParallelFor(0, vel.Length(), [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            force_vis[i] = vel[i]*REAL(-vis_coeff);
+        }
+    });
+}
+
+/* calculates the gravity (external) forces on the threads of the pool */
+template <class REAL>
+void gravity_force(double mass, ArrayT<Vec3T<REAL> > &force_gravity, ThreadPool& pool) {
+    PROFILE_SCOPE(kProfileGravity);
+    pool.ParallelFor(0, force_gravity.Length(), [&](int first, int last) {
+        Vec3T<REAL> g(0, 0, REAL(-9.8));      // Earth's gravity vector
+        for (int i = first; i < last; i++) {
+            force_gravity[i] = g*REAL(mass);
+        }
+    });
+}
+
+/* the Verlet step of nodes [first, last), with the models of the nodes */
+template <class REAL>
+static void VerletNodes(int first, int last, const ClothNodeForcesT<REAL>& models, double mass, double dt,
+                        const Vec3T<REAL>* pos, Vec3T<REAL>* pos_old, Vec3T<REAL>* vel, Vec3T<REAL>* force) {
+
+    const ClothNodeForcesT<REAL> local(models);     // which the stores cannot alias
+    REAL inverseMass = REAL(1.0/mass);
+    REAL step = REAL(dt);
+
+    for (int n = first; n < last; n++) {
+        force[n] = local.Add(force[n], pos[n], vel[n]);
+        Vec3T<REAL> acc = force[n]*inverseMass;
+        Vec3T<REAL> v = vel[n] + acc*step;
+        pos_old[n] = pos[n] + v*step;
+        vel[n] = v;
+    }
+}
+
+/* the pinned nodes back where they started, at rest */
+template <class REAL>
+void verlet_pinned(const ArrayT<int>& pinned, const ArrayT<Vec3T<REAL> >& pos0, ArrayT<Vec3T<REAL> >& pos_old,
+                   ArrayT<Vec3T<REAL> >& vel) {
+    PROFILE_SCOPE(kProfileBoundary);
+    for (int p = 0; p < pinned.Length(); p++) {
+        pos_old[pinned[p]] = pos0[pinned[p]];
+        vel[pinned[p]] = Vec3T<REAL>(0, 0, 0);
+    }
+}
+
+/* one sweep of the fixed Verlet step */
+template <class REAL>
+void verlet_step(const ClothNodeForcesT<REAL>& models, double mass, double dt, const ArrayT<Vec3T<REAL> >& pos,
+                 ArrayT<Vec3T<REAL> >& pos_old, ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force,
+                 const ArrayT<int>& pinned, const ArrayT<Vec3T<REAL> >& pos0) {
+    {
+        PROFILE_SCOPE(kProfileIntegration);
+        VerletNodes(0, pos.Length(), models, mass, dt, pos.Pointer(), pos_old.Pointer(), vel.Pointer(), force.Pointer());
+    }
+    verlet_pinned(pinned, pos0, pos_old, vel);
+}
+
+/* one sweep of the fixed Verlet step on the threads of the pool */
+template <class REAL>
+void verlet_step(const ClothNodeForcesT<REAL>& models, double mass, double dt, const ArrayT<Vec3T<REAL> >& pos,
+                 ArrayT<Vec3T<REAL> >& pos_old, ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force,
+                 const ArrayT<int>& pinned, const ArrayT<Vec3T<REAL> >& pos0, ThreadPool& pool) {
+    {
+        PROFILE_SCOPE(kProfileIntegration);
+        pool.ParallelFor(0, pos.Length(), [&](int first, int last) {
+            VerletNodes(first, last, models, mass, dt, pos.Pointer(), pos_old.Pointer(), vel.Pointer(), force.Pointer());
+        });
+    }
+    verlet_pinned(pinned, pos0, pos_old, vel);
+}
+
+/* the fixed Verlet step of a block of nodes */
+template <class REAL>
+void verlet_step(const ClothNodeForcesT<REAL>& models, double mass, double dt, const ArrayT<Vec3T<REAL> >& pos,
+                 ArrayT<Vec3T<REAL> >& pos_old, ArrayT<Vec3T<REAL> >& vel, ArrayT<Vec3T<REAL> >& force,
+                 int first, int last) {
+    assert(first >= 0 && last <= pos.Length());
+    VerletNodes(first, last, models, mass, dt, pos.Pointer(), pos_old.Pointer(), vel.Pointer(), force.Pointer());
+}
+
+/* the precisions of ClothSimulationT */
+template void viscous_forces<double>(const ArrayT<Vec3>&, double, ArrayT<Vec3>&);
+template void viscous_forces<double>(const ArrayT<Vec3>&, double, ArrayT<Vec3>&, ThreadPool&);
+template void gravity_force<double>(double, ArrayT<Vec3>&);
+template void gravity_force<double>(double, ArrayT<Vec3>&, ThreadPool&);
+template void viscous_forces<float>(const ArrayT<Vec3f>&, double, ArrayT<Vec3f>&);
+template void viscous_forces<float>(const ArrayT<Vec3f>&, double, ArrayT<Vec3f>&, ThreadPool&);
+template void gravity_force<float>(double, ArrayT<Vec3f>&);
+template void gravity_force<float>(double, ArrayT<Vec3f>&, ThreadPool&);
+template void verlet_step<double>(const ClothNodeForcesT<double>&, double, double, const ArrayT<Vec3>&, ArrayT<Vec3>&,
+                                  ArrayT<Vec3>&, ArrayT<Vec3>&, const ArrayT<int>&, const ArrayT<Vec3>&);
+template void verlet_step<double>(const ClothNodeForcesT<double>&, double, double, const ArrayT<Vec3>&, ArrayT<Vec3>&,
+                                  ArrayT<Vec3>&, ArrayT<Vec3>&, const ArrayT<int>&, const ArrayT<Vec3>&, ThreadPool&);
+template void verlet_step<double>(const ClothNodeForcesT<double>&, double, double, const ArrayT<Vec3>&, ArrayT<Vec3>&,
+                                  ArrayT<Vec3>&, ArrayT<Vec3>&, int, int);
+template void verlet_pinned<double>(const ArrayT<int>&, const ArrayT<Vec3>&, ArrayT<Vec3>&, ArrayT<Vec3>&);
+template void verlet_step<float>(const ClothNodeForcesT<float>&, double, double, const ArrayT<Vec3f>&, ArrayT<Vec3f>&,
+                                 ArrayT<Vec3f>&, ArrayT<Vec3f>&, const ArrayT<int>&, const ArrayT<Vec3f>&);
+template void verlet_step<float>(const ClothNodeForcesT<float>&, double, double, const ArrayT<Vec3f>&, ArrayT<Vec3f>&,
+                                 ArrayT<Vec3f>&, ArrayT<Vec3f>&, const ArrayT<int>&, const ArrayT<Vec3f>&, ThreadPool&);
+template void verlet_step<float>(const ClothNodeForcesT<float>&, double, double, const ArrayT<Vec3f>&, ArrayT<Vec3f>&,
+                                 ArrayT<Vec3f>&, ArrayT<Vec3f>&, int, int);
+template void verlet_pinned<float>(const ArrayT<int>&, const ArrayT<Vec3f>&, ArrayT<Vec3f>&, ArrayT<Vec3f>&);
+
+/* storing in CSV files */
+void write_csv(const string &filename, const ArrayT<Vec3>& dataset) {
+
+    PROFILE_SCOPE(kProfileFileWrite);
+
+    // Create an output filestream object
+    std::ofstream myFile(filename);
+
+    // Send column names to the stream
+    myFile << "ID" << "," << "x" << "," << "y" << "," << "z";
+    myFile << "\n";
+
+    for(int j = 0; j < dataset.Length(); ++j)
+    {
+        myFile << j << "," << dataset[j].x << "," <<  dataset[j].y << "," << dataset[j].z;
+        myFile << "\n";
+
+    }
+
+    // Close the file
+    PROFILE_BYTES(kProfileFileWrite, myFile.tellp());
+    myFile.close();
+}
+
+/* storing part of a dataset in CSV files, with the global node indices */
+void write_csv(const string &filename, const ArrayT<Vec3>& dataset, const ArrayT<int>& ids) {
+
+    assert(dataset.Length() == ids.Length());
+
+    PROFILE_SCOPE(kProfileFileWrite);
+
+    std::ofstream myFile(filename);
+
+    myFile << "ID" << "," << "x" << "," << "y" << "," << "z";
+    myFile << "\n";
+
+    for(int j = 0; j < dataset.Length(); ++j)
+    {
+        myFile << ids[j] << "," << dataset[j].x << "," <<  dataset[j].y << "," << dataset[j].z;
+        myFile << "\n";
+    }
+
+    PROFILE_BYTES(kProfileFileWrite, myFile.tellp());
+    myFile.close();
+}
@@ -0,0 +1,736 @@
+//
+// The hanging and released cloth of main(): state, time stepping and checkpoints.
+//
+
+#include "ClothSimulation.h"
+#include "Cloth.h"
+#include "Profiler.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/** \name layout of the checkpoint files */
+/*@{*/
+#define CHECKPOINT_MAGIC "SCLCHKP"
+#define CHECKPOINT_VERSION 3
+/*@}*/
+
+/* backward Euler is only available in double precision, the constructor refuses the other ones */
+static void ImplicitStep(ImplicitIntegrator& integrator, const SpringNetwork& springs, double m, double c, double dt,
+                         const ArrayT<Vec3>& forces, const ArrayT<int>& pinned, ArrayT<Vec3>& pos, ArrayT<Vec3>& vel) {
+    integrator.Step(springs, m, c, dt, forces, pinned, pos, vel);
+}
+
+static void ImplicitStep(ImplicitIntegrator&, const SpringNetwork&, double, double, double,
+                         const ArrayT<Vec3f>&, const ArrayT<int>&, ArrayT<Vec3f>&, ArrayT<Vec3f>&) {
+    throw std::logic_error("ClothSimulation: the implicit integrator needs double precision");
+}
+
+template <class REAL>
+ClothSimulationT<REAL>::ClothSimulationT(const SimulationOptions& options, ThreadPool* pool):
+    ClothSimulationT(options, options.garment.empty() ? ConnectivityStructure(options.N) : SpringNetwork(), pool)
+{ }
+
+template <class REAL>
+ClothSimulationT<REAL>::ClothSimulationT(const SimulationOptions& options, const SpringNetwork& connectivity,
+                                         ThreadPool* pool):
+    fOptions(options),
+    fPool(pool),
+    fApprox(options.rsqrt == "approx"),
+    fUseStencil(options.spring_kernel == "stencil" || (options.spring_kernel == "auto" && options.garment.empty())),
+    fLimiter(options.max_strain, options.strain_iterations, options.strain_sweep == "jacobi" ? kJacobi : kGaussSeidel),
+    fNodeForces(ViscousDragT<REAL>(options.c), GravityT<REAL>(options.m),
+                WindT<REAL>(Vec3(options.wind_x, options.wind_y, options.wind_z), options.wind_drag)),
+    fReleased(-1),
+    fTime(0.0),
+    fCounter(0)
+{
+    int N = fOptions.N;
+    double length = fOptions.length;
+
+    /* Initialization! The rest lengths are taken in double whatever the precision */
+    ArrayT<Vec3> pos0;
+    ArrayT<int> triangles;
+    if (!fOptions.garment.empty()) {
+        if (fUseStencil || fOptions.sleep_tile > 0 || fOptions.collision == "on")
+            throw std::runtime_error("ClothSimulation: garments need the edges spring kernel, not the stencil, without sleeping tiles and self-collision");
+
+        /* the nodes renumbered so that the springs of a node are near it in memory, pinned at the top */
+        TriangleMesh mesh = ReadMesh(fOptions.garment);
+        if (mesh.NumTriangles() == 0) throw std::runtime_error("ClothSimulation: no triangles in " + fOptions.garment);
+        fImportIndex = NodeNumbering(mesh, NodeOrderFromName(fOptions.node_order));
+        mesh = RenumberVertices(mesh, fImportIndex);
+        pos0 = mesh.vertices;
+        triangles = mesh.triangles;
+        fSprings = MeshSprings(mesh);
+        fFixed = TopNodes(pos0);
+        if (fFixed.Length() == pos0.Length())
+            throw std::runtime_error("ClothSimulation: the garment " + fOptions.garment + " is flat, nothing hangs from its top");
+    }
+    else {
+        pos0.Dimension(N*N);
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                pos0[N*j + i] = Vec3(i * length / (N - 1), j * length / (N - 1), 0.0);
+            }
+        }
+        assert(connectivity.NumNodes() == N*N);
+        fSprings = connectivity;
+        fStencil.SetRestState(N, pos0, fOptions.k);
+        triangles = GridTriangles(N);
+
+        /* the two top corners, the bottom-left one until t_release */
+        fFixed.Insert(0);
+        fFixed.Insert(N-1);
+        fReleased = N*(N-1);
+    }
+    int numNodes = pos0.Length();
+    fPos0.Dimension(numNodes);
+    for (int n = 0; n < numNodes; n++) fPos0[n] = VecType(pos0[n]);
+    fPos = fPos0;
+    fPosOld = fPos0;
+    fVel.Dimension(numNodes);
+    fVel = VecType(0.0, 0.0, 0.0);
+    fAcc.Dimension(numNodes);
+    fAcc = VecType(0.0, 0.0, 0.0);
+
+    /* Create the springs between connected nodes, rest lengths are taken from the initial configuration */
+    fSprings.SetRestState(pos0, fOptions.k);
+
+    /* the distances of the collisions are in spacings of the grid, or in mean structural springs */
+    fSpacing = length/(N - 1);
+    if (!fOptions.garment.empty()) {
+        double sum = 0.0;
+        int count = 0;
+        for (int s = 0; s < fSprings.NumSprings(); s++) {
+            if (fSprings[s].type != kStructural) continue;
+            sum += fSprings[s].rest;
+            count++;
+        }
+        fSpacing = sum/Max(count, 1);
+    }
+
+    fForces.Dimension(numNodes);
+    fForces = VecType(0.0, 0.0, 0.0);
+    fForceInt.Dimension(numNodes);
+
+    /* Adaptive steps start from dt, the stability limit uses the largest number of springs at a node */
+    fMaxNodeSprings = 0;
+    for (int n = 0; n < numNodes; n++) fMaxNodeSprings = Max(fMaxNodeSprings, fSprings.NumNodeSprings(n));
+    if (fOptions.dt_control == "adaptive") {
+        fController.reset(new StepController(fOptions.dt, fOptions.dt_min, fOptions.dt_max, fOptions.dt_tolerance,
+                                             fOptions.dt_safety, fOptions.integrator != "implicit"));
+    }
+
+    /* Sleeping tiles skip nodes in the stencil and in the fixed Verlet steps only. The residual force
+     * of a node in free fall is its weight, sleep_force has to stay below it (see ParseOptions()) */
+    if (fOptions.sleep_tile > 0) {
+        assert(fOptions.integrator == "verlet" && !fController && fUseStencil);
+        assert(fOptions.sleep_force < fOptions.m*9.8);
+        fActivity.reset(new ActivityTracker(N, fOptions.sleep_tile, fOptions.sleep_displacement, fOptions.sleep_force,
+                                            fOptions.sleep_steps));
+    }
+
+    /* The air on the triangles, the sleeping nodes would keep adding it to their spring forces */
+    if (fOptions.air_density > 0.0) {
+        assert(!fActivity);
+        fAerodynamics = Aerodynamics(triangles, Vec3(fOptions.wind_x, fOptions.wind_y, fOptions.wind_z),
+                                     fOptions.air_density, fOptions.drag_coefficient, fOptions.lift_coefficient);
+    }
+
+    /* Self-collision with the triangles of the grid, the thickness in grid spacings */
+    if (fOptions.collision == "on") {
+        fCollision.reset(new SelfCollision(N, fSprings, fSpacing, fOptions.collision_thickness*fSpacing));
+    }
+    if (!fOptions.obstacle.empty()) {
+        TriangleMesh mesh = ReadObj(fOptions.obstacle);
+        if (mesh.NumTriangles() == 0) throw std::runtime_error("ClothSimulation: no triangles in " + fOptions.obstacle);
+        fObstacle.reset(new Obstacle(mesh, fOptions.obstacle_thickness*fSpacing));
+    }
+
+    /* The implicit integrator keeps the sparsity pattern of its system over the steps */
+    if (fOptions.integrator == "implicit") {
+        if (sizeof(REAL) != sizeof(double))
+            throw std::runtime_error("ClothSimulation: the implicit integrator needs double precision");
+        fIntegrator.reset(new ImplicitIntegrator(fSprings, fOptions.cg_tolerance, fOptions.cg_iterations));
+    }
+}
+
+template <class REAL>
+bool ClothSimulationT<REAL>::StartFromEquilibrium() {
+
+    int numNodes = NumNodes();
+
+    /* no hanging phase left to skip */
+    if (fOptions.t_release <= fTime) return true;
+
+    /* the nodes pinned until the release, gravity as the only load */
+    ArrayT<int> pinned = fFixed;
+    if (fReleased >= 0) pinned.Insert(fReleased);
+    ArrayT<Vec3> loads(numNodes);
+    gravity_force(fOptions.m, loads);
+
+    /* Newton from the current positions, in double whatever REAL */
+    ArrayT<Vec3> pos(numNodes);
+    for (int n = 0; n < numNodes; n++) pos[n] = Vec3(fPos[n]);
+    fStatic.reset(new StaticSolver(fSprings, fOptions.newton_tolerance, fOptions.newton_iterations,
+                                   fOptions.cg_iterations));
+    bool converged;
+    {
+        PROFILE_SCOPE(kProfileEquilibrium);
+        converged = fStatic->Solve(fSprings, loads, pinned, pos);
+    }
+
+    /* a state short of the equilibrium is not at rest, the hanging phase is stepped through instead */
+    if (!converged) return false;
+
+    /* at rest there, once the springs stretched beyond max_strain are shortened as after any step */
+    for (int n = 0; n < numNodes; n++) fPos[n] = VecType(pos[n]);
+    fArena.Reset();
+    {
+        ArenaScope arena(fArena);
+        fLimiter.Apply(fSprings, pinned, fPos);
+    }
+    fPosOld = fPos;
+    fVel = VecType(0.0, 0.0, 0.0);
+    fAcc = VecType(0.0, 0.0, 0.0);
+    fForces = VecType(0.0, 0.0, 0.0);
+
+    fTime = fOptions.t_release;
+    fCounter = fController ? 0 : lround(fOptions.t_release/fOptions.dt);
+    return converged;
+}
+
+template <class REAL>
+void ClothSimulationT<REAL>::Step() {
+
+    double m = fOptions.m;
+    double c = fOptions.c;
+    double dt = fOptions.dt;
+    double t = fTime;
+
+    /* the temporaries of the step come from the arena, those of the last one are given back */
+    fArena.Reset();
+    ArenaScope arena(fArena);
+
+    /* the release changes the boundary conditions, the whole cloth has to move again */
+    if (fActivity && t >= fOptions.t_release && t - dt < fOptions.t_release) fActivity->WakeAll();
+
+    /* the fixed nodes, the released one until t = t_release */
+    {
+        PROFILE_SCOPE(kProfileBoundary);
+        fPinned = fFixed;
+        if (fReleased >= 0 && t < fOptions.t_release) fPinned.Insert(fReleased);
+    }
+
+    /* the fixed Verlet step adds the models of the nodes in its own sweep, and with the stencil alone
+     * it computes the spring forces of every block of rows in that sweep as well */
+    bool fused = !fIntegrator && !fController && !fActivity;
+    bool blocked = fused && fUseStencil && !fAerodynamics.Enabled();
+
+    /* the forces of the springs go into fForces, the other models add theirs there. Sleeping tiles
+     * need them apart, the sleeping nodes keep theirs */
+    ArrayT<VecType>& springForces = fActivity ? fForceInt : fForces;
+    if (fPool && !blocked) {
+        if (fActivity) ActiveForces();
+        else if (fUseStencil && fApprox) grid_forces<REAL, true>(fStencil, fPos, springForces, *fPool);
+        else if (fUseStencil) grid_forces(fStencil, fPos, springForces, *fPool);
+        else if (fApprox) internal_forces<REAL, true>(fSprings, fPos, springForces, *fPool);
+        else internal_forces(fSprings, fPos, springForces, *fPool);
+    }
+    else if (!blocked) {
+        if (fActivity) ActiveForces();
+        else if (fUseStencil && fApprox) grid_forces<REAL, true>(fStencil, fPos, springForces);
+        else if (fUseStencil) grid_forces(fStencil, fPos, springForces);
+        else if (fApprox) internal_forces<REAL, true>(fSprings, fPos, springForces);
+        else internal_forces(fSprings, fPos, springForces);
+    }
+    if (fAerodynamics.Enabled()) fAerodynamics.Accumulate(fPos, fVel, springForces);
+
+    /* the models of the nodes */
+    if (!fused) {
+        if (fPool) fNodeForces.Accumulate(fPos, fVel, springForces, fForces, *fPool);
+        else fNodeForces.Accumulate(fPos, fVel, springForces, fForces);
+    }
+
+    /* the sides of the cloth and of the obstacle the nodes are on */
+    if (fCollision || fObstacle) fPosStart = fPos;
+
+    /* the size of an adaptive step, from the accelerations of the forces above */
+    double dtPrev = dt;
+    bool history = fAccPrev.Length() > 0;
+    if (fController) dt = AdaptiveStep(dtPrev);
+
+    if (fIntegrator) {
+        /** Backward Euler: the fixed corners are left out of the solve */
+        {
+            PROFILE_SCOPE(kProfileIntegration);
+            ImplicitStep(*fIntegrator, fSprings, m, c, dt, fForces, fPinned, fPos, fVel);
+        }
+
+        /* the velocity follows the nodes moved by the strain limiting and the collisions */
+        {
+            PROFILE_SCOPE(kProfileStrainLimiting);
+            fLimiter.Apply(fSprings, fPinned, fPos, NULL, &fVel, dt);
+        }
+        Collide(fPos, NULL, &fVel, dt);
+    }
+    else if (fController) {
+        /** Time-corrected Verlet for steps of varying size, the accelerations are those of AdaptiveStep():
+         *      x(t + dt) = x + (x - x(t - dtPrev)) dt/dtPrev + a dt (dt + dtPrev)/2
+         * exact for constant accelerations. The first step starts from the velocities instead */
+        {
+            PROFILE_SCOPE(kProfileIntegration);
+            if (history) fPosNext = fPos + (dt/dtPrev)*(fPos - fPosOld) + (0.5*dt*(dt + dtPrev))*fAcc;
+            else fPosNext = fPos + dt*fVel + (0.5*dt*dt)*fAcc;
+        }
+        {
+            PROFILE_SCOPE(kProfileBoundary);
+            for (int p = 0; p < fPinned.Length(); p++) fPosNext[fPinned[p]] = fPos0[fPinned[p]];
+        }
+        {
+            PROFILE_SCOPE(kProfileStrainLimiting);
+            fLimiter.Apply(fSprings, fPinned, fPosNext);
+        }
+        Collide(fPosNext);
+
+        /* the previous positions are kept for the next step, the velocity is that of the step */
+        PROFILE_SCOPE(kProfileIntegration);
+        swap(fPosOld, fPos);
+        swap(fPos, fPosNext);
+        fVel = (1.0/dt)*(fPos - fPosOld);
+    }
+    else if (fActivity) {
+        ActiveVerletStep(dt);
+    }
+    else {
+        /** Verlet Integration scheme, with the models of the nodes, the accelerations, the velocity
+         * and the new positions in one sweep over the nodes, which computes the spring forces as well
+         * when blocked: the new positions overwrite the old ones, which are no longer needed, and
+         * become the current ones by a swap */
+        if (blocked) BlockedVerletStep(dt);
+        else if (fPool) verlet_step(fNodeForces, m, dt, fPos, fPosOld, fVel, fForces, fPinned, fPos0, *fPool);
+        else verlet_step(fNodeForces, m, dt, fPos, fPosOld, fVel, fForces, fPinned, fPos0);
+        swap(fPos, fPosOld);
+
+        /* Provot's deformation constraints, the velocity follows the nodes they move */
+        {
+            PROFILE_SCOPE(kProfileStrainLimiting);
+            fLimiter.Apply(fSprings, fPinned, fPos, NULL, &fVel, dt);
+        }
+        Collide(fPos, NULL, &fVel, dt);
+    }
+
+    /* update time, adaptive steps land exactly on the events */
+    double next = fController ? NextEventTime() : 0.0;
+    fTime = (fController && dt >= next - t) ? next : fTime + dt;
+    fCounter++;
+}
+
+template <class REAL>
+double ClothSimulationT<REAL>::AdaptiveStep(double& dtPrev) {
+
+    double m = fOptions.m;
+    {
+        PROFILE_SCOPE(kProfileIntegration);
+        fAcc = (1.0/m)*fForces;
+    }
+    {
+        PROFILE_SCOPE(kProfileBoundary);
+        for (int p = 0; p < fPinned.Length(); p++) fAcc[fPinned[p]] = VecType(0, 0, 0);
+    }
+
+    PROFILE_SCOPE(kProfileStepControl);
+
+    dtPrev = fController->LastStep();
+    double jerk = (fAccPrev.Length() > 0) ? MaxJerk(fAcc, fAccPrev, dtPrev) : 0.0;
+    double stable = fIntegrator ? 0.0 : StableStep(fSprings, fMaxNodeSprings, fPos, m);
+    fAccPrev = fAcc;
+
+    return fController->NextStep(fTime, NextEventTime(), stable, jerk);
+}
+
+template <class REAL>
+void ClothSimulationT<REAL>::ActiveForces() {
+
+    PROFILE_SCOPE(kProfileInternalForces);
+
+    auto tiles = [&](int first, int last) {
+        for (int a = first; a < last; a++) {
+            int firstColumn, lastColumn, firstRow, lastRow;
+            fActivity->TileRange(fActivity->AwakeTile(a), firstColumn, lastColumn, firstRow, lastRow);
+            if (fApprox) grid_forces<REAL, true>(fStencil, fPos, fForceInt, firstColumn, lastColumn, firstRow, lastRow);
+            else grid_forces(fStencil, fPos, fForceInt, firstColumn, lastColumn, firstRow, lastRow);
+        }
+    };
+    if (fPool) fPool->ParallelFor(0, fActivity->NumAwakeTiles(), tiles);
+    else tiles(0, fActivity->NumAwakeTiles());
+}
+
+template <class REAL>
+void ClothSimulationT<REAL>::BlockedVerletStep(double dt) {
+
+    int N = fOptions.N;
+    double m = fOptions.m;
+
+    /* the positions are read and the new ones written to fPosOld, the blocks do not depend on each other */
+    auto rows = [&](int first, int last) {
+        for (int j = first; j < last; j += VERLET_BLOCK_ROWS) {
+            int end = Min(j + VERLET_BLOCK_ROWS, last);
+            {
+                PROFILE_SCOPE(kProfileInternalForces);
+                if (fApprox) grid_forces<REAL, true>(fStencil, fPos, fForces, 0, N, j, end);
+                else grid_forces(fStencil, fPos, fForces, 0, N, j, end);
+            }
+            PROFILE_SCOPE(kProfileIntegration);
+            verlet_step(fNodeForces, m, dt, fPos, fPosOld, fVel, fForces, N*j, N*end);
+        }
+    };
+    if (fPool) fPool->ParallelFor(0, N, rows);
+    else rows(0, N);
+    verlet_pinned(fPinned, fPos0, fPosOld, fVel);
+}
+
+template <class REAL>
+void ClothSimulationT<REAL>::ActiveVerletStep(double dt) {
+
+    int N = fOptions.N;
+    double m = fOptions.m;
+
+    /* body(t, n) for every node n of the awake tiles t */
+    auto active = [&](auto body) {
+        for (int a = 0; a < fActivity->NumAwakeTiles(); a++) {
+            int t = fActivity->AwakeTile(a);
+            int firstColumn, lastColumn, firstRow, lastRow;
+            fActivity->TileRange(t, firstColumn, lastColumn, firstRow, lastRow);
+            for (int j = firstRow; j < lastRow; j++)
+                for (int i = firstColumn; i < lastColumn; i++) body(t, N*j + i);
+        }
+    };
+
+    /* the Verlet step of Step(), node by node */
+    {
+        PROFILE_SCOPE(kProfileIntegration);
+        active([&](int, int n) { fAcc[n] = fForces[n]*REAL(1.0/m); });
+    }
+    {
+        PROFILE_SCOPE(kProfileBoundary);
+        for (int p = 0; p < fPinned.Length(); p++) fAcc[fPinned[p]] = VecType(0, 0, 0);
+    }
+    {
+        PROFILE_SCOPE(kProfileIntegration);
+        active([&](int, int n) {
+            VecType x = fPos[n];
+            fVel[n] = fVel[n] + fAcc[n]*REAL(dt);
+            fPos[n] = x + fVel[n]*REAL(dt);
+            fPosOld[n] = x;
+        });
+    }
+    {
+        PROFILE_SCOPE(kProfileBoundary);
+        for (int p = 0; p < fPinned.Length(); p++) {
+            fPos[fPinned[p]] = fPos0[fPinned[p]];
+            fVel[fPinned[p]] = VecType(0, 0, 0);
+        }
+    }
+
+    /* the sleeping nodes do not move either, the velocity follows the nodes moved */
+    {
+        PROFILE_SCOPE(kProfileStrainLimiting);
+        fLimiter.Apply(fSprings, fPinned, fPos, &fActivity->NodesAsleep(), &fVel, dt);
+    }
+    Collide(fPos, &fActivity->NodesAsleep(), &fVel, dt);
+
+    /* how much the awake tiles still move */
+    PROFILE_SCOPE(kProfileActivity);
+    active([&](int t, int n) {
+        fActivity->Record(t, (fPos[n] - fPosOld[n]).Magnitude(), m*fAcc[n].Magnitude());
+    });
+    fActivity->Update();
+
+    /* the tiles which went to sleep are stopped, or they would wake with the velocity they had */
+    const ArrayT<int>& asleep = fActivity->FellAsleep();
+    for (int s = 0; s < asleep.Length(); s++) {
+        int firstColumn, lastColumn, firstRow, lastRow;
+        fActivity->TileRange(asleep[s], firstColumn, lastColumn, firstRow, lastRow);
+        for (int j = firstRow; j < lastRow; j++) {
+            for (int i = firstColumn; i < lastColumn; i++) {
+                fPosOld[N*j + i] = fPos[N*j + i];
+                fVel[N*j + i] = VecType(0, 0, 0);
+            }
+        }
+    }
+}
+
+template <class REAL>
+int ClothSimulationT<REAL>::Collide(ArrayT<VecType>& pos, const ArrayT<char>* asleep, ArrayT<VecType>* vel, double dt) {
+
+    int contacts = 0;
+    if (fCollision) {
+        PROFILE_SCOPE(kProfileCollision);
+        contacts += fCollision->Apply(fPosStart, fPinned, pos, asleep, vel, dt);
+    }
+    if (fObstacle) {
+        PROFILE_SCOPE(kProfileObstacle);
+        contacts += fObstacle->Apply(fPosStart, fPinned, pos, fPool, asleep, vel, dt);
+    }
+    return contacts;
+}
+
+/* the first multiple of interval after t */
+static double NextMultiple(double t, double interval) {
+    double k = std::floor(t/interval) + 1.0;
+    while (k*interval <= t) k += 1.0;
+    return k*interval;
+}
+
+template <class REAL>
+double ClothSimulationT<REAL>::NextEventTime() const {
+
+    double next = NextMultiple(fTime, fOptions.output_interval);
+    if (fOptions.t_final > fTime) next = Min(next, fOptions.t_final);
+    if (fOptions.t_release > fTime) next = Min(next, fOptions.t_release);
+    if (fOptions.checkpoint_interval > 0.0) next = Min(next, NextMultiple(fTime, fOptions.checkpoint_interval));
+    return next;
+}
+
+template <class REAL>
+bool ClothSimulationT<REAL>::OnMultipleOf(double interval) const {
+
+    if (interval <= 0.0) return false;
+
+    /* fixed steps count them, adaptive ones land on the multiples */
+    if (!fController) return fCounter % Max(lround(interval/fOptions.dt), 1L) == 0;
+    return fTime == std::round(fTime/interval)*interval;
+}
+
+/* appending to and reading from the bytes of a checkpoint */
+template <class TYPE>
+static void Put(std::string& bytes, const TYPE& value) {
+    bytes.append(reinterpret_cast<const char*>(&value), sizeof(TYPE));
+}
+
+template <class REAL>
+static void PutArray(std::string& bytes, const ArrayT<Vec3T<REAL> >& values) {
+    for (int n = 0; n < values.Length(); n++) {
+        Put(bytes, double(values[n].x));
+        Put(bytes, double(values[n].y));
+        Put(bytes, double(values[n].z));
+    }
+}
+
+template <class TYPE>
+static void Get(std::istream& in, TYPE& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(TYPE));
+    if (!in) throw std::runtime_error("checkpoint: unexpected end of file");
+}
+
+template <class REAL>
+static void GetArray(std::istream& in, ArrayT<Vec3T<REAL> >& values) {
+    Vec3 value;
+    for (int n = 0; n < values.Length(); n++) {
+        Get(in, value.x);
+        Get(in, value.y);
+        Get(in, value.z);
+        values[n] = Vec3T<REAL>(value);
+    }
+}
+
+/* open a checkpoint and read everything up to the state: the number of nodes and the options */
+static void OpenCheckpoint(const std::string& filename, std::ifstream& in, int32_t& numNodes, std::string& options) {
+
+    in.open(filename, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("checkpoint: cannot open " + filename);
+    int64_t fileSize = int64_t(in.tellg());
+    in.seekg(0);
+
+    char magic[8];
+    int32_t version;
+    int64_t optionsLength;
+    in.read(magic, sizeof(magic));
+    Get(in, version);
+    if (strncmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 || version != CHECKPOINT_VERSION)
+        throw std::runtime_error("checkpoint: " + filename + " is not a checkpoint of this version");
+
+    /* the options are a part of the file, a length beyond its end is a corrupt file */
+    Get(in, numNodes);
+    Get(in, optionsLength);
+    if (numNodes < 0 || optionsLength < 0 || optionsLength > fileSize - int64_t(in.tellg()))
+        throw std::runtime_error("checkpoint: " + filename + " is corrupt");
+    options.resize(size_t(optionsLength));
+    in.read(&options[0], optionsLength);
+    if (!in) throw std::runtime_error("checkpoint: unexpected end of file");
+}
+
+/* make a rename in the directory of filename durable */
+static void SyncDirectory(const std::string& filename) {
+
+    size_t slash = filename.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : filename.substr(0, slash));
+    int descriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (descriptor < 0) throw std::runtime_error("checkpoint: cannot open the directory " + directory);
+    int synced = fsync(descriptor);
+    close(descriptor);
+    if (synced != 0) throw std::runtime_error("checkpoint: cannot sync the directory " + directory);
+}
+
+template <class REAL>
+void ClothSimulationT<REAL>::WriteCheckpoint(const std::string& filename) const {
+
+    PROFILE_SCOPE(kProfileCheckpoint);
+
+    std::ostringstream options;
+    WriteOptions(options, fOptions);
+
+    std::string bytes;
+    char magic[8] = CHECKPOINT_MAGIC;
+    bytes.append(magic, sizeof(magic));
+    Put(bytes, int32_t(CHECKPOINT_VERSION));
+    Put(bytes, int32_t(NumNodes()));
+    Put(bytes, int64_t(options.str().size()));
+    bytes.append(options.str());
+
+    Put(bytes, fTime);
+    Put(bytes, int64_t(fCounter));
+    PutArray(bytes, fPos);
+    PutArray(bytes, fPosOld);
+    PutArray(bytes, fVel);
+
+    /* the starting point of the next implicit solve */
+    Put(bytes, int32_t(fIntegrator ? 1 : 0));
+    if (fIntegrator) PutArray(bytes, fIntegrator->LastDv());
+
+    /* the history of the adaptive steps */
+    Put(bytes, int32_t(fController ? 1 : 0));
+    if (fController) {
+        Put(bytes, fController->LastStep());
+        Put(bytes, fController->LastProposal());
+        Put(bytes, int32_t(fAccPrev.Length() > 0 ? 1 : 0));
+        if (fAccPrev.Length() > 0) PutArray(bytes, fAccPrev);
+    }
+
+    /* the sleeping tiles and the forces they keep */
+    Put(bytes, int32_t(fActivity ? fActivity->NumTiles() : 0));
+    if (fActivity) {
+        for (int t = 0; t < fActivity->NumTiles(); t++) {
+            Put(bytes, int8_t(fActivity->AwakeFlags()[t]));
+            Put(bytes, int32_t(fActivity->QuietSteps()[t]));
+        }
+        PutArray(bytes, fForceInt);
+    }
+
+    /* a crash leaves either the old or the new checkpoint behind, never a partial one */
+    std::string temporary = filename + ".tmp";
+    int descriptor = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) throw std::runtime_error("checkpoint: cannot create " + temporary);
+
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t count = write(descriptor, bytes.data() + written, bytes.size() - written);
+        if (count < 0) {
+            close(descriptor);
+            throw std::runtime_error("checkpoint: cannot write " + temporary);
+        }
+        written += count;
+    }
+
+    PROFILE_BYTES(kProfileCheckpoint, bytes.size());
+
+    if (fsync(descriptor) != 0 || close(descriptor) != 0 || std::rename(temporary.c_str(), filename.c_str()) != 0)
+        throw std::runtime_error("checkpoint: cannot replace " + filename);
+
+    /* and the rename itself survives a crash */
+    SyncDirectory(filename);
+}
+
+template <class REAL>
+void ClothSimulationT<REAL>::ReadCheckpoint(const std::string& filename) {
+
+    std::ifstream in;
+    int32_t numNodes;
+    std::string options;
+    OpenCheckpoint(filename, in, numNodes, options);
+
+    if (numNodes != NumNodes())
+        throw std::runtime_error("checkpoint: " + filename + " is a cloth of another size");
+
+    int64_t counter;
+    Get(in, fTime);
+    Get(in, counter);
+    fCounter = long(counter);
+    GetArray(in, fPos);
+    GetArray(in, fPosOld);
+    GetArray(in, fVel);
+
+    /* a checkpoint of a Verlet run starts the implicit solves from zero */
+    int32_t hasDv;
+    Get(in, hasDv);
+    if (hasDv) {
+        ArrayT<Vec3> dv(numNodes);
+        GetArray(in, dv);
+        if (fIntegrator) fIntegrator->SetLastDv(dv);
+    }
+
+    /* a checkpoint of fixed steps starts the adaptive ones from dt */
+    int32_t hasController;
+    Get(in, hasController);
+    if (hasController) {
+        double lastStep, lastProposal;
+        int32_t hasAccPrev;
+        Get(in, lastStep);
+        Get(in, lastProposal);
+        Get(in, hasAccPrev);
+        ArrayT<VecType> accPrev(hasAccPrev ? numNodes : 0);
+        GetArray(in, accPrev);
+        if (fController) {
+            fController->Restore(lastStep, lastProposal);
+            fAccPrev = accPrev;
+        }
+    }
+
+    /* a checkpoint without sleeping tiles wakes them all */
+    int32_t numTiles;
+    Get(in, numTiles);
+    if (numTiles < 0 || numTiles > numNodes)
+        throw std::runtime_error("checkpoint: " + filename + " is corrupt");
+    if (numTiles > 0) {
+        ArrayT<char> awake(numTiles);
+        ArrayT<int> quiet(numTiles);
+        for (int t = 0; t < numTiles; t++) {
+            int8_t flag;
+            int32_t steps;
+            Get(in, flag);
+            Get(in, steps);
+            awake[t] = flag;
+            quiet[t] = steps;
+        }
+        ArrayT<VecType> forceInt(numNodes);
+        GetArray(in, forceInt);
+        if (fActivity && fActivity->NumTiles() == numTiles) {
+            fActivity->Restore(awake, quiet);
+            fForceInt = forceInt;
+        }
+    }
+}
+
+template class ClothSimulationT<double>;
+template class ClothSimulationT<float>;
+
+void ReadCheckpointOptions(const std::string& filename, SimulationOptions& options) {
+
+    std::ifstream in;
+    int32_t numNodes;
+    std::string text;
+    OpenCheckpoint(filename, in, numNodes, text);
+
+    std::istringstream lines(text);
+    if (!ReadOptions(lines, options))
+        throw std::runtime_error("checkpoint: invalid options in " + filename);
+}
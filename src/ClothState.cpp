@@ -0,0 +1,142 @@
+//
+// Structure-of-arrays cloth state and the grouping of springs into conflict-free batches.
+//
+
+#include "ClothState.h"
+
+#include <vector>
+
+void Vec3ArrayT::CopyFrom(const ArrayT<Vec3>& source) {
+
+    assert(source.Length() <= Length());
+
+    for (int n = 0; n < source.Length(); n++) {
+        x[n] = source[n].x;
+        y[n] = source[n].y;
+        z[n] = source[n].z;
+    }
+}
+
+void Vec3ArrayT::CopyTo(ArrayT<Vec3>& target) const {
+
+    assert(target.Length() <= Length());
+
+    for (int n = 0; n < target.Length(); n++) {
+        target[n] = Vec3(x[n], y[n], z[n]);
+    }
+}
+
+void ClothState::Dimension(int numNodes) {
+
+    fNumNodes = numNodes;
+
+    pos.Dimension(numNodes + 2);
+    pos_old.Dimension(numNodes + 2);
+    force.Dimension(numNodes + 2);
+
+    pos = 0.0;
+    pos_old = 0.0;
+    force = 0.0;
+
+    /* the dummy nodes are a unit distance apart, so a padding spring has a finite length */
+    pos.x[DummyNode() + 1] = 1.0;
+    pos_old.x[DummyNode() + 1] = 1.0;
+}
+
+namespace {
+
+/* A batch which is being filled */
+struct OpenBatch {
+    int count;
+    int springs[SPRING_BATCH];
+    int nodes[2*SPRING_BATCH];
+
+    bool Conflicts(int i, int j) const {
+        for (int n = 0; n < 2*count; n++) {
+            if (nodes[n] == i || nodes[n] == j) return true;
+        }
+        return false;
+    };
+
+    void Add(int s, int i, int j) {
+        springs[count] = s;
+        nodes[2*count] = i;
+        nodes[2*count + 1] = j;
+        count++;
+    };
+};
+
+/* number of batches filled at the same time */
+const int kMaxOpenBatches = 16;
+
+}
+
+void SpringBatches::Build(const SpringNetwork& springs) {
+
+    fNumSprings = springs.NumSprings();
+
+    /* greedy: every spring goes into the oldest open batch it does not conflict with, so the
+     * springs keep roughly the order of the network */
+    std::vector<int> order;
+    order.reserve(fNumSprings + SPRING_BATCH);
+
+    std::vector<OpenBatch> open;
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        int i_s = springs[s].i;
+        int j_s = springs[s].j;
+
+        bool placed = false;
+        for (size_t b = 0; b < open.size() && !placed; b++) {
+            if (!open[b].Conflicts(i_s, j_s)) {
+                open[b].Add(s, i_s, j_s);
+                placed = true;
+
+                if (open[b].count == SPRING_BATCH) {
+                    order.insert(order.end(), open[b].springs, open[b].springs + SPRING_BATCH);
+                    open.erase(open.begin() + b);
+                }
+            }
+        }
+
+        if (!placed) {
+            /* too many open batches: close the oldest one with padding */
+            if ((int) open.size() == kMaxOpenBatches) {
+                order.insert(order.end(), open[0].springs, open[0].springs + open[0].count);
+                order.insert(order.end(), SPRING_BATCH - open[0].count, -1);
+                open.erase(open.begin());
+            }
+            OpenBatch batch;
+            batch.count = 0;
+            batch.Add(s, i_s, j_s);
+            open.push_back(batch);
+        }
+    }
+    for (size_t b = 0; b < open.size(); b++) {
+        order.insert(order.end(), open[b].springs, open[b].springs + open[b].count);
+        order.insert(order.end(), SPRING_BATCH - open[b].count, -1);
+    }
+
+    /* copy over in structure-of-arrays layout, -1 marks a padding spring */
+    int numSlots = (int) order.size();
+    int dummy = springs.NumNodes();
+
+    i.Dimension(numSlots);
+    j.Dimension(numSlots);
+    rest.Dimension(numSlots);
+    k.Dimension(numSlots);
+
+    for (int slot = 0; slot < numSlots; slot++) {
+        if (order[slot] < 0) {
+            i[slot] = dummy;
+            j[slot] = dummy + 1;
+            rest[slot] = 1.0;
+            k[slot] = 0.0;
+        } else {
+            const Spring& spring = springs[order[slot]];
+            i[slot] = spring.i;
+            j[slot] = spring.j;
+            rest[slot] = spring.rest;
+            k[slot] = spring.k;
+        }
+    }
+}
@@ -0,0 +1,361 @@
+//
+// The cloth of main() split over MPI ranks: one rectangular tile of the N x N grid per rank.
+//
+
+#include "DistributedCloth.h"
+#include "SpringNetwork.h"
+#include "Cloth.h"
+#include "StrainLimiter.h"
+
+#include <stdexcept>
+
+/* the 12 springs of a node: structural, shear and bending neighbours, in the order in which
+ * ConnectivityStructure() lists them, so that the strain corrections of a node add up in the order of
+ * the Jacobi sweeps of StrainLimiter */
+static const int kNumNeighbours = 12;
+static const int kNeighbourI[kNumNeighbours] = {0, 0, -1, 1, -1, 1, 0, 1, -1, -2, 2, 0};
+static const int kNeighbourJ[kNumNeighbours] = {-2, -1, -1, -1, 0, 0, 1, 1, 1, 0, 0, 2};
+
+/* first index of part p when n items are split into parts as evenly as possible */
+static int SplitBegin(int n, int parts, int p) {
+    return (int) (((long) n*p)/parts);
+}
+
+DistributedCloth::DistributedCloth(const SimulationOptions& options, MPI_Comm comm):
+    fOptions(options),
+    fTime(0.0),
+    fCounter(0)
+{
+    int N = fOptions.N;
+
+    /* a two dimensional grid of ranks */
+    int size;
+    MPI_Comm_size(comm, &size);
+    fDims[0] = fDims[1] = 0;
+    MPI_Dims_create(size, 2, fDims);
+
+    int periods[2] = {0, 0};
+    MPI_Cart_create(comm, 2, fDims, periods, 0, &fComm);
+    MPI_Comm_rank(fComm, &fRank);
+    MPI_Cart_coords(fComm, fRank, 2, fCoords);
+
+    fI0 = SplitBegin(N, fDims[0], fCoords[0]);
+    fI1 = SplitBegin(N, fDims[0], fCoords[0] + 1);
+    fJ0 = SplitBegin(N, fDims[1], fCoords[1]);
+    fJ1 = SplitBegin(N, fDims[1], fCoords[1] + 1);
+
+    /* the halo must come from the direct neighbours only */
+    if (fI1 - fI0 < HALO_WIDTH || fJ1 - fJ0 < HALO_WIDTH)
+        throw std::runtime_error("DistributedCloth: tiles must be at least HALO_WIDTH nodes wide, use fewer ranks");
+
+    fLX = fI1 - fI0 + 2*HALO_WIDTH;
+    fLY = fJ1 - fJ0 + 2*HALO_WIDTH;
+
+    for (int dj = -1; dj <= 1; dj++) {
+        for (int di = -1; di <= 1; di++) {
+            int coords[2] = {fCoords[0] + di, fCoords[1] + dj};
+            int& neighbour = fNeighbours[(di + 1) + 3*(dj + 1)];
+
+            if (coords[0] < 0 || coords[0] >= fDims[0] || coords[1] < 0 || coords[1] >= fDims[1])
+                neighbour = MPI_PROC_NULL;
+            else
+                MPI_Cart_rank(fComm, coords, &neighbour);
+        }
+    }
+
+    /* Initialization of the tile and its halo, as in main() */
+    fPos0.Dimension(fLX*fLY);
+    fPos0 = Vec3(0.0, 0.0, 0.0);
+    for (int j = Max(fJ0 - HALO_WIDTH, 0); j < Min(fJ1 + HALO_WIDTH, N); j++) {
+        for (int i = Max(fI0 - HALO_WIDTH, 0); i < Min(fI1 + HALO_WIDTH, N); i++) {
+            fPos0[Local(i, j)] = Vec3(i * fOptions.length / (N - 1), j * fOptions.length / (N - 1), 0.0);
+        }
+    }
+    fPos = fPos0;
+    fVel.Dimension(fLX*fLY);
+    fVel = Vec3(0.0, 0.0, 0.0);
+    fForce.Dimension(fLX*fLY);
+    fForce = Vec3(0.0, 0.0, 0.0);
+    fCorrection.Dimension(fLX*fLY);
+    fCorrection = Vec3(0.0, 0.0, 0.0);
+
+    /* the rest length of every direction of the grid, from its first spring as in GridStencil::SetRestState() */
+    for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) {
+        const GridDirection& dir = kGridDirections[d];
+        int first = Max(-dir.di, 0);
+        Vec3 a(first * fOptions.length / (N - 1), 0.0, 0.0);
+        Vec3 b((first + dir.di) * fOptions.length / (N - 1), dir.dj * fOptions.length / (N - 1), 0.0);
+        fStencilRest[d] = (a - b).Magnitude();
+    }
+
+    /* rest lengths of the springs of the owned nodes, and whether they reach into the halo */
+    fRest.Dimension(kNumNeighbours*fLX*fLY);
+    fRest = -1.0;
+    fInterior.Reserve(NumOwned());
+    fFrame.Reserve(NumOwned());
+    for (int j = fJ0; j < fJ1; j++) {
+        for (int i = fI0; i < fI1; i++) {
+            int n = Local(i, j);
+            bool needsHalo = false;
+
+            for (int d = 0; d < kNumNeighbours; d++) {
+                int ii = i + kNeighbourI[d];
+                int jj = j + kNeighbourJ[d];
+                if (ii < 0 || ii >= N || jj < 0 || jj >= N) continue;
+
+                fRest[kNumNeighbours*n + d] = (fPos0[n] - fPos0[Local(ii, jj)]).Magnitude();
+                if (ii < fI0 || ii >= fI1 || jj < fJ0 || jj >= fJ1) needsHalo = true;
+            }
+
+            if (needsHalo) fFrame.Insert(n);
+            else fInterior.Insert(n);
+        }
+    }
+
+    /* one buffer per direction, sized by the exchanged region */
+    for (int dj = -1; dj <= 1; dj++) {
+        for (int di = -1; di <= 1; di++) {
+            int dir = (di + 1) + 3*(dj + 1);
+            int ib, ie, jb, je;
+            SendRange(di, fI0, fI1, ib, ie);
+            SendRange(dj, fJ0, fJ1, jb, je);
+            fSendBuffer[dir].Dimension(3*(ie - ib)*(je - jb));
+            RecvRange(di, fI0, fI1, ib, ie);
+            RecvRange(dj, fJ0, fJ1, jb, je);
+            fRecvBuffer[dir].Dimension(3*(ie - ib)*(je - jb));
+        }
+    }
+}
+
+DistributedCloth::~DistributedCloth() {
+    MPI_Comm_free(&fComm);
+}
+
+void DistributedCloth::SendRange(int d, int first, int last, int& begin, int& end) const {
+    begin = (d > 0) ? last - HALO_WIDTH : first;
+    end = (d < 0) ? first + HALO_WIDTH : last;
+}
+
+void DistributedCloth::RecvRange(int d, int first, int last, int& begin, int& end) const {
+    begin = (d < 0) ? first - HALO_WIDTH : (d > 0) ? last : first;
+    end = (d < 0) ? first : (d > 0) ? last + HALO_WIDTH : last;
+}
+
+void DistributedCloth::StartHaloExchange() {
+
+    int numRequests = 0;
+
+    for (int dir = 0; dir < 9; dir++) {
+        if (dir == 4) continue;
+
+        /* the neighbour in direction dir sends with the tag of the opposite direction */
+        MPI_Irecv(fRecvBuffer[dir].Pointer(), fRecvBuffer[dir].Length(), MPI_DOUBLE, fNeighbours[dir],
+                  8 - dir, fComm, &fRequests[numRequests++]);
+    }
+
+    for (int dir = 0; dir < 9; dir++) {
+        if (dir == 4) continue;
+
+        int ib, ie, jb, je;
+        SendRange(dir % 3 - 1, fI0, fI1, ib, ie);
+        SendRange(dir / 3 - 1, fJ0, fJ1, jb, je);
+
+        double* buffer = fSendBuffer[dir].Pointer();
+        for (int j = jb; j < je; j++) {
+            for (int i = ib; i < ie; i++) {
+                const Vec3& p = fPos[Local(i, j)];
+                *buffer++ = p.x;
+                *buffer++ = p.y;
+                *buffer++ = p.z;
+            }
+        }
+
+        MPI_Isend(fSendBuffer[dir].Pointer(), fSendBuffer[dir].Length(), MPI_DOUBLE, fNeighbours[dir],
+                  dir, fComm, &fRequests[numRequests++]);
+    }
+}
+
+void DistributedCloth::FinishHaloExchange() {
+
+    MPI_Waitall(16, fRequests, MPI_STATUSES_IGNORE);
+
+    for (int dir = 0; dir < 9; dir++) {
+        if (dir == 4 || fNeighbours[dir] == MPI_PROC_NULL) continue;
+
+        int ib, ie, jb, je;
+        RecvRange(dir % 3 - 1, fI0, fI1, ib, ie);
+        RecvRange(dir / 3 - 1, fJ0, fJ1, jb, je);
+
+        const double* buffer = fRecvBuffer[dir].Pointer();
+        for (int j = jb; j < je; j++) {
+            for (int i = ib; i < ie; i++) {
+                Vec3& p = fPos[Local(i, j)];
+                p.x = *buffer++;
+                p.y = *buffer++;
+                p.z = *buffer++;
+            }
+        }
+    }
+}
+
+void DistributedCloth::ComputeForces(const ArrayT<int>& nodes) {
+
+    int N = fOptions.N;
+    Vec3 g = {0, 0, -9.8};      // Earth's gravity vector
+
+    for (int a = 0; a < nodes.Length(); a++) {
+        int n = nodes[a];
+        int i = fI0 + n % fLX - HALO_WIDTH;
+        int j = fJ0 + n / fLX - HALO_WIDTH;
+
+        /* internal forces gathered over the springs of the node, direction by direction as by grid_forces() */
+        Vec3 f_int(0, 0, 0);
+        for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) {
+            const GridDirection& dir = kGridDirections[d];
+            int offset = dir.di + fLX*dir.dj;
+
+            if (i + dir.di >= 0 && i + dir.di < N && j + dir.dj < N)
+                f_int += SpringForce(fPos[n], fPos[n + offset], fStencilRest[d], fOptions.k);
+            if (i - dir.di >= 0 && i - dir.di < N && j - dir.dj >= 0)
+                f_int += SpringForce(fPos[n], fPos[n - offset], fStencilRest[d], fOptions.k);
+        }
+
+        /* the viscous forces and the weight, in the order of ClothNodeForcesT */
+        fForce[n] = f_int + fVel[n]*(-fOptions.c) + g*fOptions.m;
+    }
+}
+
+bool DistributedCloth::Pinned(int i, int j) const {
+
+    /* the fixed corners of main() */
+    int N = fOptions.N;
+    if (j == 0) return i == 0 || i == N-1;
+    return i == 0 && j == N-1 && fTime < fOptions.t_release;
+}
+
+void DistributedCloth::LimitStrain() {
+
+    double maxStrain = fOptions.max_strain;
+
+    for (int it = 0; it < fOptions.strain_iterations; it++) {
+        StartHaloExchange();
+        FinishHaloExchange();
+
+        /* every owned node moves by the average correction of its over-stretched springs */
+        int violations = 0;
+        for (int j = fJ0; j < fJ1; j++) {
+            for (int i = fI0; i < fI1; i++) {
+                int n = Local(i, j);
+                fCorrection[n] = Vec3(0, 0, 0);
+                if (Pinned(i, j)) continue;
+
+                int count = 0;
+                for (int d = 0; d < kNumNeighbours; d++) {
+                    double rest = fRest[kNumNeighbours*n + d];
+                    if (rest < 0.0) continue;
+
+                    double share = Pinned(i + kNeighbourI[d], j + kNeighbourJ[d]) ? 1.0 : 0.5;
+                    Vec3 correction = StrainCorrection(fPos[n], fPos[n + kNeighbourI[d] + fLX*kNeighbourJ[d]],
+                                                       (1.0 + maxStrain)*rest, share);
+                    if (correction.Magnitude() == 0.0) continue;
+
+                    fCorrection[n] += correction;
+                    count++;
+                }
+                if (count > 0) fCorrection[n] = fCorrection[n]*(1.0/count);
+                violations += count;
+            }
+        }
+
+        int total;
+        MPI_Allreduce(&violations, &total, 1, MPI_INT, MPI_SUM, fComm);
+        if (total == 0) break;
+
+        for (int j = fJ0; j < fJ1; j++) {
+            for (int i = fI0; i < fI1; i++) {
+                fPos[Local(i, j)] += fCorrection[Local(i, j)];
+                fVel[Local(i, j)] += fCorrection[Local(i, j)]*(1.0/fOptions.dt);
+            }
+        }
+    }
+}
+
+void DistributedCloth::Step() {
+
+    double dt = fOptions.dt;
+
+    /* interior forces overlap with the halo exchange */
+    StartHaloExchange();
+    ComputeForces(fInterior);
+    FinishHaloExchange();
+    ComputeForces(fFrame);
+
+    /** Verlet Integration scheme on the owned nodes, carrying the velocity of the step as verlet_step() */
+    for (int j = fJ0; j < fJ1; j++) {
+        for (int i = fI0; i < fI1; i++) {
+            int n = Local(i, j);
+            if (Pinned(i, j)) {
+                fVel[n] = Vec3(0, 0, 0);
+                fPos[n] = fPos0[n];
+                continue;
+            }
+
+            Vec3 acc = fForce[n]*(1.0/fOptions.m);
+            fVel[n] = fVel[n] + acc*dt;
+            fPos[n] = fPos[n] + fVel[n]*dt;
+        }
+    }
+
+    /* Provot's deformation constraints, the velocity follows the nodes they move */
+    LimitStrain();
+
+    fTime += dt;
+    fCounter++;
+}
+
+void DistributedCloth::OwnedIndices(ArrayT<int>& ids) const {
+
+    ids.Dimension(NumOwned());
+    int a = 0;
+    for (int j = fJ0; j < fJ1; j++) {
+        for (int i = fI0; i < fI1; i++) {
+            ids[a++] = fOptions.N*j + i;
+        }
+    }
+}
+
+void DistributedCloth::OwnedPositions(ArrayT<Vec3>& pos) const {
+
+    pos.Dimension(NumOwned());
+    int a = 0;
+    for (int j = fJ0; j < fJ1; j++) {
+        for (int i = fI0; i < fI1; i++) {
+            pos[a++] = fPos[Local(i, j)];
+        }
+    }
+}
+
+void DistributedCloth::OwnedForces(ArrayT<Vec3>& force) const {
+
+    force.Dimension(NumOwned());
+    int a = 0;
+    for (int j = fJ0; j < fJ1; j++) {
+        for (int i = fI0; i < fI1; i++) {
+            force[a++] = fForce[Local(i, j)];
+        }
+    }
+}
+
+void DistributedCloth::WriteOutput(const std::string& tag) const {
+
+    ArrayT<int> ids;
+    ArrayT<Vec3> data;
+    OwnedIndices(ids);
+    std::string suffix = "_rank" + std::to_string(fRank) + ".csv";
+
+    OwnedPositions(data);
+    write_csv("pos_" + tag + suffix, data, ids);
+
+    OwnedForces(data);
+    write_csv("force_" + tag + suffix, data, ids);
+}
@@ -0,0 +1,156 @@
+//
+// Batches of independent cloth runs in one process: parameter sweeps on a work-stealing scheduler.
+//
+
+#include "Ensemble.h"
+#include "ClothSimulation.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+/** Cost of an implicit step relative to a Verlet one, for the order of the instances only */
+#define ENSEMBLE_IMPLICIT_WEIGHT 20.0
+
+/** Cost of a single precision step relative to a double one */
+#define ENSEMBLE_FLOAT_WEIGHT 0.8
+
+bool ReadSweep(istream& in, const SimulationOptions& base, vector<SimulationOptions>& instances) {
+
+    /* the options as name and values, in the order of the file */
+    vector<string> names;
+    vector<vector<string> > values;
+
+    string line;
+    int number = 0;
+    while (getline(in, line)) {
+        number++;
+        istringstream words(line);
+        string name, value;
+        if (!(words >> name) || name[0] == '#') continue;
+
+        vector<string> list;
+        while (words >> value) list.push_back(value);
+        if (list.empty()) {
+            cerr << "ERR: sweep line " << number << ": missing value of " << name << "\n";
+            return false;
+        }
+        names.push_back(name);
+        values.push_back(list);
+    }
+
+    /* count through the combinations, the last option fastest */
+    size_t numInstances = 1;
+    for (size_t o = 0; o < values.size(); o++) numInstances *= values[o].size();
+
+    instances.clear();
+    vector<size_t> choice(values.size(), 0);
+    for (size_t i = 0; i < numInstances; i++) {
+
+        vector<string> tokens(1, "sweep");
+        for (size_t o = 0; o < names.size(); o++) {
+            tokens.push_back(names[o]);
+            tokens.push_back(values[o][choice[o]]);
+        }
+        vector<char*> argv;
+        for (size_t t = 0; t < tokens.size(); t++) argv.push_back(&tokens[t][0]);
+
+        SimulationOptions options = base;
+        if (!ParseOptions(int(argv.size()), argv.data(), options)) {
+            cerr << "ERR: invalid sweep instance " << i << "\n";
+            return false;
+        }
+        instances.push_back(options);
+
+        for (size_t o = values.size(); o-- > 0; ) {
+            if (++choice[o] < values[o].size()) break;
+            choice[o] = 0;
+        }
+    }
+    return true;
+}
+
+Ensemble::Ensemble(const vector<SimulationOptions>& instances):
+    fInstances(instances),
+    fResults(instances.size())
+{
+    /* the topology depends on the size only */
+    for (size_t i = 0; i < fInstances.size(); i++) {
+        int N = fInstances[i].N;
+        if (fConnectivity.find(N) == fConnectivity.end()) fConnectivity[N] = ConnectivityStructure(N);
+    }
+}
+
+double Ensemble::Cost(int instance) const {
+
+    const SimulationOptions& options = fInstances[instance];
+
+    double steps = options.t_final/options.dt;
+    double weight = options.integrator == "implicit" ? ENSEMBLE_IMPLICIT_WEIGHT : 1.0;
+    if (options.precision == "float") weight *= ENSEMBLE_FLOAT_WEIGHT;
+    return weight*steps*options.N*options.N;
+}
+
+/* run an instance to t_final in the precision REAL and summarize its final state */
+template <class REAL>
+static void RunToEnd(const SimulationOptions& options, const SpringNetwork& connectivity, EnsembleResult& result) {
+
+    /* serial: the instances are the parallelism */
+    ClothSimulationT<REAL> sim(options, connectivity);
+    if (options.start == "equilibrium") sim.StartFromEquilibrium();
+    while (!sim.Finished()) sim.Step();
+
+    result.steps = sim.Counter();
+
+    const ArrayT<Vec3T<REAL> >& pos = sim.Positions();
+    const ArrayT<Vec3T<REAL> >& vel = sim.Velocities();
+    result.centre = Vec3(0.0, 0.0, 0.0);
+    result.lowest = pos[0].z;
+    result.kinetic = 0.0;
+    for (int n = 0; n < sim.NumNodes(); n++) {
+        Vec3 v(vel[n]);
+        result.centre += Vec3(pos[n]);
+        result.lowest = Min(result.lowest, double(pos[n].z));
+        result.kinetic += 0.5*options.m*v.Dot(v);
+    }
+    result.centre *= 1.0/sim.NumNodes();
+}
+
+void Ensemble::RunInstance(int instance, int thread, ostream& results) {
+
+    const SimulationOptions& options = fInstances[instance];
+    EnsembleResult& result = fResults[instance];
+
+    auto start = chrono::steady_clock::now();
+
+    if (options.precision == "float") RunToEnd<float>(options, fConnectivity.at(options.N), result);
+    else RunToEnd<double>(options, fConnectivity.at(options.N), result);
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.thread = thread;
+
+    /* a whole row at once */
+    ostringstream row;
+    row.precision(10);
+    row << instance << "," << options.N << "," << options.m << "," << options.k << "," << options.c << ","
+        << options.dt << "," << options.integrator << "," << options.precision << "," << options.rsqrt << "," << result.steps << "," << result.seconds << ","
+        << result.thread << "," << result.centre.x << "," << result.centre.y << "," << result.centre.z << ","
+        << result.lowest << "," << result.kinetic << "\n";
+
+    lock_guard<mutex> lock(fOutputMutex);
+    results << row.str();
+    results.flush();
+}
+
+void Ensemble::Run(TaskScheduler& scheduler, ostream& results) {
+
+    results << "instance,N,mass,stiffness,damping,dt,integrator,precision,rsqrt,steps,seconds,thread,"
+            << "centre_x,centre_y,centre_z,lowest_z,kinetic_energy\n";
+
+    ArrayT<double> costs(NumInstances());
+    for (int i = 0; i < NumInstances(); i++) costs[i] = Cost(i);
+
+    scheduler.Run(costs, [&](int instance, int thread) { RunInstance(instance, thread, results); });
+}
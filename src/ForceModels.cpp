@@ -0,0 +1,73 @@
+//
+// Force models of the cloth besides its springs: gravity, viscous drag, wind and the aerodynamic drag
+// and lift of the triangles, all added into one force buffer.
+//
+
+#include "ForceModels.h"
+
+#include <cmath>
+
+Aerodynamics::Aerodynamics():
+    fWind(0.0, 0.0, 0.0),
+    fDensity(0.0),
+    fDrag(0.0),
+    fLift(0.0)
+{ }
+
+Aerodynamics::Aerodynamics(const ArrayT<int>& triangles, const Vec3& wind, double density, double drag, double lift):
+    fTriangles(triangles),
+    fWind(wind),
+    fDensity(density),
+    fDrag(drag),
+    fLift(lift)
+{
+    assert(triangles.Length() % 3 == 0 && density >= 0.0);
+}
+
+template <class REAL>
+void Aerodynamics::Accumulate(const ArrayT<Vec3T<REAL> >& pos, const ArrayT<Vec3T<REAL> >& vel,
+                              ArrayT<Vec3T<REAL> >& force) const {
+
+    PROFILE_SCOPE(kProfileAerodynamics);
+
+    for (int t = 0; t < NumTriangles(); t++) {
+        const int* corner = fTriangles.Pointer(3*t);
+        Vec3 pa(pos[corner[0]]), pb(pos[corner[1]]), pc(pos[corner[2]]);
+
+        /* twice the area along the normal, degenerate triangles feel nothing */
+        Vec3 normal = (pb - pa).Cross(pc - pa);
+        double twiceArea = normal.Magnitude();
+        if (twiceArea == 0.0) continue;
+        normal *= 1.0/twiceArea;
+
+        /* the air relative to the triangle */
+        Vec3 u = fWind - (Vec3(vel[corner[0]]) + Vec3(vel[corner[1]]) + Vec3(vel[corner[2]]))*(1.0/3.0);
+        double speed2 = u.Dot(u);
+        if (speed2 == 0.0) continue;
+        double un = u.Dot(normal);
+
+        /* a third of the drag and of the lift to every corner */
+        double pressure = 0.5*fDensity*0.5*twiceArea*std::sqrt(speed2)*un/3.0;
+        Vec3 across = normal - u*(un/speed2);
+        Vec3T<REAL> share(normal*(pressure*fDrag) + across*(pressure*fLift));
+        for (int v = 0; v < 3; v++) force[corner[v]] += share;
+    }
+}
+
+ArrayT<int> GridTriangles(int N) {
+
+    ArrayT<int> triangles;
+    triangles.Reserve(6*(N - 1)*(N - 1));
+    for (int j = 0; j + 1 < N; j++) {
+        for (int i = 0; i + 1 < N; i++) {
+            int n = N*j + i;
+            int quad[6] = {n, n + 1, n + N + 1, n, n + N + 1, n + N};
+            for (int v = 0; v < 6; v++) triangles.Insert(quad[v]);
+        }
+    }
+    return triangles;
+}
+
+/* the precisions of ClothSimulationT */
+template void Aerodynamics::Accumulate<double>(const ArrayT<Vec3>&, const ArrayT<Vec3>&, ArrayT<Vec3>&) const;
+template void Aerodynamics::Accumulate<float>(const ArrayT<Vec3f>&, const ArrayT<Vec3f>&, ArrayT<Vec3f>&) const;
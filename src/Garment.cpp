@@ -0,0 +1,325 @@
+//
+// Garments: the springs of a triangulated cloth of any shape and the numbering of its nodes.
+//
+
+#include "Garment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+NodeOrder NodeOrderFromName(const std::string& name) {
+
+    if (name == "import") return kImportOrder;
+    if (name == "rcm") return kCuthillMcKee;
+    if (name == "morton") return kMortonOrder;
+    throw std::runtime_error("NodeOrderFromName: unknown node order " + name);
+}
+
+namespace {
+
+/* An edge of a triangle: its end points (a < b), the opposite corner and the cosine of its angle */
+struct EdgeSide {
+    int a;
+    int b;
+    int opposite;
+    double cosine;
+
+    bool operator<(const EdgeSide& other) const {
+        return a < other.a || (a == other.a && b < other.b);
+    };
+};
+
+/* A spring before it is stored: its end points (i < j) and its family */
+struct SpringPair {
+    int i;
+    int j;
+    SpringType type;
+
+    bool operator<(const SpringPair& other) const {
+        if (i != other.i) return i < other.i;
+        if (j != other.j) return j < other.j;
+        return type < other.type;
+    };
+
+    bool operator==(const SpringPair& other) const { return i == other.i && j == other.j; };
+};
+
+}
+
+/* the pair of nodes a and b in order */
+static SpringPair MakePair(int a, int b, SpringType type) {
+    return a < b ? SpringPair{a, b, type} : SpringPair{b, a, type};
+}
+
+SpringNetwork MeshSprings(const TriangleMesh& mesh) {
+
+    /* the three sides of every triangle, sorted so that those of an edge follow each other */
+    std::vector<EdgeSide> sides;
+    sides.reserve(3*mesh.NumTriangles());
+    for (int t = 0; t < mesh.NumTriangles(); t++) {
+        const int* corners = mesh.triangles.Pointer(3*t);
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0]) continue;
+
+        const Vec3& p0 = mesh.vertices[corners[0]];
+        if ((mesh.vertices[corners[1]] - p0).Cross(mesh.vertices[corners[2]] - p0).Magnitude() == 0.0) continue;
+
+        for (int c = 0; c < 3; c++) {
+            int a = corners[(c + 1) % 3];
+            int b = corners[(c + 2) % 3];
+            Vec3 ea = mesh.vertices[a] - mesh.vertices[corners[c]];
+            Vec3 eb = mesh.vertices[b] - mesh.vertices[corners[c]];
+            double cosine = ea.Dot(eb)/(ea.Magnitude()*eb.Magnitude());
+            sides.push_back(EdgeSide{Min(a, b), Max(a, b), corners[c], cosine});
+        }
+    }
+    std::sort(sides.begin(), sides.end());
+
+    /* the springs of every edge and of the corners across it */
+    const double quadCosine = std::cos(QUAD_DIAGONAL_ANGLE*std::acos(-1.0)/180.0);
+    std::vector<SpringPair> pairs;
+    size_t first = 0;
+    while (first < sides.size()) {
+        size_t last = first + 1;
+        while (last < sides.size() && sides[last].a == sides[first].a && sides[last].b == sides[first].b) last++;
+
+        const EdgeSide& one = sides[first];
+        if (last - first == 2) {
+            const EdgeSide& other = sides[first + 1];
+            bool diagonal = one.cosine <= quadCosine && other.cosine <= quadCosine;
+            pairs.push_back(MakePair(one.a, one.b, diagonal ? kShear : kStructural));
+            if (one.opposite != other.opposite)
+                pairs.push_back(MakePair(one.opposite, other.opposite, diagonal ? kShear : kBending));
+        }
+        else pairs.push_back(MakePair(one.a, one.b, kStructural));
+
+        first = last;
+    }
+
+    /* every pair once, an edge of the mesh rather than the spring across another one */
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    SpringNetwork springs(mesh.NumVertices(), int(pairs.size()));
+    for (size_t s = 0; s < pairs.size(); s++) springs.SetSpring(int(s), pairs[s].i, pairs[s].j, pairs[s].type);
+    springs.BuildNodeMap();
+
+    /* springs far apart in a scattered numbering share nodes with many chunks, smaller chunks need fewer
+     * colours; single springs need at most twice the largest number of springs at a node */
+    for (int chunkSize = 512; ; chunkSize /= 2) {
+        try {
+            springs.BuildColouring(chunkSize);
+            break;
+        }
+        catch (const std::runtime_error&) {
+            if (chunkSize == 1) throw;
+        }
+    }
+
+    return springs;
+}
+
+/* the neighbours of every vertex along the edges of the triangles, in CSR form */
+static void MeshNeighbours(const TriangleMesh& mesh, ArrayT<int>& offsets, ArrayT<int>& neighbours) {
+
+    std::vector<std::pair<int, int> > links;
+    links.reserve(6*mesh.NumTriangles());
+    for (int t = 0; t < mesh.NumTriangles(); t++) {
+        for (int c = 0; c < 3; c++) {
+            int a = mesh.triangles[3*t + c];
+            int b = mesh.triangles[3*t + (c + 1) % 3];
+            if (a == b) continue;
+            links.push_back(std::make_pair(a, b));
+            links.push_back(std::make_pair(b, a));
+        }
+    }
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+
+    offsets.Dimension(mesh.NumVertices() + 1);
+    offsets = 0;
+    for (size_t l = 0; l < links.size(); l++) offsets[links[l].first + 1]++;
+    for (int n = 0; n < mesh.NumVertices(); n++) offsets[n + 1] += offsets[n];
+
+    neighbours.Dimension(int(links.size()));
+    for (size_t l = 0; l < links.size(); l++) neighbours[int(l)] = links[l].second;
+}
+
+/* the breadth-first levels from root over the nodes not numbered yet, into level (-1 elsewhere) for
+ * the nodes of reached; returns the depth of the last level */
+static int BreadthFirstLevels(const ArrayT<int>& offsets, const ArrayT<int>& neighbours, const ArrayT<char>& numbered,
+                              int root, ArrayT<int>& level, ArrayT<int>& reached) {
+
+    for (int r = 0; r < reached.Length(); r++) level[reached[r]] = -1;
+    reached.Dimension(0);
+
+    reached.Insert(root);
+    level[root] = 0;
+    int depth = 0;
+    for (int r = 0; r < reached.Length(); r++) {
+        int n = reached[r];
+        depth = level[n];
+        for (int e = offsets[n]; e < offsets[n + 1]; e++) {
+            int m = neighbours[e];
+            if (numbered[m] || level[m] >= 0) continue;
+            level[m] = level[n] + 1;
+            reached.Insert(m);
+        }
+    }
+    return depth;
+}
+
+/* reverse Cuthill-McKee, component by component */
+static ArrayT<int> CuthillMcKeeNumbering(const TriangleMesh& mesh) {
+
+    ArrayT<int> offsets, neighbours;
+    MeshNeighbours(mesh, offsets, neighbours);
+
+    int V = mesh.NumVertices();
+    ArrayT<char> numbered(V);
+    numbered = char(0);
+    ArrayT<int> level(V);
+    level = -1;
+    ArrayT<int> reached, order, next;
+    auto degree = [&](int n) { return offsets[n + 1] - offsets[n]; };
+
+    for (int start = 0; start < V; start++) {
+        if (numbered[start]) continue;
+
+        /* a pseudo-peripheral root: the node of least degree of the last level, while the levels deepen */
+        int root = start;
+        int depth = BreadthFirstLevels(offsets, neighbours, numbered, root, level, reached);
+        for (int attempt = 0; attempt < 8; attempt++) {
+            int candidate = -1;
+            for (int r = 0; r < reached.Length(); r++) {
+                int n = reached[r];
+                if (level[n] == depth && (candidate < 0 || degree(n) < degree(candidate))) candidate = n;
+            }
+            int candidateDepth = BreadthFirstLevels(offsets, neighbours, numbered, candidate, level, reached);
+            if (candidateDepth <= depth) break;
+            root = candidate;
+            depth = candidateDepth;
+        }
+
+        /* the walk, the neighbours of a node by increasing degree */
+        int head = order.Length();
+        order.Insert(root);
+        numbered[root] = 1;
+        for (; head < order.Length(); head++) {
+            int n = order[head];
+            next.Dimension(0);
+            for (int e = offsets[n]; e < offsets[n + 1]; e++) {
+                int m = neighbours[e];
+                if (numbered[m]) continue;
+                numbered[m] = 1;
+                next.Insert(m);
+            }
+            std::sort(next.Pointer(), next.Pointer() + next.Length(), [&](int a, int b) {
+                return degree(a) < degree(b) || (degree(a) == degree(b) && a < b);
+            });
+            for (int m = 0; m < next.Length(); m++) order.Insert(next[m]);
+        }
+    }
+
+    std::reverse(order.Pointer(), order.Pointer() + order.Length());
+    return order;
+}
+
+/* the bits of a 21 bit integer spread to every third bit */
+static uint64_t SpreadBits(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+}
+
+/* along the Z-order curve through the bounding cube of the vertices */
+static ArrayT<int> MortonNumbering(const TriangleMesh& mesh) {
+
+    int V = mesh.NumVertices();
+    ArrayT<int> order(V);
+    if (V == 0) return order;
+
+    Vec3 low = mesh.vertices[0], high = mesh.vertices[0];
+    for (int n = 1; n < V; n++) {
+        const Vec3& p = mesh.vertices[n];
+        low = Vec3(Min(low.x, p.x), Min(low.y, p.y), Min(low.z, p.z));
+        high = Vec3(Max(high.x, p.x), Max(high.y, p.y), Max(high.z, p.z));
+    }
+    double extent = Max(Max(high.x - low.x, high.y - low.y), high.z - low.z);
+    double scale = extent > 0.0 ? double((1 << 21) - 1)/extent : 0.0;
+
+    std::vector<std::pair<uint64_t, int> > keys(V);
+    for (int n = 0; n < V; n++) {
+        Vec3 q = (mesh.vertices[n] - low)*scale;
+        keys[n] = std::make_pair(SpreadBits(uint64_t(q.x)) | SpreadBits(uint64_t(q.y)) << 1 | SpreadBits(uint64_t(q.z)) << 2, n);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    for (int n = 0; n < V; n++) order[n] = keys[n].second;
+    return order;
+}
+
+ArrayT<int> NodeNumbering(const TriangleMesh& mesh, NodeOrder order) {
+
+    if (order == kCuthillMcKee) return CuthillMcKeeNumbering(mesh);
+    if (order == kMortonOrder) return MortonNumbering(mesh);
+
+    ArrayT<int> identity(mesh.NumVertices());
+    for (int n = 0; n < identity.Length(); n++) identity[n] = n;
+    return identity;
+}
+
+TriangleMesh RenumberVertices(const TriangleMesh& mesh, const ArrayT<int>& order) {
+
+    assert(order.Length() == mesh.NumVertices());
+
+    TriangleMesh renumbered;
+    renumbered.vertices.Dimension(mesh.NumVertices());
+    ArrayT<int> newIndex(mesh.NumVertices());
+    for (int n = 0; n < order.Length(); n++) {
+        renumbered.vertices[n] = mesh.vertices[order[n]];
+        newIndex[order[n]] = n;
+    }
+
+    renumbered.triangles.Dimension(mesh.triangles.Length());
+    for (int c = 0; c < mesh.triangles.Length(); c++) renumbered.triangles[c] = newIndex[mesh.triangles[c]];
+    return renumbered;
+}
+
+ArrayT<int> TopNodes(const ArrayT<Vec3>& pos0) {
+
+    ArrayT<int> top;
+    if (pos0.Length() == 0) return top;
+
+    double highest = pos0[0].z, lowest = pos0[0].z;
+    for (int n = 1; n < pos0.Length(); n++) {
+        highest = Max(highest, pos0[n].z);
+        lowest = Min(lowest, pos0[n].z);
+    }
+    double level = highest - GARMENT_PIN_TOLERANCE*(highest - lowest);
+    for (int n = 0; n < pos0.Length(); n++) {
+        if (pos0[n].z >= level) top.Insert(n);
+    }
+    return top;
+}
+
+int Bandwidth(const SpringNetwork& springs) {
+
+    int bandwidth = 0;
+    for (int s = 0; s < springs.NumSprings(); s++) bandwidth = Max(bandwidth, Abs(springs[s].i - springs[s].j));
+    return bandwidth;
+}
+
+double MeanSpringSpan(const SpringNetwork& springs) {
+
+    double span = 0.0;
+    for (int s = 0; s < springs.NumSprings(); s++) span += Abs(springs[s].i - springs[s].j);
+    return springs.NumSprings() > 0 ? span/springs.NumSprings() : 0.0;
+}
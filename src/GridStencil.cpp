@@ -0,0 +1,166 @@
+//
+// Spring forces of the regular N x N grid as a fixed stencil: no spring list, no index lookups.
+//
+
+#include "GridStencil.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <stdexcept>
+
+/* relative difference up to which the springs of a direction count as having the same rest length */
+#define GRID_REST_TOLERANCE 1.0e-12
+
+GridStencil::GridStencil():
+    fN(0),
+    fK(0.0)
+{
+    for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) fRest[d] = 0.0;
+}
+
+void GridStencil::SetRestState(int N, const ArrayT<Vec3>& pos0, double k) {
+
+    assert(N > GRID_REACH && pos0.Length() == N*N);
+
+    fN = N;
+    fK = k;
+
+    for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) {
+        const GridDirection& dir = kGridDirections[d];
+        int first = Max(-dir.di, 0);
+
+        /* the first spring of the direction sets the rest length, all the others have to agree */
+        fRest[d] = (pos0[first] - pos0[N*dir.dj + first + dir.di]).Magnitude();
+        for (int j = 0; j + dir.dj < N; j++) {
+            for (int i = first; i < N - Max(dir.di, 0); i++) {
+                double rest = (pos0[N*j + i] - pos0[N*(j + dir.dj) + i + dir.di]).Magnitude();
+                if (std::fabs(rest - fRest[d]) > GRID_REST_TOLERANCE*fRest[d])
+                    throw std::runtime_error("GridStencil::SetRestState: the grid is not regular");
+            }
+        }
+    }
+}
+
+/* force on node (i, j) of all its springs, the neighbours are checked against the edges of the grid */
+template <class REAL, bool APPROX>
+static inline Vec3T<REAL> EdgeNodeForce(int N, int i, int j, const Vec3T<REAL>* pos, const REAL* rest, REAL k) {
+
+    const Vec3T<REAL>& p = pos[N*j + i];
+    Vec3T<REAL> f(0, 0, 0);
+
+    for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) {
+        const GridDirection& dir = kGridDirections[d];
+
+        int ia = i + dir.di, ja = j + dir.dj;
+        if (ia >= 0 && ia < N && ja < N) f += SpringForceT<REAL, APPROX>(p, pos[N*ja + ia], rest[d], k);
+
+        int ib = i - dir.di, jb = j - dir.dj;
+        if (ib >= 0 && ib < N && jb >= 0) f += SpringForceT<REAL, APPROX>(p, pos[N*jb + ib], rest[d], k);
+    }
+    return f;
+}
+
+/* forces on the nodes of columns [firstColumn, lastColumn) of rows [firstRow, lastRow). With N_FIXED > 0
+ * the size, and with it every neighbour offset, is a compile-time constant */
+template <int N_FIXED, class REAL, bool APPROX>
+static void GridBlock(const GridStencil& stencil, const Vec3T<REAL>* pos, Vec3T<REAL>* force,
+                      int firstColumn, int lastColumn, int firstRow, int lastRow) {
+
+    const int N = N_FIXED > 0 ? N_FIXED : stencil.N();
+    const REAL k = REAL(stencil.Stiffness());
+
+    REAL rest[GRID_NUM_DIRECTIONS];
+    for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) rest[d] = REAL(stencil.Rest(d));
+
+    /* the interior columns of the block */
+    const int first = Max(firstColumn, GRID_REACH);
+    const int last = Min(lastColumn, N - GRID_REACH);
+
+    for (int j = firstRow; j < lastRow; j++) {
+
+        /* rows along the top and bottom edges */
+        if (j < GRID_REACH || j >= N - GRID_REACH) {
+            for (int i = firstColumn; i < lastColumn; i++) force[N*j + i] = EdgeNodeForce<REAL, APPROX>(N, i, j, pos, rest, k);
+            continue;
+        }
+
+        /* columns along the left and right edges */
+        for (int i = firstColumn; i < Min(first, lastColumn); i++)
+            force[N*j + i] = EdgeNodeForce<REAL, APPROX>(N, i, j, pos, rest, k);
+        for (int i = Max(last, firstColumn); i < lastColumn; i++)
+            force[N*j + i] = EdgeNodeForce<REAL, APPROX>(N, i, j, pos, rest, k);
+
+        /* interior: all the twelve neighbours are there */
+        const Vec3T<REAL>* row = pos + N*j;
+        Vec3T<REAL>* rowForce = force + N*j;
+        for (int i = first; i < last; i++) {
+            const Vec3T<REAL>& p = row[i];
+            Vec3T<REAL> f(0, 0, 0);
+
+            #pragma GCC unroll 6
+            for (int d = 0; d < GRID_NUM_DIRECTIONS; d++) {
+                const int offset = N*kGridDirections[d].dj + kGridDirections[d].di;
+                f += SpringForceT<REAL, APPROX>(p, row[i + offset], rest[d], k);
+                f += SpringForceT<REAL, APPROX>(p, row[i - offset], rest[d], k);
+            }
+            rowForce[i] = f;
+        }
+    }
+}
+
+/* the kernel for a block of the size of the stencil */
+template <class REAL, bool APPROX>
+static void GridBlockDispatch(const GridStencil& stencil, const Vec3T<REAL>* pos, Vec3T<REAL>* force,
+                              int firstColumn, int lastColumn, int firstRow, int lastRow) {
+
+    switch (stencil.N()) {
+        case 32: GridBlock<32, REAL, APPROX>(stencil, pos, force, firstColumn, lastColumn, firstRow, lastRow); break;
+        case 64: GridBlock<64, REAL, APPROX>(stencil, pos, force, firstColumn, lastColumn, firstRow, lastRow); break;
+        case 128: GridBlock<128, REAL, APPROX>(stencil, pos, force, firstColumn, lastColumn, firstRow, lastRow); break;
+        case 256: GridBlock<256, REAL, APPROX>(stencil, pos, force, firstColumn, lastColumn, firstRow, lastRow); break;
+        case 512: GridBlock<512, REAL, APPROX>(stencil, pos, force, firstColumn, lastColumn, firstRow, lastRow); break;
+        default: GridBlock<0, REAL, APPROX>(stencil, pos, force, firstColumn, lastColumn, firstRow, lastRow); break;
+    }
+}
+
+template <class REAL, bool APPROX>
+void grid_forces(const GridStencil& stencil, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int) {
+
+    PROFILE_SCOPE(kProfileInternalForces);
+    assert(pos.Length() == stencil.N()*stencil.N() && force_int.Length() == pos.Length());
+
+    GridBlockDispatch<REAL, APPROX>(stencil, pos.Pointer(), force_int.Pointer(), 0, stencil.N(), 0, stencil.N());
+}
+
+template <class REAL, bool APPROX>
+void grid_forces(const GridStencil& stencil, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int,
+                 ThreadPool& pool) {
+
+    PROFILE_SCOPE(kProfileInternalForces);
+    assert(pos.Length() == stencil.N()*stencil.N() && force_int.Length() == pos.Length());
+
+    pool.ParallelFor(0, stencil.N(), [&](int first, int last) {
+        GridBlockDispatch<REAL, APPROX>(stencil, pos.Pointer(), force_int.Pointer(), 0, stencil.N(), first, last);
+    });
+}
+
+template <class REAL, bool APPROX>
+void grid_forces(const GridStencil& stencil, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int,
+                 int firstColumn, int lastColumn, int firstRow, int lastRow) {
+
+    assert(firstColumn >= 0 && lastColumn <= stencil.N() && firstRow >= 0 && lastRow <= stencil.N());
+    GridBlockDispatch<REAL, APPROX>(stencil, pos.Pointer(), force_int.Pointer(), firstColumn, lastColumn, firstRow, lastRow);
+}
+
+/* the precisions and inverse lengths of ClothSimulationT */
+#define INSTANTIATE_GRID_FORCES(REAL, APPROX) \
+    template void grid_forces<REAL, APPROX>(const GridStencil&, const ArrayT<Vec3T<REAL> >&, ArrayT<Vec3T<REAL> >&); \
+    template void grid_forces<REAL, APPROX>(const GridStencil&, const ArrayT<Vec3T<REAL> >&, ArrayT<Vec3T<REAL> >&, \
+                                            ThreadPool&); \
+    template void grid_forces<REAL, APPROX>(const GridStencil&, const ArrayT<Vec3T<REAL> >&, ArrayT<Vec3T<REAL> >&, \
+                                            int, int, int, int);
+
+INSTANTIATE_GRID_FORCES(double, false)
+INSTANTIATE_GRID_FORCES(double, true)
+INSTANTIATE_GRID_FORCES(float, false)
+INSTANTIATE_GRID_FORCES(float, true)
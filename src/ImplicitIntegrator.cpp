@@ -0,0 +1,256 @@
+//
+// Implicit (backward Euler) time integration of the cloth in the style of Baraff & Witkin.
+//
+
+#include "ImplicitIntegrator.h"
+
+#include <algorithm>
+#include <cmath>
+
+/* 3 x 3 blocks in column-major order: entry (r, c) is at [3*c + r] */
+static inline Vec3 BlockTimes(const double* block, const Vec3& x) {
+    return Vec3(block[0]*x.x + block[3]*x.y + block[6]*x.z,
+                block[1]*x.x + block[4]*x.y + block[7]*x.z,
+                block[2]*x.x + block[5]*x.y + block[8]*x.z);
+}
+
+static inline void AddToBlock(double* block, const double* values, double scale) {
+    for (int e = 0; e < 9; e++) block[e] += scale*values[e];
+}
+
+/* inverse of a 3 x 3 block by cofactors. A singular block, e.g. of a node whose springs have no length,
+ * gets the inverse of its diagonal instead, the identity where that is not positive, and false */
+static bool InvertBlock(const double* a, double* inv) {
+
+    inv[0] = a[4]*a[8] - a[7]*a[5];
+    inv[1] = a[7]*a[2] - a[1]*a[8];
+    inv[2] = a[1]*a[5] - a[4]*a[2];
+    inv[3] = a[6]*a[5] - a[3]*a[8];
+    inv[4] = a[0]*a[8] - a[6]*a[2];
+    inv[5] = a[3]*a[2] - a[0]*a[5];
+    inv[6] = a[3]*a[7] - a[6]*a[4];
+    inv[7] = a[6]*a[1] - a[0]*a[7];
+    inv[8] = a[0]*a[4] - a[3]*a[1];
+
+    double det = a[0]*inv[0] + a[3]*inv[1] + a[6]*inv[2];
+    if (std::isfinite(det) && Abs(det) > SINGULAR_BLOCK_TOLERANCE*Abs(a[0]*a[4]*a[8])) {
+        for (int e = 0; e < 9; e++) inv[e] /= det;
+        return true;
+    }
+
+    for (int e = 0; e < 9; e++) inv[e] = 0.0;
+    for (int r = 0; r < 3; r++) {
+        double d = a[4*r];
+        inv[4*r] = (std::isfinite(d) && d > 0.0) ? 1.0/d : 1.0;
+    }
+    return false;
+}
+
+void BlockSparseMatrix::BuildPattern(const SpringNetwork& springs) {
+
+    fNumRows = springs.NumNodes();
+
+    /* columns of each row: the node itself and the other ends of its springs, sorted and unique */
+    fRowOffsets.Dimension(fNumRows + 1);
+    fRowOffsets[0] = 0;
+    fColumns.Dimension(0);
+    fColumns.Reserve(fNumRows + 2*springs.NumSprings());
+    fDiagonal.Dimension(fNumRows);
+
+    vector<int> columns;
+    for (int n = 0; n < fNumRows; n++) {
+        columns.clear();
+        columns.push_back(n);
+        for (int a = 0; a < springs.NumNodeSprings(n); a++) {
+            const Spring& spring = springs[springs.NodeSprings(n)[a]];
+            columns.push_back(spring.i == n ? spring.j : spring.i);
+        }
+        std::sort(columns.begin(), columns.end());
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+        for (size_t c = 0; c < columns.size(); c++) {
+            if (columns[c] == n) fDiagonal[n] = fColumns.Length();
+            fColumns.Insert(columns[c]);
+        }
+        fRowOffsets[n + 1] = fColumns.Length();
+    }
+
+    /* where the off-diagonal blocks of every spring are */
+    fSpringBlocks.Dimension(2*springs.NumSprings());
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        int ends[2] = {springs[s].i, springs[s].j};
+        for (int which = 0; which < 2; which++) {
+            int row = ends[which];
+            int col = ends[1 - which];
+            const int* first = fColumns.Pointer(fRowOffsets[row]);
+            const int* last = fColumns.Pointer(fRowOffsets[row + 1]);
+            fSpringBlocks[2*s + which] = fRowOffsets[row] + int(std::lower_bound(first, last, col) - first);
+        }
+    }
+
+    fBlocks.Dimension(9, fColumns.Length());
+    Zero();
+}
+
+void BlockSparseMatrix::Multiply(const Vec3* x, Vec3* y) const {
+
+    for (int n = 0; n < fNumRows; n++) {
+        Vec3 sum(0, 0, 0);
+        for (int b = fRowOffsets[n]; b < fRowOffsets[n + 1]; b++) {
+            sum += BlockTimes(Block(b), x[fColumns[b]]);
+        }
+        y[n] = sum;
+    }
+}
+
+ImplicitIntegrator::ImplicitIntegrator(const SpringNetwork& springs, double tolerance, int maxIterations):
+    fTolerance(tolerance),
+    fMaxIterations(maxIterations),
+    fIterations(0),
+    fResidual(0.0),
+    fSingularBlocks(0),
+    fTotalIterations(0),
+    fTotalSolves(0),
+    fTotalSingularBlocks(0)
+{
+    fA.BuildPattern(springs);
+    fInvDiagonal.Dimension(9, springs.NumNodes());
+
+    fDv.Dimension(springs.NumNodes());
+    fDv = Vec3(0, 0, 0);
+}
+
+void ImplicitIntegrator::Assemble(const SpringNetwork& springs, double m, double c, double dt,
+                                  const ArrayT<Vec3>& forces, const ArrayT<Vec3>& pos, const ArrayT<Vec3>& vel,
+                                  Vec3* rhs) {
+
+    fA.Zero();
+
+    /* J v0 is accumulated in rhs */
+    for (int n = 0; n < fA.NumRows(); n++) rhs[n] = Vec3(0, 0, 0);
+
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+
+        Vec3 d = pos[spring.i] - pos[spring.j];
+        double length = d.Magnitude();
+        Vec3 u = d*(1.0/length);
+
+        double k = spring.k;
+
+        /* df_i/dx_i = -k (u u^T + (1 - rest/length) (I - u u^T)), the transverse part is dropped
+         * for compressed springs */
+        double transverse = Max(1.0 - spring.rest/length, 0.0);
+        double uu[3] = {u.x, u.y, u.z};
+        double K[9];
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                double outer = uu[row]*uu[col];
+                K[3*col + row] = -k*(outer + transverse*((row == col ? 1.0 : 0.0) - outer));
+            }
+        }
+
+        /* A = M - dt^2 J: J_ii = J_jj = K, J_ij = J_ji = -K */
+        AddToBlock(fA.Block(fA.DiagonalBlock(spring.i)), K, -dt*dt);
+        AddToBlock(fA.Block(fA.DiagonalBlock(spring.j)), K, -dt*dt);
+        AddToBlock(fA.Block(fA.SpringBlock(s, 0)), K, dt*dt);
+        AddToBlock(fA.Block(fA.SpringBlock(s, 1)), K, dt*dt);
+
+        Vec3 Kdv = BlockTimes(K, vel[spring.i] - vel[spring.j]);
+        rhs[spring.i] += Kdv;
+        rhs[spring.j] -= Kdv;
+    }
+
+    /* mass and drag: df/dv = -c I */
+    double mass[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    fSingularBlocks = 0;
+    for (int n = 0; n < fA.NumRows(); n++) {
+        double* diagonal = fA.Block(fA.DiagonalBlock(n));
+        AddToBlock(diagonal, mass, m + dt*c);
+        if (!InvertBlock(diagonal, fInvDiagonal(n))) fSingularBlocks++;
+
+        /* rhs = dt (f0 + dt J v0) */
+        rhs[n] = (forces[n] + rhs[n]*dt)*dt;
+    }
+    fTotalSingularBlocks += fSingularBlocks;
+}
+
+void ImplicitIntegrator::Solve(const Vec3* rhs, const char* fixed) {
+
+    int numNodes = fA.NumRows();
+    ArrayT<Vec3, ArenaAllocator<Vec3> > r(numNodes), z(numNodes), p(numNodes), Ap(numNodes);
+
+    /* filtered preconditioned conjugate gradient, warm started from the dv of the previous step */
+    for (int n = 0; n < numNodes; n++) {
+        if (fixed[n]) fDv[n] = Vec3(0, 0, 0);
+    }
+    fA.Multiply(fDv.Pointer(), Ap.Pointer());
+
+    double rz = 0.0;
+    double rhsNorm = 0.0;
+    for (int n = 0; n < numNodes; n++) {
+        r[n] = fixed[n] ? Vec3(0, 0, 0) : rhs[n] - Ap[n];
+        z[n] = BlockTimes(fInvDiagonal(n), r[n]);
+        p[n] = z[n];
+        rz += r[n].Dot(z[n]);
+        if (!fixed[n]) rhsNorm += rhs[n].Dot(rhs[n]);
+    }
+    rhsNorm = sqrt(rhsNorm);
+
+    fIterations = 0;
+    fResidual = 0.0;
+    fTotalSolves++;
+    if (rhsNorm == 0.0) fDv = Vec3(0, 0, 0);
+
+    /* nothing to solve for without a load, or once the warm start leaves no residual */
+    while (rhsNorm > 0.0 && rz > 0.0 && fIterations < fMaxIterations) {
+        fA.Multiply(p.Pointer(), Ap.Pointer());
+
+        double pAp = 0.0;
+        for (int n = 0; n < numNodes; n++) {
+            if (fixed[n]) Ap[n] = Vec3(0, 0, 0);
+            pAp += p[n].Dot(Ap[n]);
+        }
+        double alpha = rz/pAp;
+
+        double residual = 0.0;
+        for (int n = 0; n < numNodes; n++) {
+            fDv[n] += p[n]*alpha;
+            r[n] -= Ap[n]*alpha;
+            residual += r[n].Dot(r[n]);
+        }
+        fIterations++;
+        fResidual = sqrt(residual)/rhsNorm;
+        if (fResidual <= fTolerance) break;
+
+        double rzNew = 0.0;
+        for (int n = 0; n < numNodes; n++) {
+            z[n] = BlockTimes(fInvDiagonal(n), r[n]);
+            rzNew += r[n].Dot(z[n]);
+        }
+        double beta = rzNew/rz;
+        rz = rzNew;
+
+        p = z + beta*p;
+    }
+
+    fTotalIterations += fIterations;
+}
+
+void ImplicitIntegrator::Step(const SpringNetwork& springs, double m, double c, double dt, const ArrayT<Vec3>& forces,
+                              const ArrayT<int>& pinned, ArrayT<Vec3>& pos, ArrayT<Vec3>& vel) {
+
+    ArrayT<char, ArenaAllocator<char> > fixed(pos.Length());
+    fixed = char(0);
+    for (int p = 0; p < pinned.Length(); p++) {
+        fixed[pinned[p]] = 1;
+    }
+
+    ArrayT<Vec3, ArenaAllocator<Vec3> > rhs(pos.Length());
+    Assemble(springs, m, c, dt, forces, pos, vel, rhs.Pointer());
+    Solve(rhs.Pointer(), fixed.Pointer());
+
+    /* v1 = v0 + dv, x1 = x0 + dt v1 */
+    vel = vel + fDv;
+    pos = pos + dt*vel;
+}
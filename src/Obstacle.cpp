@@ -0,0 +1,391 @@
+//
+// Static obstacles: the nodes of the cloth against a triangle mesh, through a bounding volume hierarchy.
+//
+
+#include "Obstacle.h"
+
+#include <algorithm>
+#include <atomic>
+
+/* surface area of a box, for the heuristic */
+static double Area(const Vec3& low, const Vec3& high) {
+    Vec3 d = high - low;
+    return 2.0*(d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+static double Component(const Vec3& v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static void Grow(Vec3& low, Vec3& high, const Vec3& lowOther, const Vec3& highOther) {
+    low = Vec3(Min(low.x, lowOther.x), Min(low.y, lowOther.y), Min(low.z, lowOther.z));
+    high = Vec3(Max(high.x, highOther.x), Max(high.y, highOther.y), Max(high.z, highOther.z));
+}
+
+/* squared distance from p to the box, 0 inside */
+static double BoxDistance2(const Vec3& low, const Vec3& high, const Vec3& p) {
+    double dx = Max(Max(low.x - p.x, p.x - high.x), 0.0);
+    double dy = Max(Max(low.y - p.y, p.y - high.y), 0.0);
+    double dz = Max(Max(low.z - p.z, p.z - high.z), 0.0);
+    return dx*dx + dy*dy + dz*dz;
+}
+
+/* whether the segment from + t d, t in [0, tMax], meets the box (slabs) */
+static bool SegmentHitsBox(const Vec3& low, const Vec3& high, const Vec3& from, const Vec3& d, double tMax) {
+    double t0 = 0.0, t1 = tMax;
+    for (int axis = 0; axis < 3; axis++) {
+        double o = Component(from, axis), v = Component(d, axis);
+        double l = Component(low, axis), h = Component(high, axis);
+        if (v == 0.0) {
+            if (o < l || o > h) return false;
+            continue;
+        }
+        double ta = (l - o)/v, tb = (h - o)/v;
+        t0 = Max(t0, Min(ta, tb));
+        t1 = Min(t1, Max(ta, tb));
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+/* the point of triangle a, a + ab, a + ac closest to p (Ericson, Real-Time Collision Detection 5.1.5) */
+static Vec3 ClosestOnTriangle(const Vec3& p, const Vec3& a, const Vec3& ab, const Vec3& ac) {
+
+    Vec3 ap = p - a;
+    double d1 = ab.Dot(ap), d2 = ac.Dot(ap);
+    if (d1 <= 0.0 && d2 <= 0.0) return a;
+
+    Vec3 bp = ap - ab;
+    double d3 = ab.Dot(bp), d4 = ac.Dot(bp);
+    if (d3 >= 0.0 && d4 <= d3) return a + ab;
+
+    double vc = d1*d4 - d3*d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) return a + ab*(d1/(d1 - d3));
+
+    Vec3 cp = ap - ac;
+    double d5 = ab.Dot(cp), d6 = ac.Dot(cp);
+    if (d6 >= 0.0 && d5 <= d6) return a + ac;
+
+    double vb = d5*d2 - d1*d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) return a + ac*(d2/(d2 - d6));
+
+    double va = d3*d6 - d5*d4;
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) {
+        double w = (d4 - d3)/((d4 - d3) + (d5 - d6));
+        return a + ab + (ac - ab)*w;
+    }
+
+    double denominator = 1.0/(va + vb + vc);
+    return a + ab*(vb*denominator) + ac*(vc*denominator);
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(const TriangleMesh& mesh):
+    fDepth(0)
+{
+    int numTriangles = mesh.NumTriangles();
+    assert(numTriangles > 0);
+
+    ArrayT<Vec3> centroids(numTriangles), lows(numTriangles), highs(numTriangles);
+    ArrayT<int> order(numTriangles);
+    for (int t = 0; t < numTriangles; t++) {
+        const Vec3& a = mesh.vertices[mesh.triangles[3*t]];
+        const Vec3& b = mesh.vertices[mesh.triangles[3*t + 1]];
+        const Vec3& c = mesh.vertices[mesh.triangles[3*t + 2]];
+        centroids[t] = (a + b + c)*(1.0/3.0);
+        lows[t] = a;
+        highs[t] = a;
+        Grow(lows[t], highs[t], b, b);
+        Grow(lows[t], highs[t], c, c);
+        order[t] = t;
+    }
+
+    fNodes.Reserve(2*numTriangles);
+    Build(order, 0, numTriangles, centroids, lows, highs, 1);
+
+    /* the triangles in the order of the leaves */
+    fTriangles.Dimension(numTriangles);
+    for (int s = 0; s < numTriangles; s++) {
+        int t = order[s];
+        const Vec3& a = mesh.vertices[mesh.triangles[3*t]];
+        Triangle& triangle = fTriangles[s];
+        triangle.a = a;
+        triangle.ab = mesh.vertices[mesh.triangles[3*t + 1]] - a;
+        triangle.ac = mesh.vertices[mesh.triangles[3*t + 2]] - a;
+        Vec3 normal = triangle.ab.Cross(triangle.ac);
+        double length = normal.Magnitude();
+        triangle.normal = length > 0.0 ? normal*(1.0/length) : Vec3(0.0, 0.0, 0.0);
+        triangle.index = t;
+    }
+}
+
+int BoundingVolumeHierarchy::Build(ArrayT<int>& order, int first, int last, const ArrayT<Vec3>& centroids,
+                                   const ArrayT<Vec3>& lows, const ArrayT<Vec3>& highs, int depth) {
+
+    int node = fNodes.Length();
+    fNodes.Insert(Node());
+    fDepth = Max(fDepth, depth);
+
+    /* the box of the triangles and that of their centroids */
+    Vec3 low = lows[order[first]], high = highs[order[first]];
+    Vec3 centroidLow = centroids[order[first]], centroidHigh = centroidLow;
+    for (int s = first + 1; s < last; s++) {
+        Grow(low, high, lows[order[s]], highs[order[s]]);
+        Grow(centroidLow, centroidHigh, centroids[order[s]], centroids[order[s]]);
+    }
+    fNodes[node].low = low;
+    fNodes[node].high = high;
+    fNodes[node].first = first;
+    fNodes[node].count = last - first;
+
+    int count = last - first;
+    if (count <= BVH_LEAF_SIZE || depth + 1 >= BVH_STACK_DEPTH) return node;
+
+    /* the cheapest plane between the bins of the centroids: area times triangles on either side */
+    double bestCost = -1.0;
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        double origin = Component(centroidLow, axis);
+        double extent = Component(centroidHigh, axis) - origin;
+        if (extent <= 0.0) continue;
+
+        int binCount[BVH_BINS] = {0};
+        Vec3 binLow[BVH_BINS], binHigh[BVH_BINS];
+        for (int s = first; s < last; s++) {
+            int t = order[s];
+            int b = Min(int(BVH_BINS*(Component(centroids[t], axis) - origin)/extent), BVH_BINS - 1);
+            if (binCount[b] == 0) {
+                binLow[b] = lows[t];
+                binHigh[b] = highs[t];
+            }
+            else Grow(binLow[b], binHigh[b], lows[t], highs[t]);
+            binCount[b]++;
+        }
+
+        /* the areas and counts left of every plane, then right of it */
+        double leftArea[BVH_BINS];
+        int leftCount[BVH_BINS];
+        Vec3 sideLow, sideHigh;
+        int side = 0;
+        for (int b = 0; b + 1 < BVH_BINS; b++) {
+            if (binCount[b] > 0) {
+                if (side == 0) {
+                    sideLow = binLow[b];
+                    sideHigh = binHigh[b];
+                }
+                else Grow(sideLow, sideHigh, binLow[b], binHigh[b]);
+                side += binCount[b];
+            }
+            leftCount[b] = side;
+            leftArea[b] = side > 0 ? Area(sideLow, sideHigh) : 0.0;
+        }
+        side = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--) {
+            if (binCount[b] > 0) {
+                if (side == 0) {
+                    sideLow = binLow[b];
+                    sideHigh = binHigh[b];
+                }
+                else Grow(sideLow, sideHigh, binLow[b], binHigh[b]);
+                side += binCount[b];
+            }
+            if (leftCount[b - 1] == 0 || side == 0) continue;
+            double cost = leftArea[b - 1]*leftCount[b - 1] + Area(sideLow, sideHigh)*side;
+            if (bestAxis < 0 || cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    /* all centroids in one point: a leaf, however large */
+    if (bestAxis < 0) return node;
+
+    double origin = Component(centroidLow, bestAxis);
+    double extent = Component(centroidHigh, bestAxis) - origin;
+    int* middle = std::partition(order.Pointer(first), order.Pointer() + last, [&](int t) {
+        return Min(int(BVH_BINS*(Component(centroids[t], bestAxis) - origin)/extent), BVH_BINS - 1) < bestSplit;
+    });
+    int split = int(middle - order.Pointer());
+
+    Build(order, first, split, centroids, lows, highs, depth + 1);
+    int second = Build(order, split, last, centroids, lows, highs, depth + 1);
+    fNodes[node].first = second;
+    fNodes[node].count = 0;
+    return node;
+}
+
+bool BoundingVolumeHierarchy::Closest(const Vec3& p, double radius, Vec3& closest, int& triangle,
+                                      double& distance) const {
+
+    double best = radius*radius;
+    bool found = false;
+
+    int stack[BVH_STACK_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int n = stack[--top];
+        const Node& node = fNodes[n];
+        if (BoxDistance2(node.low, node.high, p) >= best) continue;
+
+        if (node.count > 0) {
+            for (int s = node.first; s < node.first + node.count; s++) {
+                const Triangle& candidate = fTriangles[s];
+                Vec3 q = ClosestOnTriangle(p, candidate.a, candidate.ab, candidate.ac);
+                Vec3 d = p - q;
+                double d2 = d.Dot(d);
+                if (d2 < best) {
+                    best = d2;
+                    closest = q;
+                    triangle = s;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        /* the nearer child is popped first */
+        int left = n + 1, right = node.first;
+        double dLeft = BoxDistance2(fNodes[left].low, fNodes[left].high, p);
+        double dRight = BoxDistance2(fNodes[right].low, fNodes[right].high, p);
+        if (dLeft > dRight) {
+            std::swap(left, right);
+            std::swap(dLeft, dRight);
+        }
+        if (dRight < best) stack[top++] = right;
+        if (dLeft < best) stack[top++] = left;
+    }
+
+    if (found) distance = sqrt(best);
+    return found;
+}
+
+bool BoundingVolumeHierarchy::FirstHit(const Vec3& from, const Vec3& to, int& triangle, double& t) const {
+
+    Vec3 d = to - from;
+    double best = 1.0;
+    bool found = false;
+
+    int stack[BVH_STACK_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int n = stack[--top];
+        const Node& node = fNodes[n];
+        if (!SegmentHitsBox(node.low, node.high, from, d, best)) continue;
+
+        if (node.count > 0) {
+            /* Moller-Trumbore */
+            for (int s = node.first; s < node.first + node.count; s++) {
+                const Triangle& candidate = fTriangles[s];
+                Vec3 pvec = d.Cross(candidate.ac);
+                double det = candidate.ab.Dot(pvec);
+                if (det == 0.0) continue;
+                double inverse = 1.0/det;
+                Vec3 tvec = from - candidate.a;
+                double u = tvec.Dot(pvec)*inverse;
+                if (u < 0.0 || u > 1.0) continue;
+                Vec3 qvec = tvec.Cross(candidate.ab);
+                double v = d.Dot(qvec)*inverse;
+                if (v < 0.0 || u + v > 1.0) continue;
+                double hit = candidate.ac.Dot(qvec)*inverse;
+                if (hit >= 0.0 && hit <= best) {
+                    best = hit;
+                    triangle = s;
+                    found = true;
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.first;
+        stack[top++] = n + 1;
+    }
+
+    if (found) t = best;
+    return found;
+}
+
+Obstacle::Obstacle(const TriangleMesh& mesh, double thickness):
+    fBVH(mesh),
+    fThickness(thickness),
+    fContacts(0),
+    fTotalContacts(0)
+{
+    assert(thickness > 0.0);
+}
+
+bool Obstacle::Resolve(const Vec3& prev, Vec3& pos) const {
+
+    bool moved = false;
+    int triangle;
+
+    /* back to where the step went through the mesh, on the side it came from */
+    double t;
+    if (fBVH.FirstHit(prev, pos, triangle, t)) {
+        Vec3 hit = prev + (pos - prev)*t;
+        Vec3 normal = fBVH.Normal(triangle);
+        if (normal.Dot(prev - hit) < 0.0) normal *= -1.0;
+        pos = hit + normal*fThickness;
+        moved = true;
+    }
+
+    /* out of the layer of the thickness around the mesh */
+    Vec3 closest;
+    double distance;
+    if (fBVH.Closest(pos, fThickness, closest, triangle, distance)) {
+        Vec3 away = pos - closest;
+        if (distance > 0.0) pos = closest + away*(fThickness/distance);
+        else {
+            Vec3 normal = fBVH.Normal(triangle);
+            if (normal.Dot(prev - closest) < 0.0) normal *= -1.0;
+            pos = closest + normal*fThickness;
+        }
+        moved = true;
+    }
+    return moved;
+}
+
+template <class REAL>
+int Obstacle::Apply(const ArrayT<Vec3T<REAL> >& prev, const ArrayT<int>& pinned, ArrayT<Vec3T<REAL> >& pos,
+                    ThreadPool* pool, const ArrayT<char>* asleep, ArrayT<Vec3T<REAL> >* vel, double dt) {
+
+    assert(prev.Length() == pos.Length());
+    assert(!vel || (vel->Length() == pos.Length() && dt > 0.0));
+    double inverseDt = vel ? 1.0/dt : 0.0;
+
+    ArrayT<char, ArenaAllocator<char> > fixed(pos.Length());
+    if (asleep) {
+        for (int n = 0; n < pos.Length(); n++) fixed[n] = (*asleep)[n];
+    }
+    else fixed = char(0);
+    for (int p = 0; p < pinned.Length(); p++) fixed[pinned[p]] = 1;
+
+    /* every node on its own, the mesh does not move */
+    std::atomic<int> contacts(0);
+    auto nodes = [&](int first, int last) {
+        int moved = 0;
+        for (int n = first; n < last; n++) {
+            if (fixed[n]) continue;
+            Vec3 p(pos[n]);
+            if (Resolve(Vec3(prev[n]), p)) {
+                if (vel) (*vel)[n] += Vec3T<REAL>((p - Vec3(pos[n]))*inverseDt);
+                pos[n] = Vec3T<REAL>(p);
+                moved++;
+            }
+        }
+        contacts += moved;
+    };
+    if (pool) pool->ParallelFor(0, pos.Length(), nodes);
+    else nodes(0, pos.Length());
+
+    fContacts = contacts;
+    fTotalContacts += fContacts;
+    return fContacts;
+}
+
+/* the precisions of ClothSimulationT */
+template int Obstacle::Apply(const ArrayT<Vec3>&, const ArrayT<int>&, ArrayT<Vec3>&, ThreadPool*, const ArrayT<char>*,
+                             ArrayT<Vec3>*, double);
+template int Obstacle::Apply(const ArrayT<Vec3f>&, const ArrayT<int>&, ArrayT<Vec3f>&, ThreadPool*, const ArrayT<char>*,
+                             ArrayT<Vec3f>*, double);
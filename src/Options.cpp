@@ -0,0 +1,314 @@
+//
+// Run parameters of the simulator and their command line.
+//
+
+#include "Options.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+void PrintUsage(ostream& out, const char* program) {
+
+    SimulationOptions defaults;
+
+    out << "usage: " << program << " [options]\n"
+        << "  --N <int>            nodes per side of the cloth (" << defaults.N << ")\n"
+        << "  --length <real>      side length of the cloth (" << defaults.length << ")\n"
+        << "  --garment <file>     OBJ or PLY mesh of the cloth instead of the grid, none if empty\n"
+        << "  --node_order <name>  import, rcm or morton numbering of the nodes of a garment (" << defaults.node_order << ")\n"
+        << "  --mass <real>        nodal mass (" << defaults.m << ")\n"
+        << "  --stiffness <real>   spring stiffness (" << defaults.k << ")\n"
+        << "  --damping <real>     viscous coefficient (" << defaults.c << ")\n"
+        << "  --dt <real>          time step (" << defaults.dt << ")\n"
+        << "  --t_final <real>     end time (" << defaults.t_final << ")\n"
+        << "  --dt_control <name>  fixed or adaptive steps, dt is then the first one (" << defaults.dt_control << ")\n"
+        << "  --dt_min <real>      smallest adaptive step (" << defaults.dt_min << ")\n"
+        << "  --dt_max <real>      largest adaptive step (" << defaults.dt_max << ")\n"
+        << "  --dt_tol <real>      position error allowed per adaptive step (" << defaults.dt_tolerance << ")\n"
+        << "  --dt_safety <real>   fraction of the stability limit taken by adaptive verlet steps (" << defaults.dt_safety << ")\n"
+        << "  --integrator <name>  verlet or implicit (" << defaults.integrator << ")\n"
+        << "  --cg_tol <real>      relative residual of the implicit solve (" << defaults.cg_tolerance << ")\n"
+        << "  --cg_iter <int>      iterations of the implicit solve (" << defaults.cg_iterations << ")\n"
+        << "  --precision <name>   double or float, float with the verlet integrator only (" << defaults.precision << ")\n"
+        << "  --rsqrt <name>       exact or approx inverse spring lengths (" << defaults.rsqrt << ")\n"
+        << "  --spring_kernel <name> stencil, edges or auto, the stencil unless a garment is given (" << defaults.spring_kernel << ")\n"
+        << "  --max_strain <real>  largest elongation left by the strain limiting (" << defaults.max_strain << ")\n"
+        << "  --strain_iter <int>  strain limiting sweeps per step, 0 to disable (" << defaults.strain_iterations << ")\n"
+        << "  --strain_sweep <name> gauss-seidel or jacobi (" << defaults.strain_sweep << ")\n"
+        << "  --collision <name>   off or on, self-collision of the nodes with the triangles (" << defaults.collision << ")\n"
+        << "  --collision_thickness <real> least distance of the nodes to the triangles, in grid spacings (" << defaults.collision_thickness << ")\n"
+        << "  --obstacle <file>    OBJ mesh the cloth collides with, none if empty\n"
+        << "  --obstacle_thickness <real> least distance of the nodes to the obstacle, in grid spacings (" << defaults.obstacle_thickness << ")\n"
+        << "  --wind <x,y,z>       velocity of the air (" << defaults.wind_x << "," << defaults.wind_y << "," << defaults.wind_z << ")\n"
+        << "  --wind_drag <real>   drag of every node towards the velocity of the air, 0 to disable it (" << defaults.wind_drag << ")\n"
+        << "  --air_density <real> for the drag and lift of the triangles, 0 to disable them (" << defaults.air_density << ")\n"
+        << "  --drag_coeff <real>  aerodynamic drag coefficient of the triangles (" << defaults.drag_coefficient << ")\n"
+        << "  --lift_coeff <real>  aerodynamic lift coefficient of the triangles (" << defaults.lift_coefficient << ")\n"
+        << "  --sleep_tile <int>   side of the sleeping tiles in nodes, 0 to disable them (" << defaults.sleep_tile << ")\n"
+        << "  --sleep_disp <real>  displacement per step below which a tile is quiet (" << defaults.sleep_displacement << ")\n"
+        << "  --sleep_force <real> residual force below which a tile is quiet, less than the nodal weight (" << defaults.sleep_force << ")\n"
+        << "  --sleep_steps <int>  quiet steps before a tile sleeps (" << defaults.sleep_steps << ")\n"
+        << "  --activity <file>    fraction of active nodes at every output (" << defaults.activity << ")\n"
+        << "  --t_release <real>   time at which the third corner is let go (" << defaults.t_release << ")\n"
+        << "  --start <name>       rest or equilibrium, which skips the hanging phase (" << defaults.start << ")\n"
+        << "  --newton_tol <real>  residual force of the equilibrium relative to the nodal weight (" << defaults.newton_tolerance << ")\n"
+        << "  --newton_iter <int>  newton steps of the equilibrium (" << defaults.newton_iterations << ")\n"
+        << "  --output <file>      trajectory of the snapshots (" << defaults.output << ")\n"
+        << "  --output_interval <real> time between snapshots (" << defaults.output_interval << ")\n"
+        << "  --output_buffers <int> snapshots queued for the writer thread (" << defaults.output_buffers << ")\n"
+        << "  --checkpoint <file>  checkpoint of the complete state (" << defaults.checkpoint << ")\n"
+        << "  --checkpoint_interval <real> time between checkpoints, 0 for the end of the run only (" << defaults.checkpoint_interval << ")\n"
+        << "  --restart <file>     resume from a checkpoint, the options given as well override its own\n"
+        << "  --threads <int>      threads of the force stage, 0 for all cores (" << defaults.threads << ")\n"
+        << "  --help               print this message\n";
+}
+
+bool ParseOptions(int argc, char* argv[], SimulationOptions& options) {
+
+    for (int a = 1; a < argc; a++) {
+        string name = argv[a];
+
+        if (name == "--help" || name == "-h") {
+            PrintUsage(cout, argv[0]);
+            return false;
+        }
+
+        /* all the other options take a value */
+        if (a + 1 >= argc) {
+            cerr << "ERR: missing value of " << name << "\n";
+            PrintUsage(cerr, argv[0]);
+            return false;
+        }
+        const char* value = argv[++a];
+
+        if (name == "--N") options.N = atoi(value);
+        else if (name == "--length") options.length = atof(value);
+        else if (name == "--garment") options.garment = value;
+        else if (name == "--node_order") options.node_order = value;
+        else if (name == "--mass") options.m = atof(value);
+        else if (name == "--stiffness") options.k = atof(value);
+        else if (name == "--damping") options.c = atof(value);
+        else if (name == "--dt") options.dt = atof(value);
+        else if (name == "--t_final") options.t_final = atof(value);
+        else if (name == "--dt_control") options.dt_control = value;
+        else if (name == "--dt_min") options.dt_min = atof(value);
+        else if (name == "--dt_max") options.dt_max = atof(value);
+        else if (name == "--dt_tol") options.dt_tolerance = atof(value);
+        else if (name == "--dt_safety") options.dt_safety = atof(value);
+        else if (name == "--integrator") options.integrator = value;
+        else if (name == "--cg_tol") options.cg_tolerance = atof(value);
+        else if (name == "--cg_iter") options.cg_iterations = atoi(value);
+        else if (name == "--precision") options.precision = value;
+        else if (name == "--rsqrt") options.rsqrt = value;
+        else if (name == "--spring_kernel") options.spring_kernel = value;
+        else if (name == "--max_strain") options.max_strain = atof(value);
+        else if (name == "--strain_iter") options.strain_iterations = atoi(value);
+        else if (name == "--strain_sweep") options.strain_sweep = value;
+        else if (name == "--collision") options.collision = value;
+        else if (name == "--collision_thickness") options.collision_thickness = atof(value);
+        else if (name == "--obstacle") options.obstacle = value;
+        else if (name == "--obstacle_thickness") options.obstacle_thickness = atof(value);
+        else if (name == "--wind") {
+            if (sscanf(value, "%lf,%lf,%lf", &options.wind_x, &options.wind_y, &options.wind_z) != 3) {
+                cerr << "ERR: need --wind x,y,z\n";
+                return false;
+            }
+        }
+        else if (name == "--wind_drag") options.wind_drag = atof(value);
+        else if (name == "--air_density") options.air_density = atof(value);
+        else if (name == "--drag_coeff") options.drag_coefficient = atof(value);
+        else if (name == "--lift_coeff") options.lift_coefficient = atof(value);
+        else if (name == "--sleep_tile") options.sleep_tile = atoi(value);
+        else if (name == "--sleep_disp") options.sleep_displacement = atof(value);
+        else if (name == "--sleep_force") options.sleep_force = atof(value);
+        else if (name == "--sleep_steps") options.sleep_steps = atoi(value);
+        else if (name == "--activity") options.activity = value;
+        else if (name == "--t_release") options.t_release = atof(value);
+        else if (name == "--start") options.start = value;
+        else if (name == "--newton_tol") options.newton_tolerance = atof(value);
+        else if (name == "--newton_iter") options.newton_iterations = atoi(value);
+        else if (name == "--output") options.output = value;
+        else if (name == "--output_interval") options.output_interval = atof(value);
+        else if (name == "--output_buffers") options.output_buffers = atoi(value);
+        else if (name == "--checkpoint") options.checkpoint = value;
+        else if (name == "--checkpoint_interval") options.checkpoint_interval = atof(value);
+        else if (name == "--restart") options.restart = value;
+        else if (name == "--threads") options.threads = atoi(value);
+        else {
+            cerr << "ERR: unknown option " << name << "\n";
+            PrintUsage(cerr, argv[0]);
+            return false;
+        }
+    }
+
+    if (options.N < 3 || options.dt <= 0.0 || options.m <= 0.0 || options.threads < 0 || options.output_buffers < 1) {
+        cerr << "ERR: need N >= 3, dt > 0, mass > 0, threads >= 0 and output_buffers >= 1\n";
+        return false;
+    }
+
+    if ((options.dt_control != "fixed" && options.dt_control != "adaptive") || options.dt_min <= 0.0 ||
+        options.dt_max < options.dt_min || options.dt_tolerance <= 0.0 || options.dt_safety <= 0.0) {
+        cerr << "ERR: need dt_control fixed or adaptive, 0 < dt_min <= dt_max, dt_tol > 0 and dt_safety > 0\n";
+        return false;
+    }
+    if (options.output_interval <= 0.0) {
+        cerr << "ERR: need output_interval > 0\n";
+        return false;
+    }
+    if (options.integrator != "verlet" && options.integrator != "implicit") {
+        cerr << "ERR: unknown integrator " << options.integrator << "\n";
+        return false;
+    }
+    if (options.cg_tolerance <= 0.0 || options.cg_iterations < 1) {
+        cerr << "ERR: need cg_tol > 0 and cg_iter >= 1\n";
+        return false;
+    }
+    if ((options.precision != "double" && options.precision != "float") ||
+        (options.rsqrt != "exact" && options.rsqrt != "approx")) {
+        cerr << "ERR: need precision double or float and rsqrt exact or approx\n";
+        return false;
+    }
+    if (options.spring_kernel != "stencil" && options.spring_kernel != "edges" && options.spring_kernel != "auto") {
+        cerr << "ERR: unknown spring_kernel " << options.spring_kernel << "\n";
+        return false;
+    }
+    if (options.precision == "float" && options.integrator == "implicit") {
+        cerr << "ERR: the implicit integrator needs double precision\n";
+        return false;
+    }
+    if (options.max_strain < 0.0 || options.strain_iterations < 0 ||
+        (options.strain_sweep != "gauss-seidel" && options.strain_sweep != "jacobi")) {
+        cerr << "ERR: need max_strain >= 0, strain_iter >= 0 and strain_sweep gauss-seidel or jacobi\n";
+        return false;
+    }
+    if ((options.collision != "off" && options.collision != "on") || options.collision_thickness <= 0.0 ||
+        options.collision_thickness > 0.5) {
+        cerr << "ERR: need collision off or on and 0 < collision_thickness <= 0.5\n";
+        return false;
+    }
+    if (options.obstacle_thickness <= 0.0) {
+        cerr << "ERR: need obstacle_thickness > 0\n";
+        return false;
+    }
+    if (options.wind_drag < 0.0 || options.air_density < 0.0 || options.drag_coefficient < 0.0 ||
+        options.lift_coefficient < 0.0) {
+        cerr << "ERR: need wind_drag >= 0, air_density >= 0, drag_coeff >= 0 and lift_coeff >= 0\n";
+        return false;
+    }
+    if (options.air_density > 0.0 && options.sleep_tile > 0) {
+        cerr << "ERR: the aerodynamic forces need all the nodes awake, without sleeping tiles\n";
+        return false;
+    }
+    if (options.node_order != "import" && options.node_order != "rcm" && options.node_order != "morton") {
+        cerr << "ERR: unknown node_order " << options.node_order << "\n";
+        return false;
+    }
+    if (!options.garment.empty() && (options.spring_kernel == "stencil" || options.sleep_tile > 0 || options.collision == "on")) {
+        cerr << "ERR: garments need the edges spring kernel, not the stencil, without sleeping tiles and self-collision\n";
+        return false;
+    }
+    if (options.sleep_tile < 0 || options.sleep_displacement < 0.0 || options.sleep_force < 0.0 || options.sleep_steps < 1) {
+        cerr << "ERR: need sleep_tile >= 0, sleep_disp >= 0, sleep_force >= 0 and sleep_steps >= 1\n";
+        return false;
+    }
+    if (options.sleep_tile > 0 && (options.integrator != "verlet" || options.dt_control != "fixed" ||
+                                   options.spring_kernel == "edges")) {
+        cerr << "ERR: sleeping tiles need fixed verlet steps and the stencil spring kernel\n";
+        return false;
+    }
+    if (options.sleep_tile > 0 && options.sleep_force >= options.m*9.8) {
+        cerr << "ERR: sleep_force must be below the weight of a node, " << options.m*9.8 << ", or falling tiles sleep\n";
+        return false;
+    }
+    if ((options.start != "rest" && options.start != "equilibrium") || options.newton_tolerance <= 0.0 ||
+        options.newton_iterations < 1) {
+        cerr << "ERR: need start rest or equilibrium, newton_tol > 0 and newton_iter >= 1\n";
+        return false;
+    }
+    if (options.checkpoint_interval < 0.0) {
+        cerr << "ERR: need checkpoint_interval >= 0\n";
+        return false;
+    }
+    return true;
+}
+
+void WriteOptions(ostream& out, const SimulationOptions& options) {
+
+    /* doubles are written exactly */
+    std::streamsize precision = out.precision(17);
+
+    out << "--N " << options.N << "\n"
+        << "--length " << options.length << "\n"
+        << "--garment " << options.garment << "\n"
+        << "--node_order " << options.node_order << "\n"
+        << "--mass " << options.m << "\n"
+        << "--stiffness " << options.k << "\n"
+        << "--damping " << options.c << "\n"
+        << "--dt " << options.dt << "\n"
+        << "--t_final " << options.t_final << "\n"
+        << "--dt_control " << options.dt_control << "\n"
+        << "--dt_min " << options.dt_min << "\n"
+        << "--dt_max " << options.dt_max << "\n"
+        << "--dt_tol " << options.dt_tolerance << "\n"
+        << "--dt_safety " << options.dt_safety << "\n"
+        << "--integrator " << options.integrator << "\n"
+        << "--cg_tol " << options.cg_tolerance << "\n"
+        << "--cg_iter " << options.cg_iterations << "\n"
+        << "--precision " << options.precision << "\n"
+        << "--rsqrt " << options.rsqrt << "\n"
+        << "--spring_kernel " << options.spring_kernel << "\n"
+        << "--max_strain " << options.max_strain << "\n"
+        << "--strain_iter " << options.strain_iterations << "\n"
+        << "--strain_sweep " << options.strain_sweep << "\n"
+        << "--collision " << options.collision << "\n"
+        << "--collision_thickness " << options.collision_thickness << "\n"
+        << "--obstacle " << options.obstacle << "\n"
+        << "--obstacle_thickness " << options.obstacle_thickness << "\n"
+        << "--wind " << options.wind_x << "," << options.wind_y << "," << options.wind_z << "\n"
+        << "--wind_drag " << options.wind_drag << "\n"
+        << "--air_density " << options.air_density << "\n"
+        << "--drag_coeff " << options.drag_coefficient << "\n"
+        << "--lift_coeff " << options.lift_coefficient << "\n"
+        << "--sleep_tile " << options.sleep_tile << "\n"
+        << "--sleep_disp " << options.sleep_displacement << "\n"
+        << "--sleep_force " << options.sleep_force << "\n"
+        << "--sleep_steps " << options.sleep_steps << "\n"
+        << "--activity " << options.activity << "\n"
+        << "--t_release " << options.t_release << "\n"
+        << "--start " << options.start << "\n"
+        << "--newton_tol " << options.newton_tolerance << "\n"
+        << "--newton_iter " << options.newton_iterations << "\n"
+        << "--output " << options.output << "\n"
+        << "--output_interval " << options.output_interval << "\n"
+        << "--output_buffers " << options.output_buffers << "\n"
+        << "--checkpoint " << options.checkpoint << "\n"
+        << "--checkpoint_interval " << options.checkpoint_interval << "\n"
+        << "--threads " << options.threads << "\n";
+
+    out.precision(precision);
+}
+
+bool ReadOptions(istream& in, SimulationOptions& options) {
+
+    /* the value is the rest of the line, file names may contain spaces */
+    vector<string> tokens;
+    tokens.push_back("options");
+    string line;
+    while (getline(in, line)) {
+        if (line.empty()) continue;
+        size_t space = line.find(' ');
+        if (space == string::npos) return false;
+        tokens.push_back(line.substr(0, space));
+        tokens.push_back(line.substr(space + 1));
+    }
+
+    vector<char*> argv;
+    for (size_t t = 0; t < tokens.size(); t++) argv.push_back(&tokens[t][0]);
+
+    return ParseOptions(int(argv.size()), argv.data(), options);
+}
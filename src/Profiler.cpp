@@ -0,0 +1,195 @@
+//
+// Per-phase profiling of the time loop: scoped timers and hardware counters, compiled out by default.
+//
+
+#include "Profiler.h"
+#include "Environment.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* phaseNames[kNumProfilePhases] = {
+    "internal forces", "viscous forces", "gravity", "node forces", "aerodynamics", "integration", "boundary",
+    "strain limiting", "self collision", "obstacle", "step control", "activity",
+    "equilibrium", "output", "file write", "checkpoint"
+};
+
+static int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* the counters of one thread, opened on first use and closed with the thread */
+struct CounterGroup {
+    int descriptors[PROFILE_NUM_COUNTERS];
+    bool opened;
+    bool valid;
+
+    CounterGroup(): opened(false), valid(false) {
+        for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) descriptors[c] = -1;
+    }
+
+    ~CounterGroup() {
+#ifdef __linux__
+        for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) {
+            if (descriptors[c] >= 0) close(descriptors[c]);
+        }
+#endif
+    }
+
+    void Open() {
+        opened = true;
+#ifdef __linux__
+        const uint64_t configs[PROFILE_NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+        };
+        valid = true;
+        for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[c];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            /* this thread on any cpu */
+            descriptors[c] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if (descriptors[c] < 0) valid = false;
+        }
+#endif
+    }
+};
+
+static thread_local CounterGroup counterGroup;
+
+Profiler::Profiler():
+    fCountersWanted(false),
+    fCountersFailed(false)
+{
+    Reset();
+
+    const char* counters = getenv("SIMPLECLOTH_COUNTERS");
+    fCountersWanted = counters != NULL && strcmp(counters, "0") != 0;
+}
+
+Profiler& Profiler::Instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+const char* Profiler::PhaseName(ProfilePhase phase) {
+    return phaseNames[phase];
+}
+
+bool Profiler::ReadCounters(int64_t values[PROFILE_NUM_COUNTERS]) {
+
+    if (!CountersEnabled()) return false;
+
+    if (!counterGroup.opened) counterGroup.Open();
+    if (!counterGroup.valid) {
+        fCountersFailed = true;
+        return false;
+    }
+
+#ifdef __linux__
+    for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) {
+        if (read(counterGroup.descriptors[c], &values[c], sizeof(int64_t)) != sizeof(int64_t)) {
+            fCountersFailed = true;
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void Profiler::Add(ProfilePhase phase, int64_t ns, const int64_t* counters) {
+
+    Totals& totals = fTotals[phase];
+    totals.ns += ns;
+    totals.calls++;
+    if (counters) {
+        for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) totals.counters[c] += counters[c];
+    }
+}
+
+void Profiler::Reset() {
+
+    for (int p = 0; p < kNumProfilePhases; p++) {
+        fTotals[p].ns = 0;
+        fTotals[p].calls = 0;
+        fTotals[p].bytes = 0;
+        for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) fTotals[p].counters[c] = 0;
+    }
+}
+
+void Profiler::Print(std::ostream& out, long steps, long numNodes, double seconds) const {
+
+    double nodeSteps = double(Max(steps, 1L))*Max(numNodes, 1L);
+    bool counters = CountersEnabled();
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+
+    out << "profile: " << steps << " steps of " << numNodes << " nodes in " << seconds << " s, "
+        << steps/Max(seconds, 1.0e-9) << " steps/s, " << 1.0e9*seconds/nodeSteps << " ns/node/step\n";
+    out << std::setw(18) << "phase" << std::setw(10) << "calls" << std::setw(12) << "ms" << std::setw(8) << "%"
+        << std::setw(14) << "ns/node/step" << std::setw(8) << "IPC" << std::setw(14) << "LLC misses"
+        << std::setw(12) << "MB" << "\n";
+
+    int64_t bytes = 0;
+    for (int p = 0; p < kNumProfilePhases; p++) {
+        const Totals& totals = fTotals[p];
+        if (totals.calls == 0) continue;
+
+        double ms = 1.0e-6*totals.ns;
+        out << std::setw(18) << phaseNames[p] << std::setw(10) << totals.calls << std::setw(12) << ms
+            << std::setw(8) << 100.0*ms/Max(1000.0*seconds, 1.0e-9) << std::setw(14) << totals.ns/nodeSteps;
+
+        if (counters && totals.counters[PROFILE_CYCLES] > 0) {
+            out << std::setw(8) << double(totals.counters[PROFILE_INSTRUCTIONS])/totals.counters[PROFILE_CYCLES]
+                << std::setw(14) << totals.counters[PROFILE_LLC_MISSES];
+        }
+        else {
+            out << std::setw(8) << "n/a" << std::setw(14) << "n/a";
+        }
+        out << std::setw(12) << 1.0e-6*totals.bytes << "\n";
+        bytes += totals.bytes;
+    }
+    out << "profile: " << 1.0e-6*bytes << " MB written, " << 1.0e-6*bytes/Max(seconds, 1.0e-9) << " MB/s\n";
+    if (fCountersWanted && fCountersFailed)
+        out << "profile: the hardware counters are not available (perf_event_open failed)\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+ProfileScope::ProfileScope(ProfilePhase phase):
+    fPhase(phase)
+{
+    fCounting = Profiler::Instance().ReadCounters(fCounters);
+    fStart = Now();
+}
+
+ProfileScope::~ProfileScope() {
+
+    int64_t ns = Now() - fStart;
+
+    int64_t end[PROFILE_NUM_COUNTERS];
+    if (fCounting && Profiler::Instance().ReadCounters(end)) {
+        for (int c = 0; c < PROFILE_NUM_COUNTERS; c++) end[c] -= fCounters[c];
+        Profiler::Instance().Add(fPhase, ns, end);
+    }
+    else {
+        Profiler::Instance().Add(fPhase, ns, NULL);
+    }
+}
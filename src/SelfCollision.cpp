@@ -0,0 +1,183 @@
+//
+// Self-collision of the cloth: the nodes against the triangles of the grid, with a spatial hash as
+// broad phase.
+//
+
+#include "SelfCollision.h"
+#include "ForceModels.h"
+
+#include <algorithm>
+
+template <class REAL>
+void SpatialHash::Build(const ArrayT<Vec3T<REAL> >& pos, double cellSize) {
+
+    assert(cellSize > 0.0);
+    fCellSize = cellSize;
+
+    /* a power of two, so that the entry is a mask of the hash */
+    int numPoints = pos.Length();
+    unsigned entries = 1;
+    while (entries < unsigned(HASH_LOAD_FACTOR*Max(numPoints, 1))) entries *= 2;
+    fMask = entries - 1;
+
+    fStart.Dimension(entries + 1);
+    fPoints.Dimension(numPoints);
+    ArrayT<unsigned, ArenaAllocator<unsigned> > entry(numPoints);
+
+    /* count */
+    fStart = 0;
+    for (int p = 0; p < numPoints; p++) {
+        entry[p] = Entry(Cell(pos[p].x), Cell(pos[p].y), Cell(pos[p].z));
+        fStart[entry[p] + 1]++;
+    }
+
+    /* offsets */
+    for (unsigned e = 0; e < entries; e++) fStart[e + 1] += fStart[e];
+
+    /* scatter, the points of an entry keep their order */
+    for (int p = 0; p < numPoints; p++) fPoints[fStart[entry[p]]++] = p;
+
+    /* the scatter moved every start to the next one */
+    for (unsigned e = entries; e > 0; e--) fStart[e] = fStart[e - 1];
+    fStart[0] = 0;
+}
+
+SelfCollision::SelfCollision(int N, const SpringNetwork& springs, double spacing, double thickness):
+    fSpacing(spacing),
+    fThickness(thickness),
+    fCandidates(0),
+    fContacts(0),
+    fTotalContacts(0)
+{
+    assert(N > 1 && springs.NumNodes() == N*N && spacing > 0.0 && thickness > 0.0);
+
+    fTriangles = GridTriangles(N);
+
+    /* the other ends of the springs of every node, sorted for the lookups */
+    fNeighbourStart.Dimension(N*N + 1);
+    fNeighbourStart[0] = 0;
+    for (int n = 0; n < N*N; n++) {
+        for (int a = 0; a < springs.NumNodeSprings(n); a++) {
+            const Spring& spring = springs[springs.NodeSprings(n)[a]];
+            fNeighbours.Insert(spring.i == n ? spring.j : spring.i);
+        }
+        std::sort(fNeighbours.Pointer(fNeighbourStart[n]), fNeighbours.Pointer() + fNeighbours.Length());
+        fNeighbourStart[n + 1] = fNeighbours.Length();
+    }
+}
+
+bool SelfCollision::Adjacent(int a, int b) const {
+
+    if (a == b) return true;
+    const int* first = fNeighbours.Pointer(fNeighbourStart[a]);
+    const int* last = fNeighbours.Pointer() + fNeighbourStart[a + 1];
+    return std::binary_search(first, last, b);
+}
+
+template <class REAL>
+int SelfCollision::Apply(const ArrayT<Vec3T<REAL> >& prev, const ArrayT<int>& pinned, ArrayT<Vec3T<REAL> >& pos,
+                         const ArrayT<char>* asleep, ArrayT<Vec3T<REAL> >* vel, double dt) {
+
+    assert(prev.Length() == pos.Length() && pos.Length() == fNeighbourStart.Length() - 1);
+    assert(!vel || (vel->Length() == pos.Length() && dt > 0.0));
+    double inverseDt = vel ? 1.0/dt : 0.0;
+
+    ArrayT<char, ArenaAllocator<char> > fixed(pos.Length());
+    if (asleep) {
+        for (int n = 0; n < pos.Length(); n++) fixed[n] = (*asleep)[n];
+    }
+    else fixed = char(0);
+    for (int p = 0; p < pinned.Length(); p++) fixed[pinned[p]] = 1;
+
+    SpatialHash hash;
+    hash.Build(pos, COLLISION_CELL_SIZE*fSpacing);
+    fCandidates = 0;
+    fContacts = 0;
+
+    Vec3 margin(fThickness, fThickness, fThickness);
+
+    for (int t = 0; t < NumTriangles(); t++) {
+        const int* corner = fTriangles.Pointer(3*t);
+        int a = corner[0], b = corner[1], c = corner[2];
+
+        /* the box of the triangle grown by the thickness */
+        Vec3 pa(pos[a]), pb(pos[b]), pc(pos[c]);
+        Vec3 low(Min(Min(pa.x, pb.x), pc.x), Min(Min(pa.y, pb.y), pc.y), Min(Min(pa.z, pb.z), pc.z));
+        Vec3 high(Max(Max(pa.x, pb.x), pc.x), Max(Max(pa.y, pb.y), pc.y), Max(Max(pa.z, pb.z), pc.z));
+        low -= margin;
+        high += margin;
+
+        hash.Query(low, high, [&](int q) {
+            fCandidates++;
+
+            /* cheap rejections first: outside the box, or next to the triangle in the grid */
+            Vec3 p(pos[q]);
+            if (p.x < low.x || p.x > high.x || p.y < low.y || p.y > high.y || p.z < low.z || p.z > high.z) return;
+            if (Adjacent(q, a) || Adjacent(q, b) || Adjacent(q, c)) return;
+            if (fixed[q] && fixed[a] && fixed[b] && fixed[c]) return;
+
+            /* the triangle as it is now, its corners may have moved since the box */
+            Vec3 xa(pos[a]), xb(pos[b]), xc(pos[c]);
+            Vec3 normal = (xb - xa).Cross(xc - xa);
+            double area = normal.Magnitude();
+            if (area <= 0.0) return;
+            normal *= 1.0/area;
+
+            double distance = normal.Dot(p - xa);
+            if (Abs(distance) >= fThickness) {
+                /* far enough, unless it went through the triangle during the step */
+                Vec3 oldNormal = (Vec3(prev[b]) - Vec3(prev[a])).Cross(Vec3(prev[c]) - Vec3(prev[a]));
+                if (oldNormal.Dot(Vec3(prev[q]) - Vec3(prev[a]))*distance >= 0.0) return;
+            }
+
+            /* the projection has to fall on the triangle: barycentric coordinates */
+            Vec3 e0 = xb - xa, e1 = xc - xa, d = p - xa;
+            double d00 = e0.Dot(e0), d01 = e0.Dot(e1), d11 = e1.Dot(e1);
+            double d20 = d.Dot(e0), d21 = d.Dot(e1);
+            double denominator = d00*d11 - d01*d01;
+            double wb = (d11*d20 - d01*d21)/denominator;
+            double wc = (d00*d21 - d01*d20)/denominator;
+            double wa = 1.0 - wb - wc;
+            if (wa < 0.0 || wb < 0.0 || wc < 0.0) return;
+
+            /* the side the node came from */
+            Vec3 oldNormal = (Vec3(prev[b]) - Vec3(prev[a])).Cross(Vec3(prev[c]) - Vec3(prev[a]));
+            double oldDistance = oldNormal.Dot(Vec3(prev[q]) - Vec3(prev[a]));
+            double side = (oldDistance > 0.0 || (oldDistance == 0.0 && distance >= 0.0)) ? 1.0 : -1.0;
+
+            /* C = side n.(p - sum w_k x_k) - thickness >= 0, each node moves in proportion to its
+             * share of the constraint gradient, the fixed ones not at all */
+            double violation = fThickness - side*distance;
+            if (violation <= 0.0) return;
+
+            double mq = fixed[q] ? 0.0 : 1.0;
+            double ma = fixed[a] ? 0.0 : 1.0, mb = fixed[b] ? 0.0 : 1.0, mc = fixed[c] ? 0.0 : 1.0;
+            double weight = mq + ma*wa*wa + mb*wb*wb + mc*wc*wc;
+            if (weight <= 0.0) return;
+
+            Vec3 push = normal*(side*violation/weight);
+            pos[q] += Vec3T<REAL>(push*mq);
+            pos[a] -= Vec3T<REAL>(push*(ma*wa));
+            pos[b] -= Vec3T<REAL>(push*(mb*wb));
+            pos[c] -= Vec3T<REAL>(push*(mc*wc));
+            if (vel) {
+                Vec3 kick = push*inverseDt;
+                (*vel)[q] += Vec3T<REAL>(kick*mq);
+                (*vel)[a] -= Vec3T<REAL>(kick*(ma*wa));
+                (*vel)[b] -= Vec3T<REAL>(kick*(mb*wb));
+                (*vel)[c] -= Vec3T<REAL>(kick*(mc*wc));
+            }
+            fContacts++;
+        });
+    }
+    fTotalContacts += fContacts;
+    return fContacts;
+}
+
+/* the precisions of ClothSimulationT */
+template void SpatialHash::Build(const ArrayT<Vec3>&, double);
+template void SpatialHash::Build(const ArrayT<Vec3f>&, double);
+template int SelfCollision::Apply(const ArrayT<Vec3>&, const ArrayT<int>&, ArrayT<Vec3>&, const ArrayT<char>*,
+                                  ArrayT<Vec3>*, double);
+template int SelfCollision::Apply(const ArrayT<Vec3f>&, const ArrayT<int>&, ArrayT<Vec3f>&, const ArrayT<char>*,
+                                  ArrayT<Vec3f>*, double);
@@ -0,0 +1,181 @@
+//
+// Spring force kernels on the structure-of-arrays state: a scalar reference version and
+// AVX2/AVX-512 versions, selected at runtime from the capabilities of the CPU.
+//
+
+#include "ClothState.h"
+#include "Profiler.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMPLECLOTH_X86_KERNELS
+#include <immintrin.h>
+
+/* GCC reports the undefined pass-through operand of the gather intrinsics */
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/* scalar reference kernel */
+static void SpringForcesScalar(const SpringBatches& springs, ClothState& state) {
+
+    const double* px = state.pos.x.Pointer();
+    const double* py = state.pos.y.Pointer();
+    const double* pz = state.pos.z.Pointer();
+    double* fx = state.force.x.Pointer();
+    double* fy = state.force.y.Pointer();
+    double* fz = state.force.z.Pointer();
+
+    for (int s = 0; s < springs.NumSlots(); s++) {
+        int a = springs.i[s];
+        int b = springs.j[s];
+
+        double dx = px[a] - px[b];
+        double dy = py[a] - py[b];
+        double dz = pz[a] - pz[b];
+        double length = sqrt(dx*dx + dy*dy + dz*dz);
+
+        double coef = -springs.k[s]*(length - springs.rest[s])/length;
+
+        fx[a] += coef*dx; fy[a] += coef*dy; fz[a] += coef*dz;
+        fx[b] -= coef*dx; fy[b] -= coef*dy; fz[b] -= coef*dz;
+    }
+}
+
+#ifdef SIMPLECLOTH_X86_KERNELS
+
+/* 4 springs per instruction: gathered loads, the scatter is done lane by lane */
+__attribute__((target("avx2,fma")))
+static void SpringForcesAVX2(const SpringBatches& springs, ClothState& state) {
+
+    const double* px = state.pos.x.Pointer();
+    const double* py = state.pos.y.Pointer();
+    const double* pz = state.pos.z.Pointer();
+    double* fx = state.force.x.Pointer();
+    double* fy = state.force.y.Pointer();
+    double* fz = state.force.z.Pointer();
+
+    const __m256d zero = _mm256_setzero_pd();
+
+    alignas(32) double cx[4], cy[4], cz[4];
+
+    for (int s = 0; s < springs.NumSlots(); s += 4) {
+        __m128i vi = _mm_load_si128(reinterpret_cast<const __m128i*>(springs.i.Pointer(s)));
+        __m128i vj = _mm_load_si128(reinterpret_cast<const __m128i*>(springs.j.Pointer(s)));
+
+        __m256d dx = _mm256_sub_pd(_mm256_i32gather_pd(px, vi, 8), _mm256_i32gather_pd(px, vj, 8));
+        __m256d dy = _mm256_sub_pd(_mm256_i32gather_pd(py, vi, 8), _mm256_i32gather_pd(py, vj, 8));
+        __m256d dz = _mm256_sub_pd(_mm256_i32gather_pd(pz, vi, 8), _mm256_i32gather_pd(pz, vj, 8));
+
+        __m256d length = _mm256_sqrt_pd(_mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz))));
+
+        __m256d rest = _mm256_load_pd(springs.rest.Pointer(s));
+        __m256d k = _mm256_load_pd(springs.k.Pointer(s));
+
+        /* coef = -k*(length - rest)/length */
+        __m256d coef = _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(zero, k), _mm256_sub_pd(length, rest)), length);
+
+        _mm256_store_pd(cx, _mm256_mul_pd(coef, dx));
+        _mm256_store_pd(cy, _mm256_mul_pd(coef, dy));
+        _mm256_store_pd(cz, _mm256_mul_pd(coef, dz));
+
+        for (int l = 0; l < 4; l++) {
+            int a = springs.i[s + l];
+            int b = springs.j[s + l];
+            fx[a] += cx[l]; fy[a] += cy[l]; fz[a] += cz[l];
+            fx[b] -= cx[l]; fy[b] -= cy[l]; fz[b] -= cz[l];
+        }
+    }
+}
+
+/* 8 springs per instruction: gathered loads and scattered stores, which is safe because no
+ * node appears twice in a batch */
+__attribute__((target("avx512f")))
+static void SpringForcesAVX512(const SpringBatches& springs, ClothState& state) {
+
+    const double* px = state.pos.x.Pointer();
+    const double* py = state.pos.y.Pointer();
+    const double* pz = state.pos.z.Pointer();
+    double* fx = state.force.x.Pointer();
+    double* fy = state.force.y.Pointer();
+    double* fz = state.force.z.Pointer();
+
+    const __m512d zero = _mm512_setzero_pd();
+
+    for (int s = 0; s < springs.NumSlots(); s += SPRING_BATCH) {
+        __m256i vi = _mm256_load_si256(reinterpret_cast<const __m256i*>(springs.i.Pointer(s)));
+        __m256i vj = _mm256_load_si256(reinterpret_cast<const __m256i*>(springs.j.Pointer(s)));
+
+        __m512d dx = _mm512_sub_pd(_mm512_i32gather_pd(vi, px, 8), _mm512_i32gather_pd(vj, px, 8));
+        __m512d dy = _mm512_sub_pd(_mm512_i32gather_pd(vi, py, 8), _mm512_i32gather_pd(vj, py, 8));
+        __m512d dz = _mm512_sub_pd(_mm512_i32gather_pd(vi, pz, 8), _mm512_i32gather_pd(vj, pz, 8));
+
+        __m512d length = _mm512_sqrt_pd(_mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dz, dz))));
+
+        __m512d rest = _mm512_load_pd(springs.rest.Pointer(s));
+        __m512d k = _mm512_load_pd(springs.k.Pointer(s));
+
+        __m512d coef = _mm512_div_pd(_mm512_mul_pd(_mm512_sub_pd(zero, k), _mm512_sub_pd(length, rest)), length);
+        __m512d cx = _mm512_mul_pd(coef, dx);
+        __m512d cy = _mm512_mul_pd(coef, dy);
+        __m512d cz = _mm512_mul_pd(coef, dz);
+
+        /* +f on the first end points ... */
+        _mm512_i32scatter_pd(fx, vi, _mm512_add_pd(_mm512_i32gather_pd(vi, fx, 8), cx), 8);
+        _mm512_i32scatter_pd(fy, vi, _mm512_add_pd(_mm512_i32gather_pd(vi, fy, 8), cy), 8);
+        _mm512_i32scatter_pd(fz, vi, _mm512_add_pd(_mm512_i32gather_pd(vi, fz, 8), cz), 8);
+
+        /* ... and -f on the second ones */
+        _mm512_i32scatter_pd(fx, vj, _mm512_sub_pd(_mm512_i32gather_pd(vj, fx, 8), cx), 8);
+        _mm512_i32scatter_pd(fy, vj, _mm512_sub_pd(_mm512_i32gather_pd(vj, fy, 8), cy), 8);
+        _mm512_i32scatter_pd(fz, vj, _mm512_sub_pd(_mm512_i32gather_pd(vj, fz, 8), cz), 8);
+    }
+}
+
+#endif // SIMPLECLOTH_X86_KERNELS
+
+SimdLevel DetectSimdLevel() {
+
+#ifdef SIMPLECLOTH_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return kSimdAVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return kSimdAVX2;
+#endif
+    return kSimdScalar;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case kSimdAVX512: return "avx512";
+        case kSimdAVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+void internal_forces(const SpringBatches& springs, ClothState& state) {
+
+    /* the CPU is only queried once */
+    static const SimdLevel level = DetectSimdLevel();
+
+    internal_forces(springs, state, level);
+}
+
+void internal_forces(const SpringBatches& springs, ClothState& state, SimdLevel level) {
+
+    assert(level <= DetectSimdLevel());
+
+    PROFILE_SCOPE(kProfileInternalForces);
+
+    state.force = 0.0;
+
+    switch (level) {
+#ifdef SIMPLECLOTH_X86_KERNELS
+        case kSimdAVX512:
+            SpringForcesAVX512(springs, state);
+            break;
+        case kSimdAVX2:
+            SpringForcesAVX2(springs, state);
+            break;
+#endif
+        default:
+            SpringForcesScalar(springs, state);
+    }
+}
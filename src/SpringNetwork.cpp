@@ -0,0 +1,261 @@
+//
+// Flat spring topology of the cloth: every spring is stored once.
+//
+
+#include "SpringNetwork.h"
+#include "Profiler.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+SpringNetwork::SpringNetwork():
+    fNumNodes(0),
+    fChunkSize(0)
+{
+
+}
+
+SpringNetwork::SpringNetwork(int numNodes, int numSprings):
+    fNumNodes(0),
+    fChunkSize(0)
+{
+    Dimension(numNodes, numSprings);
+}
+
+void SpringNetwork::Dimension(int numNodes, int numSprings) {
+
+    fNumNodes = numNodes;
+    fSprings.Dimension(numSprings);
+
+    /* the node map and the colouring have to be rebuilt */
+    fNodeOffsets.Dimension(0);
+    fNodeSprings.Dimension(0);
+    fColourOffsets.Dimension(0);
+    fColourChunks.Dimension(0);
+}
+
+void SpringNetwork::SetSpring(int s, int i, int j, SpringType type) {
+
+    assert(i >= 0 && i < fNumNodes && j >= 0 && j < fNumNodes);
+
+    Spring& spring = fSprings[s];
+    spring.i = i;
+    spring.j = j;
+    spring.type = type;
+    spring.rest = 0.0;
+    spring.k = 0.0;
+}
+
+void SpringNetwork::SetRestState(const ArrayT<Vec3>& pos0, double k) {
+
+    assert(pos0.Length() == fNumNodes);
+
+    for (int s = 0; s < fSprings.Length(); s++) {
+        Spring& spring = fSprings[s];
+        spring.rest = (pos0[spring.i] - pos0[spring.j]).Magnitude();
+        spring.k = k;
+    }
+}
+
+void SpringNetwork::BuildNodeMap() {
+
+    /* count the springs per node */
+    fNodeOffsets.Dimension(fNumNodes + 1);
+    fNodeOffsets = 0;
+    for (int s = 0; s < fSprings.Length(); s++) {
+        fNodeOffsets[fSprings[s].i + 1]++;
+        fNodeOffsets[fSprings[s].j + 1]++;
+    }
+    for (int n = 0; n < fNumNodes; n++) {
+        fNodeOffsets[n+1] += fNodeOffsets[n];
+    }
+
+    /* fill the spring indices in their node slots */
+    fNodeSprings.Dimension(fNodeOffsets[fNumNodes]);
+    ArrayT<int> fill(fNumNodes);
+    for (int n = 0; n < fNumNodes; n++) {
+        fill[n] = fNodeOffsets[n];
+    }
+    for (int s = 0; s < fSprings.Length(); s++) {
+        fNodeSprings[fill[fSprings[s].i]++] = s;
+        fNodeSprings[fill[fSprings[s].j]++] = s;
+    }
+}
+
+void SpringNetwork::BuildColouring(int chunkSize) {
+
+    fChunkSize = chunkSize;
+    int numChunks = (fSprings.Length() + chunkSize - 1)/chunkSize;
+
+    /* greedy: a chunk takes the lowest colour not used yet by any chunk touching its nodes,
+     * the colours in use at a node are kept as bits */
+    ArrayT<uint64_t> nodeColours(fNumNodes);
+    nodeColours = uint64_t(0);
+    ArrayT<int> chunkColour(numChunks);
+    int numColours = 0;
+
+    for (int c = 0; c < numChunks; c++) {
+        int first = c*chunkSize;
+        int last = Min(first + chunkSize, fSprings.Length());
+
+        uint64_t used = 0;
+        for (int s = first; s < last; s++) {
+            used |= nodeColours[fSprings[s].i] | nodeColours[fSprings[s].j];
+        }
+        if (~used == 0) throw std::runtime_error("SpringNetwork::BuildColouring: more than 64 colours needed");
+
+        int colour = 0;
+        while (used & (uint64_t(1) << colour)) colour++;
+
+        for (int s = first; s < last; s++) {
+            nodeColours[fSprings[s].i] |= uint64_t(1) << colour;
+            nodeColours[fSprings[s].j] |= uint64_t(1) << colour;
+        }
+        chunkColour[c] = colour;
+        numColours = Max(numColours, colour + 1);
+    }
+
+    /* sort the chunks by colour, keeping their order within a colour */
+    fColourOffsets.Dimension(numColours + 1);
+    fColourOffsets = 0;
+    for (int c = 0; c < numChunks; c++) {
+        fColourOffsets[chunkColour[c] + 1]++;
+    }
+    for (int colour = 0; colour < numColours; colour++) {
+        fColourOffsets[colour + 1] += fColourOffsets[colour];
+    }
+
+    fColourChunks.Dimension(numChunks);
+    ArrayT<int> fill(numColours);
+    for (int colour = 0; colour < numColours; colour++) {
+        fill[colour] = fColourOffsets[colour];
+    }
+    for (int c = 0; c < numChunks; c++) {
+        fColourChunks[fill[chunkColour[c]]++] = c;
+    }
+}
+
+/* Creating the edge list of a N x N grid, node (i, j) is stored at N*j + i */
+SpringNetwork ConnectivityStructure(int N) {
+
+    /* number of springs of each family */
+    int numStructural = 2*N*(N-1);
+    int numShear = 2*(N-1)*(N-1);
+    int numBending = (N > 2) ? 2*N*(N-2) : 0;
+
+    SpringNetwork springs(N*N, numStructural + numShear + numBending);
+    int s = 0;
+
+    /* springs are emitted row by row, so consecutive springs touch neighbouring nodes */
+    for (int j = 0; j < N; j++) {
+
+        /** Structure springs connections */
+        /*@{*/
+        /* Horizontals: (i, j)<--->(i+1, j)  */
+        for (int i = 0; i < N-1; i++) {
+            springs.SetSpring(s++, N*j + i, N*j + i+1, kStructural);
+        }
+        /* Verticals: (i, j)<--->(i, j+1) */
+        for (int i = 0; i < N && j < N-1; i++) {
+            springs.SetSpring(s++, N*j + i, N*(j+1) + i, kStructural);
+        } // End of structure springs
+        /*@}*/
+
+        /** Shear springs connections */
+        /*@{*/
+        /* left-to-rights: (i, j)<--->(i+1, j+1) */
+        for (int i = 0; i < N-1 && j < N-1; i++) {
+            springs.SetSpring(s++, N*j + i, N*(j+1) + i+1, kShear);
+        }
+        /* right-to-left: (i, j)<--->(i-1, j+1) */
+        for (int i = 1; i < N && j < N-1; i++) {
+            springs.SetSpring(s++, N*j + i, N*(j+1) + i-1, kShear);
+        } // End of shear springs
+        /*@}*/
+
+        /** Bending springs */
+        /*@{*/
+        /* Horizontals: (i, j)<--->(i+2, j) */
+        for (int i = 0; i < N-2; i++) {
+            springs.SetSpring(s++, N*j + i, N*j + i+2, kBending);
+        }
+        /* verticals: (i, j)<--->(i, j+2) */
+        for (int i = 0; i < N && j < N-2; i++) {
+            springs.SetSpring(s++, N*j + i, N*(j+2) + i, kBending);
+        } // End of bending springs
+        /*@}*/
+    }
+
+    assert(s == springs.NumSprings());
+
+    springs.BuildNodeMap();
+    springs.BuildColouring();
+
+    return springs;
+}
+
+/* calculates internal forces: one evaluation per spring, scattered to both end points */
+template <class REAL, bool APPROX>
+void internal_forces(const SpringNetwork& springs, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int) {
+
+    PROFILE_SCOPE(kProfileInternalForces);
+
+    force_int = Vec3T<REAL>(0, 0, 0);
+
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+
+        Vec3T<REAL> f = SpringForceT<REAL, APPROX>(pos[spring.i], pos[spring.j], REAL(spring.rest), REAL(spring.k));
+
+        force_int[spring.i] += f;
+        force_int[spring.j] -= f;
+    }
+}
+
+/* calculates internal forces in parallel: the chunks of one colour share no node, so their +f/-f
+ * scatters never collide. Every node receives its contributions in the order of the colours, whatever
+ * the number of threads */
+template <class REAL, bool APPROX>
+void internal_forces(const SpringNetwork& springs, const ArrayT<Vec3T<REAL> >& pos, ArrayT<Vec3T<REAL> >& force_int,
+                     ThreadPool& pool) {
+
+    PROFILE_SCOPE(kProfileInternalForces);
+    assert(springs.NumColours() > 0 || springs.NumSprings() == 0);
+
+    pool.ParallelFor(0, force_int.Length(), [&](int first, int last) {
+        for (int n = first; n < last; n++) {
+            force_int[n] = Vec3T<REAL>(0, 0, 0);
+        }
+    });
+
+    for (int colour = 0; colour < springs.NumColours(); colour++) {
+        const int* chunks = springs.ColourChunks(colour);
+
+        pool.ParallelFor(0, springs.NumColourChunks(colour), [&](int first, int last) {
+            for (int c = first; c < last; c++) {
+                int begin = chunks[c]*springs.ChunkSize();
+                int end = Min(begin + springs.ChunkSize(), springs.NumSprings());
+
+                for (int s = begin; s < end; s++) {
+                    const Spring& spring = springs[s];
+
+                    Vec3T<REAL> f = SpringForceT<REAL, APPROX>(pos[spring.i], pos[spring.j], REAL(spring.rest), REAL(spring.k));
+
+                    force_int[spring.i] += f;
+                    force_int[spring.j] -= f;
+                }
+            }
+        });
+    }
+}
+
+/* the precisions and inverse lengths of ClothSimulationT */
+#define INSTANTIATE_INTERNAL_FORCES(REAL, APPROX) \
+    template void internal_forces<REAL, APPROX>(const SpringNetwork&, const ArrayT<Vec3T<REAL> >&, ArrayT<Vec3T<REAL> >&); \
+    template void internal_forces<REAL, APPROX>(const SpringNetwork&, const ArrayT<Vec3T<REAL> >&, ArrayT<Vec3T<REAL> >&, \
+                                                ThreadPool&);
+
+INSTANTIATE_INTERNAL_FORCES(double, false)
+INSTANTIATE_INTERNAL_FORCES(double, true)
+INSTANTIATE_INTERNAL_FORCES(float, false)
+INSTANTIATE_INTERNAL_FORCES(float, true)
@@ -0,0 +1,363 @@
+//
+// Static equilibrium of the spring network under constant loads: Newton's method with a line search.
+//
+
+#include "StaticSolver.h"
+
+#include <cmath>
+
+/** \name the Newton iteration */
+/*@{*/
+#define STATIC_ARMIJO 1.0e-4           /**< part of the predicted decrease a step has to achieve */
+#define STATIC_BACKTRACKS 30           /**< halvings of the step before the shift is raised instead */
+#define STATIC_FIRST_SHIFT 1.0e-2      /**< first shift, relative to the largest stiffness */
+#define STATIC_SMALLEST_SHIFT 1.0e-10  /**< relative to the largest stiffness as well */
+/*@}*/
+
+/* largest diagonal shift of the incomplete Cholesky factorization */
+#define CHOLESKY_LARGEST_SHIFT 1.0e3
+
+/* 3 x 3 blocks in column-major order: entry (r, c) is at [3*c + r] */
+static inline Vec3 BlockTimes(const double* block, const Vec3& x) {
+    return Vec3(block[0]*x.x + block[3]*x.y + block[6]*x.z,
+                block[1]*x.x + block[4]*x.y + block[7]*x.z,
+                block[2]*x.x + block[5]*x.y + block[8]*x.z);
+}
+
+static inline Vec3 BlockTransposeTimes(const double* block, const Vec3& x) {
+    return Vec3(block[0]*x.x + block[1]*x.y + block[2]*x.z,
+                block[3]*x.x + block[4]*x.y + block[5]*x.z,
+                block[6]*x.x + block[7]*x.y + block[8]*x.z);
+}
+
+/* c -= a b^T */
+static inline void SubtractOuter(double* c, const double* a, const double* b) {
+    for (int col = 0; col < 3; col++)
+        for (int row = 0; row < 3; row++)
+            c[3*col + row] -= a[row]*b[col] + a[3 + row]*b[3 + col] + a[6 + row]*b[6 + col];
+}
+
+/* lower Cholesky factor of a symmetric block, false if it is not positive definite */
+static bool CholeskyBlock(const double* s, double* l) {
+
+    for (int e = 0; e < 9; e++) l[e] = 0.0;
+
+    double d0 = s[0];
+    if (!(d0 > 0.0)) return false;
+    l[0] = std::sqrt(d0);
+    l[1] = s[1]/l[0];
+    l[2] = s[2]/l[0];
+
+    double d1 = s[4] - l[1]*l[1];
+    if (!(d1 > 0.0)) return false;
+    l[4] = std::sqrt(d1);
+    l[5] = (s[5] - l[2]*l[1])/l[4];
+
+    double d2 = s[8] - l[2]*l[2] - l[5]*l[5];
+    if (!(d2 > 0.0)) return false;
+    l[8] = std::sqrt(d2);
+    return true;
+}
+
+/* inverse of a lower triangular block */
+static void InvertLowerBlock(const double* l, double* inv) {
+
+    for (int e = 0; e < 9; e++) inv[e] = 0.0;
+    inv[0] = 1.0/l[0];
+    inv[4] = 1.0/l[4];
+    inv[8] = 1.0/l[8];
+    inv[1] = -l[1]*inv[0]/l[4];
+    inv[5] = -l[5]*inv[4]/l[8];
+    inv[2] = -(l[2]*inv[0] + l[5]*inv[1])/l[8];
+}
+
+bool BlockIncompleteCholesky::TryFactor(double shift) {
+
+    const BlockSparseMatrix& A = *fA;
+
+    for (int i = 0; i < A.NumRows(); i++) {
+        int diagonal = A.DiagonalBlock(i);
+
+        /* L_ik = (A_ik - sum_{j < k} L_ij L_kj^T) L_kk^-T over the blocks of both rows */
+        for (int b = A.RowBegin(i); b < diagonal; b++) {
+            int k = A.Column(b);
+            double s[9];
+            for (int e = 0; e < 9; e++) s[e] = A.Block(b)[e];
+
+            int bi = A.RowBegin(i), bk = A.RowBegin(k);
+            while (bi < b && bk < A.DiagonalBlock(k)) {
+                if (A.Column(bi) == A.Column(bk)) SubtractOuter(s, fL(bi++), fL(bk++));
+                else if (A.Column(bi) < A.Column(bk)) bi++;
+                else bk++;
+            }
+
+            const double* inv = fInvDiagonal(k);
+            double* l = fL(b);
+            for (int col = 0; col < 3; col++)
+                for (int row = 0; row < 3; row++)
+                    l[3*col + row] = s[row]*inv[col] + s[3 + row]*inv[3 + col] + s[6 + row]*inv[6 + col];
+        }
+
+        /* L_ii L_ii^T = A_ii - sum_{j < i} L_ij L_ij^T */
+        double s[9];
+        for (int e = 0; e < 9; e++) s[e] = A.Block(diagonal)[e];
+        for (int d = 0; d < 3; d++) s[4*d] *= 1.0 + shift;
+        for (int b = A.RowBegin(i); b < diagonal; b++) SubtractOuter(s, fL(b), fL(b));
+
+        if (!CholeskyBlock(s, fL(diagonal))) return false;
+        InvertLowerBlock(fL(diagonal), fInvDiagonal(i));
+    }
+    return true;
+}
+
+bool BlockIncompleteCholesky::Factor(const BlockSparseMatrix& A) {
+
+    fA = &A;
+    fL.Dimension(9, A.NumBlocks());
+    fInvDiagonal.Dimension(9, A.NumRows());
+
+    fShift = 0.0;
+    while (!TryFactor(fShift)) {
+        fShift = (fShift > 0.0) ? 10.0*fShift : 1.0e-3;
+        if (fShift > CHOLESKY_LARGEST_SHIFT) return false;
+    }
+    return true;
+}
+
+void BlockIncompleteCholesky::Apply(const ArrayT<Vec3>& r, ArrayT<Vec3>& z) const {
+
+    const BlockSparseMatrix& A = *fA;
+    int numRows = A.NumRows();
+
+    /* L y = r */
+    for (int i = 0; i < numRows; i++) {
+        Vec3 s = r[i];
+        for (int b = A.RowBegin(i); b < A.DiagonalBlock(i); b++) s -= BlockTimes(fL(b), z[A.Column(b)]);
+        z[i] = BlockTimes(fInvDiagonal(i), s);
+    }
+
+    /* L^T z = y, row i of L scatters into the rows before it once z_i is known */
+    for (int i = numRows - 1; i >= 0; i--) {
+        z[i] = BlockTransposeTimes(fInvDiagonal(i), z[i]);
+        for (int b = A.RowBegin(i); b < A.DiagonalBlock(i); b++)
+            z[A.Column(b)] -= BlockTransposeTimes(fL(b), z[i]);
+    }
+}
+
+StaticSolver::StaticSolver(const SpringNetwork& springs, double tolerance, int maxIterations, int maxCGIterations):
+    fTolerance(tolerance),
+    fMaxIterations(maxIterations),
+    fMaxCGIterations(maxCGIterations),
+    fIterations(0),
+    fCGIterations(0),
+    fResidual(0.0)
+{
+    fH.BuildPattern(springs);
+
+    int numNodes = springs.NumNodes();
+    fFixed.Dimension(numNodes);
+    fGradient.Dimension(numNodes);
+    fStep.Dimension(numNodes);
+    fTrial.Dimension(numNodes);
+    fR.Dimension(numNodes);
+    fZ.Dimension(numNodes);
+    fP.Dimension(numNodes);
+    fHp.Dimension(numNodes);
+}
+
+double StaticSolver::Energy(const SpringNetwork& springs, const ArrayT<Vec3>& loads, const ArrayT<Vec3>& pos) const {
+
+    double energy = 0.0;
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+        double stretch = (pos[spring.i] - pos[spring.j]).Magnitude() - spring.rest;
+        energy += 0.5*spring.k*stretch*stretch;
+    }
+    for (int n = 0; n < pos.Length(); n++) {
+        if (!fFixed[n]) energy -= loads[n].Dot(pos[n]);
+    }
+    return energy;
+}
+
+double StaticSolver::Gradient(const SpringNetwork& springs, const ArrayT<Vec3>& loads, const ArrayT<Vec3>& pos) {
+
+    fGradient = (-1.0)*loads;
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+        Vec3 f = SpringForceT<double, false>(pos[spring.i], pos[spring.j], spring.rest, spring.k);
+        fGradient[spring.i] -= f;
+        fGradient[spring.j] += f;
+    }
+
+    double largest = 0.0;
+    for (int n = 0; n < pos.Length(); n++) {
+        if (fFixed[n]) fGradient[n] = Vec3(0, 0, 0);
+        largest = Max(largest, fGradient[n].Magnitude());
+    }
+    return largest;
+}
+
+void StaticSolver::AssembleHessian(const SpringNetwork& springs, const ArrayT<Vec3>& pos, double mu, bool clamp) {
+
+    fH.Zero();
+
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+
+        Vec3 d = pos[spring.i] - pos[spring.j];
+        double length = d.Magnitude();
+        Vec3 u = d*(1.0/length);
+
+        /* k (u u^T + (1 - rest/length) (I - u u^T)), clamped: without the transverse part under compression */
+        double transverse = clamp ? Max(1.0 - spring.rest/length, 0.0) : 1.0 - spring.rest/length;
+        double uu[3] = {u.x, u.y, u.z};
+        double K[9];
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                double outer = uu[row]*uu[col];
+                K[3*col + row] = spring.k*(outer + transverse*((row == col ? 1.0 : 0.0) - outer));
+            }
+        }
+
+        /* the fixed nodes are out of the system */
+        bool free_i = !fFixed[spring.i], free_j = !fFixed[spring.j];
+        if (free_i) for (int e = 0; e < 9; e++) fH.Block(fH.DiagonalBlock(spring.i))[e] += K[e];
+        if (free_j) for (int e = 0; e < 9; e++) fH.Block(fH.DiagonalBlock(spring.j))[e] += K[e];
+        if (free_i && free_j) {
+            for (int e = 0; e < 9; e++) {
+                fH.Block(fH.SpringBlock(s, 0))[e] -= K[e];
+                fH.Block(fH.SpringBlock(s, 1))[e] -= K[e];
+            }
+        }
+    }
+
+    for (int n = 0; n < fH.NumRows(); n++) {
+        double* diagonal = fH.Block(fH.DiagonalBlock(n));
+        for (int d = 0; d < 3; d++) diagonal[4*d] += fFixed[n] ? 1.0 : mu;
+    }
+}
+
+int StaticSolver::SolveStep(double tolerance) {
+
+    int numNodes = fH.NumRows();
+
+    /* preconditioned conjugate gradient from zero, the fixed nodes have no residual. It gives up on
+     * directions of negative curvature */
+    fStep = Vec3(0, 0, 0);
+    fR = (-1.0)*fGradient;
+    fPreconditioner.Apply(fR, fZ);
+    fP = fZ;
+
+    double rz = 0.0, rhsNorm = 0.0;
+    for (int n = 0; n < numNodes; n++) {
+        rz += fR[n].Dot(fZ[n]);
+        rhsNorm += fR[n].Dot(fR[n]);
+    }
+    rhsNorm = sqrt(rhsNorm);
+    if (rhsNorm == 0.0) return 0;
+
+    int iterations = 0;
+    while (iterations < fMaxCGIterations) {
+        fH.Multiply(fP.Pointer(), fHp.Pointer());
+
+        double pHp = 0.0;
+        for (int n = 0; n < numNodes; n++) pHp += fP[n].Dot(fHp[n]);
+        if (pHp <= 0.0) return -1;
+        double alpha = rz/pHp;
+
+        double residual = 0.0;
+        for (int n = 0; n < numNodes; n++) {
+            fStep[n] += fP[n]*alpha;
+            fR[n] -= fHp[n]*alpha;
+            residual += fR[n].Dot(fR[n]);
+        }
+        iterations++;
+        if (sqrt(residual) <= tolerance*rhsNorm) break;
+
+        fPreconditioner.Apply(fR, fZ);
+        double rzNew = 0.0;
+        for (int n = 0; n < numNodes; n++) rzNew += fR[n].Dot(fZ[n]);
+        double beta = rzNew/rz;
+        rz = rzNew;
+
+        fP = fZ + beta*fP;
+    }
+    return iterations;
+}
+
+bool StaticSolver::Solve(const SpringNetwork& springs, const ArrayT<Vec3>& loads, const ArrayT<int>& pinned,
+                         ArrayT<Vec3>& pos) {
+
+    assert(loads.Length() == pos.Length() && pos.Length() == fH.NumRows());
+
+    fFixed = char(0);
+    for (int p = 0; p < pinned.Length(); p++) fFixed[pinned[p]] = 1;
+
+    /* the scales of the forces and of the shift */
+    double largestLoad = 0.0;
+    for (int n = 0; n < pos.Length(); n++) {
+        if (!fFixed[n]) largestLoad = Max(largestLoad, loads[n].Magnitude());
+    }
+    double target = fTolerance*(largestLoad > 0.0 ? largestLoad : 1.0);
+
+    double stiffness = 0.0;
+    for (int s = 0; s < springs.NumSprings(); s++) stiffness = Max(stiffness, springs[s].k);
+    double mu = STATIC_FIRST_SHIFT*stiffness;
+    double smallestShift = STATIC_SMALLEST_SHIFT*stiffness;
+
+    fIterations = 0;
+    fCGIterations = 0;
+
+    double energy = Energy(springs, loads, pos);
+    double residual = Gradient(springs, loads, pos);
+    double firstResidual = residual;
+
+    while (residual > target && fIterations < fMaxIterations) {
+        fIterations++;
+
+        /* inexact Newton: the linear solves get tighter as the residual falls. The full Hessian is
+         * definite near the equilibrium, where it converges quadratically. Away from it compressed
+         * springs make it indefinite, and their transverse part is dropped */
+        double tolerance = Min(0.1, sqrt(residual/firstResidual));
+        int iterations = -1;
+        for (int clamp = 0; clamp < 2 && iterations < 0; clamp++) {
+            AssembleHessian(springs, pos, mu, clamp == 1);
+            if (fPreconditioner.Factor(fH)) iterations = SolveStep(tolerance);
+        }
+        if (iterations < 0) {
+            mu *= 10.0;
+            continue;
+        }
+        fCGIterations += iterations;
+
+        double slope = 0.0;
+        for (int n = 0; n < pos.Length(); n++) slope += fGradient[n].Dot(fStep[n]);
+
+        /* backtrack until the energy falls by a part of the predicted decrease. Below the rounding
+         * of the energy the residual force decides instead */
+        bool rounding = -slope < 1.0e-12*Abs(energy);
+        double alpha = 1.0;
+        bool accepted = false;
+        for (int b = 0; b < STATIC_BACKTRACKS && slope < 0.0; b++, alpha *= 0.5) {
+            fTrial = pos + alpha*fStep;
+            double trial = Energy(springs, loads, fTrial);
+            if (rounding ? Gradient(springs, loads, fTrial) < residual : trial <= energy + STATIC_ARMIJO*alpha*slope) {
+                energy = trial;
+                accepted = true;
+                break;
+            }
+        }
+
+        if (!accepted) {
+            mu *= 10.0;
+            Gradient(springs, loads, pos);
+            continue;
+        }
+        pos = fTrial;
+        mu = Max((alpha == 1.0) ? 0.25*mu : 4.0*mu, smallestShift);
+        residual = Gradient(springs, loads, pos);
+    }
+
+    fResidual = residual/(largestLoad > 0.0 ? largestLoad : 1.0);
+    return residual <= target;
+}
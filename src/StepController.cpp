@@ -0,0 +1,122 @@
+//
+// Adaptive time steps: stability limit of the explicit scheme, local error control and scheduled events.
+//
+
+#include "StepController.h"
+
+#include <cmath>
+
+static const char* limitNames[kNumStepLimits] = {
+    "max", "stability", "error", "growth", "min", "event"
+};
+
+StepController::StepController(double firstStep, double minStep, double maxStep, double tolerance, double safety,
+                               bool explicitScheme):
+    fMinStep(minStep),
+    fMaxStep(maxStep),
+    fTolerance(tolerance),
+    fSafety(safety),
+    fExplicit(explicitScheme),
+    fLastStep(firstStep),
+    fLastProposal(firstStep),
+    fSmallest(0.0),
+    fLargest(0.0)
+{
+    assert(minStep > 0.0 && maxStep >= minStep && tolerance > 0.0 && safety > 0.0);
+    for (int l = 0; l < kNumStepLimits; l++) fCounts[l] = 0;
+}
+
+double StepController::NextStep(double t, double nextEvent, double stableStep, double jerk) {
+
+    assert(nextEvent > t);
+
+    double dt = fMaxStep;
+    StepLimit limit = kStepLimitMax;
+
+    double error = jerk > 0.0 ? std::cbrt(6.0*fTolerance/jerk) : dt;
+    if (error < dt) {
+        dt = error;
+        limit = kStepLimitError;
+    }
+    if (STEP_GROWTH*fLastProposal < dt) {
+        dt = STEP_GROWTH*fLastProposal;
+        limit = kStepLimitGrowth;
+    }
+    if (dt < fMinStep) {
+        dt = fMinStep;
+        limit = kStepLimitMin;
+    }
+
+    /* the smallest step does not override the stability */
+    if (fExplicit && fSafety*stableStep < dt) {
+        dt = fSafety*stableStep;
+        limit = kStepLimitStability;
+    }
+    fLastProposal = dt;
+
+    /* land on the event, without leaving a sliver for the step after */
+    double gap = nextEvent - t;
+    if (dt >= gap) {
+        dt = gap;
+        limit = kStepLimitEvent;
+    }
+    else if (2.0*dt > gap) {
+        dt = 0.5*gap;
+        limit = kStepLimitEvent;
+    }
+
+    fCounts[limit]++;
+    fSmallest = (fSmallest > 0.0) ? Min(fSmallest, dt) : dt;
+    fLargest = Max(fLargest, dt);
+    fLastStep = dt;
+
+    return dt;
+}
+
+void StepController::Restore(double lastStep, double lastProposal) {
+    fLastStep = lastStep;
+    fLastProposal = lastProposal;
+}
+
+const char* StepController::LimitName(StepLimit limit) {
+    return limitNames[limit];
+}
+
+template <class REAL>
+double StableStep(const SpringNetwork& springs, int maxNodeSprings, const ArrayT<Vec3T<REAL> >& pos, double m) {
+
+    /* largest k |1 - rest/length| above k: only springs shorter than half their rest length */
+    double kMax = 0.0;
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+        double effective = spring.k;
+
+        Vec3T<REAL> d = pos[spring.i] - pos[spring.j];
+        double length2 = d.Dot(d);
+        if (4.0*length2 < spring.rest*spring.rest)
+            effective = spring.k*(spring.rest/Max(std::sqrt(length2), 1.0e-12*spring.rest) - 1.0);
+
+        kMax = Max(kMax, effective);
+    }
+
+    double omega2 = 2.0*maxNodeSprings*kMax/m;
+    return omega2 > 0.0 ? 2.0/std::sqrt(omega2) : 1.0e30;
+}
+
+template <class REAL>
+double MaxJerk(const ArrayT<Vec3T<REAL> >& acc, const ArrayT<Vec3T<REAL> >& accPrev, double dt) {
+
+    assert(acc.Length() == accPrev.Length() && dt > 0.0);
+
+    double change2 = 0.0;
+    for (int n = 0; n < acc.Length(); n++) {
+        Vec3T<REAL> d = acc[n] - accPrev[n];
+        change2 = Max(change2, double(d.Dot(d)));
+    }
+    return std::sqrt(change2)/dt;
+}
+
+template double StableStep(const SpringNetwork&, int, const ArrayT<Vec3>&, double);
+template double StableStep(const SpringNetwork&, int, const ArrayT<Vec3f>&, double);
+template double MaxJerk(const ArrayT<Vec3>&, const ArrayT<Vec3>&, double);
+template double MaxJerk(const ArrayT<Vec3f>&, const ArrayT<Vec3f>&, double);
@@ -0,0 +1,127 @@
+//
+// Provot's deformation constraints: over-stretched springs are projected back to a maximum strain
+// after the integration step.
+//
+
+#include "StrainLimiter.h"
+
+StrainLimiter::StrainLimiter(double maxStrain, int maxIterations, StrainSweep sweep):
+    fMaxStrain(maxStrain),
+    fMaxIterations(maxIterations),
+    fSweep(sweep),
+    fIterations(0),
+    fViolations(0)
+{
+    assert(maxStrain >= 0.0 && maxIterations >= 0);
+}
+
+template <class REAL>
+int StrainLimiter::SweepGaussSeidel(const SpringNetwork& springs, const char* fixed, ArrayT<Vec3T<REAL> >& pos,
+                                    Vec3T<REAL>* vel, REAL inverseDt) {
+
+    int violations = 0;
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+        if (fixed[spring.i] && fixed[spring.j]) continue;
+
+        REAL maxLength = REAL((1.0 + fMaxStrain)*spring.rest);
+        REAL share = (fixed[spring.i] || fixed[spring.j]) ? 1.0 : 0.5;
+
+        /* end point i takes its share of the excess, j the rest */
+        Vec3T<REAL> correction = StrainCorrection(pos[spring.i], pos[spring.j], maxLength, REAL(1));
+        if (correction.Magnitude() == 0.0) continue;
+        violations++;
+
+        Vec3T<REAL> delta = correction*share;
+        if (!fixed[spring.i]) pos[spring.i] += delta;
+        if (!fixed[spring.j]) pos[spring.j] -= delta;
+        if (vel) {
+            if (!fixed[spring.i]) vel[spring.i] += delta*inverseDt;
+            if (!fixed[spring.j]) vel[spring.j] -= delta*inverseDt;
+        }
+    }
+    return violations;
+}
+
+template <class REAL>
+int StrainLimiter::SweepJacobi(const SpringNetwork& springs, const char* fixed, Vec3* correction, int* count,
+                               ArrayT<Vec3T<REAL> >& pos, Vec3T<REAL>* vel, REAL inverseDt) {
+
+    for (int n = 0; n < pos.Length(); n++) {
+        correction[n] = Vec3(0, 0, 0);
+        count[n] = 0;
+    }
+
+    /* all the corrections are computed from the same positions */
+    int violations = 0;
+    for (int s = 0; s < springs.NumSprings(); s++) {
+        const Spring& spring = springs[s];
+        if (fixed[spring.i] && fixed[spring.j]) continue;
+
+        REAL maxLength = REAL((1.0 + fMaxStrain)*spring.rest);
+        REAL share = (fixed[spring.i] || fixed[spring.j]) ? 1.0 : 0.5;
+
+        /* accumulated in double whatever the precision of the positions */
+        Vec3 excess(StrainCorrection(pos[spring.i], pos[spring.j], maxLength, share));
+        if (excess.Magnitude() == 0.0) continue;
+        violations++;
+
+        correction[spring.i] += excess;
+        correction[spring.j] -= excess;
+        count[spring.i]++;
+        count[spring.j]++;
+    }
+
+    for (int n = 0; n < pos.Length(); n++) {
+        if (count[n] == 0 || fixed[n]) continue;
+        Vec3T<REAL> delta(correction[n]*(1.0/count[n]));
+        pos[n] += delta;
+        if (vel) vel[n] += delta*inverseDt;
+    }
+    return violations;
+}
+
+template <class REAL>
+int StrainLimiter::Apply(const SpringNetwork& springs, const ArrayT<int>& pinned, ArrayT<Vec3T<REAL> >& pos,
+                         const ArrayT<char>* asleep, ArrayT<Vec3T<REAL> >* vel, double dt) {
+
+    fIterations = 0;
+    fViolations = 0;
+    if (fMaxIterations == 0) return 0;
+
+    int numNodes = pos.Length();
+    ArrayT<char, ArenaAllocator<char> > fixed(numNodes);
+    if (asleep) {
+        assert(asleep->Length() == numNodes);
+        for (int n = 0; n < numNodes; n++) fixed[n] = (*asleep)[n];
+    }
+    else fixed = char(0);
+    for (int p = 0; p < pinned.Length(); p++) {
+        fixed[pinned[p]] = 1;
+    }
+    ArrayT<Vec3, ArenaAllocator<Vec3> > correction;
+    ArrayT<int, ArenaAllocator<int> > count;
+    if (fSweep == kJacobi) {
+        correction.Dimension(numNodes);
+        count.Dimension(numNodes);
+    }
+    assert(!vel || (vel->Length() == numNodes && dt > 0.0));
+    Vec3T<REAL>* velocity = vel ? vel->Pointer() : NULL;
+    REAL inverseDt = vel ? REAL(1.0/dt) : REAL(0);
+
+    /* a sweep which finds no over-stretched spring moves nothing and ends the iterations */
+    while (fIterations < fMaxIterations) {
+        fViolations = (fSweep == kJacobi)
+                      ? SweepJacobi(springs, fixed.Pointer(), correction.Pointer(), count.Pointer(), pos, velocity, inverseDt)
+                      : SweepGaussSeidel(springs, fixed.Pointer(), pos, velocity, inverseDt);
+        if (fViolations == 0) break;
+        fIterations++;
+    }
+    return fIterations;
+}
+
+/* the precisions of ClothSimulationT */
+template int StrainLimiter::Apply<double>(const SpringNetwork&, const ArrayT<int>&, ArrayT<Vec3>&, const ArrayT<char>*,
+                                          ArrayT<Vec3>*, double);
+template int StrainLimiter::Apply<float>(const SpringNetwork&, const ArrayT<int>&, ArrayT<Vec3f>&, const ArrayT<char>*,
+                                         ArrayT<Vec3f>*, double);
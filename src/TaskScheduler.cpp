@@ -0,0 +1,94 @@
+//
+// Work-stealing scheduler for batches of independent tasks of very different sizes.
+//
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+TaskScheduler::TaskScheduler(int numThreads):
+    fNumThreads(numThreads),
+    fSteals(0)
+{
+    if (fNumThreads <= 0) {
+        fNumThreads = (int) std::thread::hardware_concurrency();
+        if (fNumThreads <= 0) fNumThreads = 1;
+    }
+}
+
+void TaskScheduler::WorkerLoop(int thread, std::vector<Queue>& queues, const std::function<void(int, int)>& body,
+                               std::mutex& mutex, std::exception_ptr& error) {
+
+    while (true) {
+        int task = -1;
+
+        /* the largest task of its own queue */
+        {
+            Queue& own = queues[thread];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+            }
+        }
+
+        /* otherwise the smallest task of another queue, starting with the next thread */
+        for (int other = 1; task < 0 && other < fNumThreads; other++) {
+            Queue& victim = queues[(thread + other) % fNumThreads];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                std::lock_guard<std::mutex> statistics(mutex);
+                fSteals++;
+            }
+        }
+
+        /* tasks are never added during a run: all queues are empty */
+        if (task < 0) return;
+
+        fTaskThreads[task] = thread;
+        try {
+            body(task, thread);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = std::current_exception();
+        }
+    }
+}
+
+void TaskScheduler::Run(const ArrayT<double>& costs, const std::function<void(int, int)>& body) {
+
+    int numTasks = costs.Length();
+    fSteals = 0;
+    fTaskThreads.Dimension(numTasks);
+
+    /* the largest first, equal costs in their original order */
+    std::vector<int> order(numTasks);
+    for (int t = 0; t < numTasks; t++) order[t] = t;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] > costs[b]; });
+
+    std::vector<Queue> queues(fNumThreads);
+    for (int t = 0; t < numTasks; t++) {
+        queues[t % fNumThreads].tasks.push_back(order[t]);
+    }
+
+    std::mutex mutex;
+    std::exception_ptr error;
+
+    /* the calling thread is thread 0, the mutex guards the error and the statistics */
+    std::vector<std::thread> workers;
+    for (int thread = 1; thread < fNumThreads; thread++) {
+        workers.push_back(std::thread(&TaskScheduler::WorkerLoop, this, thread, std::ref(queues), std::cref(body),
+                                      std::ref(mutex), std::ref(error)));
+    }
+    WorkerLoop(0, queues, body, mutex, error);
+
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,91 @@
+//
+// A small pool of persistent worker threads for data-parallel loops.
+//
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int numThreads):
+    fNumThreads(numThreads),
+    fBody(NULL),
+    fBegin(0),
+    fEnd(0),
+    fGeneration(0),
+    fPending(0),
+    fShutDown(false)
+{
+    if (fNumThreads <= 0) {
+        fNumThreads = (int) std::thread::hardware_concurrency();
+        if (fNumThreads <= 0) fNumThreads = 1;
+    }
+
+    for (int part = 1; part < fNumThreads; part++) {
+        fWorkers.push_back(std::thread(&ThreadPool::WorkerLoop, this, part));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fShutDown = true;
+    }
+    fStart.notify_all();
+
+    for (size_t t = 0; t < fWorkers.size(); t++) {
+        fWorkers[t].join();
+    }
+}
+
+void ThreadPool::RunPart(int part) {
+
+    /* the same cut for the same number of threads */
+    long length = fEnd - fBegin;
+    int first = fBegin + (int) ((length*part)/fNumThreads);
+    int last = fBegin + (int) ((length*(part + 1))/fNumThreads);
+
+    if (first < last) (*fBody)(first, last);
+}
+
+void ThreadPool::WorkerLoop(int part) {
+
+    long generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fStart.wait(lock, [&]() { return fShutDown || fGeneration != generation; });
+            if (fShutDown) return;
+            generation = fGeneration;
+        }
+
+        RunPart(part);
+
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fPending--;
+        }
+        fDone.notify_one();
+    }
+}
+
+void ThreadPool::Run(int begin, int end, const LoopBody& body) {
+
+    if (fNumThreads == 1) {
+        if (begin < end) body(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fBody = &body;
+        fBegin = begin;
+        fEnd = end;
+        fPending = fNumThreads - 1;
+        fGeneration++;
+    }
+    fStart.notify_all();
+
+    RunPart(0);
+
+    std::unique_lock<std::mutex> lock(fMutex);
+    fDone.wait(lock, [&]() { return fPending == 0; });
+    fBody = NULL;
+}
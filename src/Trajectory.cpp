@@ -0,0 +1,314 @@
+//
+// Binary trajectory files: all the snapshots of a run in one file, read back with mmap.
+//
+
+#include "Trajectory.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(TrajectoryHeader) <= TRAJECTORY_HEADER_SIZE, "the trajectory header does not fit");
+static_assert(sizeof(TrajectoryIndexEntry) == 16, "unexpected padding of the trajectory index");
+
+TrajectoryWriter::TrajectoryWriter() {
+    memset(&fHeader, 0, sizeof(fHeader));
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string& filename, int numNodes, int gridSize, double dt,
+                                   std::initializer_list<const char*> fields) {
+    Open(filename, numNodes, gridSize, dt, fields);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    Close();
+}
+
+void TrajectoryWriter::SetHeader(int numNodes, int gridSize, double dt, std::initializer_list<const char*> fields) {
+
+    if (fields.size() < 1 || fields.size() > TRAJECTORY_MAX_FIELDS)
+        throw std::runtime_error("TrajectoryWriter: need 1 to TRAJECTORY_MAX_FIELDS fields");
+
+    memset(&fHeader, 0, sizeof(fHeader));
+    strcpy(fHeader.magic, TRAJECTORY_MAGIC);
+    fHeader.version = TRAJECTORY_VERSION;
+    fHeader.numNodes = numNodes;
+    fHeader.gridSize = gridSize;
+    fHeader.numFields = int32_t(fields.size());
+    fHeader.dt = dt;
+    fHeader.frameStride = TRAJECTORY_FRAME_HEADER + int64_t(fields.size())*3*numNodes*sizeof(double);
+
+    int f = 0;
+    for (const char* name : fields) {
+        strncpy(fHeader.fields[f++], name, TRAJECTORY_FIELD_NAME - 1);
+    }
+}
+
+void TrajectoryWriter::Open(const std::string& filename, int numNodes, int gridSize, double dt,
+                            std::initializer_list<const char*> fields) {
+
+    Close();
+    SetHeader(numNodes, gridSize, dt, fields);
+
+    fFile.open(filename, std::ios::binary | std::ios::trunc);
+    if (!fFile) throw std::runtime_error("TrajectoryWriter: cannot create " + filename);
+
+    /* the header padded to TRAJECTORY_HEADER_SIZE */
+    char block[TRAJECTORY_HEADER_SIZE] = {0};
+    memcpy(block, &fHeader, sizeof(fHeader));
+    fFile.write(block, TRAJECTORY_HEADER_SIZE);
+
+    fIndex.Dimension(0);
+    fBuffer.Dimension(3*numNodes);
+}
+
+void TrajectoryWriter::Resume(const std::string& filename, int numNodes, int gridSize, double dt,
+                              std::initializer_list<const char*> fields, long lastStep) {
+
+    Close();
+    SetHeader(numNodes, gridSize, dt, fields);
+
+    /* the frames to keep, if the file is a trajectory of the same kind */
+    long numKept = -1;
+    try {
+        TrajectoryReader reader(filename);
+        bool same = reader.NumNodes() == numNodes && reader.GridSize() == gridSize && reader.Dt() == dt &&
+                    reader.NumFields() == fHeader.numFields;
+        for (int f = 0; same && f < fHeader.numFields; f++) {
+            same = strncmp(reader.FieldName(f), fHeader.fields[f], TRAJECTORY_FIELD_NAME) == 0;
+        }
+
+        if (same) {
+            fIndex.Dimension(0);
+            for (long frame = 0; frame < reader.NumFrames() && reader.Step(frame) <= lastStep; frame++) {
+                TrajectoryIndexEntry entry = {reader.Time(frame), TRAJECTORY_HEADER_SIZE + frame*fHeader.frameStride};
+                fIndex.Insert(entry);
+            }
+            numKept = fIndex.Length();
+        }
+    }
+    catch (const std::runtime_error&) { }
+
+    if (numKept < 0) {
+        Open(filename, numNodes, gridSize, dt, fields);
+        return;
+    }
+
+    /* drop the later frames and the old index, the header is unfinished again until Close() */
+    if (truncate(filename.c_str(), TRAJECTORY_HEADER_SIZE + numKept*fHeader.frameStride) != 0)
+        throw std::runtime_error("TrajectoryWriter: cannot truncate " + filename);
+
+    fFile.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+    if (!fFile) throw std::runtime_error("TrajectoryWriter: cannot open " + filename);
+    fFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(fHeader));
+    fFile.seekp(0, std::ios::end);
+
+    fBuffer.Dimension(3*numNodes);
+}
+
+void TrajectoryWriter::WriteFrame(double time, long step, std::initializer_list<const ArrayT<Vec3>*> fields) {
+    WriteFrame(time, step, fields.begin(), int(fields.size()));
+}
+
+void TrajectoryWriter::WriteFrame(double time, long step, const ArrayT<Vec3>* const* fields, int numFields) {
+
+    assert(IsOpen());
+    assert(numFields == fHeader.numFields);
+
+    PROFILE_SCOPE(kProfileFileWrite);
+    PROFILE_BYTES(kProfileFileWrite, fHeader.frameStride);
+
+    TrajectoryIndexEntry entry = {time, TRAJECTORY_HEADER_SIZE + fIndex.Length()*fHeader.frameStride};
+    fIndex.Insert(entry);
+
+    int64_t step64 = step;
+    fFile.write(reinterpret_cast<const char*>(&time), sizeof(time));
+    fFile.write(reinterpret_cast<const char*>(&step64), sizeof(step64));
+
+    /* interleaved x, y, z whatever the layout of Vec3 */
+    for (int f = 0; f < numFields; f++) {
+        const ArrayT<Vec3>* field = fields[f];
+        assert(field->Length() == fHeader.numNodes);
+
+        double* out = fBuffer.Pointer();
+        for (int n = 0; n < fHeader.numNodes; n++) {
+            const Vec3& v = (*field)[n];
+            *out++ = v.x;
+            *out++ = v.y;
+            *out++ = v.z;
+        }
+        fFile.write(reinterpret_cast<const char*>(fBuffer.Pointer()), fBuffer.Length()*sizeof(double));
+    }
+
+    if (!fFile) throw std::runtime_error("TrajectoryWriter: write failed");
+}
+
+void TrajectoryWriter::Flush() {
+    fFile.flush();
+}
+
+void TrajectoryWriter::Close() {
+
+    if (!fFile.is_open()) return;
+
+    fHeader.numFrames = fIndex.Length();
+    fHeader.indexOffset = TRAJECTORY_HEADER_SIZE + fIndex.Length()*fHeader.frameStride;
+
+    fFile.write(reinterpret_cast<const char*>(fIndex.Pointer()), fIndex.Length()*sizeof(TrajectoryIndexEntry));
+
+    /* the completed header marks the file as finished */
+    fFile.seekp(0);
+    fFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(fHeader));
+    fFile.close();
+}
+
+TrajectoryReader::TrajectoryReader():
+    fDescriptor(-1),
+    fData(NULL),
+    fSize(0),
+    fHeader(NULL),
+    fIndex(NULL),
+    fNumFrames(0)
+{ }
+
+TrajectoryReader::TrajectoryReader(const std::string& filename):
+    TrajectoryReader()
+{
+    Open(filename);
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    Close();
+}
+
+void TrajectoryReader::Open(const std::string& filename) {
+
+    Close();
+
+    fDescriptor = open(filename.c_str(), O_RDONLY);
+    if (fDescriptor < 0) throw std::runtime_error("TrajectoryReader: cannot open " + filename);
+
+    struct stat status;
+    if (fstat(fDescriptor, &status) != 0 || size_t(status.st_size) < TRAJECTORY_HEADER_SIZE) {
+        Close();
+        throw std::runtime_error("TrajectoryReader: " + filename + " is too short");
+    }
+    fSize = status.st_size;
+
+    void* data = mmap(NULL, fSize, PROT_READ, MAP_SHARED, fDescriptor, 0);
+    if (data == MAP_FAILED) {
+        Close();
+        throw std::runtime_error("TrajectoryReader: cannot map " + filename);
+    }
+    fData = static_cast<const char*>(data);
+    fHeader = reinterpret_cast<const TrajectoryHeader*>(fData);
+
+    if (strncmp(fHeader->magic, TRAJECTORY_MAGIC, sizeof(fHeader->magic)) != 0 ||
+        fHeader->version != TRAJECTORY_VERSION) {
+        Close();
+        throw std::runtime_error("TrajectoryReader: " + filename + " is not a trajectory of this version");
+    }
+
+    /* the frames are found from the stride, which must be that of the fields, a corrupt one is not divided by */
+    int64_t stride = int64_t(TRAJECTORY_FRAME_HEADER) + int64_t(fHeader->numFields)*3*fHeader->numNodes*int64_t(sizeof(double));
+    if (fHeader->numFields < 1 || fHeader->numFields > TRAJECTORY_MAX_FIELDS || fHeader->numNodes < 0 ||
+        fHeader->frameStride <= 0 || fHeader->frameStride != stride) {
+        Close();
+        throw std::runtime_error("TrajectoryReader: " + filename + " has an invalid header");
+    }
+
+    /* the complete frames of an unfinished file */
+    if (fHeader->indexOffset == 0) {
+        fIndex = NULL;
+        fNumFrames = (fSize - TRAJECTORY_HEADER_SIZE)/fHeader->frameStride;
+        return;
+    }
+
+    /* the index of a closed file lies within it, and so does every frame it points to; the sizes are
+       compared by division so that a corrupt count cannot overflow */
+    int64_t size = int64_t(fSize);
+    int64_t indexOffset = fHeader->indexOffset;
+    int64_t numFrames = fHeader->numFrames;
+    bool valid = indexOffset >= int64_t(TRAJECTORY_HEADER_SIZE) && indexOffset <= size &&
+                 indexOffset % sizeof(int64_t) == 0 && numFrames >= 0 &&
+                 numFrames <= (size - indexOffset)/int64_t(sizeof(TrajectoryIndexEntry));
+    const TrajectoryIndexEntry* index = reinterpret_cast<const TrajectoryIndexEntry*>(fData + indexOffset);
+    for (int64_t f = 0; valid && f < numFrames; f++) {
+        int64_t offset = index[f].offset;
+        valid = offset >= int64_t(TRAJECTORY_HEADER_SIZE) && offset % sizeof(int64_t) == 0 &&
+                offset <= indexOffset - fHeader->frameStride;
+    }
+    if (!valid) {
+        Close();
+        throw std::runtime_error("TrajectoryReader: " + filename + " has an invalid frame index");
+    }
+    fIndex = index;
+    fNumFrames = numFrames;
+}
+
+void TrajectoryReader::Close() {
+
+    if (fData != NULL) munmap(const_cast<char*>(fData), fSize);
+    if (fDescriptor >= 0) close(fDescriptor);
+
+    fDescriptor = -1;
+    fData = NULL;
+    fSize = 0;
+    fHeader = NULL;
+    fIndex = NULL;
+    fNumFrames = 0;
+}
+
+int TrajectoryReader::FieldIndex(const std::string& name) const {
+
+    for (int f = 0; f < NumFields(); f++) {
+        if (name == FieldName(f)) return f;
+    }
+    return -1;
+}
+
+const char* TrajectoryReader::Frame(long f) const {
+
+    assert(f >= 0 && f < fNumFrames);
+
+    int64_t offset = fIndex ? fIndex[f].offset : TRAJECTORY_HEADER_SIZE + f*fHeader->frameStride;
+    return fData + offset;
+}
+
+double TrajectoryReader::Time(long frame) const {
+
+    double time;
+    memcpy(&time, Frame(frame), sizeof(time));
+    return time;
+}
+
+long TrajectoryReader::Step(long frame) const {
+
+    int64_t step;
+    memcpy(&step, Frame(frame) + sizeof(double), sizeof(step));
+    return long(step);
+}
+
+const double* TrajectoryReader::Field(long frame, int field) const {
+
+    assert(field >= 0 && field < NumFields());
+
+    /* frames and fields are multiples of 8 bytes from the page aligned mapping */
+    const char* data = Frame(frame) + TRAJECTORY_FRAME_HEADER + size_t(field)*3*NumNodes()*sizeof(double);
+    return reinterpret_cast<const double*>(data);
+}
+
+void TrajectoryReader::CopyField(long frame, int field, ArrayT<Vec3>& values) const {
+
+    const double* data = Field(frame, field);
+
+    values.Dimension(NumNodes());
+    for (int n = 0; n < NumNodes(); n++) {
+        values[n] = Vec3(data[3*n], data[3*n + 1], data[3*n + 2]);
+    }
+}
@@ -0,0 +1,300 @@
+//
+// Triangle meshes: the static obstacles the cloth collides with and the garments it is made of.
+//
+
+#include "TriangleMesh.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+TriangleMesh ReadObj(const std::string& filename) {
+
+    std::ifstream in(filename);
+    if (!in) throw std::runtime_error("ReadObj: cannot open " + filename);
+
+    TriangleMesh mesh;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+
+        if (keyword == "v") {
+            double x, y, z;
+            if (!(words >> x >> y >> z))
+                throw std::runtime_error("ReadObj: bad vertex at line " + std::to_string(lineNumber) + " of " + filename);
+            mesh.vertices.Insert(Vec3(x, y, z));
+        }
+        else if (keyword == "f") {
+            /* the vertex index leads "a/t/n", counted from 1 or from the end if negative */
+            ArrayT<int> face;
+            std::string corner;
+            while (words >> corner) {
+                int index = atoi(corner.c_str());
+                index = index < 0 ? mesh.NumVertices() + index : index - 1;
+                if (index < 0 || index >= mesh.NumVertices())
+                    throw std::runtime_error("ReadObj: missing vertex at line " + std::to_string(lineNumber) + " of " + filename);
+                face.Insert(index);
+            }
+            if (face.Length() < 3)
+                throw std::runtime_error("ReadObj: bad face at line " + std::to_string(lineNumber) + " of " + filename);
+
+            /* a fan around the first corner */
+            for (int c = 1; c + 1 < face.Length(); c++) {
+                mesh.triangles.Insert(face[0]);
+                mesh.triangles.Insert(face[c]);
+                mesh.triangles.Insert(face[c + 1]);
+            }
+        }
+    }
+    return mesh;
+}
+
+namespace {
+
+/** \name the header of a PLY file */
+/*@{*/
+enum PlyFormat { kPlyAscii, kPlyLittleEndian, kPlyBigEndian };
+
+struct PlyProperty {
+    std::string name;
+    std::string type;           /**< of the values */
+    std::string countType;      /**< of the length of a list, empty for single values */
+};
+
+struct PlyElement {
+    std::string name;
+    long count;
+    std::vector<PlyProperty> properties;
+};
+/*@}*/
+
+}
+
+/* bytes of a value of a PLY type, 0 for an unknown type */
+static int PlyTypeSize(const std::string& type) {
+    if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+    if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+    if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32") return 4;
+    if (type == "double" || type == "float64") return 8;
+    return 0;
+}
+
+/* the next value of a PLY file as a double */
+static double ReadPlyValue(std::istream& in, PlyFormat format, const std::string& type, const std::string& filename) {
+
+    if (format == kPlyAscii) {
+        double value;
+        if (!(in >> value)) throw std::runtime_error("ReadPly: unexpected end of " + filename);
+        return value;
+    }
+
+    unsigned char bytes[8];
+    int size = PlyTypeSize(type);
+    if (!in.read(reinterpret_cast<char*>(bytes), size)) throw std::runtime_error("ReadPly: unexpected end of " + filename);
+
+    /* to the byte order of this machine */
+    uint16_t probe = 1;
+    bool littleEndian = *reinterpret_cast<unsigned char*>(&probe) == 1;
+    if (littleEndian != (format == kPlyLittleEndian)) {
+        for (int b = 0; b < size/2; b++) std::swap(bytes[b], bytes[size - 1 - b]);
+    }
+
+    if (type == "char" || type == "int8") return double(*reinterpret_cast<int8_t*>(bytes));
+    if (type == "uchar" || type == "uint8") return double(bytes[0]);
+    if (type == "short" || type == "int16") { int16_t v; memcpy(&v, bytes, 2); return double(v); }
+    if (type == "ushort" || type == "uint16") { uint16_t v; memcpy(&v, bytes, 2); return double(v); }
+    if (type == "int" || type == "int32") { int32_t v; memcpy(&v, bytes, 4); return double(v); }
+    if (type == "uint" || type == "uint32") { uint32_t v; memcpy(&v, bytes, 4); return double(v); }
+    if (type == "float" || type == "float32") { float v; memcpy(&v, bytes, 4); return double(v); }
+    double v;
+    memcpy(&v, bytes, 8);
+    return v;
+}
+
+TriangleMesh ReadPly(const std::string& filename) {
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) throw std::runtime_error("ReadPly: cannot open " + filename);
+
+    /* the header, up to end_header */
+    std::string line;
+    std::getline(in, line);
+    if (line.compare(0, 3, "ply") != 0) throw std::runtime_error("ReadPly: " + filename + " is not a PLY file");
+
+    PlyFormat format = kPlyAscii;
+    std::vector<PlyElement> elements;
+    bool ended = false;
+    while (!ended && std::getline(in, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+
+        if (keyword == "format") {
+            std::string name;
+            words >> name;
+            if (name == "ascii") format = kPlyAscii;
+            else if (name == "binary_little_endian") format = kPlyLittleEndian;
+            else if (name == "binary_big_endian") format = kPlyBigEndian;
+            else throw std::runtime_error("ReadPly: unknown format " + name + " of " + filename);
+        }
+        else if (keyword == "element") {
+            PlyElement element;
+            if (!(words >> element.name >> element.count) || element.count < 0)
+                throw std::runtime_error("ReadPly: bad element in the header of " + filename);
+            elements.push_back(element);
+        }
+        else if (keyword == "property") {
+            PlyProperty property;
+            words >> property.type;
+            if (property.type == "list") words >> property.countType >> property.type;
+            words >> property.name;
+            if (elements.empty() || property.name.empty() || PlyTypeSize(property.type) == 0 ||
+                (!property.countType.empty() && PlyTypeSize(property.countType) == 0))
+                throw std::runtime_error("ReadPly: bad property in the header of " + filename);
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header") ended = true;
+    }
+    if (!ended) throw std::runtime_error("ReadPly: no end_header in " + filename);
+
+    /* the elements in the order of the header */
+    TriangleMesh mesh;
+    for (const PlyElement& element : elements) {
+        bool vertex = element.name == "vertex";
+        bool face = element.name == "face";
+
+        for (long e = 0; e < element.count; e++) {
+            double x = 0.0, y = 0.0, z = 0.0;
+            ArrayT<int> corners;
+            for (const PlyProperty& property : element.properties) {
+                bool indices = face && (property.name == "vertex_indices" || property.name == "vertex_index");
+                if (property.countType.empty()) {
+                    double value = ReadPlyValue(in, format, property.type, filename);
+                    if (vertex && property.name == "x") x = value;
+                    else if (vertex && property.name == "y") y = value;
+                    else if (vertex && property.name == "z") z = value;
+                    continue;
+                }
+                int count = int(ReadPlyValue(in, format, property.countType, filename));
+                for (int c = 0; c < count; c++) {
+                    int index = int(ReadPlyValue(in, format, property.type, filename));
+                    if (indices) corners.Insert(index);
+                }
+            }
+
+            if (vertex) mesh.vertices.Insert(Vec3(x, y, z));
+            if (face) {
+                if (corners.Length() < 3) throw std::runtime_error("ReadPly: bad face in " + filename);
+                for (int c = 0; c < corners.Length(); c++) {
+                    if (corners[c] < 0 || corners[c] >= mesh.NumVertices())
+                        throw std::runtime_error("ReadPly: missing vertex of a face in " + filename);
+                }
+
+                /* a fan around the first corner */
+                for (int c = 1; c + 1 < corners.Length(); c++) {
+                    mesh.triangles.Insert(corners[0]);
+                    mesh.triangles.Insert(corners[c]);
+                    mesh.triangles.Insert(corners[c + 1]);
+                }
+            }
+        }
+    }
+    return mesh;
+}
+
+TriangleMesh ReadMesh(const std::string& filename) {
+
+    size_t dot = filename.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : filename.substr(dot + 1);
+    for (size_t c = 0; c < extension.size(); c++) extension[c] = char(tolower(extension[c]));
+
+    return extension == "ply" ? ReadPly(filename) : ReadObj(filename);
+}
+
+void WriteObj(const std::string& filename, const TriangleMesh& mesh) {
+
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("WriteObj: cannot create " + filename);
+
+    out.precision(17);
+    for (int v = 0; v < mesh.NumVertices(); v++)
+        out << "v " << mesh.vertices[v].x << " " << mesh.vertices[v].y << " " << mesh.vertices[v].z << "\n";
+    for (int t = 0; t < mesh.NumTriangles(); t++)
+        out << "f " << mesh.triangles[3*t] + 1 << " " << mesh.triangles[3*t + 1] + 1 << " " << mesh.triangles[3*t + 2] + 1 << "\n";
+    if (!out) throw std::runtime_error("WriteObj: write failed");
+}
+
+TriangleMesh SphereMesh(const Vec3& center, double radius, int segments) {
+
+    assert(segments >= 4 && radius > 0.0);
+    const double pi = std::acos(-1.0);
+    int rings = segments/2;
+
+    /* the poles and the vertices of the parallels in between */
+    TriangleMesh mesh;
+    mesh.vertices.Insert(center + Vec3(0.0, 0.0, radius));
+    for (int r = 1; r < rings; r++) {
+        double polar = pi*r/rings;
+        for (int s = 0; s < segments; s++) {
+            double azimuth = 2.0*pi*s/segments;
+            mesh.vertices.Insert(center + Vec3(radius*std::sin(polar)*std::cos(azimuth),
+                                               radius*std::sin(polar)*std::sin(azimuth), radius*std::cos(polar)));
+        }
+    }
+    mesh.vertices.Insert(center + Vec3(0.0, 0.0, -radius));
+    int south = mesh.NumVertices() - 1;
+
+    /* vertex s of parallel r */
+    auto vertex = [&](int r, int s) { return 1 + (r - 1)*segments + (s % segments); };
+
+    for (int s = 0; s < segments; s++) {
+        int top[3] = {0, vertex(1, s), vertex(1, s + 1)};
+        int bottom[3] = {south, vertex(rings - 1, s + 1), vertex(rings - 1, s)};
+        for (int c = 0; c < 3; c++) mesh.triangles.Insert(top[c]);
+        for (int c = 0; c < 3; c++) mesh.triangles.Insert(bottom[c]);
+    }
+    for (int r = 1; r + 1 < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            int quad[6] = {vertex(r, s), vertex(r + 1, s), vertex(r + 1, s + 1),
+                           vertex(r, s), vertex(r + 1, s + 1), vertex(r, s + 1)};
+            for (int c = 0; c < 6; c++) mesh.triangles.Insert(quad[c]);
+        }
+    }
+    return mesh;
+}
+
+TriangleMesh TubeMesh(const Vec3& center, double radius, double height, int segments, int rings) {
+
+    assert(segments >= 3 && rings >= 1 && radius > 0.0 && height > 0.0);
+    const double pi = std::acos(-1.0);
+
+    TriangleMesh mesh;
+    for (int r = 0; r <= rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            double azimuth = 2.0*pi*s/segments;
+            mesh.vertices.Insert(center + Vec3(radius*std::cos(azimuth), radius*std::sin(azimuth), height*(rings - r)/rings));
+        }
+    }
+
+    /* vertex s of circle r */
+    auto vertex = [&](int r, int s) { return r*segments + (s % segments); };
+
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            int quad[6] = {vertex(r, s), vertex(r + 1, s), vertex(r + 1, s + 1),
+                           vertex(r, s), vertex(r + 1, s + 1), vertex(r, s + 1)};
+            for (int c = 0; c < 6; c++) mesh.triangles.Insert(quad[c]);
+        }
+    }
+    return mesh;
+}
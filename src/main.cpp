@@ -14,298 +14,197 @@
  */
 #include "Vec3.h"
 #include "ArrayT.h"
-
+#include "Options.h"
+#include "ThreadPool.h"
+#include "ClothSimulation.h"
+#include "AsyncTrajectoryWriter.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
-/** Adding two arrays of containing cartesian vectors Vec3 */
-ArrayT<Vec3> AddArrays(ArrayT<Vec3> arr1, ArrayT<Vec3> arr2);
-
-/** Adding three arrays of containing cartesian vectors */
-ArrayT<Vec3> AddArrays(ArrayT<Vec3> arr1, ArrayT<Vec3> arr2, ArrayT<Vec3> arr3);
-
-/* Set each vector of the array to scaled */
-ArrayT<Vec3> SetToScaled(ArrayT<Vec3> arr, double scale);
-
-/** The connectivity structure creates an array of connected indices: an array of vectors */
-ArrayT<vector<int>> ConnectivityStructure(int N);
-
-/* Calculate internal spring forces */
-void internal_forces(ArrayT<vector<int>> indices, ArrayT<Vec3> pos, ArrayT<Vec3> pos0, double k, ArrayT<Vec3> &force_int);
-
-/* Viscous forces! */
-void viscous_forces(ArrayT<Vec3> vel, double vis_coeff, ArrayT<Vec3> &force_vis);
-
-/* Applying external forces */
-void gravity_force(double mass, ArrayT<Vec3> &force_gravity);
-
-/* Writing the output in a csv */
-void write_csv(const std::string& filename, ArrayT<Vec3> dataset);
-
-
-int main() {
+/* the trajectory is written in double whatever the precision of the run */
+static const ArrayT<Vec3>& AsDouble(const ArrayT<Vec3>& values, ArrayT<Vec3>&) {
+    return values;
+}
 
-    /** \name geometrical size */
-    /*@{*/
-    int N = 20;
-    double length = 10;
-    /*@}*/
+static const ArrayT<Vec3>& AsDouble(const ArrayT<Vec3f>& values, ArrayT<Vec3>& copy) {
+    copy.Dimension(values.Length());
+    for (int n = 0; n < values.Length(); n++) copy[n] = Vec3(values[n]);
+    return copy;
+}
 
-    /** \name material properties */
-    /*@{*/
-    double m = 0.1;
-    double k = 1000.0;
-    double c = 0.0001;
-    /*@}*/
+/* the snapshot of a garment in the order of its file */
+static const ArrayT<Vec3>& InImportOrder(const ArrayT<Vec3>& values, const ArrayT<int>& importIndex, ArrayT<Vec3>& copy) {
+    if (importIndex.Length() == 0) return values;
+    copy.Dimension(values.Length());
+    for (int n = 0; n < values.Length(); n++) copy[importIndex[n]] = values[n];
+    return copy;
+}
 
-    /** \name time integration parameters */
-    /*@{*/
-    double dt = 0.001;
-    double t_final = 2000;
-    /*@}*/
+/* the time loop in the precision REAL */
+template <class REAL>
+static int Run(const SimulationOptions& options) {
 
-    /* Create the mapping between connected nodes */
-    ArrayT<vector<int>> Indices = ConnectivityStructure(N);
+    int N = options.N;
+    double dt = options.dt;
 
-    /* Pre-allocate arrays */
-    ArrayT<Vec3> pos0, vel, acc;
-    pos0.Dimension(N*N);
-    vel.Dimension(N*N);
-    acc.Dimension(N*N);
+    /* Threads of the force stage */
+    ThreadPool pool(options.threads);
 
-    /* Initialization! */
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            /* Initialize kinematic information Coord, Velocity and Acceleration */
-            pos0[N*j + i] = Vec3(i * length / (N - 1), j * length / (N - 1), 0.0);
-            vel[N*j + i] = Vec3(0.0, 0.0, 0.0);
-            acc[N*j + i] = Vec3(0.0, 0.0, 0.0);
+    /* The cloth at rest, or as it was at the checkpoint */
+    ClothSimulationT<REAL> sim(options, &pool);
+    bool restarted = !options.restart.empty();
+    if (restarted) {
+        try {
+            sim.ReadCheckpoint(options.restart);
+        }
+        catch (const std::runtime_error& error) {
+            cerr << "ERR: " << error.what() << "\n";
+            return 1;
         }
     }
 
-    // Write the initial configuration of nodes
-    write_csv("pos_init.csv", pos0);
-
-    // time zero!
-    double t = 0.0;
-
-    // Allocating arrays for force calculations
-    ArrayT<Vec3> forces, force_int, force_vis, force_gravity;
-    forces.Dimension(N*N);
-    force_int.Dimension(N*N);
-    force_vis.Dimension(N*N);
-    force_gravity.Dimension(N*N);
-
-    // Copy to the new position vector
-    ArrayT<Vec3> pos;
-    pos = pos0;
-
-    // Copy to the old position vector
-    ArrayT<Vec3> pos_old;
-    pos_old = pos0;
+    /* The hanging phase solved as a static problem instead of stepped through */
+    if (!restarted && options.start == "equilibrium") {
+        auto solve = std::chrono::steady_clock::now();
+        bool converged = sim.StartFromEquilibrium();
+        if (const StaticSolver* equilibrium = sim.Equilibrium()) {
+            cout << "equilibrium: " << equilibrium->Iterations() << " Newton steps, " << equilibrium->CGIterations()
+                 << " CG iterations, residual force " << equilibrium->Residual() << " of the nodal weight in "
+                 << std::chrono::duration<double>(std::chrono::steady_clock::now() - solve).count() << " s\n";
+        }
+        if (!converged) cerr << "WARNING: the equilibrium did not reach --newton_tol, stepping through the hanging phase instead\n";
+    }
+    long first = sim.Counter();
+    double first_time = sim.Time();
+
+
+    /* All the snapshots go to one trajectory file, starting with the initial configuration. They
+     * are written by a background thread. A restarted run continues the trajectory of its
+     * checkpoint */
+    ArrayT<Vec3> pos, forces, filePos, fileForces;
+    const ArrayT<int>& importIndex = sim.ImportIndices();
+    int gridSize = options.garment.empty() ? N : 0;
+    AsyncTrajectoryWriter trajectory(options.output, sim.NumNodes(), gridSize, dt, {"pos", "force"}, options.output_buffers,
+                                     restarted ? first : -1);
+    auto submit = [&]() {
+        trajectory.Submit(sim.Time(), sim.Counter(), {&InImportOrder(AsDouble(sim.Positions(), pos), importIndex, filePos),
+                                                      &InImportOrder(AsDouble(sim.Forces(), forces), importIndex, fileForces)});
+    };
+    if (!restarted) submit();
+
+    /* The share of the cloth still awake at every output, with sleeping tiles */
+    std::ofstream activity;
+    if (sim.Activity()) {
+        activity.open(options.activity, restarted ? std::ios::app : std::ios::trunc);
+        if (!activity) {
+            cerr << "ERR: cannot open " << options.activity << "\n";
+            return 1;
+        }
+        if (!restarted) activity << "time,active_nodes,active_fraction\n";
+    }
 
-    // counter for exporting data
-    int counter = 0;
+    auto start = std::chrono::steady_clock::now();
 
     // Time stepping!
-    while (t < t_final) {
-
-        /* Calculating forces */
-        internal_forces(Indices, pos, pos0, k, force_int);
-        viscous_forces(vel, c, force_vis);
-        gravity_force(m, force_gravity);
-
-        /* Adding forces together */
-        forces = AddArrays(force_int, force_vis, force_gravity);
-
-        /** Verlet Integration scheme: */
-        /* calculate accelerations */
-        acc = SetToScaled(forces, 1.0/m);
-        acc[0] = Vec3(0,0,0);       /**< keep the fixed BC corner top-left  */
-        acc[N-1] = Vec3(0,0,0);     /**< keep the fixed BC corner top-right */
-
-        /** Condition for letting go of the rope at time t = 1000 */
-        if (t < 1000) acc[N*(N-1)] = Vec3(0,0,0);
-
-        /* calculate positions */
-        pos = AddArrays(SetToScaled(pos, 2.0), SetToScaled(pos_old, -1), SetToScaled(acc, dt*dt));
-        pos[0] = pos0[0];           /**< keep the fixed BC corner top-left  */
-        pos[N-1] = pos0[N-1];       /**< keep the fixed BC corner top-right */
-
-        /** Condition for letting go of the rope at time t = 1000 */
-        if (t < 1000) pos[N*(N-1)] = pos0[N*(N-1)];
-
-        /* update the old position vector */
-        pos_old = pos;
-
-        /* update time */
-        t += dt;
+    while (!sim.Finished()) {
 
-        counter++;
+        sim.Step();
 
-        /* create outputs */
-        if (counter % 10000 == 0) {
-            std::string pos_filename = "pos_t" + std::to_string(int(t)) + ".csv";
-            write_csv(pos_filename, pos);
-
-            std::string force_filename = "force_t" + std::to_string(int(t)) + ".csv";
-            write_csv(force_filename, forces);
+        /* create outputs every output_interval time units, checkpoints every checkpoint_interval and at the end */
+        if (sim.OnMultipleOf(options.output_interval)) {
+            PROFILE_SCOPE(kProfileOutput);
+            submit();
+            if (const ActivityTracker* tracker = sim.Activity())
+                activity << sim.Time() << "," << tracker->ActiveNodes() << "," << tracker->ActiveFraction() << "\n";
+        }
+        if (sim.OnMultipleOf(options.checkpoint_interval)) {
+            sim.WriteCheckpoint(options.checkpoint);
         }
     }
-
-    return 0;
-}
-
-
-ArrayT<Vec3> AddArrays(ArrayT<Vec3> arr1, ArrayT<Vec3> arr2) {
-
-    /* First check the size match */
-    assert(arr1.Length() == arr2.Length());
-
-    ArrayT<Vec3> vecSum;
-
-    for (int i = 0; i < arr1.Length(); i++) {
-        vecSum.Insert(arr1[i] + arr2[i]);
+    {
+        PROFILE_SCOPE(kProfileOutput);
+        trajectory.Close();
     }
-
-    return vecSum;
-}
-
-ArrayT<Vec3> AddArrays(ArrayT<Vec3> arr1, ArrayT<Vec3> arr2, ArrayT<Vec3> arr3) {
-    assert(arr1.Length() == arr2.Length() && arr2.Length() == arr3.Length());
-
-    ArrayT<Vec3> vecSum;
-
-    for (int i = 0; i < arr1.Length(); i++) {
-        vecSum.Insert(arr1[i] + arr2[i] + arr3[i]);
+    sim.WriteCheckpoint(options.checkpoint);
+
+    long counter = sim.Counter() - first;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cout << options.integrator << ": " << counter << " steps";
+    if (!sim.Controller()) cout << " of dt = " << dt;
+    cout << " in " << seconds << " s";
+    if (const ImplicitIntegrator* integrator = sim.Integrator())
+        cout << ", " << double(integrator->TotalIterations())/Max(integrator->TotalSolves(), 1L) << " CG iterations per step";
+    cout << "\n";
+    if (sim.Integrator() && sim.Integrator()->TotalSingularBlocks() > 0)
+        cout << "WARNING: " << sim.Integrator()->TotalSingularBlocks()
+             << " singular diagonal blocks were preconditioned by their diagonal alone\n";
+    if (const StepController* controller = sim.Controller()) {
+        cout << "adaptive: steps from " << controller->Smallest() << " to " << controller->Largest() << ", "
+             << (sim.Time() - first_time)/Max(counter, 1L) << " on average, set by";
+        for (int l = 0; l < kNumStepLimits; l++)
+            cout << " " << StepController::LimitName(StepLimit(l)) << " " << controller->Count(StepLimit(l));
+        cout << "\n";
     }
-
-    return vecSum;
-}
-
-ArrayT<Vec3> SetToScaled(ArrayT<Vec3> arr, double scale) {
-
-    ArrayT<Vec3> scaledArr;
-    scaledArr.Dimension(arr.Length());
-
-    for (int i = 0; i < arr.Length(); i++) {
-        scaledArr[i] = arr[i]*(scale);
+    if (const ActivityTracker* tracker = sim.Activity()) {
+        cout << "sleeping tiles: " << 100.0*tracker->MeanActiveFraction() << "% of the nodes awake on average, "
+             << tracker->NumAwakeTiles() << " of " << tracker->NumTiles() << " tiles awake at the end\n";
     }
-    return scaledArr;
-}
-
-/* Creating an array of STL vectors containing nodal (array indicies) connected to the index */
-ArrayT<vector<int>> ConnectivityStructure(int N) {
-
-    ArrayT<vector<int>> Connectivity(N*N);
-
-    /** Structure springs connections */
-    /*@{*/
-    /* Horizontals: (i, j)<--->(i+1, j)  */
-    for (int i = 0; i < N-1; i++) {
-        for (int j = 0; j < N; j++) {
-            Connectivity[N*j + i].push_back(N*j + i+1);
-            Connectivity[N*j + i+1].push_back(N*j + i);
-        }
+    if (const SelfCollision* collision = sim.Collision()) {
+        cout << "self collision: " << collision->TotalContacts() << " contacts resolved, " << collision->Contacts()
+             << " in the last step\n";
     }
-    /* Verticals: (i, j)<--->(i, j+1) */
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N-1; j++) {
-            Connectivity[N*j + i].push_back(N*(j+1) + i);
-            Connectivity[N*(j+1) + i].push_back(N*j + i);
-        }
-    } // End of structure springs
-    /*@}*/
-
-    /** Shear springs connections */
-    /*@{*/
-    /* left-to-rights: (i, j)<--->(i+1, j+1) */
-    for (int i = 0; i < N-1; i++) {
-        for (int j = 0; j < N-1; j++) {
-            Connectivity[N*j + i].push_back(N*(j+1) + i+1);
-            Connectivity[N*(j+1) + i+1].push_back(N*j + i);
-        }
+    if (!options.garment.empty()) {
+        cout << "garment: " << sim.NumNodes() << " nodes, " << sim.Springs().NumSprings() << " springs in "
+             << options.node_order << " order, bandwidth " << Bandwidth(sim.Springs()) << ", mean span "
+             << MeanSpringSpan(sim.Springs()) << "\n";
     }
-    /* right-to-left: (i, j)<--->(i-1, j+1) */
-    for (int i = 1; i < N; i++) {
-        for (int j = 0; j < N-1; j++) {
-            Connectivity[N*j + i].push_back(N*(j+1) + i-1);
-            Connectivity[N*(j+1) + i-1].push_back(N*j + i);
-        }
-    } // End of shear springs
-    /*@}*/
-
-    /** Bending springs */
-    /*@{*/
-    /* Horizontals: (i, j)<--->(i+2, j) */
-    for (int i = 0; i < N-2; i++) {
-        for (int j = 0; j < N; j++) {
-            Connectivity[N*j + i].push_back(N*j + i+2);
-            Connectivity[N*j + i+2].push_back(N*j + i);
-        }
+    if (const Obstacle* obstacle = sim.Obstacles()) {
+        cout << "obstacle: " << obstacle->Hierarchy().NumTriangles() << " triangles in " << obstacle->Hierarchy().NumNodes()
+             << " boxes, " << obstacle->TotalContacts() << " node contacts resolved, " << obstacle->Contacts()
+             << " in the last step\n";
     }
-    /* verticals: (i, j)<--->(i, j+2) */
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N-2; j++) {
-            Connectivity[N*j + i].push_back(N*(j+2) + i);
-            Connectivity[N*(j+2) + i].push_back(N*j + i);
-        }
-    } // End of bending springs
-    /*@}*/
+    cout << "output: " << trajectory.NumWritten() << " frames, queue depth " << trajectory.AverageQueueDepth()
+         << " on average and " << trajectory.MaxQueueDepth() << " at most of " << trajectory.NumBuffers()
+         << ", stepping stalled " << trajectory.StallSeconds() << " s\n";
+    PROFILE_PRINT(cout, counter, sim.NumNodes(), seconds);
 
-    return Connectivity;
+    return 0;
 }
 
-/* calculates internal fores */
-void internal_forces(ArrayT<vector<int>> indices, ArrayT<Vec3> pos, ArrayT<Vec3> pos0, double k, ArrayT<Vec3> &force_int) {
-    for (int i = 0; i < pos.Length(); i++) {
-        Vec3 f_i(0,0,0);
-        for (size_t j = 0; j < indices[i].size(); j++) {
-            /* Super-elasticity resolution: */
-            // if the spring is over stretched make it stiffer!
-            if ((pos[i] - pos[indices[i][j]]).Magnitude() > 1.1*(pos0[i] - pos0[indices[i][j]]).Magnitude()) {
-                k *= 1.1;
+int main(int argc, char* argv[]) {
+
+    /* A restarted run takes the options of its checkpoint, those given as well override them: a
+     * run is branched by restarting from the same checkpoint with other parameters */
+    SimulationOptions options;
+    for (int a = 1; a + 1 < argc; a++) {
+        if (strcmp(argv[a], "--restart") == 0) {
+            try {
+                ReadCheckpointOptions(argv[a + 1], options);
+            }
+            catch (const std::runtime_error& error) {
+                cerr << "ERR: " << error.what() << "\n";
+                return 1;
             }
-            f_i += (pos[i] - pos[indices[i][j]]).UnitVec()*(-k * ((pos[i] - pos[indices[i][j]]).Magnitude() - (pos0[i] - pos0[indices[i][j]]).Magnitude()));
         }
-        force_int[i] = f_i;
     }
-}
+    if (!ParseOptions(argc, argv, options)) return 1;
 
-/* calculates the viscous forces */
-void viscous_forces(ArrayT<Vec3> vel, double vis_coeff, ArrayT<Vec3> &force_vis) {
-    for (int i = 0; i < vel.Length(); i++) {
-        force_vis[i] = vel[i]*(-vis_coeff);
+    /* e.g. an obstacle file which cannot be read */
+    try {
+        if (options.precision == "float") return Run<float>(options);
+        return Run<double>(options);
     }
-}
-
-/* calculates the gravity (external) forces */
-void gravity_force(double mass, ArrayT<Vec3> &force_gravity) {
-    for (int i = 0; i < force_gravity.Length(); i++) {
-        Vec3 g = {0, 0, -9.8};      // Earth's gravity vector
-        force_gravity[i] = g*mass;
+    catch (const std::runtime_error& error) {
+        cerr << "ERR: " << error.what() << "\n";
+        return 1;
     }
 }
-
-/* storing in CSV files */
-void write_csv(const string &filename, ArrayT<Vec3> dataset) {
-
-    // Create an output filestream object
-    std::ofstream myFile(filename);
-
-    // Send column names to the stream
-    myFile << "ID" << "," << "x" << "," << "y" << "," << "z";
-    myFile << "\n";
-
-    for(int j = 0; j < dataset.Length(); ++j)
-    {
-        myFile << j << "," << dataset[j].x << "," <<  dataset[j].y << "," << dataset[j].z;
-        myFile << "\n";
-
-    }
-
-    // Close the file
-    myFile.close();
-}
@@ -0,0 +1,77 @@
+/* Parameter sweeps: many independent cloth runs in one process
+ *
+ *  SimpleCloth_batch <sweep> [--results results.csv] [--threads n]
+ *
+ * The sweep file holds "--name value..." lines, see ReadSweep(). Every instance runs serially on
+ * one thread of a work-stealing scheduler, the largest first, and appends its summary to the
+ * results.
+ */
+#include "Options.h"
+#include "TaskScheduler.h"
+#include "Ensemble.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 2 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+        cout << "usage: " << argv[0] << " <sweep> [--results results.csv] [--threads n]\n";
+        return argc < 2 ? 1 : 0;
+    }
+
+    string resultsName = "results.csv";
+    int threads = 0;
+    for (int a = 2; a < argc; a++) {
+        if (strcmp(argv[a], "--results") == 0 && a + 1 < argc) resultsName = argv[++a];
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) threads = atoi(argv[++a]);
+        else {
+            cerr << "ERR: unknown option " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    ifstream sweep(argv[1]);
+    if (!sweep) {
+        cerr << "ERR: cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    /* the defaults of SimpleCloth, with the threads of the force stage unused */
+    vector<SimulationOptions> instances;
+    if (!ReadSweep(sweep, SimulationOptions(), instances)) return 1;
+
+    ofstream results(resultsName);
+    if (!results) {
+        cerr << "ERR: cannot create " << resultsName << "\n";
+        return 1;
+    }
+
+    TaskScheduler scheduler(threads);
+    Ensemble ensemble(instances);
+
+    auto start = chrono::steady_clock::now();
+    try {
+        ensemble.Run(scheduler, results);
+    }
+    catch (const std::exception& error) {
+        cerr << "ERR: " << error.what() << "\n";
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double busy = 0.0;
+    for (int i = 0; i < ensemble.NumInstances(); i++) busy += ensemble.Result(i).seconds;
+
+    cout << ensemble.NumInstances() << " instances on " << scheduler.NumThreads() << " threads in " << seconds
+         << " s, " << 100.0*busy/(seconds*scheduler.NumThreads()) << " % busy, " << scheduler.NumSteals()
+         << " steals, results in " << resultsName << "\n";
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/* The cloth of main() on several MPI ranks, for sheets which do not fit one machine.
+ *
+ * Every rank owns a rectangular tile of the N x N grid and writes its own part of the output every
+ * output_interval: pos_t<time>_rank<r>.csv and force_t<time>_rank<r>.csv, rows are labelled with the
+ * global node index. The tiles are the grid of the stencil spring kernel, advanced by the Verlet step
+ * with Jacobi strain sweeps; the options of the other models are rejected.
+ *
+ *      mpirun -np 4 SimpleCloth_mpi --N 2000 --t_final 10
+ */
+#include "DistributedCloth.h"
+#include "Options.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+/* the options DistributedCloth takes, the others select models the tiles do not have */
+static const char* const kSupportedOptions[] = {
+    "--N", "--length", "--mass", "--stiffness", "--damping", "--dt", "--t_final", "--max_strain",
+    "--strain_iter", "--t_release", "--output_interval"
+};
+
+static bool Supported(const string& name) {
+    for (const char* supported : kSupportedOptions)
+        if (name == supported) return true;
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+
+    MPI_Init(&argc, &argv);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* the names are every other argument up to --help, their values are checked by ParseOptions */
+    for (int a = 1; a < argc; a += 2) {
+        if (string(argv[a]) == "--help" || string(argv[a]) == "-h") break;
+        if (!Supported(argv[a])) {
+            if (rank == 0) cerr << "ERR: the distributed cloth does not support " << argv[a] << "\n";
+            MPI_Finalize();
+            return 1;
+        }
+    }
+
+    SimulationOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        MPI_Finalize();
+        return 1;
+    }
+    long outputSteps = Max(lround(options.output_interval/options.dt), 1L);
+
+    try {
+        DistributedCloth cloth(options, MPI_COMM_WORLD);
+
+        double start = MPI_Wtime();
+
+        // Time stepping!
+        while (cloth.Time() < options.t_final) {
+            cloth.Step();
+
+            /* create outputs every output_interval time units */
+            if (options.output_interval > 0.0 && cloth.Counter() % outputSteps == 0) {
+                ostringstream tag;
+                tag << "t" << cloth.Time();
+                cloth.WriteOutput(tag.str());
+            }
+        }
+
+        if (rank == 0) {
+            cout << cloth.Counter() << " steps in " << MPI_Wtime() - start << " s" << endl;
+        }
+    }
+    catch (const std::exception& error) {
+        cerr << "ERR: rank " << rank << ": " << error.what() << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,47 @@
+/* Converts a binary trajectory of SimpleCloth into the CSV files of the older versions, one file
+ * per field and frame: pos_init.csv for the initial frame, then pos_tT.csv, force_tT.csv, ...
+ * with T the time of the frame to six decimals (pos_t10.000000.csv, as read by scripts/plotting.m),
+ * which keeps frames closer than a time unit apart in files of their own
+ *
+ *      SimpleCloth_traj2csv cloth.traj [output directory]
+ */
+#include "Trajectory.h"
+#include "Cloth.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: " << argv[0] << " <trajectory> [output directory]\n";
+        return 1;
+    }
+    string directory = (argc > 2) ? string(argv[2]) + "/" : "";
+
+    try {
+        TrajectoryReader trajectory(argv[1]);
+        if (!trajectory.HasIndex())
+            cerr << "WARNING: " << argv[1] << " was not closed, converting its " << trajectory.NumFrames() << " complete frames\n";
+
+        ArrayT<Vec3> values;
+        for (long frame = 0; frame < trajectory.NumFrames(); frame++) {
+            char time[64];
+            snprintf(time, sizeof(time), "t%.6f", trajectory.Time(frame));
+            string tag = (trajectory.Step(frame) == 0) ? "init" : time;
+
+            for (int field = 0; field < trajectory.NumFields(); field++) {
+                trajectory.CopyField(frame, field, values);
+                write_csv(directory + trajectory.FieldName(field) + "_" + tag + ".csv", values);
+            }
+        }
+    }
+    catch (const std::exception& error) {
+        cerr << "ERR: " << error.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
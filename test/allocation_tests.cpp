@@ -0,0 +1,93 @@
+//
+// Tests of the allocations of the steps. They replace the global operator new, so they are a program
+// of their own.
+//
+
+#define BOOST_TEST_MODULE allocation_unit_tests
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include "../includes/Vec3.h"
+#include "../includes/ArrayT.h"
+#include "../includes/ClothSimulation.h"
+#include "../includes/ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+/* Every heap allocation of this program goes through these, whichever code makes it: the arrays,
+ * the standard containers, the thread pool. NumHeapAllocations() counts them over all the
+ * threads */
+static std::atomic<long> gHeapAllocations(0);
+
+static long NumHeapAllocations() { return gHeapAllocations.load(std::memory_order_relaxed); }
+
+static void* CountedAllocate(size_t bytes) {
+    gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(Max(bytes, size_t(1)));
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t bytes) { return CountedAllocate(bytes); }
+void* operator new[](size_t bytes) { return CountedAllocate(bytes); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+BOOST_AUTO_TEST_SUITE(allocation_testsuite)
+
+    BOOST_AUTO_TEST_CASE(allocation_free_steps)
+    {
+        /* the storage of plain types is aligned to a cache line */
+        ArrayT<Vec3> positions(7);
+        ArrayT<char> flags(3);
+        BOOST_TEST (reinterpret_cast<uintptr_t>(positions.Pointer()) % ARRAY_ALIGNMENT == 0);
+        BOOST_TEST (reinterpret_cast<uintptr_t>(flags.Pointer()) % ARRAY_ALIGNMENT == 0);
+
+        /* an arena keeps its blocks over the resets */
+        StepArena arena(1024);
+        for (int step = 0; step < 3; step++) {
+            ArenaScope scope(arena);
+            ArrayT<double, ArenaAllocator<double> > a(100), b(200);
+            BOOST_TEST (reinterpret_cast<uintptr_t>(b.Pointer()) % ARRAY_ALIGNMENT == 0);
+            BOOST_TEST (arena.NumBlocks() == 2);
+            arena.Reset();
+        }
+        BOOST_TEST (arena.Used() == 0);
+        BOOST_TEST (arena.Peak() == 2432);
+
+        /* after the first steps the steps allocate nothing, serial or threaded: neither the arrays
+         * nor anything else on the heap, over the release of the corner as well */
+        long heap = NumHeapAllocations();
+        std::vector<int> counted(10);
+        BOOST_TEST (NumHeapAllocations() == heap + 1);
+
+        ThreadPool pool(2);
+        SimulationOptions options;
+        options.N = 12;
+        options.t_release = 0.05;
+        for (int config = 0; config < 7; config++) {
+            SimulationOptions o = options;
+            if (config == 1) o.dt_control = "adaptive";
+            if (config == 2) o.integrator = "implicit";
+            if (config == 3) o.sleep_tile = 4;
+            if (config == 4) o.collision = "on";
+            if (config == 5) o.spring_kernel = "edges";
+            if (config == 6) o.air_density = 1.2;
+            ClothSimulation sim(o, (config == 0 || config == 5) ? &pool : NULL);
+            for (int n = 0; n < 20; n++) sim.Step();
+            long before = NumAllocations();
+            long heapBefore = NumHeapAllocations();
+            for (int n = 0; n < 50; n++) sim.Step();
+            BOOST_TEST (NumAllocations() == before);
+            BOOST_TEST (NumHeapAllocations() == heapBefore, "config " << config << ": "
+                        << NumHeapAllocations() - heapBefore << " heap allocations in 50 steps");
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+//
+// Tests of the distributed cloth, run with mpirun -np 4.
+//
+
+#define BOOST_TEST_MODULE mpi_unit_tests
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include "../includes/Vec3.h"
+#include "../includes/ArrayT.h"
+#include "../includes/ClothSimulation.h"
+#include "../includes/DistributedCloth.h"
+
+/* MPI lives as long as the test module */
+struct MpiFixture {
+    MpiFixture() { MPI_Init(NULL, NULL); };
+    ~MpiFixture() { MPI_Finalize(); };
+};
+BOOST_TEST_GLOBAL_FIXTURE(MpiFixture);
+
+BOOST_AUTO_TEST_SUITE(mpi_testsuite)
+
+    BOOST_AUTO_TEST_CASE(tiles_cover_the_grid)
+    {
+        SimulationOptions options;
+        options.N = 13;
+        DistributedCloth cloth(options, MPI_COMM_WORLD);
+
+        ArrayT<int> ids;
+        cloth.OwnedIndices(ids);
+        ArrayT<int> owner(options.N*options.N), total(options.N*options.N);
+        owner = 0;
+        for (int a = 0; a < ids.Length(); a++)
+            owner[ids[a]] += 1;
+        MPI_Allreduce(owner.Pointer(), total.Pointer(), owner.Length(), MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+        for (int n = 0; n < total.Length(); n++)
+            BOOST_TEST (total[n] == 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(distributed_run_matches_serial)
+    {
+        /* the default strain limit, which is not reached, and a tight one which is */
+        double maxStrains[2] = {0.1, 0.0005};
+        for (double maxStrain : maxStrains) {
+            SimulationOptions options;
+            options.N = 17;
+            options.t_release = 0.15;     // let go of the corner half way
+            options.max_strain = maxStrain;
+            int steps = 300;
+
+            DistributedCloth cloth(options, MPI_COMM_WORLD);
+            for (int step = 0; step < steps; step++)
+                cloth.Step();
+
+            /* the serial simulator with the kernels of the tiles: the forces of the stencil and Jacobi sweeps */
+            options.spring_kernel = "stencil";
+            options.strain_sweep = "jacobi";
+            ClothSimulation serial(options);
+            for (int step = 0; step < steps; step++)
+                serial.Step();
+            const ArrayT<Vec3>& pos = serial.Positions();
+            const ArrayT<Vec3>& forces = serial.Forces();
+
+            ArrayT<int> ids;
+            ArrayT<Vec3> owned_pos, owned_force;
+            cloth.OwnedIndices(ids);
+            cloth.OwnedPositions(owned_pos);
+            cloth.OwnedForces(owned_force);
+
+            double moved = 0.0;
+            for (int a = 0; a < ids.Length(); a++) {
+                BOOST_TEST ((owned_pos[a] - pos[ids[a]]).Magnitude() < 1e-10);
+                BOOST_TEST ((owned_force[a] - forces[ids[a]]).Magnitude() < 1e-8);
+                moved = Max(moved, Abs(pos[ids[a]].z));
+            }
+
+            /* the cloth has actually moved */
+            double max_moved;
+            MPI_Allreduce(&moved, &max_moved, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            BOOST_TEST (max_moved > 1e-3);
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
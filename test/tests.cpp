@@ -10,6 +10,44 @@
 
 #include "../includes/Vec3.h"
 #include "../includes/ArrayT.h"
+#include "../includes/SpringNetwork.h"
+#include "../includes/ClothState.h"
+#include "../includes/GridStencil.h"
+#include "../includes/ThreadPool.h"
+#include "../includes/Cloth.h"
+#include "../includes/ForceModels.h"
+#include "../includes/ImplicitIntegrator.h"
+#include "../includes/StrainLimiter.h"
+#include "../includes/Trajectory.h"
+#include "../includes/AsyncTrajectoryWriter.h"
+#include "../includes/ClothSimulation.h"
+#include "../includes/StepController.h"
+#include "../includes/StaticSolver.h"
+#include "../includes/ActivityTracker.h"
+#include "../includes/SelfCollision.h"
+#include "../includes/TriangleMesh.h"
+#include "../includes/Obstacle.h"
+#include "../includes/Garment.h"
+#include "../includes/TaskScheduler.h"
+#include "../includes/Ensemble.h"
+#include "../includes/Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+/* the initial flat N x N grid of the simulator */
+static ArrayT<Vec3> FlatGrid(int N, double length) {
+    ArrayT<Vec3> pos0(N*N);
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+            pos0[N*j + i] = Vec3(i * length / (N - 1), j * length / (N - 1), 0.0);
+    return pos0;
+}
 
 
 BOOST_AUTO_TEST_SUITE(my_testsuite)
@@ -45,5 +83,1344 @@ BOOST_AUTO_TEST_SUITE(my_testsuite)
         BOOST_TEST (v2.x == 4.0);
         BOOST_TEST (v2.y == 6.0);
     }
-    
+    BOOST_AUTO_TEST_CASE(array_expressions)
+    {
+        ArrayT<Vec3> pos(3), pos_old(3), acc(3);
+        for (int n = 0; n < 3; n++) {
+            pos[n] = Vec3(n, 1.0, 2.0);
+            pos_old[n] = Vec3(0.5*n, 1.0, 1.0);
+            acc[n] = Vec3(0.0, 0.0, -10.0);
+        }
+        /* the expression may read the array it is assigned to */
+        pos = 2.0*pos - pos_old + 0.01*acc;
+        for (int n = 0; n < 3; n++) {
+            BOOST_TEST (pos[n].x == 1.5*n);
+            BOOST_TEST (pos[n].y == 1.0);
+            BOOST_TEST (pos[n].z == 2.9, boost::test_tools::tolerance(1e-12));
+        }
+        ArrayT<Vec3> sum;
+        sum = pos_old + acc*2.0;
+        BOOST_TEST (sum.Length() == 3);
+        BOOST_TEST (sum[2].x == 1.0);
+        BOOST_TEST (sum[2].z == -19.0);
+    }
+    BOOST_AUTO_TEST_CASE(array_growth)
+    {
+        ArrayT<int> arr;
+        for (int i = 0; i < 100; i++)
+            arr.Insert(i);
+        BOOST_TEST (arr.Length() == 100);
+        BOOST_TEST (arr.Capacity() >= 100);
+        BOOST_TEST (arr.Capacity() < 200);
+        BOOST_TEST (arr[57] == 57);
+
+        /* inserting an element of the array itself while it grows */
+        ArrayT<int> small;
+        small.Insert(7);
+        for (int i = 0; i < 10; i++)
+            small.Insert(small[0]);
+        BOOST_TEST (small[10] == 7);
+
+        arr.Remove(0);
+        BOOST_TEST (arr.Length() == 99);
+        BOOST_TEST (arr[0] == 1);
+        BOOST_TEST (arr[98] == 99);
+
+        arr.Resize(120);
+        BOOST_TEST (arr[98] == 99);
+        int* memory = arr.Pointer();
+        arr.Dimension(10);
+        BOOST_TEST (arr.Pointer() == memory);
+    }
+    BOOST_AUTO_TEST_CASE(array_move_and_swap)
+    {
+        ArrayT<Vec3> arr1(10), arr2(5);
+        arr1 = Vec3(1, 2, 3);
+        arr2 = Vec3(4, 5, 6);
+        const Vec3* memory1 = arr1.Pointer();
+
+        arr1.swap(arr2);
+        BOOST_TEST (arr1.Length() == 5);
+        BOOST_TEST (arr2.Length() == 10);
+        BOOST_TEST (arr2.Pointer() == memory1);
+        BOOST_TEST (arr2[9].z == 3);
+
+        ArrayT<Vec3> arr3(std::move(arr2));
+        BOOST_TEST (arr3.Pointer() == memory1);
+        BOOST_TEST (arr2.Length() == 0);
+
+        arr1 = std::move(arr3);
+        BOOST_TEST (arr1.Pointer() == memory1);
+        BOOST_TEST (arr1[0].x == 1);
+    }
+    BOOST_AUTO_TEST_CASE(springs_are_stored_once)
+    {
+        int N = 6;
+        SpringNetwork springs = ConnectivityStructure(N);
+        BOOST_TEST (springs.NumNodes() == N*N);
+        BOOST_TEST (springs.NumSprings() == 2*N*(N-1) + 2*(N-1)*(N-1) + 2*N*(N-2));
+
+        /* an interior node has 4 structural, 4 shear and 4 bending springs */
+        int n = N*3 + 3;
+        BOOST_TEST (springs.NumNodeSprings(n) == 12);
+        for (int s = 0; s < springs.NumNodeSprings(n); s++) {
+            const Spring& spring = springs[springs.NodeSprings(n)[s]];
+            BOOST_TEST ((spring.i == n || spring.j == n));
+        }
+    }
+    BOOST_AUTO_TEST_CASE(cached_rest_lengths)
+    {
+        int N = 5;
+        double h = 1.0;
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(FlatGrid(N, h*(N-1)), 10.0);
+        for (int s = 0; s < springs.NumSprings(); s++) {
+            double expected = (springs[s].type == kStructural) ? h : (springs[s].type == kShear) ? sqrt(2.0)*h : 2*h;
+            BOOST_TEST (springs[s].rest == expected, boost::test_tools::tolerance(1e-12));
+            BOOST_TEST (springs[s].k == 10.0);
+        }
+    }
+    BOOST_AUTO_TEST_CASE(spring_forces_balance)
+    {
+        int N = 5;
+        ArrayT<Vec3> pos0 = FlatGrid(N, 4.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 100.0);
+
+        /* the rest state is force free */
+        ArrayT<Vec3> force(N*N);
+        internal_forces(springs, pos0, force);
+        for (int n = 0; n < N*N; n++)
+            BOOST_TEST (force[n].Magnitude() < 1e-12);
+
+        /* Newton's third law: a deformed state has no net internal force */
+        ArrayT<Vec3> pos = FlatGrid(N, 4.0);
+        for (int n = 0; n < N*N; n++)
+            pos[n].z = 0.1*(n % 3) + 0.05*(n % 7);
+        internal_forces(springs, pos, force);
+        Vec3 total;
+        for (int n = 0; n < N*N; n++)
+            total += force[n];
+        BOOST_TEST (total.Magnitude() < 1e-9);
+        BOOST_TEST (force[N*2 + 2].Magnitude() > 0.0);
+    }
+    BOOST_AUTO_TEST_CASE(soa_spring_kernels)
+    {
+        int N = 9;
+        ArrayT<Vec3> pos0 = FlatGrid(N, 8.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 100.0);
+
+        /* deformed state, some springs over-stretched */
+        ArrayT<Vec3> pos = FlatGrid(N, 8.0), force(N*N);
+        for (int n = 0; n < N*N; n++)
+            pos[n] = Vec3(1.15*pos[n].x, pos[n].y, 0.2*sin(1.0*n));
+        internal_forces(springs, pos, force);
+
+        SpringBatches batches;
+        batches.Build(springs);
+        BOOST_TEST (batches.NumSlots() % SPRING_BATCH == 0);
+
+        /* no node appears twice in a batch */
+        for (int b = 0; b < batches.NumSlots(); b += SPRING_BATCH) {
+            for (int l = 0; l < SPRING_BATCH; l++)
+                for (int m = l + 1; m < SPRING_BATCH; m++)
+                    if (batches.k[b + l] > 0 && batches.k[b + m] > 0)
+                        BOOST_TEST ((batches.i[b + l] != batches.i[b + m] && batches.i[b + l] != batches.j[b + m] &&
+                                     batches.j[b + l] != batches.i[b + m] && batches.j[b + l] != batches.j[b + m]));
+        }
+
+        ClothState state(N*N);
+        state.pos.CopyFrom(pos);
+        ArrayT<Vec3> force_soa(N*N);
+        for (int level = kSimdScalar; level <= DetectSimdLevel(); level++) {
+            internal_forces(batches, state, SimdLevel(level));
+            state.force.CopyTo(force_soa);
+            for (int n = 0; n < N*N; n++)
+                BOOST_TEST ((force_soa[n] - force[n]).Magnitude() < 1e-9);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(grid_stencil_forces)
+    {
+        /* a size compiled with N known and one with N at run time */
+        for (int N : {32, 9}) {
+            ArrayT<Vec3> pos0 = FlatGrid(N, 8.0);
+            SpringNetwork springs = ConnectivityStructure(N);
+            springs.SetRestState(pos0, 100.0);
+            GridStencil stencil;
+            stencil.SetRestState(N, pos0, 100.0);
+
+            ArrayT<Vec3> pos = FlatGrid(N, 8.0), force(N*N), force_grid(N*N), force_pool(N*N);
+            for (int n = 0; n < N*N; n++)
+                pos[n] = Vec3(1.15*pos[n].x, pos[n].y, 0.2*sin(1.0*n));
+            internal_forces(springs, pos, force);
+
+            grid_forces(stencil, pos, force_grid);
+            ThreadPool pool(3);
+            grid_forces(stencil, pos, force_pool, pool);
+            for (int n = 0; n < N*N; n++) {
+                BOOST_TEST ((force_grid[n] - force[n]).Magnitude() < 1e-9);
+                BOOST_TEST (force_pool[n].x == force_grid[n].x);
+                BOOST_TEST (force_pool[n].z == force_grid[n].z);
+            }
+
+            ArrayT<Vec3f> posf(N*N), forcef(N*N);
+            for (int n = 0; n < N*N; n++) posf[n] = Vec3f(pos[n]);
+            grid_forces<float, true>(stencil, posf, forcef);
+            for (int n = 0; n < N*N; n++)
+                BOOST_TEST ((Vec3(forcef[n]) - force[n]).Magnitude() < 1e-3);
+        }
+
+        /* the stencil needs the same rest length along a direction */
+        int N = 6;
+        ArrayT<Vec3> pos0 = FlatGrid(N, 5.0);
+        pos0[N + 3].x += 0.1;
+        GridStencil stencil;
+        BOOST_CHECK_THROW (stencil.SetRestState(N, pos0, 100.0), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(coloured_parallel_forces)
+    {
+        int N = 30;
+        ArrayT<Vec3> pos0 = FlatGrid(N, 10.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 100.0);
+        springs.BuildColouring(64);
+
+        /* chunks of the same colour share no node */
+        ArrayT<int> owner(N*N);
+        for (int colour = 0; colour < springs.NumColours(); colour++) {
+            owner = -1;
+            for (int c = 0; c < springs.NumColourChunks(colour); c++) {
+                int chunk = springs.ColourChunks(colour)[c];
+                for (int s = chunk*64; s < Min(chunk*64 + 64, springs.NumSprings()); s++) {
+                    int ends[2] = {springs[s].i, springs[s].j};
+                    for (int e = 0; e < 2; e++) {
+                        BOOST_TEST ((owner[ends[e]] == -1 || owner[ends[e]] == chunk));
+                        owner[ends[e]] = chunk;
+                    }
+                }
+            }
+        }
+
+        ArrayT<Vec3> pos = FlatGrid(N, 10.0);
+        for (int n = 0; n < N*N; n++)
+            pos[n].z = 0.3*sin(0.7*n);
+
+        ArrayT<Vec3> force_serial(N*N);
+        internal_forces(springs, pos, force_serial);
+
+        /* bitwise the same result whatever the number of threads */
+        ArrayT<Vec3> force_one(N*N), force_many(N*N);
+        ThreadPool one(1);
+        internal_forces(springs, pos, force_one, one);
+        for (int threads = 2; threads <= 5; threads++) {
+            ThreadPool pool(threads);
+            internal_forces(springs, pos, force_many, pool);
+            for (int n = 0; n < N*N; n++) {
+                BOOST_TEST (force_many[n].x == force_one[n].x);
+                BOOST_TEST (force_many[n].y == force_one[n].y);
+                BOOST_TEST (force_many[n].z == force_one[n].z);
+            }
+        }
+        for (int n = 0; n < N*N; n++)
+            BOOST_TEST ((force_one[n] - force_serial[n]).Magnitude() < 1e-9);
+
+        ArrayT<Vec3> vel(N*N), force_vis(N*N);
+        vel = Vec3(1.0, -2.0, 0.5);
+        ThreadPool pool(3);
+        viscous_forces(vel, 0.1, force_vis, pool);
+        BOOST_TEST (force_vis[N*N - 1].y == 0.2);
+    }
+
+    BOOST_AUTO_TEST_CASE(fused_verlet_step)
+    {
+        int N = 9;
+        double m = 0.1, c = 0.05, dt = 0.001;
+        ArrayT<Vec3> pos0 = FlatGrid(N, 1.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 1000.0);
+        ArrayT<int> pinned;
+        pinned.Insert(0);
+        pinned.Insert(N-1);
+
+        /* a moving cloth, its previous positions and its velocity */
+        ArrayT<Vec3> pos(N*N), pos_old(N*N), vel(N*N), force_int(N*N);
+        for (int n = 0; n < N*N; n++) {
+            pos[n] = pos0[n] + Vec3(0.0, 0.001*(n % 3), 0.002*(n % 5));
+            vel[n] = Vec3(0.01*(n % 4), 0.0, -0.02);
+            pos_old[n] = pos[n] - vel[n]*dt;
+        }
+        for (int p = 0; p < pinned.Length(); p++) pos_old[pinned[p]] = pos[pinned[p]] = pos0[pinned[p]];
+        internal_forces(springs, pos, force_int);
+
+        /* the same step as the passes of the forces, their sum, the velocities and the positions */
+        ArrayT<Vec3> force_vis(N*N), force_gravity(N*N), forces(N*N), vel_next(N*N), next(N*N);
+        viscous_forces(vel, c, force_vis);
+        gravity_force(m, force_gravity);
+        forces = force_int + force_vis + force_gravity;
+        vel_next = vel + dt*((1.0/m)*forces);
+        next = pos + dt*vel_next;
+        for (int p = 0; p < pinned.Length(); p++) {
+            next[pinned[p]] = pos0[pinned[p]];
+            vel_next[pinned[p]] = Vec3(0, 0, 0);
+        }
+
+        ClothNodeForcesT<double> models(ViscousDragT<double>(c), GravityT<double>(m), WindT<double>(Vec3(0, 0, 0), 0.0));
+        ThreadPool pool(3);
+        /* in one go, on the threads, and by blocks of nodes as the stencil sweep does */
+        for (int variant = 0; variant < 3; variant++) {
+            ArrayT<Vec3> old, v, f;
+            old = pos_old;
+            v = vel;
+            f = force_int;
+            if (variant == 1) verlet_step(models, m, dt, pos, old, v, f, pinned, pos0, pool);
+            else if (variant == 0) verlet_step(models, m, dt, pos, old, v, f, pinned, pos0);
+            else {
+                verlet_step(models, m, dt, pos, old, v, f, 0, 2*N);
+                verlet_step(models, m, dt, pos, old, v, f, 2*N, N*N);
+                verlet_pinned(pinned, pos0, old, v);
+            }
+            for (int n = 0; n < N*N; n++) {
+                BOOST_TEST ((f[n] - forces[n]).Magnitude() == 0.0);
+                BOOST_TEST ((old[n] - next[n]).Magnitude() == 0.0);
+                BOOST_TEST ((v[n] - vel_next[n]).Magnitude() == 0.0);
+                BOOST_TEST ((v[n] - (next[n] - pos[n])*(1.0/dt)).Magnitude() < 1e-12);
+            }
+        }
+
+        /* the velocity of the simulation is that of its last step, so the damping acts on it */
+        SimulationOptions options;
+        options.N = N;
+        ClothSimulation sim(options);
+        for (int n = 0; n < 50; n++) sim.Step();
+        ArrayT<Vec3> before = sim.Positions();
+        sim.Step();
+        double speed = 0.0;
+        for (int n = 0; n < N*N; n++) {
+            BOOST_TEST ((sim.Velocities()[n] - (sim.Positions()[n] - before[n])*(1.0/options.dt)).Magnitude() < 1e-9);
+            speed = Max(speed, sim.Velocities()[n].Magnitude());
+        }
+        BOOST_TEST (speed > 0.1);
+
+        options.c = 0.05;
+        ClothSimulation damped(options);
+        for (int n = 0; n < 51; n++) damped.Step();
+        BOOST_TEST (damped.Positions()[N*N/2].z > sim.Positions()[N*N/2].z);
+    }
+
+    BOOST_AUTO_TEST_CASE(force_models)
+    {
+        int N = 6;
+        double m = 0.1, c = 0.05;
+        Vec3 air(2.0, 0.0, 0.0);
+        ArrayT<Vec3> pos = FlatGrid(N, 1.0), vel(N*N), springs(N*N);
+        for (int n = 0; n < N*N; n++) {
+            vel[n] = Vec3(0.1*n, -0.2, 0.01*n);
+            springs[n] = Vec3(1.0, 2.0, 3.0*n);
+        }
+
+        /* the models of the nodes add up to the separate arrays, into another buffer or in place */
+        ArrayT<Vec3> force_vis(N*N), force_gravity(N*N), expected(N*N);
+        viscous_forces(vel, c, force_vis);
+        gravity_force(m, force_gravity);
+        expected = springs + force_vis + force_gravity;
+        for (int n = 0; n < N*N; n++) expected[n] += (air - vel[n])*0.3;
+
+        ClothNodeForcesT<double> models(ViscousDragT<double>(c), GravityT<double>(m), WindT<double>(air, 0.3));
+        BOOST_TEST (models.Model<WindT<double> >().Enabled());
+        ThreadPool pool(2);
+        ArrayT<Vec3> force(N*N), inPlace;
+        models.Accumulate(pos, vel, springs, force);
+        inPlace = springs;
+        models.Accumulate(pos, vel, inPlace, inPlace, pool);
+        for (int n = 0; n < N*N; n++) {
+            BOOST_TEST ((force[n] - expected[n]).Magnitude() == 0.0);
+            BOOST_TEST ((inPlace[n] - expected[n]).Magnitude() == 0.0);
+        }
+
+        /* a flat triangle in a wind blowing down on it is pushed down, one edge-on to it feels nothing */
+        ArrayT<int> triangle;
+        triangle.Insert(0);
+        triangle.Insert(1);
+        triangle.Insert(N + 1);
+        ArrayT<Vec3> still(N*N);
+        still = Vec3(0, 0, 0);
+        double area = 0.5*0.2*0.2;
+        Aerodynamics down(triangle, Vec3(0, 0, -3.0), 1.2, 1.0, 0.5);
+        force = Vec3(0, 0, 0);
+        down.Accumulate(pos, still, force);
+        Vec3 total = force[0] + force[1] + force[N + 1];
+        BOOST_TEST ((total - Vec3(0, 0, -0.5*1.2*area*9.0)).Magnitude() < 1e-12);
+        Aerodynamics across(triangle, Vec3(3.0, 0, 0), 1.2, 1.0, 0.5);
+        force = Vec3(0, 0, 0);
+        across.Accumulate(pos, still, force);
+        BOOST_TEST (force[0].Magnitude() == 0.0);
+
+        /* at an angle the lift is across the wind, and the triangle moving with the air feels nothing */
+        Aerodynamics lift(triangle, Vec3(3.0, 0, -3.0), 1.2, 0.0, 0.5);
+        force = Vec3(0, 0, 0);
+        lift.Accumulate(pos, still, force);
+        BOOST_TEST (force[0].Magnitude() > 0.0);
+        BOOST_TEST (std::fabs(force[0].Dot(Vec3(3.0, 0, -3.0))) < 1e-12);
+        ArrayT<Vec3> drift(N*N);
+        drift = Vec3(3.0, 0, -3.0);
+        force = Vec3(0, 0, 0);
+        lift.Accumulate(pos, drift, force);
+        BOOST_TEST (force[0].Magnitude() == 0.0);
+
+        /* the wind blows the hanging cloth along y, from the command line and from a checkpoint */
+        SimulationOptions options;
+        options.N = 8;
+        const char* argv[] = {"SimpleCloth", "--wind", "0,3,0", "--wind_drag", "0.01", "--air_density", "1.2"};
+        BOOST_TEST (ParseOptions(7, const_cast<char**>(argv), options));
+        std::stringstream text;
+        WriteOptions(text, options);
+        SimulationOptions read;
+        BOOST_TEST (ReadOptions(text, read));
+        BOOST_TEST (read.wind_y == 3.0);
+        BOOST_TEST (read.air_density == 1.2);
+
+        ClothSimulation windy(read);
+        options.wind_drag = 0.0;
+        options.air_density = 0.0;
+        ClothSimulation calm(options);
+        BOOST_TEST (windy.TriangleForces().NumTriangles() == 2*7*7);
+        double shift = 0.0;
+        for (int n = 0; n < 300; n++) {
+            windy.Step();
+            calm.Step();
+        }
+        for (int n = 0; n < windy.NumNodes(); n++) shift += windy.Positions()[n].y - calm.Positions()[n].y;
+        BOOST_TEST (shift > 0.0);
+
+        /* the sleeping nodes would keep adding the forces of the triangles */
+        const char* sleeping[] = {"SimpleCloth", "--air_density", "1.2", "--sleep_tile", "4"};
+        BOOST_TEST (!ParseOptions(5, const_cast<char**>(sleeping), read));
+    }
+    BOOST_AUTO_TEST_CASE(implicit_steps_are_stable)
+    {
+        /* the hanging cloth of main() with a step 100 times larger than Verlet's */
+        int N = 12;
+        double m = 0.1, c = 0.0001, dt = 0.1;
+        ArrayT<Vec3> pos0 = FlatGrid(N, 10.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 1000.0);
+
+        /* the pattern holds the diagonal and one block per neighbour */
+        BlockSparseMatrix A;
+        A.BuildPattern(springs);
+        BOOST_TEST (A.NumBlocks() == N*N + 2*springs.NumSprings());
+        BOOST_TEST (A.SpringBlock(0, 0) != A.SpringBlock(0, 1));
+
+        ImplicitIntegrator integrator(springs, 1e-8);
+        StepArena arena;
+        ArenaScope scope(arena);
+
+        ArrayT<Vec3> pos, vel(N*N), forces(N*N), force_int(N*N), force_vis(N*N), force_gravity(N*N);
+        pos = pos0;
+        vel = Vec3(0, 0, 0);
+        ArrayT<int> pinned;
+        pinned.Insert(0);
+        pinned.Insert(N-1);
+
+        for (int step = 0; step < 200; step++) {
+            internal_forces(springs, pos, force_int);
+            viscous_forces(vel, c, force_vis);
+            gravity_force(m, force_gravity);
+            forces = force_int + force_vis + force_gravity;
+
+            arena.Reset();
+            integrator.Step(springs, m, c, dt, forces, pinned, pos, vel);
+            BOOST_TEST (integrator.Residual() <= 1e-8);
+        }
+        BOOST_TEST (integrator.TotalSolves() == 200);
+        BOOST_TEST (integrator.TotalSingularBlocks() == 0);
+
+        /* the corners stay put and the cloth hangs below them without blowing up */
+        BOOST_TEST ((pos[0] - pos0[0]).Magnitude() == 0.0);
+        BOOST_TEST ((pos[N-1] - pos0[N-1]).Magnitude() == 0.0);
+        for (int n = 0; n < N*N; n++) {
+            BOOST_TEST (pos[n].z <= 1e-9);
+            BOOST_TEST (pos[n].z > -15.0);
+        }
+
+        /* massless nodes on a straight chain have rank one diagonal blocks, which are preconditioned
+         * by their diagonal, with the second spring compressed as well: the step stays finite */
+        SpringNetwork chain(3, 2);
+        chain.SetSpring(0, 0, 1, kStructural);
+        chain.SetSpring(1, 1, 2, kStructural);
+        ArrayT<Vec3> chainPos(3), chainVel(3), chainForces(3);
+        for (int n = 0; n < 3; n++) chainPos[n] = Vec3(n, 0, 0);
+        chain.SetRestState(chainPos, 100.0);
+        chain.BuildNodeMap();
+        chainPos[2] = Vec3(1.8, 0, 0);
+        chainVel = Vec3(0, 0, 0);
+        internal_forces(chain, chainPos, chainForces);
+
+        ImplicitIntegrator massless(chain, 1e-8);
+        ArrayT<int> first;
+        first.Insert(0);
+        massless.Step(chain, 0.0, 0.0, dt, chainForces, first, chainPos, chainVel);
+        BOOST_TEST (massless.SingularBlocks() == 3);
+        for (int n = 0; n < 3; n++) BOOST_TEST (std::isfinite(chainPos[n].Dot(chainPos[n])));
+        BOOST_TEST (chainPos[2].x > 1.8);
+    }
+
+    BOOST_AUTO_TEST_CASE(static_equilibrium)
+    {
+        int N = 6;
+        double m = 0.1;
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(FlatGrid(N, 5.0), 1000.0);
+
+        ArrayT<Vec3> loads(N*N);
+        gravity_force(m, loads);
+        ArrayT<int> pinned;
+        pinned.Insert(0);
+        pinned.Insert(N-1);
+        pinned.Insert(N*(N-1));
+
+        /* from the flat sheet, which has no stiffness normal to it */
+        ArrayT<Vec3> pos = FlatGrid(N, 5.0);
+        StaticSolver solver(springs, 1e-10);
+        BOOST_TEST (solver.Solve(springs, loads, pinned, pos));
+        BOOST_TEST (solver.Residual() <= 1e-10);
+        BOOST_TEST (solver.Iterations() < 100);
+
+        /* the springs balance the weight at the free nodes, and the pins carry all of it */
+        ArrayT<Vec3> force(N*N);
+        internal_forces(springs, pos, force);
+        BOOST_TEST ((force[N*N-1] + loads[N*N-1]).Magnitude() < 1e-9);
+        Vec3 carried = force[0] + force[N-1] + force[N*(N-1)];
+        BOOST_TEST (carried.z == -(N*N - 3)*m*9.8, boost::test_tools::tolerance(1e-9));
+        BOOST_TEST (pos[0].z == 0.0);
+        BOOST_TEST (pos[N*N-1].z < -1.0);
+
+        /* the simulation starts the release phase from it */
+        SimulationOptions options;
+        options.N = N;
+        options.length = 5.0;
+        options.dt = 0.01;
+        options.t_release = 5.0;
+        ClothSimulation sim(options);
+        BOOST_TEST (sim.StartFromEquilibrium());
+        BOOST_TEST (sim.Time() == 5.0);
+        BOOST_TEST (sim.Counter() == 500);
+        BOOST_TEST (sim.Equilibrium()->Residual() <= options.newton_tolerance);
+        BOOST_TEST (sim.Velocities()[N*N-1].Magnitude() == 0.0);
+        BOOST_TEST (sim.Positions()[N*N-1].z < -1.0);
+        sim.Step();
+        BOOST_TEST (sim.Positions()[N*(N-1)].z < pos[N*(N-1)].z);
+
+        /* short of the equilibrium the cloth stays flat, at rest at the start */
+        options.newton_iterations = 2;
+        ClothSimulation unconverged(options);
+        BOOST_TEST (!unconverged.StartFromEquilibrium());
+        BOOST_TEST (unconverged.Time() == 0.0);
+        BOOST_TEST (unconverged.Counter() == 0);
+        BOOST_TEST (unconverged.Positions()[N*N-1].z == 0.0);
+    }
+
+    BOOST_AUTO_TEST_CASE(strain_limiting)
+    {
+        int N = 8;
+        StepArena arena;
+        ArenaScope scope(arena);
+        ArrayT<Vec3> pos0 = FlatGrid(N, 7.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 100.0);
+
+        ArrayT<int> pinned;
+        pinned.Insert(0);
+        pinned.Insert(N-1);
+
+        /* the spring force is linear in the elongation */
+        Vec3 f1 = SpringForce(Vec3(1.5, 0, 0), Vec3(0, 0, 0), 1.0, 100.0);
+        Vec3 f2 = SpringForce(Vec3(2.0, 0, 0), Vec3(0, 0, 0), 1.0, 100.0);
+        BOOST_TEST (f2.x == 2.0*f1.x);
+
+        StrainSweep sweeps[2] = {kGaussSeidel, kJacobi};
+        for (StrainSweep sweep : sweeps) {
+            /* stretched by 50% and crumpled */
+            ArrayT<Vec3> pos = FlatGrid(N, 7.0);
+            for (int n = 0; n < N*N; n++)
+                pos[n] = Vec3(1.5*pos[n].x, 1.3*pos[n].y, 0.4*sin(1.3*n));
+            pos[0] = pos0[0];
+            pos[N-1] = pos0[N-1];
+
+            StrainLimiter limiter(0.1, 5000, sweep);
+            limiter.Apply(springs, pinned, pos);
+            BOOST_TEST (limiter.Violations() == 0);
+            BOOST_TEST (limiter.Iterations() > 0);
+
+            for (int s = 0; s < springs.NumSprings(); s++) {
+                double length = (pos[springs[s].i] - pos[springs[s].j]).Magnitude();
+                BOOST_TEST (length <= (1.0 + STRAIN_TOLERANCE)*1.1*springs[s].rest);
+            }
+            BOOST_TEST ((pos[0] - pos0[0]).Magnitude() == 0.0);
+            BOOST_TEST ((pos[N-1] - pos0[N-1]).Magnitude() == 0.0);
+        }
+
+        /* no sweep is spent on a cloth within the limit */
+        ArrayT<Vec3> pos = FlatGrid(N, 7.0);
+        StrainLimiter limiter;
+        BOOST_TEST (limiter.Apply(springs, pinned, pos) == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(self_collision)
+    {
+        int N = 8;
+        StepArena arena;
+        ArenaScope scope(arena);
+        ArrayT<Vec3> pos0 = FlatGrid(N, 7.0);
+        SpringNetwork springs = ConnectivityStructure(N);
+        springs.SetRestState(pos0, 100.0);
+
+        /* the hash returns every point of the box */
+        ArrayT<Vec3> points(500);
+        for (int p = 0; p < points.Length(); p++)
+            points[p] = Vec3(3.0*sin(1.7*p), 3.0*cos(0.9*p), 2.0*sin(0.3*p));
+        SpatialHash hash;
+        hash.Build(points, 0.5);
+        BOOST_TEST (hash.NumEntries() >= HASH_LOAD_FACTOR*points.Length());
+        Vec3 low(-1.0, -0.5, -2.0), high(0.7, 1.2, 0.3);
+        ArrayT<int> found(points.Length());
+        found = 0;
+        hash.Query(low, high, [&](int p) { found[p]++; });
+        for (int p = 0; p < points.Length(); p++) {
+            bool inside = points[p].x >= low.x && points[p].x <= high.x && points[p].y >= low.y &&
+                          points[p].y <= high.y && points[p].z >= low.z && points[p].z <= high.z;
+            if (inside) BOOST_TEST (found[p] >= 1);
+        }
+
+        /* the flat cloth has no contacts: the neighbours of the triangles are left out */
+        SelfCollision collision(N, springs, 1.0, 0.3);
+        BOOST_TEST (collision.NumTriangles() == 2*(N-1)*(N-1));
+        BOOST_TEST (collision.Adjacent(0, N+1));
+        BOOST_TEST (!collision.Adjacent(0, 3*N+3));
+        ArrayT<int> pinned;
+        ArrayT<Vec3> pos = pos0;
+        BOOST_TEST (collision.Apply(pos0, pinned, pos) == 0);
+
+        /* the far corner folded over the cloth goes through the triangle (n, n+1, n+N+1) at n = N+1
+         * during the step, it is put back above it and the momentum is kept */
+        int q = N*N-1, n = N+1;
+        ArrayT<Vec3> prev = pos0;
+        prev[q] = Vec3(1.7, 1.2, 0.5);
+        pos = pos0;
+        pos[q] = Vec3(1.7, 1.2, -0.2);
+        Vec3 before(0.0, 0.0, 0.0);
+        for (int p = 0; p < N*N; p++) before += pos[p];
+        BOOST_TEST (collision.Apply(prev, pinned, pos) >= 1);
+        BOOST_TEST (collision.Candidates() > 0);
+
+        Vec3 normal = (pos[n+1] - pos[n]).Cross(pos[n+N+1] - pos[n]).UnitVec();
+        BOOST_TEST (normal.Dot(pos[q] - pos[n]) >= 0.3*(1.0 - 1e-9));
+        Vec3 after(0.0, 0.0, 0.0);
+        for (int p = 0; p < N*N; p++) after += pos[p];
+        BOOST_TEST ((after - before).Magnitude() < 1e-12);
+
+        /* a pinned triangle does not give way, the node takes all of the correction (and more from
+         * the triangles of its own stretched springs) */
+        pinned.Insert(n);
+        pinned.Insert(n+1);
+        pinned.Insert(n+N+1);
+        pos = pos0;
+        pos[q] = Vec3(1.7, 1.2, -0.2);
+        collision.Apply(prev, pinned, pos);
+        BOOST_TEST ((pos[n] - pos0[n]).Magnitude() == 0.0);
+        BOOST_TEST ((pos[n+N+1] - pos0[n+N+1]).Magnitude() == 0.0);
+        BOOST_TEST (pos[q].z >= 0.3*(1.0 - 1e-9));
+
+        /* a simulation with self-collision runs and stays clear of contacts while it just hangs */
+        SimulationOptions options;
+        options.N = N;
+        options.dt = 0.01;
+        options.collision = "on";
+        ClothSimulation sim(options);
+        for (int s = 0; s < 20; s++) sim.Step();
+        BOOST_TEST (sim.Collision() != (const SelfCollision*) NULL);
+        BOOST_TEST (sim.Collision()->Contacts() == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(obstacle_collision)
+    {
+        StepArena arena;
+        ArenaScope scope(arena);
+
+        /* OBJ files: fans of polygons, "a/t/n" and relative indices, through a round trip */
+        const char* filename = "test_obstacle.obj";
+        {
+            std::ofstream out(filename);
+            out << "# a unit square and a triangle\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvn 0 0 1\n"
+                << "f 1/1/1 2/2/1 3/3/1 4/4/1\nf -4 -3 -1\n";
+        }
+        TriangleMesh square = ReadObj(filename);
+        BOOST_TEST (square.NumVertices() == 4);
+        BOOST_TEST (square.NumTriangles() == 3);
+        BOOST_TEST (square.triangles[8] == 3);
+
+        Vec3 center(0.5, 0.5, -1.0);
+        double radius = 1.0;
+        WriteObj(filename, SphereMesh(center, radius, 24));
+        TriangleMesh sphere = ReadObj(filename);
+        BOOST_TEST (sphere.NumTriangles() == 2*24*11);
+        BOOST_CHECK_THROW (ReadObj("no such file.obj"), std::runtime_error);
+
+        /* the closest points of the hierarchy are those of all the triangles one by one */
+        BoundingVolumeHierarchy bvh(sphere);
+        BOOST_TEST (bvh.NumTriangles() == sphere.NumTriangles());
+        BOOST_TEST (bvh.Depth() < BVH_STACK_DEPTH);
+        for (int p = 0; p < 40; p++) {
+            Vec3 point = center + Vec3(1.5*sin(1.3*p), 1.5*cos(0.7*p), 1.5*sin(2.1*p + 0.4));
+            Vec3 closest;
+            int triangle;
+            double distance;
+            BOOST_TEST (bvh.Closest(point, 10.0, closest, triangle, distance));
+
+            double nearest = 10.0;
+            for (int t = 0; t < sphere.NumTriangles(); t++) {
+                TriangleMesh single;
+                for (int c = 0; c < 3; c++) {
+                    single.vertices.Insert(sphere.vertices[sphere.triangles[3*t + c]]);
+                    single.triangles.Insert(c);
+                }
+                Vec3 q;
+                int s;
+                double d;
+                if (BoundingVolumeHierarchy(single).Closest(point, 10.0, q, s, d)) nearest = Min(nearest, d);
+            }
+            BOOST_TEST (distance == nearest, boost::test_tools::tolerance(1e-12));
+        }
+
+        /* a segment through the sphere meets it first on the near side */
+        int triangle;
+        double t;
+        BOOST_TEST (bvh.FirstHit(center + Vec3(0.03, 0.02, 2.0), center + Vec3(0.03, 0.02, -2.0), triangle, t));
+        BOOST_TEST (t > 0.24);
+        BOOST_TEST (t < 0.26);
+        BOOST_TEST (!bvh.FirstHit(center + Vec3(2.0, 0.0, 0.0), center + Vec3(3.0, 0.0, 0.0), triangle, t));
+
+        /* a node falling through the top goes back above it, a pinned one and a far one stay */
+        Obstacle obstacle(sphere, 0.05);
+        ArrayT<Vec3> prev(3), pos(3);
+        prev[0] = center + Vec3(0.1, 0.05, 1.2);
+        pos[0] = center + Vec3(0.1, 0.05, 0.7);
+        prev[1] = pos[1] = center + Vec3(0.0, 0.2, 0.9);
+        prev[2] = pos[2] = center + Vec3(3.0, 0.0, 0.0);
+        ArrayT<int> pinned;
+        pinned.Insert(1);
+        BOOST_TEST (obstacle.Apply(prev, pinned, pos) == 1);
+        BOOST_TEST (pos[0].z > center.z + radius*0.99);
+        BOOST_TEST ((pos[1] - prev[1]).Magnitude() == 0.0);
+        BOOST_TEST ((pos[2] - prev[2]).Magnitude() == 0.0);
+
+        /* the cloth falls onto the sphere and stays outside of it, the same with threads */
+        SimulationOptions options;
+        options.N = 8;
+        options.length = 1.0;
+        options.dt = 0.001;
+        options.obstacle = filename;
+        ArrayT<Vec3> serial;
+        for (int threads : {1, 3}) {
+            ThreadPool pool(threads);
+            ClothSimulation sim(options, &pool);
+            for (int s = 0; s < 300; s++) sim.Step();
+            BOOST_TEST (sim.Obstacles()->TotalContacts() > 0);
+            for (int n = 0; n < sim.NumNodes(); n++)
+                BOOST_TEST ((sim.Positions()[n] - center).Magnitude() > radius*0.98);
+            if (threads == 1) serial = sim.Positions();
+            else for (int n = 0; n < sim.NumNodes(); n++) BOOST_TEST ((sim.Positions()[n] - serial[n]).Magnitude() == 0.0);
+        }
+        std::remove(filename);
+    }
+
+    BOOST_AUTO_TEST_CASE(trajectory_round_trip)
+    {
+        int N = 6;
+        ArrayT<Vec3> pos = FlatGrid(N, 5.0), force(N*N);
+        const char* filename = "test_trajectory.traj";
+
+        {
+            TrajectoryWriter writer(filename, N*N, N, 0.01, {"pos", "force"});
+            for (int frame = 0; frame < 3; frame++) {
+                for (int n = 0; n < N*N; n++) {
+                    pos[n].z = 0.1*frame*n;
+                    force[n] = Vec3(n, -frame, 0.5);
+                }
+                writer.WriteFrame(10.0*frame, 1000*frame, {&pos, &force});
+            }
+            writer.Flush();
+
+            /* a file still being written: the frames are found from its size */
+            TrajectoryReader partial(filename);
+            BOOST_TEST (!partial.HasIndex());
+            BOOST_TEST (partial.NumFrames() == 3);
+        }
+
+        TrajectoryReader reader(filename);
+        BOOST_TEST (reader.HasIndex());
+        BOOST_TEST (reader.NumFrames() == 3);
+        BOOST_TEST (reader.NumNodes() == N*N);
+        BOOST_TEST (reader.GridSize() == N);
+        BOOST_TEST (reader.Dt() == 0.01);
+        BOOST_TEST (reader.FieldIndex("force") == 1);
+        BOOST_TEST (reader.FieldIndex("vel") == -1);
+        BOOST_TEST (reader.Time(2) == 20.0);
+        BOOST_TEST (reader.Step(1) == 1000);
+
+        /* interleaved x, y, z, straight from the mapping */
+        const double* p = reader.Field(2, 0);
+        BOOST_TEST (p[3*7] == pos[7].x);
+        BOOST_TEST (p[3*7 + 1] == pos[7].y);
+        BOOST_TEST (p[3*7 + 2] == 0.1*2*7);
+
+        ArrayT<Vec3> values;
+        reader.CopyField(1, reader.FieldIndex("force"), values);
+        BOOST_TEST (values[5].x == 5.0);
+        BOOST_TEST (values[5].y == -1.0);
+
+        reader.Close();
+
+        /* a corrupt frame stride is refused rather than divided by */
+        {
+            std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+            int64_t stride = 0;
+            file.seekp(offsetof(TrajectoryHeader, frameStride));
+            file.write(reinterpret_cast<const char*>(&stride), sizeof(stride));
+        }
+        BOOST_CHECK_THROW (TrajectoryReader corrupt(filename), std::runtime_error);
+
+        /* so are a negative frame count and a frame offset beyond the index */
+        int64_t stride = TRAJECTORY_FRAME_HEADER + 2*3*N*N*sizeof(double);
+        {
+            std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+            int64_t numFrames = -1;
+            file.seekp(offsetof(TrajectoryHeader, frameStride));
+            file.write(reinterpret_cast<const char*>(&stride), sizeof(stride));
+            file.seekp(offsetof(TrajectoryHeader, numFrames));
+            file.write(reinterpret_cast<const char*>(&numFrames), sizeof(numFrames));
+        }
+        BOOST_CHECK_THROW (TrajectoryReader corrupt(filename), std::runtime_error);
+        {
+            std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+            int64_t numFrames = 3, offset = TRAJECTORY_HEADER_SIZE + 3*stride;
+            file.seekp(offsetof(TrajectoryHeader, numFrames));
+            file.write(reinterpret_cast<const char*>(&numFrames), sizeof(numFrames));
+            file.seekp(TRAJECTORY_HEADER_SIZE + 3*stride + 2*sizeof(TrajectoryIndexEntry) + offsetof(TrajectoryIndexEntry, offset));
+            file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        }
+        BOOST_CHECK_THROW (TrajectoryReader corrupt(filename), std::runtime_error);
+        std::remove(filename);
+    }
+
+    BOOST_AUTO_TEST_CASE(async_trajectory_writer)
+    {
+        int N = 10;
+        ArrayT<Vec3> pos = FlatGrid(N, 5.0), force(N*N);
+        const char* filename = "test_async.traj";
+
+        /* a single buffer forces Submit() to wait for the writer */
+        AsyncTrajectoryWriter writer(filename, N*N, N, 0.1, {"pos", "force"}, 1);
+        for (int frame = 0; frame < 20; frame++) {
+            pos = Vec3(frame, 0, 0);
+            force = Vec3(0, 0, -frame);
+            writer.Submit(0.1*frame, frame, {&pos, &force});
+        }
+        writer.Close();
+        BOOST_TEST (writer.NumWritten() == 20);
+        BOOST_TEST (writer.MaxQueueDepth() == 1);
+
+        /* the frames are the arrays at the time of Submit() */
+        TrajectoryReader reader(filename);
+        BOOST_TEST (reader.NumFrames() == 20);
+        for (long frame = 0; frame < reader.NumFrames(); frame++) {
+            BOOST_TEST (reader.Step(frame) == frame);
+            BOOST_TEST (reader.Field(frame, 0)[3*(N*N - 1)] == double(frame));
+            BOOST_TEST (reader.Field(frame, 1)[2] == -double(frame));
+        }
+        reader.Close();
+        std::remove(filename);
+    }
+
+    BOOST_AUTO_TEST_CASE(checkpoint_restart)
+    {
+        SimulationOptions options;
+        options.N = 8;
+        options.dt = 0.01;
+        options.t_release = 0.15;
+        options.cg_tolerance = 1e-8;
+        const char* filename = "test_restart.chk";
+
+        /* the options survive the round trip exactly */
+        std::stringstream text;
+        WriteOptions(text, options);
+        SimulationOptions read;
+        BOOST_TEST (ReadOptions(text, read));
+        BOOST_TEST (read.dt == options.dt);
+        BOOST_TEST (read.t_release == options.t_release);
+        BOOST_TEST (read.output == options.output);
+
+        for (const char* integrator : {"verlet", "implicit", "adaptive verlet", "sleeping verlet"}) {
+            options.integrator = std::string(integrator) == "implicit" ? "implicit" : "verlet";
+            options.dt_control = std::string(integrator) == "adaptive verlet" ? "adaptive" : "fixed";
+            bool sleeping = std::string(integrator) == "sleeping verlet";
+            int K = 20;
+
+            /* the damped cloth settles: most tiles sleep at the checkpoint, the release wakes them after it */
+            if (sleeping) {
+                options.dt = 0.001;
+                options.c = 0.3;
+                options.t_release = 4.0;
+                options.sleep_tile = 2;
+                options.sleep_displacement = 1e-3;
+                options.sleep_force = 0.5;
+                options.sleep_steps = 5;
+                K = 3400;
+            }
+
+            /* 2K steps in one go, and K steps before and after a checkpoint */
+            ClothSimulation straight(options);
+            for (int n = 0; n < 2*K; n++) straight.Step();
+
+            ClothSimulation first(options);
+            for (int n = 0; n < K; n++) first.Step();
+            if (sleeping) BOOST_TEST (first.Activity()->NumAwakeTiles() < first.Activity()->NumTiles()/2);
+            first.WriteCheckpoint(filename);
+
+            SimulationOptions stored;
+            ReadCheckpointOptions(filename, stored);
+            BOOST_TEST (stored.integrator == options.integrator);
+            BOOST_TEST (stored.dt_control == options.dt_control);
+
+            ClothSimulation second(stored);
+            second.ReadCheckpoint(filename);
+            BOOST_TEST (second.Counter() == K);
+            for (int n = 0; n < K; n++) second.Step();
+
+            /* bit for bit */
+            BOOST_TEST (second.Time() == straight.Time());
+            for (int n = 0; n < straight.NumNodes(); n++) {
+                BOOST_TEST (second.Positions()[n].x == straight.Positions()[n].x);
+                BOOST_TEST (second.Positions()[n].y == straight.Positions()[n].y);
+                BOOST_TEST (second.Positions()[n].z == straight.Positions()[n].z);
+                BOOST_TEST (second.Velocities()[n].z == straight.Velocities()[n].z);
+            }
+        }
+
+        /* an options length beyond the end of the file is a corrupt checkpoint, not an allocation */
+        {
+            std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+            int64_t length = int64_t(1) << 60;
+            file.seekp(16);
+            file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        }
+        SimulationOptions corrupt;
+        BOOST_CHECK_THROW (ReadCheckpointOptions(filename, corrupt), std::runtime_error);
+        std::remove(filename);
+    }
+
+    BOOST_AUTO_TEST_CASE(adaptive_steps)
+    {
+        /* growth, stability and the landing on events without slivers */
+        StepController controller(0.001, 1e-6, 0.01, 1e-4, 0.5, true);
+        BOOST_TEST (controller.NextStep(0.0, 10.0, 1.0, 0.0) == STEP_GROWTH*0.001);
+        BOOST_TEST (controller.NextStep(0.0012, 10.0, 0.002, 0.0) == 0.001);
+        BOOST_TEST (controller.Count(kStepLimitStability) == 1);
+        BOOST_TEST (controller.NextStep(9.9995, 10.0, 1.0, 0.0) == 0.0005, boost::test_tools::tolerance(1e-9));
+        BOOST_TEST (controller.NextStep(9.9985, 10.0, 1.0, 0.0) == 0.00075, boost::test_tools::tolerance(1e-9));
+        BOOST_TEST (controller.Count(kStepLimitEvent) == 2);
+
+        /* the error estimate dt^3 jerk/6 meets the tolerance, the implicit scheme has no stability limit */
+        StepController implicit(0.01, 1e-6, 0.01, 1e-4, 0.5, false);
+        BOOST_TEST (implicit.NextStep(0.0, 10.0, 0.0, 6.0*1e-4/1e-9) == 0.001, boost::test_tools::tolerance(1e-9));
+        BOOST_TEST (implicit.NextStep(0.0, 10.0, 0.0, 1e30) == 1e-6);
+        BOOST_TEST (implicit.Count(kStepLimitError) == 1);
+        BOOST_TEST (implicit.Count(kStepLimitMin) == 1);
+
+        /* without springs the nodes fall freely: the time-corrected Verlet steps are exact for a
+         * constant acceleration however their sizes change */
+        SimulationOptions options;
+        options.N = 6;
+        options.k = 0.0;
+        options.c = 0.0;
+        options.strain_iterations = 0;
+        options.dt_control = "adaptive";
+        options.dt_max = 0.05;
+        options.output_interval = 0.5;
+        options.t_final = 2.0;
+        ClothSimulation sim(options);
+        int outputs = 0;
+        while (!sim.Finished()) {
+            sim.Step();
+            if (sim.OnMultipleOf(options.output_interval)) outputs++;
+        }
+        BOOST_TEST (sim.Time() == 2.0);
+        BOOST_TEST (outputs == 4);
+        BOOST_TEST (sim.Controller()->Largest() == 0.05);
+        BOOST_TEST (sim.Counter() < 80);
+        BOOST_TEST (sim.Positions()[8].z == -0.5*9.8*4.0, boost::test_tools::tolerance(1e-10));
+        /* the velocity is the mean one of the last step */
+        double last = sim.Controller()->LastStep();
+        BOOST_TEST (sim.Velocities()[8].z == -9.8*(2.0 - 0.5*last), boost::test_tools::tolerance(1e-10));
+        BOOST_TEST (sim.Positions()[0].z == 0.0);
+    }
+
+    BOOST_AUTO_TEST_CASE(sleeping_tiles)
+    {
+        /* 3 x 3 tiles of 4 x 4 nodes: the corner tile keeps moving, its neighbours stay awake */
+        ActivityTracker tracker(12, 4, 1e-3, 1e-3, 3);
+        StepArena arena;
+        ArenaScope scope(arena);
+        BOOST_TEST (tracker.NumTiles() == 9);
+        for (int step = 0; step < 3; step++) {
+            for (int t = 0; t < tracker.NumTiles(); t++) tracker.Record(t, t == 0 ? 1.0 : 0.0, 0.0);
+            tracker.Update();
+        }
+        BOOST_TEST (tracker.NumAwakeTiles() == 4);
+        BOOST_TEST (tracker.Awake(1));
+        BOOST_TEST (tracker.Awake(4));
+        BOOST_TEST (!tracker.Awake(8));
+        BOOST_TEST (tracker.ActiveNodes() == 4*16);
+        BOOST_TEST (tracker.NodesAsleep()[12*11 + 11] == 1);
+        BOOST_TEST (tracker.NodesAsleep()[0] == 0);
+
+        /* a sleeping tile wakes when a neighbour moves */
+        tracker.Record(1, 1.0, 0.0);
+        tracker.Update();
+        BOOST_TEST (tracker.Awake(2));
+        BOOST_TEST (tracker.Awake(5));
+        BOOST_TEST (!tracker.Awake(8));
+        tracker.WakeAll();
+        BOOST_TEST (tracker.ActiveFraction() == 1.0);
+
+        /* with zero thresholds nothing sleeps and the steps are those without tiles */
+        SimulationOptions options;
+        options.N = 10;
+        options.dt = 0.01;
+        options.t_release = 0.15;
+        ClothSimulation reference(options);
+        options.sleep_tile = 4;
+        options.sleep_displacement = 0.0;
+        options.sleep_force = 0.0;
+        ClothSimulation awake(options);
+        for (int n = 0; n < 30; n++) {
+            reference.Step();
+            awake.Step();
+        }
+        BOOST_TEST (awake.Activity()->ActiveFraction() == 1.0);
+        for (int n = 0; n < reference.NumNodes(); n++) {
+            BOOST_TEST (awake.Positions()[n].x == reference.Positions()[n].x);
+            BOOST_TEST (awake.Positions()[n].z == reference.Positions()[n].z);
+        }
+
+        /* the residual force of a falling node is its weight: a sleep_force above it would freeze the
+         * falling cloth in mid-air */
+        SimulationOptions frozen;
+        const char* argv[] = {"SimpleCloth", "--sleep_tile", "4", "--sleep_force", "1.0"};
+        BOOST_TEST (!ParseOptions(5, const_cast<char**>(argv), frozen));
+        argv[4] = "0.9";
+        BOOST_TEST (ParseOptions(5, const_cast<char**>(argv), frozen));
+
+        /* the damped cloth settles: it sleeps at rest, stays put until the release wakes it, and
+         * falls asleep again once it hangs from the two corners left */
+        options.dt = 0.001;
+        options.c = 0.3;
+        options.t_release = 6.0;
+        options.sleep_displacement = 1e-3;
+        options.sleep_force = 0.5;
+        options.sleep_steps = 5;
+        ClothSimulation sleeping(options);
+        while (sleeping.Time() < 5.5) sleeping.Step();
+        BOOST_TEST (sleeping.Activity()->NumAwakeTiles() == 0);
+        ArrayT<Vec3> asleep = sleeping.Positions();
+        sleeping.Step();
+        for (int n = 0; n < sleeping.NumNodes(); n++) {
+            BOOST_TEST (sleeping.Positions()[n].z == asleep[n].z);
+            BOOST_TEST (sleeping.Velocities()[n].Magnitude() == 0.0);
+        }
+        while (sleeping.Time() < options.t_release + 0.5*options.dt) sleeping.Step();
+        BOOST_TEST (sleeping.Activity()->ActiveFraction() == 1.0);
+        BOOST_TEST (sleeping.Positions()[50].z < asleep[50].z);
+        while (sleeping.Time() < 16.0) sleeping.Step();
+        BOOST_TEST (sleeping.Activity()->NumAwakeTiles() == 0);
+        for (int n = 0; n < sleeping.NumNodes(); n++) BOOST_TEST (sleeping.Velocities()[n].Magnitude() == 0.0);
+        BOOST_TEST (sleeping.Positions()[50].z < asleep[50].z - 1.0);
+        BOOST_TEST (sleeping.Activity()->MeanActiveFraction() < 1.0);
+    }
+
+    BOOST_AUTO_TEST_CASE(trajectory_resume)
+    {
+        int N = 5;
+        ArrayT<Vec3> pos = FlatGrid(N, 1.0);
+        const char* filename = "test_resume.traj";
+
+        TrajectoryWriter writer(filename, N*N, N, 0.1, {"pos"});
+        for (int frame = 0; frame < 6; frame++) writer.WriteFrame(0.1*frame, 10*frame, {&pos});
+        writer.Close();
+
+        /* a restart at step 30 drops the frames after it */
+        writer.Resume(filename, N*N, N, 0.1, {"pos"}, 30);
+        BOOST_TEST (writer.NumFrames() == 4);
+        writer.WriteFrame(0.4, 40, {&pos});
+        writer.Close();
+
+        TrajectoryReader reader(filename);
+        BOOST_TEST (reader.HasIndex());
+        BOOST_TEST (reader.NumFrames() == 5);
+        for (long frame = 0; frame < reader.NumFrames(); frame++) BOOST_TEST (reader.Step(frame) == 10*frame);
+        reader.Close();
+
+        /* another kind of trajectory is started anew */
+        writer.Resume(filename, N*N, N, 0.2, {"pos"}, 30);
+        BOOST_TEST (writer.NumFrames() == 0);
+        writer.Close();
+        std::remove(filename);
+    }
+
+    BOOST_AUTO_TEST_CASE(task_scheduler)
+    {
+        /* uneven tasks, every one runs exactly once */
+        int numTasks = 100;
+        ArrayT<double> costs(numTasks);
+        for (int t = 0; t < numTasks; t++) costs[t] = (t*37) % 11;
+
+        TaskScheduler scheduler(4);
+        std::vector<std::atomic<int> > runs(numTasks);
+        scheduler.Run(costs, [&](int task, int thread) {
+            BOOST_REQUIRE (thread >= 0 && thread < 4);
+            runs[task]++;
+        });
+        for (int t = 0; t < numTasks; t++) BOOST_TEST (runs[t] == 1);
+
+        /* a failing task does not stop the others */
+        for (int t = 0; t < numTasks; t++) runs[t] = 0;
+        BOOST_CHECK_THROW (scheduler.Run(costs, [&](int task, int) {
+            runs[task]++;
+            if (task == 7) throw std::runtime_error("task 7");
+        }), std::runtime_error);
+        for (int t = 0; t < numTasks; t++) BOOST_TEST (runs[t] == 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(ensemble_sweep)
+    {
+        std::istringstream sweep("# a small sweep\n--t_final 0.05\n--N 4 6\n\n--stiffness 500 1000 2000\n");
+        std::vector<SimulationOptions> instances;
+        BOOST_REQUIRE (ReadSweep(sweep, SimulationOptions(), instances));
+        BOOST_TEST (instances.size() == 6u);
+        BOOST_TEST (instances[1].N == 4);
+        BOOST_TEST (instances[1].k == 1000.0);
+        BOOST_TEST (instances[5].N == 6);
+        BOOST_TEST (instances[5].t_final == 0.05);
+
+        std::istringstream invalid("--N 2\n");
+        BOOST_TEST (!ReadSweep(invalid, SimulationOptions(), instances));
+
+        /* the instances are the same runs as on their own */
+        std::istringstream sizes("--t_final 0.05\n--N 4 6\n--stiffness 500 1000 2000\n");
+        ReadSweep(sizes, SimulationOptions(), instances);
+        Ensemble ensemble(instances);
+        TaskScheduler scheduler(3);
+        std::ostringstream results;
+        ensemble.Run(scheduler, results);
+
+        int rows = 0;
+        for (char ch : results.str()) rows += ch == '\n';
+        BOOST_TEST (rows == 7);
+
+        for (int i = 0; i < ensemble.NumInstances(); i++) {
+            ClothSimulation sim(instances[i]);
+            while (!sim.Finished()) sim.Step();
+            BOOST_TEST (ensemble.Result(i).steps == sim.Counter());
+
+            double lowest = sim.Positions()[0].z;
+            for (int n = 0; n < sim.NumNodes(); n++) lowest = Min(lowest, sim.Positions()[n].z);
+            BOOST_TEST (ensemble.Result(i).lowest == lowest);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(garment_import)
+    {
+        /* PLY files: ASCII with a quad, binary with properties and elements which are skipped */
+        const char* filename = "test_garment.ply";
+        {
+            std::ofstream out(filename);
+            out << "ply\nformat ascii 1.0\ncomment a unit square\nelement vertex 4\nproperty float x\nproperty float y\n"
+                << "property float z\nelement face 1\nproperty list uchar int vertex_indices\nend_header\n"
+                << "0 0 0\n1 0 0\n1 1 0\n0 1 0\n4 0 1 2 3\n";
+        }
+        TriangleMesh square = ReadMesh(filename);
+        BOOST_TEST (square.NumVertices() == 4);
+        BOOST_TEST (square.NumTriangles() == 2);
+        BOOST_TEST (square.triangles[5] == 3);
+        {
+            std::ofstream out(filename, std::ios::binary);
+            out << "ply\nformat binary_little_endian 1.0\nelement vertex 3\nproperty double x\nproperty uchar red\n"
+                << "property double y\nproperty double z\nelement face 1\nproperty list uchar uint vertex_index\n"
+                << "property short flags\nelement edge 1\nproperty int vertex1\nproperty int vertex2\nend_header\n";
+            auto put = [&](uint64_t bits, int bytes) {
+                for (int b = 0; b < bytes; b++) out.put(char((bits >> 8*b) & 0xff));
+            };
+            auto putDouble = [&](double value) {
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                put(bits, 8);
+            };
+            for (int v = 0; v < 3; v++) {
+                putDouble(v);
+                put(255, 1);
+                putDouble(2.0*v);
+                putDouble(-0.5);
+            }
+            put(3, 1);
+            for (int c = 2; c >= 0; c--) put(c, 4);
+            put(7, 2);
+            put(0, 4);
+            put(1, 4);
+        }
+        TriangleMesh triangle = ReadMesh(filename);
+        BOOST_TEST (triangle.NumVertices() == 3);
+        BOOST_TEST (triangle.NumTriangles() == 1);
+        BOOST_TEST (triangle.vertices[2].y == 4.0);
+        BOOST_TEST (triangle.vertices[1].z == -0.5);
+        BOOST_TEST (triangle.triangles[0] == 2);
+        std::remove(filename);
+        BOOST_CHECK_THROW (ReadPly("no such file.ply"), std::runtime_error);
+
+        /* a grid of 2 x 2 quads cut into triangles: 12 structural springs, both diagonals of the quads
+         * as shear springs and a bending spring across each of the 4 inner edges */
+        TriangleMesh grid;
+        for (int j = 0; j < 3; j++)
+            for (int i = 0; i < 3; i++) grid.vertices.Insert(Vec3(i, j, 0.0));
+        for (int j = 0; j < 2; j++) {
+            for (int i = 0; i < 2; i++) {
+                int quad[6] = {3*j + i, 3*j + i + 1, 3*(j + 1) + i + 1, 3*j + i, 3*(j + 1) + i + 1, 3*(j + 1) + i};
+                for (int c = 0; c < 6; c++) grid.triangles.Insert(quad[c]);
+            }
+        }
+        SpringNetwork springs = MeshSprings(grid);
+        int count[3] = {0, 0, 0};
+        for (int s = 0; s < springs.NumSprings(); s++) {
+            count[springs[s].type]++;
+            BOOST_TEST (springs[s].i < springs[s].j);
+            if (s > 0) BOOST_TEST (springs[s - 1].i <= springs[s].i);
+        }
+        BOOST_TEST (count[kStructural] == 12);
+        BOOST_TEST (count[kShear] == 8);
+        BOOST_TEST (count[kBending] == 4);
+
+        /* the numberings of a sleeve whose vertices come in a scattered order */
+        TriangleMesh tube = TubeMesh(Vec3(0.0, 0.0, 0.0), 1.0, 4.0, 24, 16);
+        int V = tube.NumVertices();
+        ArrayT<int> scatter(V);
+        for (int n = 0; n < V; n++) scatter[n] = int((7919L*n) % V);
+        TriangleMesh scattered = RenumberVertices(tube, scatter);
+        SpringNetwork imported = MeshSprings(scattered);
+        for (NodeOrder order : {kImportOrder, kCuthillMcKee, kMortonOrder}) {
+            ArrayT<int> numbering = NodeNumbering(scattered, order);
+            ArrayT<int> sorted = numbering;
+            std::sort(sorted.Pointer(), sorted.Pointer() + V);
+            for (int n = 0; n < V; n++) BOOST_TEST (sorted[n] == n);
+
+            SpringNetwork renumbered = MeshSprings(RenumberVertices(scattered, numbering));
+            BOOST_TEST (renumbered.NumSprings() == imported.NumSprings());
+            if (order != kImportOrder) BOOST_TEST (MeanSpringSpan(renumbered) < 0.25*MeanSpringSpan(imported));
+        }
+        BOOST_TEST (Bandwidth(MeshSprings(RenumberVertices(scattered, NodeNumbering(scattered, kCuthillMcKee)))) < 4*24);
+
+        /* hanging from its top circle, the sleeve moves the same in every numbering. The Gauss-Seidel
+         * sweeps of the strain limiting follow the order of the springs, they are left out */
+        const char* garment = "test_garment.obj";
+        WriteObj(garment, scattered);
+        SimulationOptions options;
+        options.garment = garment;
+        options.strain_iterations = 0;
+        ArrayT<Vec3> reference;
+        for (const char* order : {"import", "rcm", "morton"}) {
+            options.node_order = order;
+            ClothSimulation sim(options);
+            BOOST_TEST (sim.NumNodes() == V);
+            BOOST_TEST (sim.ImportIndices().Length() == V);
+            for (int n = 0; n < 200; n++) sim.Step();
+
+            ArrayT<Vec3> pos(V);
+            for (int n = 0; n < V; n++) pos[sim.ImportIndices()[n]] = sim.Positions()[n];
+            if (reference.Length() == 0) reference = pos;
+            double difference = 0.0;
+            for (int n = 0; n < V; n++) difference = Max(difference, (pos[n] - reference[n]).Magnitude());
+            BOOST_TEST (difference < 1e-9);
+        }
+        for (int n = 0; n < V; n++) {
+            if (scattered.vertices[n].z == 4.0) BOOST_TEST (reference[n].z == 4.0);
+            else BOOST_TEST (reference[n].z < scattered.vertices[n].z);
+        }
+
+        /* garments take the spring list by default, asking for the stencil is an error */
+        SimulationOptions stencil;
+        stencil.garment = garment;
+        stencil.spring_kernel = "stencil";
+        BOOST_CHECK_THROW (ClothSimulation sim(stencil), std::runtime_error);
+        stencil.spring_kernel = "auto";
+        ClothSimulation sleeve(stencil);
+        BOOST_TEST (sleeve.NumNodes() == V);
+
+        /* a flat garment has nothing to hang from */
+        WriteObj(garment, grid);
+        BOOST_CHECK_THROW (ClothSimulation flat(options), std::runtime_error);
+        std::remove(garment);
+    }
+
+    BOOST_AUTO_TEST_CASE(profiler_scopes)
+    {
+        /* the classes work whether or not the PROFILE_* macros are compiled in */
+        Profiler& profiler = Profiler::Instance();
+        profiler.Reset();
+        for (int n = 0; n < 3; n++) {
+            ProfileScope scope(kProfileCheckpoint);
+        }
+        profiler.AddBytes(kProfileCheckpoint, 1000000);
+
+        std::ostringstream table;
+        profiler.Print(table, 10, 100, 1.0);
+        BOOST_TEST (table.str().find("checkpoint") != std::string::npos);
+        BOOST_TEST (table.str().find("1.00 MB written") != std::string::npos);
+        BOOST_TEST (table.str().find("gravity") == std::string::npos);
+        profiler.Reset();
+    }
+
+    BOOST_AUTO_TEST_CASE(precision_tiers)
+    {
+        /* the estimates refined by Newton steps are close to 1/sqrt */
+        for (double value : {1e-4, 0.25, 1.0, 3.0, 1e4}) {
+            BOOST_TEST (std::fabs(ApproxRsqrt(float(value))*std::sqrt(value) - 1.0) < 1e-6);
+            BOOST_TEST (std::fabs(ApproxRsqrt(value)*std::sqrt(value) - 1.0) < 1e-11);
+        }
+
+        SimulationOptions options;
+        options.N = 8;
+        options.t_release = 0.1;
+        int K = 500;
+
+        ClothSimulation reference(options);
+        for (int n = 0; n < K; n++) reference.Step();
+
+        /* the single precision and approximate tiers stay near the reference */
+        options.precision = "float";
+        options.rsqrt = "approx";
+        ClothSimulationT<float> preview(options);
+        for (int n = 0; n < K; n++) preview.Step();
+
+        double deviation = 0.0;
+        for (int n = 0; n < reference.NumNodes(); n++) {
+            deviation = Max(deviation, (Vec3(preview.Positions()[n]) - reference.Positions()[n]).Magnitude());
+        }
+        BOOST_TEST (deviation < 1e-4);
+
+        /* the implicit integrator is double only */
+        options.integrator = "implicit";
+        BOOST_CHECK_THROW (ClothSimulationT<float> implicit(options), std::runtime_error);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()